@@ -180,7 +180,7 @@ impl ValidatingMockServer {
 
   /// Returns the metrics collected by the mock server
   pub fn metrics(&self) -> MockServerMetrics {
-    self.mock_server.lock().unwrap().metrics.clone()
+    self.mock_server.lock().unwrap().metrics()
   }
 }
 
@@ -0,0 +1,193 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "pact.h"
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+  Load driver for the mock server. It starts a mock server with pactffi_create_mock_server, makes
+  requests to it with the curl multi interface, keeping the given number of requests in flight,
+  and reports the latency percentiles and the requests per second.
+
+  Usage: pact_ffi_bench [concurrency] [requests] [pact file] [request path]
+*/
+
+#define DEFAULT_CONCURRENCY 16
+#define DEFAULT_REQUESTS 10000
+
+static const char *DEFAULT_PACT = "{\
+  \"consumer\": { \"name\": \"bench-consumer\" },\
+  \"provider\": { \"name\": \"bench-provider\" },\
+  \"interactions\": [\
+    {\
+      \"description\": \"a request for the items\",\
+      \"request\": { \"method\": \"GET\", \"path\": \"/items\" },\
+      \"response\": {\
+        \"status\": 200,\
+        \"headers\": { \"Content-Type\": \"application/json\" },\
+        \"body\": { \"items\": [ { \"id\": 1, \"name\": \"one\" }, { \"id\": 2, \"name\": \"two\" } ] }\
+      }\
+    }\
+  ],\
+  \"metadata\": { \"pactSpecification\": { \"version\": \"3.0.0\" } }\
+}";
+
+static char *slurp_file(const char *filename) {
+  FILE *fp = fopen(filename, "rb");
+  if (!fp) {
+    printf("Failed to read %s\n", filename);
+    return NULL;
+  }
+  fseek(fp, 0, SEEK_END);
+  long fsize = ftell(fp);
+  if (fsize < 0) {
+    printf("Failed to get the size of %s\n", filename);
+    fclose(fp);
+    return NULL;
+  }
+  fseek(fp, 0, SEEK_SET);
+  char *string = malloc(fsize + 1);
+  if (!string) {
+    printf("Failed to allocate %ld bytes for %s\n", fsize + 1, filename);
+    fclose(fp);
+    return NULL;
+  }
+  size_t read = fread(string, 1, fsize, fp);
+  string[read] = 0;
+  fclose(fp);
+  return string;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t discard_body(char *ptr, size_t size, size_t nmemb, void *userdata) {
+  (void) ptr;
+  (void) userdata;
+  return size * nmemb;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+  return (da > db) - (da < db);
+}
+
+static double percentile(const double *sorted, int count, int pct) {
+  return sorted[(count - 1) * pct / 100];
+}
+
+int main(int argc, char **argv) {
+  int concurrency = argc > 1 ? atoi(argv[1]) : DEFAULT_CONCURRENCY;
+  int total = argc > 2 ? atoi(argv[2]) : DEFAULT_REQUESTS;
+  char *pact_json = argc > 3 ? slurp_file(argv[3]) : NULL;
+  const char *path = argc > 4 ? argv[4] : "/items";
+
+  if (concurrency <= 0 || total <= 0) {
+    printf("Usage: %s [concurrency] [requests] [pact file] [request path]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (argc > 3 && pact_json == NULL) {
+    return EXIT_FAILURE;
+  }
+  if (concurrency > total) {
+    concurrency = total;
+  }
+
+  int port = pactffi_create_mock_server(pact_json ? pact_json : DEFAULT_PACT, "127.0.0.1:0", false);
+  if (port <= 0) {
+    printf("Failed to create the mock server: %d\n", port);
+    return EXIT_FAILURE;
+  }
+
+  char url[256];
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", port, path);
+  printf("Mock server started on port %d, making %d requests to %s with concurrency %d\n",
+    port, total, url, concurrency);
+
+  curl_global_init(CURL_GLOBAL_ALL);
+  CURLM *multi = curl_multi_init();
+  CURL **handles = calloc(concurrency, sizeof(CURL *));
+  double *latencies = calloc(total, sizeof(double));
+
+  int started = 0;
+  int completed = 0;
+  int failures = 0;
+  double start = now_seconds();
+
+  for (int i = 0; i < concurrency; i++) {
+    handles[i] = curl_easy_init();
+    curl_easy_setopt(handles[i], CURLOPT_URL, url);
+    curl_easy_setopt(handles[i], CURLOPT_WRITEFUNCTION, discard_body);
+    curl_multi_add_handle(multi, handles[i]);
+    started++;
+  }
+
+  while (completed < total) {
+    int running = 0;
+    curl_multi_perform(multi, &running);
+
+    CURLMsg *msg;
+    int queued;
+    while ((msg = curl_multi_info_read(multi, &queued))) {
+      if (msg->msg != CURLMSG_DONE) {
+        continue;
+      }
+      CURL *easy = msg->easy_handle;
+      double time = 0;
+      long status = 0;
+      curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME, &time);
+      curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+      if (msg->data.result != CURLE_OK || status != 200) {
+        failures++;
+      }
+      latencies[completed++] = time;
+
+      // Re-use the handle for the next request, so the connection is kept alive
+      curl_multi_remove_handle(multi, easy);
+      if (started < total) {
+        curl_multi_add_handle(multi, easy);
+        started++;
+      }
+    }
+
+    if (completed < total) {
+      curl_multi_wait(multi, NULL, 0, 100, NULL);
+    }
+  }
+
+  double elapsed = now_seconds() - start;
+  qsort(latencies, total, sizeof(double), compare_doubles);
+
+  printf("Requests:     %d (%d failed)\n", total, failures);
+  printf("Elapsed:      %.3f s\n", elapsed);
+  printf("Requests/sec: %.1f\n", total / elapsed);
+  printf("Latency p50:  %.3f ms\n", percentile(latencies, total, 50) * 1000.0);
+  printf("Latency p99:  %.3f ms\n", percentile(latencies, total, 99) * 1000.0);
+  printf("Latency max:  %.3f ms\n", latencies[total - 1] * 1000.0);
+
+  for (int i = 0; i < concurrency; i++) {
+    curl_easy_cleanup(handles[i]);
+  }
+  curl_multi_cleanup(multi);
+  curl_global_cleanup();
+  free(handles);
+  free(latencies);
+
+  bool matched = pactffi_mock_server_matched(port);
+  pactffi_cleanup_mock_server(port);
+  free(pact_json);
+
+  if (failures > 0 || !matched) {
+    printf("Not all requests matched\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,266 @@
+//! Writer that hands log output off to a background thread, so that the thread doing the logging
+//! does not wait on the I/O of the underlying sink.
+
+use std::io::{self, BufWriter, Write};
+use std::mem;
+use std::sync::{Arc, Mutex};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::mpsc::{self, Receiver, SyncSender, TrySendError};
+use std::thread;
+
+use lazy_static::*;
+
+/// Maximum number of bytes accumulated before they are sent to the background writer
+const MAX_PENDING_BYTES: usize = 8 * 1024;
+
+/// Maximum number of entries written by the background writer before it flushes the sink
+const MAX_BATCH_SIZE: usize = 1024;
+
+/// An enum representing what to do with a log entry when the channel to the background log
+/// writer is full.
+///
+/// This enum is passed to `pactffi_logger_init_async`.
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum LogOverflowPolicy {
+  /// Block the logging thread until there is space in the channel
+  Block,
+  /// Discard the log entry. A count of the discarded entries is written to the sink.
+  Drop
+}
+
+/// Options for writing log entries on a background thread
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub(crate) struct AsyncOptions {
+  /// Number of log entries that can be queued for the background writer
+  pub capacity: usize,
+  /// What to do when the queue is full
+  pub policy: LogOverflowPolicy
+}
+
+enum Message {
+  Write(Vec<u8>),
+  Flush(SyncSender<()>)
+}
+
+lazy_static! {
+  /// Background writers of the applied logger, so they can be flushed on request.
+  /// cbindgen:ignore
+  static ref WRITERS: Mutex<Vec<FlushHandle>> = Mutex::new(vec![]);
+}
+
+/// Handle used to wait for a background writer to write out its queued entries. The writer thread
+/// runs until the writer and all its handles have been dropped.
+#[derive(Clone)]
+pub(crate) struct FlushHandle(SyncSender<Message>);
+
+/// Writer that queues log entries for a background thread to write to the underlying sink.
+pub(crate) struct AsyncWriter {
+  sender: SyncSender<Message>,
+  policy: LogOverflowPolicy,
+  dropped: Arc<AtomicUsize>,
+  pending: Vec<u8>
+}
+
+impl AsyncWriter {
+  /// Starts the background writer thread for the sink
+  pub(crate) fn new(sink: Box<dyn Write + Send>, options: AsyncOptions) -> io::Result<AsyncWriter> {
+    let (sender, receiver) = mpsc::sync_channel(options.capacity.max(1));
+    let dropped = Arc::new(AtomicUsize::new(0));
+    let writer_dropped = dropped.clone();
+    thread::Builder::new()
+      .name("pact-ffi-log-writer".to_string())
+      .spawn(move || write_entries(receiver, sink, writer_dropped))?;
+    Ok(AsyncWriter {
+      sender,
+      policy: options.policy,
+      dropped,
+      pending: vec![]
+    })
+  }
+
+  /// Handle that can be used to flush this writer once its logger has been applied
+  pub(crate) fn flush_handle(&self) -> FlushHandle {
+    FlushHandle(self.sender.clone())
+  }
+
+  fn send_pending(&mut self) {
+    if !self.pending.is_empty() {
+      let entry = Message::Write(mem::take(&mut self.pending));
+      match self.policy {
+        LogOverflowPolicy::Block => {
+          let _ = self.sender.send(entry);
+        },
+        LogOverflowPolicy::Drop => if let Err(TrySendError::Full(_)) = self.sender.try_send(entry) {
+          self.dropped.fetch_add(1, Ordering::Relaxed);
+        }
+      }
+    }
+  }
+
+  /// Box this writer
+  pub(crate) fn boxed(self) -> Box<dyn Write + Send> {
+    Box::new(self)
+  }
+}
+
+impl Write for AsyncWriter {
+  fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+    self.pending.extend_from_slice(buf);
+    if buf.ends_with(b"\n") || self.pending.len() >= MAX_PENDING_BYTES {
+      self.send_pending();
+    }
+    Ok(buf.len())
+  }
+
+  fn flush(&mut self) -> io::Result<()> {
+    // Only hands any pending bytes to the background writer. Waiting for them to be written is
+    // done with `flush_async_writers`, as this is called after every log entry.
+    self.send_pending();
+    Ok(())
+  }
+}
+
+impl std::fmt::Debug for AsyncWriter {
+  fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+    f.debug_struct("AsyncWriter")
+      .field("policy", &self.policy)
+      .field("dropped", &self.dropped)
+      .finish()
+  }
+}
+
+fn write_entries(receiver: Receiver<Message>, sink: Box<dyn Write + Send>, dropped: Arc<AtomicUsize>) {
+  let mut out = BufWriter::new(sink);
+  while let Ok(message) = receiver.recv() {
+    write_message(&mut out, message, &dropped);
+    for message in receiver.try_iter().take(MAX_BATCH_SIZE) {
+      write_message(&mut out, message, &dropped);
+    }
+    write_dropped_count(&mut out, &dropped);
+    let _ = out.flush();
+  }
+  let _ = out.flush();
+}
+
+fn write_message<W: Write>(out: &mut W, message: Message, dropped: &AtomicUsize) {
+  match message {
+    Message::Write(data) => {
+      let _ = out.write_all(&data);
+    },
+    Message::Flush(done) => {
+      write_dropped_count(out, dropped);
+      let _ = out.flush();
+      let _ = done.send(());
+    }
+  }
+}
+
+fn write_dropped_count<W: Write>(out: &mut W, dropped: &AtomicUsize) {
+  let count = dropped.swap(0, Ordering::Relaxed);
+  if count > 0 {
+    let _ = writeln!(out, "[WARN][pact_ffi::log] {} log entries were dropped as the log writer could not keep up", count);
+  }
+}
+
+/// Sets the background writers of the applied logger, replacing any previous ones
+pub(crate) fn set_async_writers(writers: Vec<FlushHandle>) {
+  *WRITERS.lock().unwrap() = writers;
+}
+
+/// Waits for all the background writers to write out the log entries that have been queued for them.
+pub(crate) fn flush_async_writers() {
+  let writers = WRITERS.lock().unwrap().clone();
+  for FlushHandle(writer) in writers {
+    let (done_sender, done_receiver) = mpsc::sync_channel(1);
+    if writer.send(Message::Flush(done_sender)).is_ok() {
+      let _ = done_receiver.recv();
+    }
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use std::io::{self, Write};
+  use std::sync::{Arc, Mutex};
+  use std::sync::atomic::AtomicBool;
+  use std::time::{Duration, Instant};
+
+  use expectest::prelude::*;
+  use fern::Dispatch;
+
+  use crate::log::logger::{add_sink, set_async_logger};
+
+  use super::*;
+
+  #[derive(Clone, Default)]
+  struct SharedBuffer(Arc<Mutex<Vec<u8>>>);
+
+  impl Write for SharedBuffer {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+      self.0.lock().unwrap().extend_from_slice(buf);
+      Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+      Ok(())
+    }
+  }
+
+  /// Sink that records when it is dropped, which happens when its writer thread finishes
+  struct DropFlag(Arc<AtomicBool>);
+
+  impl Write for DropFlag {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+      Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+      Ok(())
+    }
+  }
+
+  impl Drop for DropFlag {
+    fn drop(&mut self) {
+      self.0.store(true, Ordering::SeqCst);
+    }
+  }
+
+  #[test]
+  fn initialising_the_logger_again_stops_the_writers_of_the_previous_one() {
+    let stopped = Arc::new(AtomicBool::new(false));
+    let options = AsyncOptions { capacity: 16, policy: LogOverflowPolicy::Block };
+    set_async_logger(Dispatch::new(), options);
+    let writer = AsyncWriter::new(Box::new(DropFlag(stopped.clone())), options).unwrap();
+    let handle = writer.flush_handle();
+    add_sink(Dispatch::new().chain(writer.boxed()), Some(handle)).unwrap();
+
+    set_async_logger(Dispatch::new(), options);
+
+    let start = Instant::now();
+    while !stopped.load(Ordering::SeqCst) && start.elapsed() < Duration::from_secs(5) {
+      thread::sleep(Duration::from_millis(10));
+    }
+    expect!(stopped.load(Ordering::SeqCst)).to(be_true());
+  }
+
+  #[test]
+  fn async_writer_writes_entries_to_the_sink_in_order() {
+    let buffer = SharedBuffer::default();
+    let mut writer = AsyncWriter::new(Box::new(buffer.clone()), AsyncOptions {
+      capacity: 16,
+      policy: LogOverflowPolicy::Block
+    }).unwrap();
+
+    write!(writer, "first line").unwrap();
+    writeln!(writer, " continued").unwrap();
+    writeln!(writer, "second line").unwrap();
+    write!(writer, "partial").unwrap();
+    writer.flush().unwrap();
+    set_async_writers(vec![writer.flush_handle()]);
+    flush_async_writers();
+
+    let contents = String::from_utf8(buffer.0.lock().unwrap().clone()).unwrap();
+    expect!(contents).to(be_equal_to("first line continued\nsecond line\npartial"));
+  }
+}
@@ -6,14 +6,15 @@ use std::ptr;
 use std::str::from_utf8;
 
 use fern::Dispatch;
-use libc::{c_char, c_int};
+use libc::{c_char, c_int, size_t};
 use log::{error, LevelFilter as LogLevelFilter};
 
-use pact_matching::logging::fetch_buffer_contents;
+use pact_matching::logging::{fetch_buffer_contents, fetch_buffer_contents_since, set_log_buffer_limit};
 
 use crate::error::set_error_msg;
+use crate::log::async_writer::{AsyncOptions, flush_async_writers, LogOverflowPolicy};
 use crate::log::level_filter::LevelFilter;
-use crate::log::logger::{add_sink, apply_logger, set_logger};
+use crate::log::logger::{add_sink, apply_logger, async_options, set_async_logger, set_logger};
 use crate::log::sink::Sink;
 use crate::log::status::Status;
 use crate::util::string::to_c;
@@ -171,7 +172,8 @@ pub extern "C" fn pactffi_log_to_buffer(level_filter: LevelFilter) -> c_int {
 // /* handle the error */
 // ```
 
-/// Initialize the thread-local logger with no sinks.
+/// Initialize the thread-local logger with no sinks. Calling this again replaces the logger that
+/// is being set up.
 ///
 /// This initialized logger does nothing until `pactffi_logger_apply` has been called.
 ///
@@ -189,6 +191,48 @@ pub extern "C" fn pactffi_logger_init() {
   set_logger(Dispatch::new());
 }
 
+/// Initialize the thread-local logger with no sinks, where the stdout, stderr and file sinks
+/// attached to it will write on a background thread. Log entries are queued for the background
+/// thread, so the thread doing the logging does not wait on the I/O. The buffer sink always writes
+/// on the logging thread. Calling this again replaces the logger that is being set up, and stops
+/// the background writers of its sinks.
+///
+/// * `capacity` - Number of log entries that can be queued for each sink.
+/// * `overflow_policy` - What to do with a log entry when the queue is full. `LogOverflowPolicy_Block`
+///   will block the logging thread until there is space, `LogOverflowPolicy_Drop` will discard the
+///   entry and write a count of the discarded entries to the sink.
+///
+/// Any queued log entries can be written out with `pactffi_logger_flush`, which should be called
+/// before the program exits.
+///
+/// This initialized logger does nothing until `pactffi_logger_apply` has been called.
+///
+/// # Usage
+///
+/// ```c
+/// pactffi_logger_init_async(1024, LogOverflowPolicy_Block);
+/// ```
+///
+/// # Safety
+///
+/// This function is always safe to call.
+#[no_mangle]
+pub extern "C" fn pactffi_logger_init_async(capacity: size_t, overflow_policy: LogOverflowPolicy) {
+  set_async_logger(Dispatch::new(), AsyncOptions { capacity, policy: overflow_policy });
+}
+
+/// Flush the applied logger, waiting for any log entries queued for the background writers
+/// (see `pactffi_logger_init_async`) to be written to their sinks.
+///
+/// # Safety
+///
+/// This function is always safe to call.
+#[no_mangle]
+pub extern "C" fn pactffi_logger_flush() {
+  log::logger().flush();
+  flush_async_writers();
+}
+
 /// Attach an additional sink to the thread-local logger.
 ///
 /// This logger does nothing until `pactffi_logger_apply` has been called.
@@ -243,6 +287,20 @@ pub extern "C" fn pactffi_logger_attach_sink(
         Err(err) => return Status::from(err) as c_int,
     };
 
+    // Hand the output off to a background writer if the logger was initialized for that.
+    let sink = match async_options() {
+        Some(options) => match sink.into_async(options) {
+            Ok(sink) => sink,
+            Err(err) => return Status::from(err) as c_int,
+        },
+        None => sink,
+    };
+
+    let writer = match &sink {
+        Sink::Async(writer) => Some(writer.flush_handle()),
+        _ => None,
+    };
+
     // Convert from our `#[repr(C)]` LevelFilter to the one from the `log` crate.
     let level_filter: LogLevelFilter = level_filter.into();
 
@@ -259,7 +317,7 @@ pub extern "C" fn pactffi_logger_attach_sink(
         });
 
     // Take the existing logger, if there is one, add a new sink to it, and put it back.
-    let status = match add_sink(dispatch) {
+    let status = match add_sink(dispatch, writer) {
         Ok(_) => Status::Success,
         Err(err) => Status::from(err),
     };
@@ -311,3 +369,53 @@ pub unsafe extern "C" fn pactffi_fetch_log_buffer(log_id: *const c_char,) -> *co
     }
   }
 }
+
+/// Fetch the in-memory logger buffer contents that were added since the last fetch, without
+/// emptying the buffer. This allows the logs to be tailed without copying the previous contents
+/// again. The contents will be allocated on the heap and will need to be freed with `string_delete`.
+///
+/// `cursor` must point to a value that is initialised to zero before the first fetch. It will be
+/// updated with the position to use for the next fetch. If the buffer limit has caused log entries
+/// after the cursor to be discarded, the contents will start from the oldest entry still available.
+///
+/// Fetches the logs associated with the provided identifier, or uses the "global" one if the
+/// identifier is not specified (i.e. NULL).
+///
+/// Returns a NULL pointer if the cursor is NULL or the buffer can't be fetched. Any invalid UTF-8
+/// characters in the contents will be replaced.
+///
+/// # Safety
+///
+/// The cursor pointer must be a valid pointer to a `size_t` value.
+#[no_mangle]
+pub unsafe extern "C" fn pactffi_fetch_log_buffer_since(log_id: *const c_char, cursor: *mut size_t) -> *const c_char {
+  if cursor.is_null() {
+    error!("pactffi_fetch_log_buffer_since: cursor is NULL");
+    return ptr::null();
+  }
+
+  let id = if log_id.is_null() {
+    "global"
+  } else {
+    CStr::from_ptr(log_id).to_str().unwrap_or("global")
+  };
+  let (contents, next) = fetch_buffer_contents_since(id, *cursor);
+  match to_c(&String::from_utf8_lossy(&contents)) {
+    Ok(c_str) => {
+      *cursor = next;
+      c_str
+    },
+    Err(err) => {
+      error!("Failed to copy in-memory log buffer - {}", err);
+      ptr::null()
+    }
+  }
+}
+
+/// Sets the maximum number of bytes that will be kept in each in-memory log buffer (the global
+/// one, and the one for each mock server). Once a buffer is full, the oldest log entries are
+/// discarded. A limit of zero (the default) means the buffers are unbounded.
+#[no_mangle]
+pub extern "C" fn pactffi_log_buffer_set_limit(max_bytes: size_t) {
+  set_log_buffer_limit(max_bytes);
+}
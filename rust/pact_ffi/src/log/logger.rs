@@ -3,26 +3,53 @@
 // All of this module is `pub(crate)` and should not appear in the C header file
 // or documentation.
 
-use std::cell::RefCell;
+use std::cell::{Cell, RefCell};
 
 use fern::Dispatch;
 use log::SetLoggerError;
 
+use crate::log::async_writer::{AsyncOptions, FlushHandle, set_async_writers};
+
 thread_local! {
     // The thread-local logger. This is only populated during setup of the logger.
     /// cbindgen:ignore
     pub(crate) static LOGGER: RefCell<Option<Dispatch>> = RefCell::new(None);
+
+    // Options for sinks attached to the logger-in-progress that write on a background thread.
+    /// cbindgen:ignore
+    static ASYNC_OPTIONS: Cell<Option<AsyncOptions>> = Cell::new(None);
+
+    // Background writers of the sinks attached to the logger-in-progress. They only become
+    // flushable through `pactffi_logger_flush` once the logger is applied.
+    /// cbindgen:ignore
+    static PENDING_WRITERS: RefCell<Vec<FlushHandle>> = RefCell::new(vec![]);
 }
 
-/// Set a new dispatcher as the logger-in-progress.
+/// Set a new dispatcher as the logger-in-progress. Sinks attached to it will write on the
+/// logging thread. Any previous logger-in-progress is dropped, along with its background writers.
 pub(crate) fn set_logger(dispatch: Dispatch) {
     LOGGER.with(|logger| {
         *logger.borrow_mut() = Some(dispatch);
     });
+    ASYNC_OPTIONS.with(|options| options.set(None));
+    PENDING_WRITERS.with(|writers| writers.borrow_mut().clear());
 }
 
-/// Attach a sink to the logger-in-progress.
-pub(crate) fn add_sink(dispatch: Dispatch) -> Result<(), LoggerError> {
+/// Set a new dispatcher as the logger-in-progress, with sinks attached to it writing on a
+/// background thread.
+pub(crate) fn set_async_logger(dispatch: Dispatch, async_options: AsyncOptions) {
+    set_logger(dispatch);
+    ASYNC_OPTIONS.with(|options| options.set(Some(async_options)));
+}
+
+/// The background writer options for sinks attached to the logger-in-progress, if they should
+/// not write on the logging thread.
+pub(crate) fn async_options() -> Option<AsyncOptions> {
+    ASYNC_OPTIONS.with(|options| options.get())
+}
+
+/// Attach a sink to the logger-in-progress, with the handle of its background writer if it has one.
+pub(crate) fn add_sink(dispatch: Dispatch, writer: Option<FlushHandle>) -> Result<(), LoggerError> {
     match LOGGER.with(|logger| logger.borrow_mut().take()) {
         None => Err(LoggerError::NoLogger),
         Some(top_level_dispatch) => {
@@ -31,16 +58,23 @@ pub(crate) fn add_sink(dispatch: Dispatch) -> Result<(), LoggerError> {
             LOGGER.with(|logger| {
                 *logger.borrow_mut() = Some(top_level_dispatch)
             });
+            PENDING_WRITERS.with(|writers| writers.borrow_mut().extend(writer));
 
             Ok(())
         }
     }
 }
 
-/// Apply the logger-in-progress as the global logger.
+/// Apply the logger-in-progress as the global logger. Its background writers replace those that
+/// are flushed by `pactffi_logger_flush`. If applying fails, they are dropped with the logger.
 pub(crate) fn apply_logger() -> Result<(), LoggerError> {
+    let writers = PENDING_WRITERS.with(|writers| writers.replace(vec![]));
     match LOGGER.with(|logger| logger.borrow_mut().take()) {
-        Some(logger) => Ok(logger.apply()?),
+        Some(logger) => {
+            logger.apply()?;
+            set_async_writers(writers);
+            Ok(())
+        },
         None => Err(LoggerError::NoLogger),
     }
 }
@@ -7,12 +7,17 @@ mod sink;
 mod status;
 mod target;
 mod inmem_buffer;
+mod async_writer;
 
 pub use crate::log::ffi::{
     pactffi_logger_apply,
     pactffi_logger_attach_sink,
     pactffi_logger_init,
+    pactffi_logger_init_async,
+    pactffi_logger_flush,
     pactffi_fetch_log_buffer,
+    pactffi_fetch_log_buffer_since,
+    pactffi_log_buffer_set_limit,
     pactffi_log_to_stdout,
     pactffi_log_to_stderr,
     pactffi_log_to_file,
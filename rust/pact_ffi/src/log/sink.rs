@@ -13,6 +13,7 @@ use std::str::FromStr;
 
 use fern::Dispatch;
 
+use crate::log::async_writer::{AsyncOptions, AsyncWriter};
 use crate::log::inmem_buffer::InMemBuffer;
 
 /// A sink for logs to be written to, based on a provider specifier.
@@ -28,7 +29,26 @@ pub(crate) enum Sink {
     File(File),
 
     /// Write logs to a thread local memory buffer
-    Buffer(InMemBuffer)
+    Buffer(InMemBuffer),
+
+    /// Write logs to another sink on a background thread
+    Async(AsyncWriter)
+}
+
+impl Sink {
+  /// Converts this sink into one that writes on a background thread. The buffer sink is not
+  /// converted, as it needs the task local ID of the logging thread.
+  pub(crate) fn into_async(self, options: AsyncOptions) -> Result<Sink, SinkSpecifierError> {
+    let writer: Box<dyn io::Write + Send> = match self {
+      Sink::Stdout(stdout) => Box::new(stdout),
+      Sink::Stderr(stderr) => Box::new(stderr),
+      Sink::File(file) => Box::new(file),
+      Sink::Buffer(_) | Sink::Async(_) => return Ok(self)
+    };
+    AsyncWriter::new(writer, options)
+      .map(Sink::Async)
+      .map_err(|source| SinkSpecifierError::CantStartWriter { source })
+  }
 }
 
 impl From<Sink> for Dispatch {
@@ -39,7 +59,8 @@ impl From<Sink> for Dispatch {
       Sink::Stdout(stdout) => dispatch.chain(stdout),
       Sink::Stderr(stderr) => dispatch.chain(stderr),
       Sink::File(file) => dispatch.chain(file),
-      Sink::Buffer(buffer) => dispatch.chain(buffer.boxed())
+      Sink::Buffer(buffer) => dispatch.chain(buffer.boxed()),
+      Sink::Async(writer) => dispatch.chain(writer.boxed())
     }
   }
 }
@@ -99,4 +120,10 @@ pub(crate) enum SinkSpecifierError {
         #[source]
         source: io::Error,
     },
+
+    #[error("can't start the background log writer")]
+    CantStartWriter {
+        #[source]
+        source: io::Error,
+    },
 }
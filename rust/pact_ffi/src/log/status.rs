@@ -52,6 +52,9 @@ impl From<SinkSpecifierError> for Status {
             SinkSpecifierError::CantMakeFile { .. } => {
                 Status::CantOpenSinkToFile
             }
+            SinkSpecifierError::CantStartWriter { .. } => {
+                Status::CantConstructSink
+            }
         }
     }
 }
@@ -0,0 +1,294 @@
+//! Defining interactions in bulk from JSON.
+//!
+//! Each of the interaction builder functions (`pactffi_given`, `pactffi_with_header`, etc.) looks
+//! up the Pact handle and converts its C string arguments on every call. For test suites that
+//! define many interactions, `pactffi_with_interactions` takes them all as one JSON document,
+//! builds them without holding any lock, and then adds them to the Pact in one go.
+
+use std::cell::Cell;
+use std::ffi::CStr;
+use std::panic::catch_unwind;
+
+use anyhow::anyhow;
+use libc::c_char;
+use log::*;
+use serde_json::{Map, Value};
+
+use pact_matching::models::RequestResponseInteraction;
+use pact_models::provider_states::ProviderState;
+
+use crate::mock_server::{from_integration_json, set_body, set_header, set_query_parameter};
+use crate::mock_server::handles::{InteractionPart, PactHandle};
+
+/// Adds interactions to the Pact from a JSON document. The document is either one interaction or
+/// an array of them, where each interaction has the attributes below. Only the description is
+/// required.
+///
+/// ```json
+/// {
+///   "description": "a request for an animal",
+///   "providerStates": ["an animal exists", { "name": "a user", "params": { "id": 10 } }],
+///   "request": {
+///     "method": "GET",
+///     "path": "/animals/1",
+///     "query": { "type": "dog", "colour": ["brown", "black"] },
+///     "headers": { "Accept": "application/json" },
+///     "contentType": "application/json",
+///     "body": { "id": 1 }
+///   },
+///   "response": {
+///     "status": 200,
+///     "headers": { "Content-Type": "application/json" },
+///     "body": { "name": { "value": "Rex", "pact:matcher:type": "type" } }
+///   }
+/// }
+/// ```
+///
+/// The path, query parameter and header values can be strings, or matcher definitions in the
+/// same form as the values passed to `pactffi_with_request`, `pactffi_with_query_parameter` and
+/// `pactffi_with_header`. Query parameters and headers with more than one value are given as arrays.
+/// A string body is used as is, with a content type of `text/plain` unless one is set with the
+/// `contentType` attribute or a `Content-Type` header. Any other JSON body is a JSON body
+/// (`application/json` by default), and can have matching rules embedded in it as with
+/// `pactffi_with_body`.
+///
+/// The interactions are appended to the Pact in the order they are in the document. They are all
+/// added, or if any of them are invalid, none are.
+///
+/// Returns the number of interactions added.
+///
+/// # Errors
+///
+/// Errors are returned as negative values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | -1 | An invalid handle was received |
+/// | -2 | The mock server for the Pact has already started |
+/// | -3 | The JSON is not valid, or does not describe valid interactions |
+/// | -4 | The method panicked |
+#[no_mangle]
+pub extern fn pactffi_with_interactions(pact: PactHandle, interactions_json: *const c_char) -> i32 {
+  let result = catch_unwind(|| {
+    if interactions_json.is_null() {
+      error!("Got a null pointer instead of the interactions JSON");
+      return -3;
+    }
+    let json = unsafe { CStr::from_ptr(interactions_json) };
+
+    let interactions = match interactions_from_json(json.to_bytes()) {
+      Ok(interactions) => interactions,
+      Err(err) => {
+        error!("Could not load the interactions from JSON - {}", err);
+        return -3;
+      }
+    };
+    let count = interactions.len() as i32;
+
+    let interactions = Cell::new(interactions);
+    pact.with_pact(&|_, inner| {
+      if inner.mock_server_started {
+        -2
+      } else {
+        inner.pact.interactions.extend(interactions.take());
+        count
+      }
+    }).unwrap_or(-1)
+  });
+
+  match result {
+    Ok(val) => val,
+    Err(cause) => {
+      error!("Caught a general panic: {:?}", cause);
+      -4
+    }
+  }
+}
+
+fn interactions_from_json(json: &[u8]) -> anyhow::Result<Vec<RequestResponseInteraction>> {
+  match serde_json::from_slice(json)? {
+    Value::Array(values) => values.iter().enumerate()
+      .map(|(index, value)| interaction_from_json(value)
+        .map_err(|err| anyhow!("interaction {} - {}", index, err)))
+      .collect(),
+    value => interaction_from_json(&value).map(|interaction| vec![interaction])
+  }
+}
+
+fn interaction_from_json(json: &Value) -> anyhow::Result<RequestResponseInteraction> {
+  let attributes = json.as_object()
+    .ok_or_else(|| anyhow!("expected a JSON object, got {}", json))?;
+  let description = attributes.get("description").and_then(Value::as_str)
+    .ok_or_else(|| anyhow!("the description is missing"))?;
+  let mut interaction = RequestResponseInteraction {
+    description: description.to_string(),
+    .. RequestResponseInteraction::default()
+  };
+
+  if let Some(states) = attributes.get("providerStates") {
+    let states = states.as_array()
+      .ok_or_else(|| anyhow!("providerStates must be an array"))?;
+    for state in states {
+      interaction.provider_states.push(provider_state_from_json(state)?);
+    }
+  }
+
+  if let Some(request) = attributes.get("request") {
+    let request = request.as_object()
+      .ok_or_else(|| anyhow!("request must be a JSON object"))?;
+    if let Some(method) = request.get("method") {
+      interaction.request.method = method.as_str()
+        .ok_or_else(|| anyhow!("the request method must be a string"))?
+        .to_string();
+    }
+    if let Some(path) = request.get("path") {
+      let path = integration_value(path)?;
+      interaction.request.path = from_integration_json(&mut interaction.request.matching_rules,
+        &mut interaction.request.generators, &path, "", "path");
+    }
+    for (name, index, value) in multi_values(request, "query")? {
+      set_query_parameter(&mut interaction, name, index, &value);
+    }
+    apply_headers_and_body(&mut interaction, InteractionPart::Request, request)?;
+  }
+
+  if let Some(response) = attributes.get("response") {
+    let response = response.as_object()
+      .ok_or_else(|| anyhow!("response must be a JSON object"))?;
+    if let Some(status) = response.get("status") {
+      interaction.response.status = status.as_u64()
+        .filter(|status| *status <= u16::MAX as u64)
+        .ok_or_else(|| anyhow!("the response status must be a number, got {}", status))? as u16;
+    }
+    apply_headers_and_body(&mut interaction, InteractionPart::Response, response)?;
+  }
+
+  Ok(interaction)
+}
+
+fn provider_state_from_json(json: &Value) -> anyhow::Result<ProviderState> {
+  match json {
+    Value::String(name) => Ok(ProviderState::default(name)),
+    Value::Object(attributes) => {
+      let name = attributes.get("name").and_then(Value::as_str)
+        .ok_or_else(|| anyhow!("provider state has no name"))?;
+      let params = match attributes.get("params") {
+        Some(Value::Object(params)) => params.iter()
+          .map(|(key, value)| (key.clone(), value.clone()))
+          .collect(),
+        Some(params) => return Err(anyhow!("provider state params must be a JSON object, got {}", params)),
+        None => Default::default()
+      };
+      Ok(ProviderState { name: name.to_string(), params })
+    },
+    _ => Err(anyhow!("provider states must be strings or JSON objects, got {}", json))
+  }
+}
+
+fn apply_headers_and_body(
+  interaction: &mut RequestResponseInteraction,
+  part: InteractionPart,
+  attributes: &Map<String, Value>
+) -> anyhow::Result<()> {
+  for (name, index, value) in multi_values(attributes, "headers")? {
+    set_header(interaction, part, name, index, &value);
+  }
+
+  let content_type = match attributes.get("contentType") {
+    Some(content_type) => Some(content_type.as_str()
+      .ok_or_else(|| anyhow!("contentType must be a string"))?),
+    None => None
+  };
+  match attributes.get("body") {
+    None | Some(Value::Null) => {},
+    Some(Value::String(body)) => set_body(interaction, part, content_type.unwrap_or("text/plain"), body),
+    Some(body) => set_body(interaction, part, content_type.unwrap_or("application/json"), &body.to_string())
+  }
+  Ok(())
+}
+
+/// Returns the name, index and value of each of the values of the query parameters or headers
+fn multi_values<'a>(attributes: &'a Map<String, Value>, key: &str) -> anyhow::Result<Vec<(&'a str, usize, String)>> {
+  let mut values = vec![];
+  match attributes.get(key) {
+    Some(Value::Object(map)) => for (name, value) in map {
+      match value {
+        Value::Array(items) => for (index, item) in items.iter().enumerate() {
+          values.push((name.as_str(), index, integration_value(item)?));
+        },
+        _ => values.push((name.as_str(), 0, integration_value(value)?))
+      }
+    },
+    Some(value) => return Err(anyhow!("{} must be a JSON object, got {}", key, value)),
+    None => {}
+  }
+  Ok(values)
+}
+
+/// Values can be strings or matcher definitions, which are passed on as JSON as the single value
+/// functions expect
+fn integration_value(value: &Value) -> anyhow::Result<String> {
+  match value {
+    Value::String(s) => Ok(s.clone()),
+    Value::Object(_) | Value::Number(_) | Value::Bool(_) => Ok(value.to_string()),
+    _ => Err(anyhow!("expected a string or matcher, got {}", value))
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+  use maplit::*;
+
+  use pact_models::http_parts::HttpPart;
+
+  use super::*;
+
+  #[test]
+  fn interactions_from_json_with_all_attributes() {
+    let json = r#"[
+      {
+        "description": "a request for an animal",
+        "providerStates": ["an animal exists", { "name": "a user", "params": { "id": 10 } }],
+        "request": {
+          "method": "PUT",
+          "path": { "value": "/animals/1", "pact:matcher:type": "regex", "regex": "\\/animals\\/\\d+" },
+          "query": { "colour": ["brown", "black"] },
+          "headers": { "Accept": "application/json" },
+          "body": { "id": 1 }
+        },
+        "response": {
+          "status": 201,
+          "body": "created"
+        }
+      },
+      { "description": "a second request" }
+    ]"#;
+    let interactions = interactions_from_json(json.as_bytes()).unwrap();
+
+    expect!(interactions.len()).to(be_equal_to(2));
+    let interaction = &interactions[0];
+    expect!(interaction.provider_states.len()).to(be_equal_to(2));
+    expect!(interaction.provider_states[1].params.get("id")).to(be_some().value(&serde_json::json!(10)));
+    expect!(interaction.request.method.as_str()).to(be_equal_to("PUT"));
+    expect!(interaction.request.path.as_str()).to(be_equal_to("/animals/1"));
+    expect!(interaction.request.matching_rules.rules_for_category("path").map(|rules| rules.is_not_empty()))
+      .to(be_some().value(true));
+    expect!(interaction.request.query.clone()).to(be_some().value(hashmap! {
+      "colour".to_string() => vec!["brown".to_string(), "black".to_string()]
+    }));
+    expect!(interaction.request.lookup_header_value("content-type")).to(be_some().value("application/json"));
+    expect!(interaction.request.body.str_value()).to(be_equal_to("{\"id\":1}"));
+    expect!(interaction.response.status).to(be_equal_to(201));
+    expect!(interaction.response.lookup_header_value("content-type")).to(be_some().value("text/plain"));
+    expect!(interactions[1].description.as_str()).to(be_equal_to("a second request"));
+  }
+
+  #[test]
+  fn interactions_from_json_rejects_invalid_interactions() {
+    expect!(interactions_from_json(b"{\"request\": {}}")).to(be_err());
+    expect!(interactions_from_json(b"[{\"description\": \"a\"}, {\"description\": 1}]")).to(be_err());
+    expect!(interactions_from_json(b"{\"description\": \"a\", \"response\": {\"status\": 99999}}")).to(be_err());
+    expect!(interactions_from_json(b"not json")).to(be_err());
+  }
+}
@@ -1,11 +1,10 @@
 //! Handles wrapping Rust models
 
-use std::cell::RefCell;
 use std::collections::HashMap;
-use std::sync::Mutex;
+use std::sync::{Arc, Mutex, RwLock};
+use std::sync::atomic::{AtomicUsize, Ordering};
 
 use lazy_static::*;
-use maplit::*;
 
 use pact_matching::models::{RequestResponseInteraction, RequestResponsePact};
 use pact_matching::models::message::Message;
@@ -19,9 +18,55 @@ pub struct PactHandleInner {
   pub(crate) mock_server_started: bool
 }
 
+/// Number of shards the handle registries are split into
+const HANDLE_SHARDS: usize = 16;
+
+/// Registry of the models referenced by handles. Entries are spread over a number of shards by
+/// id, and each entry has its own lock, so calls for different handles do not contend with each
+/// other. Ids are allocated from a counter, so are never reused after an entry is removed.
+struct HandleRegistry<T> {
+  next_id: AtomicUsize,
+  shards: Vec<RwLock<HashMap<usize, Arc<Mutex<T>>>>>
+}
+
+impl <T> HandleRegistry<T> {
+  fn new() -> Self {
+    HandleRegistry {
+      next_id: AtomicUsize::new(1),
+      shards: (0..HANDLE_SHARDS).map(|_| RwLock::new(HashMap::new())).collect()
+    }
+  }
+
+  fn shard(&self, id: usize) -> &RwLock<HashMap<usize, Arc<Mutex<T>>>> {
+    &self.shards[id % HANDLE_SHARDS]
+  }
+
+  /// Adds the value to the registry, returning the id for it
+  fn insert(&self, value: T) -> usize {
+    let id = self.next_id.fetch_add(1, Ordering::Relaxed);
+    self.shard(id).write().unwrap().insert(id, Arc::new(Mutex::new(value)));
+    id
+  }
+
+  /// Invokes the closure with the value for the id. Only the lock for the value is held while the
+  /// closure runs.
+  fn with<R>(&self, id: usize, f: impl FnOnce(&mut T) -> R) -> Option<R> {
+    let entry = self.shard(id).read().unwrap().get(&id).cloned();
+    entry.map(|entry| {
+      let mut inner = entry.lock().unwrap();
+      f(&mut *inner)
+    })
+  }
+
+  /// Removes the value for the id from the registry. Returns false if there was no value for the id.
+  fn remove(&self, id: usize) -> bool {
+    self.shard(id).write().unwrap().remove(&id).is_some()
+  }
+}
+
 lazy_static! {
-  static ref PACT_HANDLES: Mutex<HashMap<usize, RefCell<PactHandleInner>>> = Mutex::new(hashmap![]);
-  static ref MESSAGE_PACT_HANDLES: Mutex<HashMap<usize, RefCell<MessagePact>>> = Mutex::new(hashmap![]);
+  static ref PACT_HANDLES: HandleRegistry<PactHandleInner> = HandleRegistry::new();
+  static ref MESSAGE_PACT_HANDLES: HandleRegistry<MessagePact> = HandleRegistry::new();
 }
 
 #[repr(C)]
@@ -55,16 +100,14 @@ pub enum InteractionPart {
 impl PactHandle {
   /// Creates a new handle to a Pact model
   pub fn new(consumer: &str, provider: &str) -> Self {
-    let mut handles = PACT_HANDLES.lock().unwrap();
-    let id = handles.len() + 1;
-    handles.insert(id, RefCell::new(PactHandleInner {
+    let id = PACT_HANDLES.insert(PactHandleInner {
       pact: RequestResponsePact {
         consumer: Consumer { name: consumer.to_string() },
         provider: Provider { name: provider.to_string() },
         .. RequestResponsePact::default()
       },
       mock_server_started: false
-    }));
+    });
     PactHandle {
       pact: id
     }
@@ -72,8 +115,13 @@ impl PactHandle {
 
   /// Invokes the closure with the inner Pact model
   pub(crate) fn with_pact<R>(&self, f: &dyn Fn(usize, &mut PactHandleInner) -> R) -> Option<R> {
-    let mut handles = PACT_HANDLES.lock().unwrap();
-    handles.get_mut(&self.pact).map(|inner| f(self.pact - 1, &mut inner.borrow_mut()))
+    PACT_HANDLES.with(self.pact, |inner| f(self.pact - 1, inner))
+  }
+
+  /// Removes the Pact model for this handle, releasing its memory. Returns false if the handle
+  /// does not refer to a Pact model.
+  pub(crate) fn free(&self) -> bool {
+    PACT_HANDLES.remove(self.pact)
   }
 }
 
@@ -88,18 +136,15 @@ impl InteractionHandle {
 
   /// Invokes the closure with the inner Pact model
   pub fn with_pact<R>(&self, f: &dyn Fn(usize, &mut PactHandleInner) -> R) -> Option<R> {
-    let mut handles = PACT_HANDLES.lock().unwrap();
-    handles.get_mut(&self.pact).map(|inner| f(self.pact - 1, &mut inner.borrow_mut()))
+    PACT_HANDLES.with(self.pact, |inner| f(self.pact - 1, inner))
   }
 
   /// Invokes the closure with the inner Interaction model
   pub fn with_interaction<R>(&self, f: &dyn Fn(usize, bool, &mut RequestResponseInteraction) -> R) -> Option<R> {
-    let mut handles = PACT_HANDLES.lock().unwrap();
-    handles.get_mut(&self.pact).map(|inner| {
-      let inner_mut = &mut *inner.borrow_mut();
-      let interactions = &mut inner_mut.pact.interactions;
-      match interactions.get_mut(self.interaction - 1) {
-        Some(inner_i) => Some(f(self.interaction - 1, inner_mut.mock_server_started, inner_i)),
+    PACT_HANDLES.with(self.pact, |inner| {
+      let mock_server_started = inner.mock_server_started;
+      match inner.pact.interactions.get_mut(self.interaction - 1) {
+        Some(inner_i) => Some(f(self.interaction - 1, mock_server_started, inner_i)),
         None => None
       }
     }).flatten()
@@ -127,13 +172,11 @@ pub struct MessageHandle {
 impl MessagePactHandle {
   /// Creates a new handle to a Pact model
   pub fn new(consumer: &str, provider: &str) -> Self {
-    let mut handles = MESSAGE_PACT_HANDLES.lock().unwrap();
-    let id = handles.len() + 1;
-    handles.insert(id, RefCell::new(MessagePact {
+    let id = MESSAGE_PACT_HANDLES.insert(MessagePact {
       consumer: Consumer { name: consumer.to_string() },
       provider: Provider { name: provider.to_string() },
       .. MessagePact::default()
-    }));
+    });
     MessagePactHandle {
       pact: id
     }
@@ -141,8 +184,13 @@ impl MessagePactHandle {
 
   /// Invokes the closure with the inner MessagePact model
   pub fn with_pact<R>(&self, f: &dyn Fn(usize, &mut MessagePact) -> R) -> Option<R> {
-    let mut handles = MESSAGE_PACT_HANDLES.lock().unwrap();
-    handles.get_mut(&self.pact).map(|inner| f(self.pact - 1, &mut inner.borrow_mut()))
+    MESSAGE_PACT_HANDLES.with(self.pact, |inner| f(self.pact - 1, inner))
+  }
+
+  /// Removes the MessagePact model for this handle, releasing its memory. Returns false if the
+  /// handle does not refer to a MessagePact model.
+  pub(crate) fn free(&self) -> bool {
+    MESSAGE_PACT_HANDLES.remove(self.pact)
   }
 }
 
@@ -157,18 +205,39 @@ impl MessageHandle {
 
   /// Invokes the closure with the inner MessagePact model
   pub fn with_pact<R>(&self, f: &dyn Fn(usize, &mut MessagePact) -> R) -> Option<R> {
-    let mut handles = MESSAGE_PACT_HANDLES.lock().unwrap();
-    handles.get_mut(&self.pact).map(|inner| f(self.pact - 1, &mut inner.borrow_mut()))
+    MESSAGE_PACT_HANDLES.with(self.pact, |inner| f(self.pact - 1, inner))
   }
 
   /// Invokes the closure with the inner Interaction model
   pub fn with_message<R>(&self, f: &dyn Fn(usize, &mut Message) -> R) -> Option<R> {
-    let mut handles = MESSAGE_PACT_HANDLES.lock().unwrap();
-    handles.get_mut(&self.pact).map(|inner| {
-      match inner.borrow_mut().messages.get_mut(self.message - 1) {
+    MESSAGE_PACT_HANDLES.with(self.pact, |inner| {
+      match inner.messages.get_mut(self.message - 1) {
         Some(inner_i) => Some(f(self.message - 1, inner_i)),
         None => None
       }
     }).flatten()
   }
 }
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+
+  use super::*;
+
+  #[test]
+  fn handle_registry_does_not_reuse_ids_after_an_entry_is_removed() {
+    let registry = HandleRegistry::new();
+    let first = registry.insert("first");
+    let second = registry.insert("second");
+    expect!(registry.remove(first)).to(be_true());
+    let third = registry.insert("third");
+
+    expect!(third).to_not(be_equal_to(first));
+    expect!(third).to_not(be_equal_to(second));
+    expect!(registry.with(first, |value| value.to_string())).to(be_none());
+    expect!(registry.with(second, |value| value.to_string())).to(be_some().value("second"));
+    expect!(registry.with(third, |value| value.to_string())).to(be_some().value("third"));
+    expect!(registry.remove(first)).to(be_false());
+  }
+}
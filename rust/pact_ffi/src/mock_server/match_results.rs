@@ -0,0 +1,262 @@
+//! Incremental access to the match results of a running mock server.
+//!
+//! Instead of serialising all the mismatches to JSON with `pactffi_mock_server_mismatches`, the
+//! results a mock server has recorded since a given sequence number can be fetched with
+//! `pactffi_mock_server_results_since`, and their fields read with the accessor functions. Only
+//! the results added since that sequence number are copied, so polling a long running mock
+//! server does not get slower as more requests are received.
+
+use std::ffi::CString;
+
+use libc::{c_char, size_t};
+
+use pact_mock_server::MANAGER;
+use pact_mock_server::matching::MatchResult;
+use pact_mock_server::server_manager::ServerManager;
+
+use crate::{as_mut, as_ref, ffi_fn};
+use crate::Mismatches;
+use crate::util::*;
+
+/// A match result recorded by a mock server, with its sequence number.
+#[allow(missing_copy_implementations)]
+#[allow(missing_debug_implementations)]
+pub struct MockServerMatchResult {
+    sequence: usize,
+    result_type: &'static [u8],
+    method: CString,
+    path: CString,
+    status: u16,
+    mismatches: Mismatches,
+}
+
+impl MockServerMatchResult {
+    fn new(sequence: usize, result: MatchResult) -> Self {
+        let (result_type, request, status, mismatches) = match result {
+            MatchResult::RequestMatch(request, response) => (&b"request-match\0"[..], request, response.status, vec![]),
+            MatchResult::RequestMismatch(request, mismatches) => (&b"request-mismatch\0"[..], request, 0, mismatches),
+            MatchResult::RequestNotFound(request) => (&b"request-not-found\0"[..], request, 0, vec![]),
+            MatchResult::MissingRequest(request) => (&b"missing-request\0"[..], request, 0, vec![]),
+        };
+        MockServerMatchResult {
+            sequence,
+            result_type,
+            method: CString::new(request.method).unwrap_or_default(),
+            path: CString::new(request.path).unwrap_or_default(),
+            status,
+            mismatches: Mismatches(mismatches),
+        }
+    }
+}
+
+/// An iterator over the match results fetched from a mock server.
+#[allow(missing_copy_implementations)]
+#[allow(missing_debug_implementations)]
+pub struct MatchResultIterator {
+    current: usize,
+    results: Vec<MockServerMatchResult>,
+}
+
+impl MatchResultIterator {
+    fn next(&mut self) -> usize {
+        let idx = self.current;
+        self.current += 1;
+        idx
+    }
+}
+
+ffi_fn! {
+    /// Get an iterator over the match results that the mock server running on the port has
+    /// recorded with a sequence number greater than `sequence`. Sequence numbers start at 1, so
+    /// passing 0 returns all the results. Pass the sequence number of the last result returned
+    /// to only get the results recorded after it.
+    ///
+    /// Sequence numbers start again at 1 when the mock server is reset with
+    /// `pactffi_mock_server_reset`. Requests that were expected but not received are not match
+    /// results, so they are only reported by `pactffi_mock_server_mismatches`.
+    ///
+    /// The iterator must be deleted with `pactffi_match_result_iter_delete`.
+    ///
+    /// # Errors
+    ///
+    /// Returns a NULL pointer if there is no mock server running on the port.
+    fn pactffi_mock_server_results_since(mock_server_port: i32, sequence: size_t) -> *mut MatchResultIterator {
+        let results = MANAGER.lock().unwrap()
+            .get_or_insert_with(ServerManager::new)
+            .find_mock_server_by_port_mut(mock_server_port as u16, &|mock_server| {
+                mock_server.matches_since(sequence)
+            })
+            .ok_or(anyhow::anyhow!("no mock server running on port {}", mock_server_port))?;
+        let results = results.into_iter()
+            .map(|(sequence, result)| MockServerMatchResult::new(sequence, result))
+            .collect();
+        ptr::raw_to(MatchResultIterator { current: 0, results })
+    } {
+        ptr::null_mut_to::<MatchResultIterator>()
+    }
+}
+
+ffi_fn! {
+    /// Get the next match result from the iterator. The result is owned by the iterator, and is
+    /// valid until the iterator is deleted.
+    ///
+    /// Returns a NULL pointer if no results remain.
+    fn pactffi_match_result_iter_next(iter: *mut MatchResultIterator) -> *const MockServerMatchResult {
+        let iter = as_mut!(iter);
+        let index = iter.next();
+        let result = iter.results
+            .get(index)
+            .ok_or(anyhow::anyhow!("iter past the end of match results"))?;
+        result as *const MockServerMatchResult
+    } {
+        ptr::null_to::<MockServerMatchResult>()
+    }
+}
+
+ffi_fn! {
+    /// Delete a match result iterator, and the results returned from it, when you're done with it.
+    fn pactffi_match_result_iter_delete(iter: *mut MatchResultIterator) {
+        ptr::drop_raw(iter);
+    }
+}
+
+ffi_fn! {
+    /// Get the sequence number of the match result.
+    ///
+    /// Returns 0 if passed a NULL pointer.
+    fn pactffi_match_result_sequence(result: *const MockServerMatchResult) -> size_t {
+        let result = as_ref!(result);
+        result.sequence
+    } {
+        0
+    }
+}
+
+ffi_fn! {
+    /// Get the type of the match result. This is one of `request-match`, `request-mismatch`,
+    /// `request-not-found` or `missing-request`, the same as the `type` attribute in the
+    /// mismatches JSON. The string is static, and must not be deleted.
+    ///
+    /// Returns a NULL pointer if passed a NULL pointer.
+    fn pactffi_match_result_type(result: *const MockServerMatchResult) -> *const c_char {
+        let result = as_ref!(result);
+        result.result_type.as_ptr() as *const c_char
+    } {
+        ptr::null_to::<c_char>()
+    }
+}
+
+ffi_fn! {
+    /// If the match result is for a request that matched an interaction.
+    ///
+    /// Returns false if passed a NULL pointer.
+    fn pactffi_match_result_matched(result: *const MockServerMatchResult) -> bool {
+        let result = as_ref!(result);
+        result.result_type == &b"request-match\0"[..]
+    } {
+        false
+    }
+}
+
+ffi_fn! {
+    /// Get the method of the request for the match result. For requests that were not expected,
+    /// this is the method of the received request, otherwise it is the method of the expected
+    /// request. The string is owned by the iterator, and must not be deleted.
+    ///
+    /// Returns a NULL pointer if passed a NULL pointer.
+    fn pactffi_match_result_method(result: *const MockServerMatchResult) -> *const c_char {
+        let result = as_ref!(result);
+        result.method.as_ptr()
+    } {
+        ptr::null_to::<c_char>()
+    }
+}
+
+ffi_fn! {
+    /// Get the path of the request for the match result. For requests that were not expected,
+    /// this is the path of the received request, otherwise it is the path of the expected
+    /// request. The string is owned by the iterator, and must not be deleted.
+    ///
+    /// Returns a NULL pointer if passed a NULL pointer.
+    fn pactffi_match_result_path(result: *const MockServerMatchResult) -> *const c_char {
+        let result = as_ref!(result);
+        result.path.as_ptr()
+    } {
+        ptr::null_to::<c_char>()
+    }
+}
+
+ffi_fn! {
+    /// Get the status of the response the mock server returned for the match result. Only
+    /// `request-match` results have a response from the Pact, so this is 0 for the other types.
+    ///
+    /// Returns 0 if passed a NULL pointer.
+    fn pactffi_match_result_status(result: *const MockServerMatchResult) -> u16 {
+        let result = as_ref!(result);
+        result.status
+    } {
+        0
+    }
+}
+
+ffi_fn! {
+    /// Get the mismatches for the match result. These can be read with
+    /// `pactffi_mismatches_get_iter` and the mismatch accessor functions, such as
+    /// `pactffi_mismatch_type`. Only `request-mismatch` results have mismatches. The mismatches
+    /// are owned by the iterator, and must not be deleted with `pactffi_mismatches_delete`.
+    ///
+    /// Returns a NULL pointer if passed a NULL pointer.
+    fn pactffi_match_result_mismatches(result: *const MockServerMatchResult) -> *const Mismatches {
+        let result = as_ref!(result);
+        &result.mismatches as *const Mismatches
+    } {
+        ptr::null_to::<Mismatches>()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::ffi::CStr;
+
+    use expectest::prelude::*;
+
+    use pact_matching::Mismatch;
+    use pact_models::request::Request;
+    use pact_models::response::Response;
+
+    use super::*;
+
+    #[test]
+    fn match_result_accessors() {
+        let request = Request { method: "PUT".into(), path: "/items/1".into(), .. Request::default() };
+        let mismatch = Mismatch::MethodMismatch { expected: "PUT".into(), actual: "POST".into() };
+        let mut iter = MatchResultIterator {
+            current: 0,
+            results: vec![
+                MockServerMatchResult::new(1, MatchResult::RequestMatch(request.clone(), Response { status: 201, .. Response::default() })),
+                MockServerMatchResult::new(2, MatchResult::RequestMismatch(request.clone(), vec![mismatch])),
+            ],
+        };
+
+        let first = pactffi_match_result_iter_next(&mut iter);
+        expect!(pactffi_match_result_sequence(first)).to(be_equal_to(1));
+        expect!(pactffi_match_result_matched(first)).to(be_true());
+        expect!(pactffi_match_result_status(first)).to(be_equal_to(201));
+        let result_type = unsafe { CStr::from_ptr(pactffi_match_result_type(first)) };
+        expect!(result_type.to_str()).to(be_ok().value("request-match"));
+        let path = unsafe { CStr::from_ptr(pactffi_match_result_path(first)) };
+        expect!(path.to_str()).to(be_ok().value("/items/1"));
+
+        let second = pactffi_match_result_iter_next(&mut iter);
+        expect!(pactffi_match_result_sequence(second)).to(be_equal_to(2));
+        expect!(pactffi_match_result_matched(second)).to(be_false());
+        expect!(pactffi_match_result_status(second)).to(be_equal_to(0));
+        let method = unsafe { CStr::from_ptr(pactffi_match_result_method(second)) };
+        expect!(method.to_str()).to(be_ok().value("PUT"));
+        let mismatches = unsafe { &*pactffi_match_result_mismatches(second) };
+        expect!(mismatches.0.len()).to(be_equal_to(1));
+
+        expect!(pactffi_match_result_iter_next(&mut iter).is_null()).to(be_true());
+        expect!(pactffi_match_result_sequence(std::ptr::null())).to(be_equal_to(0));
+    }
+}
@@ -40,36 +40,55 @@
 //!
 //! Returns 0 if the pact file was successfully written. Returns a positive code if the file can
 //! not be written, or there is no mock server running on that port or the function panics.
+//!
+//! ## [append_pact_file](fn.pactffi_append_pact_file.html)
+//!
+//! External interface to append the interactions of a mock server's pact to the journal for its
+//! pact file, for test suites where many tests write to the same pact file. The pact files are
+//! then written out once at the end with [`finalise_pact_files`](fn.pactffi_finalise_pact_files.html).
+//!
+//! ## [create_mock_server_from_snapshot](fn.pactffi_create_mock_server_from_snapshot.html)
+//!
+//! External interface to create a mock server from a snapshot of a loaded pact, written with
+//! [`write_mock_server_snapshot`](fn.pactffi_write_mock_server_snapshot.html). This avoids
+//! processing the pact JSON each time a mock server for the same pact is started.
 
 #![warn(missing_docs)]
 
 use std::{ptr, str};
 use std::any::Any;
-use std::collections::BTreeMap;
+use std::collections::{BTreeMap, HashMap};
 use std::ffi::CStr;
 use std::ffi::CString;
 use std::panic::catch_unwind;
 use std::path::PathBuf;
 use std::ptr::null_mut;
 use std::str::from_utf8;
+use std::sync::Mutex;
+use std::time::Duration;
 
 use bytes::Bytes;
 use chrono::Local;
 use itertools::Itertools;
+use lazy_static::*;
 use libc::{c_char, c_ushort, size_t};
 use log::*;
 use maplit::*;
-use onig::Regex;
 use rand::prelude::*;
+use rustls::ServerConfig;
 use serde_json::json;
 use serde_json::Value;
 use uuid::Uuid;
 
-use pact_matching::logging::fetch_buffer_contents;
+use pact_matching::logging::{fetch_buffer_contents, fetch_buffer_contents_since};
 use pact_matching::models::{Pact, RequestResponseInteraction};
+use pact_matching::models::journal;
 use pact_matching::models::message::Message;
-use pact_mock_server::{MANAGER, MockServerError, tls::TlsConfigBuilder, WritePactFileErr};
+use pact_matching::regex_cache::{cached_regex, MAX_CACHED_REGEXES};
+use pact_mock_server::{MANAGER, MockServerError, ResetMockServerErr, tls::TlsConfigBuilder, WritePactFileErr};
+use pact_mock_server::mock_server::{HttpProtocols, MockServerConfig};
 use pact_mock_server::server_manager::ServerManager;
+use pact_mock_server::snapshot::SnapshotError;
 use pact_models::bodies::OptionalBody::{Null, Present};
 use pact_models::bodies::OptionalBody;
 use pact_models::content_types::ContentType;
@@ -95,6 +114,10 @@ use crate::models::pact_specification::PactSpecification;
 
 pub mod handles;
 pub mod bodies;
+pub mod bulk;
+pub mod match_results;
+
+pub use crate::mock_server::bulk::pactffi_with_interactions;
 
 /// External interface to create a mock server. A pointer to the pact JSON as a C string is passed in,
 /// as well as the port for the mock server to run on. A value of 0 for the port will result in a
@@ -128,50 +151,179 @@ pub extern fn pactffi_create_mock_server(pact_str: *const c_char, addr_str: *con
       CStr::from_ptr(pact_str)
     };
 
-    let addr_c_str = unsafe {
-      if addr_str.is_null() {
-        log::error!("Got a null pointer instead of listener address");
-        return -1;
-      }
-      CStr::from_ptr(addr_str)
+    create_mock_server_for_json(c_str.to_bytes(), addr_str, tls)
+  });
+
+  match result {
+    Ok(val) => val,
+    Err(cause) => {
+      log::error!("Caught a general panic: {:?}", cause);
+      -4
+    }
+  }
+}
+
+/// External interface to create a mock server from a pact file. The path to the pact file is
+/// passed in, as well as the port for the mock server to run on. The file is read into memory once
+/// and parsed directly from the bytes, without any intermediate string copies. It is not memory
+/// mapped, as the bytes are dropped once the pact is parsed. A value of 0 for the port will result
+/// in a port being allocated by the operating system. The port of the mock server is returned.
+///
+/// * `file_path` - Path to the pact file
+/// * `addr_str` - Address to bind to in the form name:port (i.e. 127.0.0.1:0)
+/// * `tls` - boolean flag to indicate of the mock server should use TLS (using a self-signed certificate)
+///
+/// # Errors
+///
+/// Errors are returned as negative values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | -1 | A null pointer was received |
+/// | -2 | The pact JSON could not be parsed |
+/// | -3 | The mock server could not be started |
+/// | -4 | The method panicked |
+/// | -5 | The address is not valid |
+/// | -6 | Could not create the TLS configuration with the self-signed certificate |
+/// | -7 | The pact file could not be read |
+///
+#[no_mangle]
+pub extern fn pactffi_create_mock_server_from_file(file_path: *const c_char, addr_str: *const c_char, tls: bool) -> i32 {
+  let result = catch_unwind(|| {
+    let file_path = match convert_cstr("file_path", file_path) {
+      Some(file_path) => file_path,
+      None => return -1
     };
 
-    let tls_config = if tls {
-      let key = include_str!("self-signed.key");
-      let cert = include_str!("self-signed.crt");
-      match TlsConfigBuilder::new()
-        .key(key.as_bytes())
-        .cert(cert.as_bytes())
-        .build() {
-        Ok(tls_config) => Some(tls_config),
-        Err(err) => {
-          error!("Failed to build TLS configuration - {}", err);
-          return -6;
-        }
+    match std::fs::read(file_path) {
+      Ok(pact_json) => create_mock_server_for_json(&pact_json, addr_str, tls),
+      Err(err) => {
+        error!("Failed to read pact file '{}' - {}", file_path, err);
+        -7
       }
-    } else {
-      None
-    };
+    }
+  });
 
-    if let Ok(Ok(addr)) = str::from_utf8(addr_c_str.to_bytes()).map(|s| s.parse::<std::net::SocketAddr>()) {
-      let server_result = match tls_config {
-        Some(tls_config) => pact_mock_server::create_tls_mock_server(str::from_utf8(c_str.to_bytes()).unwrap(), addr, &tls_config),
-        None => pact_mock_server::create_mock_server(str::from_utf8(c_str.to_bytes()).unwrap(), addr)
-      };
-      match server_result {
-        Ok(ms_port) => ms_port,
-        Err(err) => match err.downcast_ref::<MockServerError>() {
-          Some(err) => match err {
-            MockServerError::InvalidPactJson => -2,
-            MockServerError::MockServerFailedToStart => -3
-          },
-          None => -3
-        }
+  match result {
+    Ok(val) => val,
+    Err(cause) => {
+      log::error!("Caught a general panic: {:?}", cause);
+      -4
+    }
+  }
+}
+
+fn create_mock_server_for_json(pact_json: &[u8], addr_str: *const c_char, tls: bool) -> i32 {
+  start_mock_server_for(addr_str, tls, &|addr, tls_config| {
+    pact_mock_server::create_mock_server_from_slice(pact_json, addr, tls_config)
+  })
+}
+
+lazy_static! {
+  static ref SELF_SIGNED_TLS_CONFIG: Result<ServerConfig, String> = TlsConfigBuilder::new()
+    .key(include_str!("self-signed.key").as_bytes())
+    .cert(include_str!("self-signed.crt").as_bytes())
+    .build()
+    .map_err(|err| err.to_string());
+}
+
+/// Returns the TLS configuration with the self-signed certificate. It is only built the first
+/// time it is needed, and the clones share the session cache and ticket keys, so clients can
+/// resume their TLS sessions with any of the TLS mock servers.
+fn self_signed_tls_config() -> Result<ServerConfig, String> {
+  SELF_SIGNED_TLS_CONFIG.clone()
+}
+
+/// Parses the listener address and builds the TLS configuration, and then starts the mock server
+/// with the given function. Errors are mapped to the negative values returned by the create
+/// mock server functions.
+fn start_mock_server_for(
+  addr_str: *const c_char,
+  tls: bool,
+  start: &dyn Fn(std::net::SocketAddr, Option<&ServerConfig>) -> anyhow::Result<i32>
+) -> i32 {
+  let addr_c_str = unsafe {
+    if addr_str.is_null() {
+      log::error!("Got a null pointer instead of listener address");
+      return -1;
+    }
+    CStr::from_ptr(addr_str)
+  };
+
+  let tls_config = if tls {
+    match self_signed_tls_config() {
+      Ok(tls_config) => Some(tls_config),
+      Err(err) => {
+        error!("Failed to build TLS configuration - {}", err);
+        return -6;
       }
     }
-    else {
-      -5
+  } else {
+    None
+  };
+
+  if let Ok(Ok(addr)) = str::from_utf8(addr_c_str.to_bytes()).map(|s| s.parse::<std::net::SocketAddr>()) {
+    match start(addr, tls_config.as_ref()) {
+      Ok(ms_port) => ms_port,
+      Err(err) => if let Some(err) = err.downcast_ref::<MockServerError>() {
+        match err {
+          MockServerError::InvalidPactJson => -2,
+          MockServerError::MockServerFailedToStart => -3
+        }
+      } else if let Some(err) = err.downcast_ref::<SnapshotError>() {
+        match err {
+          SnapshotError::InvalidSnapshot(_) => -8,
+          SnapshotError::IncompatibleVersion { .. } => -9
+        }
+      } else if let Some(err) = err.downcast_ref::<std::io::Error>() {
+        error!("Failed to read the snapshot file - {}", err);
+        -7
+      } else {
+        -3
+      }
     }
+  }
+  else {
+    -5
+  }
+}
+
+/// External interface to create a mock server from a Pact snapshot file, as written by
+/// `pactffi_write_mock_server_snapshot`. The snapshot holds the loaded Pact and the index of its
+/// interactions, so starting a mock server from it does not process the Pact JSON again. The snapshot is rejected if it was written by a different
+/// version of this library. A value of 0 for the port will result in a port being allocated by
+/// the operating system. The port of the mock server is returned.
+///
+/// * `file_path` - Path to the snapshot file
+/// * `addr_str` - Address to bind to in the form name:port (i.e. 127.0.0.1:0)
+/// * `tls` - boolean flag to indicate of the mock server should use TLS (using a self-signed certificate)
+///
+/// # Errors
+///
+/// Errors are returned as negative values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | -1 | A null pointer was received |
+/// | -3 | The mock server could not be started |
+/// | -4 | The method panicked |
+/// | -5 | The address is not valid |
+/// | -6 | Could not create the TLS configuration with the self-signed certificate |
+/// | -7 | The snapshot file could not be read |
+/// | -8 | The file is not a valid snapshot, or is truncated or corrupted |
+/// | -9 | The snapshot was written by an incompatible version |
+///
+#[no_mangle]
+pub extern fn pactffi_create_mock_server_from_snapshot(file_path: *const c_char, addr_str: *const c_char, tls: bool) -> i32 {
+  let result = catch_unwind(|| {
+    let file_path = match convert_cstr("file_path", file_path) {
+      Some(file_path) => PathBuf::from(file_path),
+      None => return -1
+    };
+
+    start_mock_server_for(addr_str, tls, &|addr, tls_config| {
+      pact_mock_server::create_mock_server_from_snapshot_file(&file_path, addr, tls_config)
+    })
   });
 
   match result {
@@ -183,6 +335,59 @@ pub extern fn pactffi_create_mock_server(pact_str: *const c_char, addr_str: *con
   }
 }
 
+/// External interface to write a snapshot of the Pact of a running mock server and the index of
+/// its interactions to a file. Mock servers for the same Pact can then be started from the file
+/// with `pactffi_create_mock_server_from_snapshot`.
+///
+/// * `mock_server_port` - Port of the mock server
+/// * `file_path` - Path to write the snapshot to
+///
+/// Returns 0 if the snapshot was written.
+///
+/// # Errors
+///
+/// Errors are returned as positive values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | 1 | A general panic was caught |
+/// | 2 | The file path was NULL, or the snapshot was not able to be written |
+/// | 3 | A mock server with the provided port was not found |
+#[no_mangle]
+pub extern fn pactffi_write_mock_server_snapshot(mock_server_port: i32, file_path: *const c_char) -> i32 {
+  let result = catch_unwind(|| {
+    let file_path = match convert_cstr("file_path", file_path) {
+      Some(file_path) => PathBuf::from(file_path),
+      None => return 2
+    };
+
+    let result = MANAGER.lock().unwrap()
+      .get_or_insert_with(ServerManager::new)
+      .find_mock_server_by_port_mut(mock_server_port as u16, &|mock_server| {
+        mock_server.write_snapshot(&file_path)
+      });
+    match result {
+      Some(Ok(_)) => 0,
+      Some(Err(err)) => {
+        error!("Failed to write the snapshot - {}", err);
+        2
+      },
+      None => {
+        error!("No mock server running on port {}", mock_server_port);
+        3
+      }
+    }
+  });
+
+  match result {
+    Ok(val) => val,
+    Err(cause) => {
+      log::error!("Caught a general panic: {:?}", cause);
+      1
+    }
+  }
+}
+
 /// Fetch the CA Certificate used to generate the self-signed certificate for the TLS mock server.
 ///
 /// **NOTE:** The string for the result is allocated on the heap, and will have to be freed
@@ -221,6 +426,213 @@ pub extern fn pactffi_get_tls_ca_certificate() -> *mut c_char  {
 ///
 #[no_mangle]
 pub extern fn pactffi_create_mock_server_for_pact(pact: handles::PactHandle, addr_str: *const c_char, tls: bool) -> i32 {
+  create_mock_server_for_pact(pact, addr_str, tls, MockServerConfig::default())
+}
+
+/// Options for starting a mock server with `pactffi_create_mock_server_for_pact_with_options`.
+///
+/// The layout of this struct does not change between versions. Options added later are appended
+/// after the existing fields, and callers set `size` to the size of the struct they were built
+/// with (`sizeof(MockServerOptions)`), so any fields they do not know about take their defaults.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct MockServerOptions {
+  /// Size of the struct in bytes, as known to the caller
+  pub size: u32,
+  /// If the mock server should use TLS (using a self-signed certificate)
+  pub tls: bool,
+  /// If CORS Pre-Flight requests should be responded to
+  pub cors_preflight: bool,
+  /// Number of worker threads to serve the mock server with. Values above 1 give the mock server
+  /// its own threads, and a listener per thread bound to the port with `SO_REUSEPORT` (on
+  /// platforms that support it), so requests from parallel clients are served on multiple cores.
+  /// 0 or 1 serves the mock server on the thread shared by all mock servers.
+  pub workers: u32,
+  /// HTTP versions the mock server accepts
+  pub protocols: MockServerProtocols,
+  /// If HTTP/1 connections should be closed after each response instead of being kept alive
+  pub disable_keep_alive: bool,
+  /// If responses on HTTP/1 connections should be flushed together, for clients that pipeline
+  /// requests
+  pub pipeline_flush: bool,
+  /// Interval in milliseconds for sending HTTP/2 keep-alive pings. 0 does not send pings.
+  pub http2_keep_alive_interval_ms: u32,
+  /// If TCP_NODELAY should be set on accepted connections
+  pub tcp_nodelay: bool
+}
+
+/// HTTP versions that a mock server accepts
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub enum MockServerProtocols {
+  /// HTTP/1.1 and HTTP/2. TLS mock servers negotiate the version with ALPN, otherwise HTTP/2
+  /// needs to be used with prior knowledge.
+  Auto,
+  /// Only HTTP/1.1
+  Http1,
+  /// Only HTTP/2
+  Http2
+}
+
+impl Default for MockServerOptions {
+  fn default() -> Self {
+    MockServerOptions {
+      size: std::mem::size_of::<MockServerOptions>() as u32,
+      tls: false,
+      cors_preflight: false,
+      workers: 0,
+      protocols: MockServerProtocols::Auto,
+      disable_keep_alive: false,
+      pipeline_flush: false,
+      http2_keep_alive_interval_ms: 0,
+      tcp_nodelay: false
+    }
+  }
+}
+
+impl From<MockServerOptions> for MockServerConfig {
+  fn from(options: MockServerOptions) -> Self {
+    MockServerConfig {
+      cors_preflight: options.cors_preflight,
+      workers: options.workers as usize,
+      protocols: match options.protocols {
+        MockServerProtocols::Auto => HttpProtocols::Auto,
+        MockServerProtocols::Http1 => HttpProtocols::Http1,
+        MockServerProtocols::Http2 => HttpProtocols::Http2
+      },
+      disable_keep_alive: options.disable_keep_alive,
+      pipeline_flush: options.pipeline_flush,
+      http2_keep_alive_interval: if options.http2_keep_alive_interval_ms > 0 {
+        Some(Duration::from_millis(options.http2_keep_alive_interval_ms as u64))
+      } else {
+        None
+      },
+      tcp_nodelay: options.tcp_nodelay
+    }
+  }
+}
+
+/// External interface to create a mock server with options. A Pact handle is passed in,
+/// as well as the port for the mock server to run on. A value of 0 for the port will result in a
+/// port being allocated by the operating system. The port of the mock server is returned.
+///
+/// * `pact` - Handle to a Pact model
+/// * `addr_str` - Address to bind to in the form name:port (i.e. 127.0.0.1:0)
+/// * `options` - Options for the mock server. A NULL pointer uses the defaults, which are the
+/// same as `pactffi_create_mock_server_for_pact` without TLS.
+///
+/// # Errors
+///
+/// Errors are returned as negative values, the same as for `pactffi_create_mock_server_for_pact`.
+/// In addition, -7 is returned if the `size` of the options does not cover the `size` field, and
+/// -8 if a `bool` field is not 0 or 1 or `protocols` is not one of the `MockServerProtocols` values.
+#[no_mangle]
+pub extern fn pactffi_create_mock_server_for_pact_with_options(
+  pact: handles::PactHandle,
+  addr_str: *const c_char,
+  options: *const MockServerOptions
+) -> i32 {
+  match unsafe { read_mock_server_options(options) } {
+    Ok(options) => create_mock_server_for_pact(pact, addr_str, options.tls, options.into()),
+    Err(code) => code
+  }
+}
+
+/// Layout of `MockServerOptions` as it is passed in by the caller, with the `bool` and enum fields
+/// as plain integers. Any bytes are valid for this struct, so the caller's bytes can be copied
+/// into it before the values are checked.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+struct RawMockServerOptions {
+  size: u32,
+  tls: u8,
+  cors_preflight: u8,
+  workers: u32,
+  protocols: u32,
+  disable_keep_alive: u8,
+  pipeline_flush: u8,
+  http2_keep_alive_interval_ms: u32,
+  tcp_nodelay: u8
+}
+
+impl From<MockServerOptions> for RawMockServerOptions {
+  fn from(options: MockServerOptions) -> Self {
+    RawMockServerOptions {
+      size: options.size,
+      tls: options.tls as u8,
+      cors_preflight: options.cors_preflight as u8,
+      workers: options.workers,
+      protocols: options.protocols as u32,
+      disable_keep_alive: options.disable_keep_alive as u8,
+      pipeline_flush: options.pipeline_flush as u8,
+      http2_keep_alive_interval_ms: options.http2_keep_alive_interval_ms,
+      tcp_nodelay: options.tcp_nodelay as u8
+    }
+  }
+}
+
+fn option_flag(name: &str, value: u8) -> Result<bool, String> {
+  match value {
+    0 => Ok(false),
+    1 => Ok(true),
+    _ => Err(format!("{} must be true or false, got {}", name, value))
+  }
+}
+
+impl RawMockServerOptions {
+  /// Checks the values of the fields and converts them
+  fn validate(&self) -> Result<MockServerOptions, String> {
+    Ok(MockServerOptions {
+      size: std::mem::size_of::<MockServerOptions>() as u32,
+      tls: option_flag("tls", self.tls)?,
+      cors_preflight: option_flag("cors_preflight", self.cors_preflight)?,
+      workers: self.workers,
+      protocols: match self.protocols {
+        0 => MockServerProtocols::Auto,
+        1 => MockServerProtocols::Http1,
+        2 => MockServerProtocols::Http2,
+        _ => return Err(format!("protocols is not a valid MockServerProtocols value, got {}", self.protocols))
+      },
+      disable_keep_alive: option_flag("disable_keep_alive", self.disable_keep_alive)?,
+      pipeline_flush: option_flag("pipeline_flush", self.pipeline_flush)?,
+      http2_keep_alive_interval_ms: self.http2_keep_alive_interval_ms,
+      tcp_nodelay: option_flag("tcp_nodelay", self.tcp_nodelay)?
+    })
+  }
+}
+
+/// Reads the mock server options passed in by the caller. Only the number of bytes given by the
+/// `size` field are read, and the remaining fields take their default values, so callers built
+/// against an older version of the struct are still supported. The bytes are read into
+/// `RawMockServerOptions` and checked, so invalid `bool` or enum values are reported as errors
+/// instead of being read into a `MockServerOptions`.
+///
+/// Returns -7 if the size is too small to include the `size` field itself, or -8 if any of the
+/// fields has an invalid value.
+unsafe fn read_mock_server_options(options: *const MockServerOptions) -> Result<MockServerOptions, i32> {
+  if options.is_null() {
+    return Ok(MockServerOptions::default());
+  }
+  let size = ptr::read_unaligned(options as *const u32) as usize;
+  if size < std::mem::size_of::<u32>() {
+    error!("The size of the mock server options is not valid");
+    return Err(-7);
+  }
+  let mut raw = RawMockServerOptions::from(MockServerOptions::default());
+  let size = size.min(std::mem::size_of::<RawMockServerOptions>());
+  ptr::copy_nonoverlapping(options as *const u8, &mut raw as *mut RawMockServerOptions as *mut u8, size);
+  raw.validate().map_err(|err| {
+    error!("The mock server options are not valid - {}", err);
+    -8
+  })
+}
+
+fn create_mock_server_for_pact(
+  pact: handles::PactHandle,
+  addr_str: *const c_char,
+  tls: bool,
+  config: MockServerConfig
+) -> i32 {
   let result = catch_unwind(|| {
     let addr_c_str = unsafe {
       if addr_str.is_null() {
@@ -231,12 +643,7 @@ pub extern fn pactffi_create_mock_server_for_pact(pact: handles::PactHandle, add
     };
 
     let tls_config = if tls {
-      let key = include_str!("self-signed.key");
-      let cert = include_str!("self-signed.crt");
-      match TlsConfigBuilder::new()
-        .key(key.as_bytes())
-        .cert(cert.as_bytes())
-        .build() {
+      match self_signed_tls_config() {
         Ok(tls_config) => Some(tls_config),
         Err(err) => {
           error!("Failed to build TLS configuration - {}", err);
@@ -250,9 +657,10 @@ pub extern fn pactffi_create_mock_server_for_pact(pact: handles::PactHandle, add
     if let Ok(Ok(addr)) = str::from_utf8(addr_c_str.to_bytes()).map(|s| s.parse::<std::net::SocketAddr>()) {
       pact.with_pact(&move |_, inner| {
         let server_result = match &tls_config {
-          Some(tls_config) => pact_mock_server::start_tls_mock_server(
-            Uuid::new_v4().to_string(), inner.pact.boxed(), addr, tls_config),
-          None => pact_mock_server::start_mock_server(Uuid::new_v4().to_string(), inner.pact.boxed(), addr)
+          Some(tls_config) => pact_mock_server::start_tls_mock_server_with_config(
+            Uuid::new_v4().to_string(), inner.pact.boxed(), addr, tls_config, config.clone()),
+          None => pact_mock_server::start_mock_server_with_config(
+            Uuid::new_v4().to_string(), inner.pact.boxed(), addr, config.clone())
         };
         match server_result {
           Ok(ms_port) => {
@@ -342,6 +750,46 @@ pub extern fn pactffi_mock_server_mismatches(mock_server_port: i32) -> *mut c_ch
   }
 }
 
+/// External interface to get the metrics collected by a mock server. The port number of the mock
+/// server is passed in, and a pointer to a C string with the metrics in JSON format is returned.
+/// The metrics include the number of requests, the bytes received and sent, the number of
+/// candidate interactions each request was matched against, and the latencies (count, mean, p50,
+/// p99 and max in microseconds) for handling, reading, matching and responding to the requests.
+/// The `interactions` attribute has the metrics for each interaction, in the order of the
+/// interactions in the Pact.
+///
+/// **NOTE:** As the metrics are usually polled, the JSON string for the result is owned by the
+/// caller rather than the mock server, and must be freed with `pactffi_string_delete` once it is
+/// no longer needed.
+///
+/// # Errors
+///
+/// If there is no mock server with the provided port number, or the function panics, a NULL
+/// pointer will be returned. Don't try to dereference it, it will not end well for you.
+///
+#[no_mangle]
+pub extern fn pactffi_mock_server_metrics(mock_server_port: i32) -> *mut c_char {
+  let result = catch_unwind(|| {
+    let result = MANAGER.lock().unwrap()
+      .get_or_insert_with(ServerManager::new)
+      .find_mock_server_by_port_mut(mock_server_port as u16, &|mock_server| {
+        json!(mock_server.metrics()).to_string()
+      });
+    match result.and_then(|json| CString::new(json).ok()) {
+      Some(s) => s.into_raw(),
+      None => std::ptr::null_mut()
+    }
+  });
+
+  match result {
+    Ok(val) => val,
+    Err(cause) => {
+      error!("{}", error_message(cause, "mock_server_metrics"));
+      std::ptr::null_mut()
+    }
+  }
+}
+
 /// External interface to cleanup a mock server. This function will try terminate the mock server
 /// with the given port number and cleanup any memory allocated for it. Returns true, unless a
 /// mock server with the given port number does not exist, or the function panics.
@@ -360,15 +808,101 @@ pub extern fn pactffi_cleanup_mock_server(mock_server_port: i32) -> bool {
   }
 }
 
-/// External interface to trigger a mock server to write out its pact file. This function should
-/// be called if all the consumer tests have passed. The directory to write the file to is passed
-/// as the second parameter. If a NULL pointer is passed, the current working directory is used.
+/// External interface to trigger a mock server to write out its pact file. This function should
+/// be called if all the consumer tests have passed. The directory to write the file to is passed
+/// as the second parameter. If a NULL pointer is passed, the current working directory is used.
+///
+/// If overwrite is true, the file will be overwritten with the contents of the current pact.
+/// Otherwise, it will be merged with any existing pact file.
+///
+/// Returns 0 if the pact file was successfully written. Returns a positive code if the file can
+/// not be written, or there is no mock server running on that port or the function panics.
+///
+/// # Errors
+///
+/// Errors are returned as positive values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | 1 | A general panic was caught |
+/// | 2 | The pact file was not able to be written |
+/// | 3 | A mock server with the provided port was not found |
+#[no_mangle]
+pub extern fn pactffi_write_pact_file(mock_server_port: i32, directory: *const c_char, overwrite: bool) -> i32 {
+  let result = catch_unwind(|| {
+    let dir = path_from_dir(directory, None);
+    let path = dir.map(|path| path.into_os_string().into_string().unwrap_or_default());
+
+    pact_mock_server::write_pact_file(mock_server_port, path, overwrite)
+  });
+
+  match result {
+    Ok(val) => match val {
+      Ok(_) => 0,
+      Err(err) => match err {
+        WritePactFileErr::IOError => 2,
+        WritePactFileErr::NoMockServer => 3
+      }
+    },
+    Err(cause) => {
+      log::error!("Caught a general panic: {:?}", cause);
+      1
+    }
+  }
+}
+
+
+/// External interface to trigger a mock server to append the interactions of its pact to the
+/// journal for its pact file. This can be used instead of `pactffi_write_pact_file` when many
+/// tests write to the same pact file, as it does not need to read and re-write the pact file
+/// each time. The pact file is written out once all the tests have completed by calling
+/// `pactffi_finalise_pact_files`. The directory of the pact file is passed as the second
+/// parameter. If a NULL pointer is passed, the current working directory is used.
+///
+/// Returns 0 if the interactions were appended to the journal.
+///
+/// # Errors
+///
+/// Errors are returned as positive values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | 1 | A general panic was caught |
+/// | 2 | The journal was not able to be written, or has conflicting interactions |
+/// | 3 | A mock server with the provided port was not found |
+#[no_mangle]
+pub extern fn pactffi_append_pact_file(mock_server_port: i32, directory: *const c_char) -> i32 {
+  let result = catch_unwind(|| {
+    let dir = path_from_dir(directory, None);
+    let path = dir.map(|path| path.into_os_string().into_string().unwrap_or_default());
+
+    pact_mock_server::append_pact_file(mock_server_port, path)
+  });
+
+  match result {
+    Ok(val) => match val {
+      Ok(_) => 0,
+      Err(err) => match err {
+        WritePactFileErr::IOError => 2,
+        WritePactFileErr::NoMockServer => 3
+      }
+    },
+    Err(cause) => {
+      log::error!("Caught a general panic: {:?}", cause);
+      1
+    }
+  }
+}
+
+/// External interface to reset a running mock server so it can be reused for another test. The
+/// mock server will serve the interactions of the new pact, and all the matches and mismatches
+/// collected so far are discarded. The mock server keeps its port and TLS configuration, so this
+/// avoids the cost of shutting it down and starting a new one.
 ///
-/// If overwrite is true, the file will be overwritten with the contents of the current pact.
-/// Otherwise, it will be merged with any existing pact file.
+/// * `mock_server_port` - Port of the mock server to reset
+/// * `pact_json` - Pact JSON for the new pact
 ///
-/// Returns 0 if the pact file was successfully written. Returns a positive code if the file can
-/// not be written, or there is no mock server running on that port or the function panics.
+/// Returns 0 if the mock server was reset.
 ///
 /// # Errors
 ///
@@ -377,23 +911,27 @@ pub extern fn pactffi_cleanup_mock_server(mock_server_port: i32) -> bool {
 /// | Error | Description |
 /// |-------|-------------|
 /// | 1 | A general panic was caught |
-/// | 2 | The pact file was not able to be written |
+/// | 2 | The pact JSON was NULL or could not be parsed |
 /// | 3 | A mock server with the provided port was not found |
+/// | 4 | The pact is not a request/response pact |
 #[no_mangle]
-pub extern fn pactffi_write_pact_file(mock_server_port: i32, directory: *const c_char, overwrite: bool) -> i32 {
+pub extern fn pactffi_mock_server_reset(mock_server_port: i32, pact_json: *const c_char) -> i32 {
   let result = catch_unwind(|| {
-    let dir = path_from_dir(directory, None);
-    let path = dir.map(|path| path.into_os_string().into_string().unwrap_or_default());
-
-    pact_mock_server::write_pact_file(mock_server_port, path, overwrite)
+    if pact_json.is_null() {
+      log::error!("Got a null pointer instead of pact json");
+      return Err(ResetMockServerErr::InvalidPactJson);
+    }
+    let pact_json = unsafe { CStr::from_ptr(pact_json) };
+    pact_mock_server::reset_mock_server(mock_server_port, pact_json.to_bytes())
   });
 
   match result {
     Ok(val) => match val {
       Ok(_) => 0,
       Err(err) => match err {
-        WritePactFileErr::IOError => 2,
-        WritePactFileErr::NoMockServer => 3
+        ResetMockServerErr::InvalidPactJson => 2,
+        ResetMockServerErr::NoMockServer => 3,
+        ResetMockServerErr::UnsupportedPact => 4
       }
     },
     Err(cause) => {
@@ -403,7 +941,6 @@ pub extern fn pactffi_write_pact_file(mock_server_port: i32, directory: *const c
   }
 }
 
-
 /// Fetch the logs for the mock server. This needs the memory buffer log sink to be setup before
 /// the mock server is started. Returned string will be freed with the `cleanup_mock_server`
 /// function call.
@@ -416,7 +953,7 @@ pub extern fn pactffi_mock_server_logs(mock_server_port: i32) -> *const c_char {
       .get_or_insert_with(ServerManager::new)
       .find_mock_server_by_port_mut(mock_server_port as u16, &|mock_server| {
         match from_utf8(&fetch_buffer_contents(&mock_server.id)) {
-          Ok(contents) => match CString::new(contents.to_string()) {
+          Ok(contents) => match CString::new(contents) {
             Ok(c_str) => {
               let p = c_str.as_ptr();
               mock_server.resources.push(c_str);
@@ -444,6 +981,54 @@ pub extern fn pactffi_mock_server_logs(mock_server_port: i32) -> *const c_char {
   }
 }
 
+/// Fetch the logs for the mock server that were added since the last fetch, without emptying the
+/// log buffer. This needs the memory buffer log sink to be setup before the mock server is started.
+/// The returned string must be freed with the `string_delete` function.
+///
+/// `cursor` must point to a value that is initialised to zero before the first fetch. It will be
+/// updated with the position to use for the next fetch.
+///
+/// Will return a NULL pointer if the cursor is NULL or the logs for the mock server can not be
+/// retrieved.
+///
+/// # Safety
+///
+/// The cursor pointer must be a valid pointer to a `size_t` value.
+#[no_mangle]
+pub unsafe extern fn pactffi_mock_server_logs_since(mock_server_port: i32, cursor: *mut size_t) -> *const c_char {
+  if cursor.is_null() {
+    error!("pactffi_mock_server_logs_since: cursor is NULL");
+    return ptr::null();
+  }
+
+  let result = catch_unwind(|| {
+    MANAGER.lock().unwrap()
+      .get_or_insert_with(ServerManager::new)
+      .find_mock_server_by_port_mut(mock_server_port as u16, &|mock_server| mock_server.id.clone())
+  });
+
+  match result {
+    Ok(Some(id)) => {
+      let (contents, next) = fetch_buffer_contents_since(&id, *cursor);
+      match CString::new(String::from_utf8_lossy(&contents).as_bytes()) {
+        Ok(c_str) => {
+          *cursor = next;
+          c_str.into_raw() as *const c_char
+        },
+        Err(err) => {
+          error!("Failed to copy in-memory log buffer - {}", err);
+          ptr::null()
+        }
+      }
+    },
+    Ok(None) => ptr::null(),
+    Err(cause) => {
+      error!("Caught a general panic: {:?}", cause);
+      ptr::null()
+    }
+  }
+}
+
 /// Creates a new Pact model and returns a handle to it.
 ///
 /// * `consumer_name` - The name of the consumer for the pact.
@@ -457,6 +1042,16 @@ pub extern fn pactffi_new_pact(consumer_name: *const c_char, provider_name: *con
   handles::PactHandle::new(consumer, provider)
 }
 
+/// Deletes a Pact model and releases its memory. The handle, and any interaction handles created
+/// from it, can not be used after this call. Any mock server started for the Pact is not affected.
+///
+/// Returns true if the Pact model was deleted, or false if the handle does not refer to a Pact
+/// model (i.e. it has already been deleted).
+#[no_mangle]
+pub extern fn pactffi_free_pact_handle(pact: handles::PactHandle) -> bool {
+  pact.free()
+}
+
 /// Creates a new Interaction and returns a handle to it.
 ///
 /// * `description` - The interaction description. It needs to be unique for each interaction.
@@ -584,28 +1179,7 @@ pub extern fn pactffi_with_query_parameter(
   if let Some(name) = convert_cstr("name", name) {
     let value = convert_cstr("value", value).unwrap_or_default();
     interaction.with_interaction(&|_, mock_server_started, inner| {
-      inner.request.query = inner.request.query.clone().map(|mut q| {
-        let value = from_integration_json(&mut inner.request.matching_rules, &mut inner.request.generators, &value.to_string(), &format!("{}[{}]", &name, index).to_string(), "query");
-        if q.contains_key(name) {
-          let values = q.get_mut(name).unwrap();
-          if index >= values.len() {
-            values.resize_with(index + 1, Default::default);
-          }
-          values[index] = value.to_string();
-        } else {
-          let mut values: Vec<String> = Vec::new();
-          values.resize_with(index + 1, Default::default);
-          values[index] = value.to_string();
-          q.insert(name.to_string(), values);
-        };
-        q
-      }).or_else(|| {
-        let value = from_integration_json(&mut inner.request.matching_rules, &mut inner.request.generators, &value.to_string(), &format!("{}[{}]", &name, index).to_string(), "query");
-        let mut values: Vec<String> = Vec::new();
-        values.resize_with(index + 1, Default::default);
-        values[index] = value.to_string();
-        Some(hashmap!{ name.to_string() => values })
-      });
+      set_query_parameter(inner, name, index, value);
       !mock_server_started
     }).unwrap_or(false)
   } else {
@@ -614,6 +1188,32 @@ pub extern fn pactffi_with_query_parameter(
   }
 }
 
+/// Sets the value of a query parameter on the request, resizing the values if needed
+fn set_query_parameter(inner: &mut RequestResponseInteraction, name: &str, index: usize, value: &str) {
+  inner.request.query = inner.request.query.clone().map(|mut q| {
+    let value = from_integration_json(&mut inner.request.matching_rules, &mut inner.request.generators, &value.to_string(), &format!("{}[{}]", &name, index).to_string(), "query");
+    if q.contains_key(name) {
+      let values = q.get_mut(name).unwrap();
+      if index >= values.len() {
+        values.resize_with(index + 1, Default::default);
+      }
+      values[index] = value.to_string();
+    } else {
+      let mut values: Vec<String> = Vec::new();
+      values.resize_with(index + 1, Default::default);
+      values[index] = value.to_string();
+      q.insert(name.to_string(), values);
+    };
+    q
+  }).or_else(|| {
+    let value = from_integration_json(&mut inner.request.matching_rules, &mut inner.request.generators, &value.to_string(), &format!("{}[{}]", &name, index).to_string(), "query");
+    let mut values: Vec<String> = Vec::new();
+    values.resize_with(index + 1, Default::default);
+    values[index] = value.to_string();
+    Some(hashmap!{ name.to_string() => values })
+  });
+}
+
 /// Convert JSON matching rule structures into their internal representation (excl. bodies)
 ///
 /// For non-body values (headers, query, path etc.) extract out the value from any matchers
@@ -695,48 +1295,7 @@ pub extern fn pactffi_with_header(
   if let Some(name) = convert_cstr("name", name) {
     let value = convert_cstr("value", value).unwrap_or_default();
     interaction.with_interaction(&|_, mock_server_started, inner| {
-      let headers = match part {
-        InteractionPart::Request => inner.request.headers.clone(),
-        InteractionPart::Response => inner.response.headers.clone()
-      };
-
-      let value = match part {
-        InteractionPart::Request => from_integration_json(&mut inner.request.matching_rules,
-                                                          &mut inner.request.generators,
-                                                          &value.to_string(),
-                                                          &name.to_string(),
-                                                          "header"),
-        InteractionPart::Response => from_integration_json(&mut inner.response.matching_rules,
-                                                           &mut inner.response.generators,
-                                                           &value.to_string(),
-                                                           &name.to_string(),
-                                                           "header")
-      };
-
-      let updated_headers = headers.map(|mut h| {
-        if h.contains_key(name) {
-          let values = h.get_mut(name).unwrap();
-          if index >= values.len() {
-            values.resize_with(index + 1, Default::default);
-          }
-          values[index] = value.to_string();
-        } else {
-          let mut values: Vec<String> = Vec::new();
-          values.resize_with(index + 1, Default::default);
-          values[index] = value.to_string();
-          h.insert(name.to_string(), values);
-        };
-        h
-      }).or_else(|| {
-        let mut values: Vec<String> = Vec::new();
-        values.resize_with(index + 1, Default::default);
-        values[index] = value.to_string();
-        Some(hashmap!{ name.to_string() => values })
-      });
-      match part {
-        InteractionPart::Request => inner.request.headers = updated_headers,
-        InteractionPart::Response => inner.response.headers = updated_headers
-      };
+      set_header(inner, part, name, index, value);
       !mock_server_started
     }).unwrap_or(false)
   } else {
@@ -745,6 +1304,52 @@ pub extern fn pactffi_with_header(
   }
 }
 
+/// Sets the value of a header on the request or response, resizing the values if needed
+fn set_header(inner: &mut RequestResponseInteraction, part: InteractionPart, name: &str, index: usize, value: &str) {
+  let headers = match part {
+    InteractionPart::Request => inner.request.headers.clone(),
+    InteractionPart::Response => inner.response.headers.clone()
+  };
+
+  let value = match part {
+    InteractionPart::Request => from_integration_json(&mut inner.request.matching_rules,
+                                                      &mut inner.request.generators,
+                                                      &value.to_string(),
+                                                      &name.to_string(),
+                                                      "header"),
+    InteractionPart::Response => from_integration_json(&mut inner.response.matching_rules,
+                                                       &mut inner.response.generators,
+                                                       &value.to_string(),
+                                                       &name.to_string(),
+                                                       "header")
+  };
+
+  let updated_headers = headers.map(|mut h| {
+    if h.contains_key(name) {
+      let values = h.get_mut(name).unwrap();
+      if index >= values.len() {
+        values.resize_with(index + 1, Default::default);
+      }
+      values[index] = value.to_string();
+    } else {
+      let mut values: Vec<String> = Vec::new();
+      values.resize_with(index + 1, Default::default);
+      values[index] = value.to_string();
+      h.insert(name.to_string(), values);
+    };
+    h
+  }).or_else(|| {
+    let mut values: Vec<String> = Vec::new();
+    values.resize_with(index + 1, Default::default);
+    values[index] = value.to_string();
+    Some(hashmap!{ name.to_string() => values })
+  });
+  match part {
+    InteractionPart::Request => inner.request.headers = updated_headers,
+    InteractionPart::Response => inner.response.headers = updated_headers
+  };
+}
+
 /// Configures the response for the Interaction. Returns false if the interaction or Pact can't be
 /// modified (i.e. the mock server for it has already started)
 ///
@@ -773,50 +1378,56 @@ pub extern fn pactffi_with_body(
 ) -> bool {
   let content_type = convert_cstr("content_type", content_type).unwrap_or("text/plain");
   let body = convert_cstr("body", body).unwrap_or_default();
-  let content_type_header = "Content-Type".to_string();
   interaction.with_interaction(&|_, mock_server_started, inner| {
-    match part {
-      InteractionPart::Request => {
-        if !inner.request.has_header(&content_type_header) {
-          match inner.request.headers {
-            Some(ref mut headers) => {
-              headers.insert(content_type_header.clone(), vec![ content_type.to_string() ]);
-            },
-            None => {
-              inner.request.headers = Some(hashmap! { content_type_header.clone() => vec![ content_type.to_string() ]});
-            }
+    set_body(inner, part, content_type, body);
+    !mock_server_started
+  }).unwrap_or(false)
+}
+
+/// Sets the body of the request or response, and the content type header if it is not already
+/// set. JSON bodies can have matching rules embedded in them.
+fn set_body(inner: &mut RequestResponseInteraction, part: InteractionPart, content_type: &str, body: &str) {
+  let content_type_header = "Content-Type".to_string();
+  match part {
+    InteractionPart::Request => {
+      if !inner.request.has_header(&content_type_header) {
+        match inner.request.headers {
+          Some(ref mut headers) => {
+            headers.insert(content_type_header.clone(), vec![ content_type.to_string() ]);
+          },
+          None => {
+            inner.request.headers = Some(hashmap! { content_type_header.clone() => vec![ content_type.to_string() ]});
           }
         }
-        let body = if inner.request.content_type().unwrap_or_default().is_json() {
-          let category = inner.request.matching_rules.add_category("body");
-          OptionalBody::from(process_json(body.to_string(), category, &mut inner.request.generators))
-        } else {
-          OptionalBody::from(body)
-        };
-        inner.request.body = body;
-      },
-      InteractionPart::Response => {
-        if !inner.response.has_header(&content_type_header) {
-          match inner.response.headers {
-            Some(ref mut headers) => {
-              headers.insert(content_type_header.clone(), vec![ content_type.to_string() ]);
-            },
-            None => {
-              inner.response.headers = Some(hashmap! { content_type_header.clone() => vec![ content_type.to_string() ]});
-            }
+      }
+      let body = if inner.request.content_type().unwrap_or_default().is_json() {
+        let category = inner.request.matching_rules.add_category("body");
+        OptionalBody::from(process_json(body.to_string(), category, &mut inner.request.generators))
+      } else {
+        OptionalBody::from(body)
+      };
+      inner.request.body = body;
+    },
+    InteractionPart::Response => {
+      if !inner.response.has_header(&content_type_header) {
+        match inner.response.headers {
+          Some(ref mut headers) => {
+            headers.insert(content_type_header.clone(), vec![ content_type.to_string() ]);
+          },
+          None => {
+            inner.response.headers = Some(hashmap! { content_type_header.clone() => vec![ content_type.to_string() ]});
           }
         }
-        let body = if inner.response.content_type().unwrap_or_default().is_json() {
-          let category = inner.response.matching_rules.add_category("body");
-          OptionalBody::from(process_json(body.to_string(), category, &mut inner.response.generators))
-        } else {
-          OptionalBody::from(body)
-        };
-        inner.response.body = body;
       }
-    };
-    !mock_server_started
-  }).unwrap_or(false)
+      let body = if inner.response.content_type().unwrap_or_default().is_json() {
+        let category = inner.response.matching_rules.add_category("body");
+        OptionalBody::from(process_json(body.to_string(), category, &mut inner.response.generators))
+      } else {
+        OptionalBody::from(body)
+      };
+      inner.response.body = body;
+    }
+  };
 }
 
 fn error_message(err: Box<dyn Any>, method: &str) -> String {
@@ -888,7 +1499,7 @@ pub unsafe extern fn pactffi_check_regex(regex: *const c_char, example: *const c
     match c_str.to_str() {
       Ok(regex) => {
         let example = convert_cstr("example", example).unwrap_or_default();
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => re.is_match(example),
           Err(err) => {
             error!("check_regex: '{}' is not a valid regular expression - {}", regex, err);
@@ -904,13 +1515,33 @@ pub unsafe extern fn pactffi_check_regex(regex: *const c_char, example: *const c
   }
 }
 
+lazy_static! {
+  static ref REGEX_GENERATORS: Mutex<HashMap<String, rand_regex::Regex>> = Mutex::new(HashMap::new());
+}
+
+/// Returns the value generator for the regex, parsing and caching it if it has not been seen before
+fn regex_generator(regex: &str) -> Result<rand_regex::Regex, regex_syntax::Error> {
+  if let Some(gen) = REGEX_GENERATORS.lock().ok().and_then(|cache| cache.get(regex).cloned()) {
+    return Ok(gen);
+  }
+
+  let mut parser = regex_syntax::ParserBuilder::new().unicode(false).build();
+  let hir = parser.parse(regex)?;
+  let gen = rand_regex::Regex::with_hir(hir, 20).unwrap();
+  if let Ok(mut cache) = REGEX_GENERATORS.lock() {
+    if cache.len() >= MAX_CACHED_REGEXES && !cache.contains_key(regex) {
+      cache.clear();
+    }
+    cache.insert(regex.to_string(), gen.clone());
+  }
+  Ok(gen)
+}
+
 /// Generates an example string based on the provided regex.
 pub fn generate_regex_value_internal(regex: &str) -> Result<String, String> {
-  let mut parser = regex_syntax::ParserBuilder::new().unicode(false).build();
-  match parser.parse(regex) {
-    Ok(hir) => {
+  match regex_generator(regex) {
+    Ok(gen) => {
       let mut rnd = rand::thread_rng();
-      let gen = rand_regex::Regex::with_hir(hir, 20).unwrap();
       let result: String = rnd.sample(gen);
       Ok(result)
     },
@@ -983,40 +1614,11 @@ pub extern fn pactffi_with_binary_file(
   body: *const u8 ,
   size: size_t
 ) -> bool {
-  let content_type_header = "Content-Type".to_string();
   match convert_cstr("content_type", content_type) {
     Some(content_type) => {
+      let body = convert_ptr_to_body(body, size);
       interaction.with_interaction(&|_, mock_server_started, inner| {
-        match part {
-          InteractionPart::Request => {
-            inner.request.body = convert_ptr_to_body(body, size);
-            if !inner.request.has_header(&content_type_header) {
-              match inner.request.headers {
-                Some(ref mut headers) => {
-                  headers.insert(content_type_header.clone(), vec!["application/octet-stream".to_string()]);
-                },
-                None => {
-                  inner.request.headers = Some(hashmap! { content_type_header.clone() => vec!["application/octet-stream".to_string()]});
-                }
-              }
-            };
-            inner.request.matching_rules.add_category("body").add_rule("$", MatchingRule::ContentType(content_type.into()), &RuleLogic::And);
-          },
-          InteractionPart::Response => {
-            inner.response.body = convert_ptr_to_body(body, size);
-            if !inner.response.has_header(&content_type_header) {
-              match inner.response.headers {
-                Some(ref mut headers) => {
-                  headers.insert(content_type_header.clone(), vec!["application/octet-stream".to_string()]);
-                },
-                None => {
-                  inner.response.headers = Some(hashmap! { content_type_header.clone() => vec!["application/octet-stream".to_string()]});
-                }
-              }
-            }
-            inner.response.matching_rules.add_category("body").add_rule("$", MatchingRule::ContentType(content_type.into()), &RuleLogic::And);
-          }
-        };
+        set_binary_body(inner, part, content_type, &body);
         !mock_server_started
       }).unwrap_or(false)
     },
@@ -1027,6 +1629,98 @@ pub extern fn pactffi_with_binary_file(
   }
 }
 
+/// Adds a binary file as the body with the expected content type, reading the example contents
+/// from the file at the given path. Will use a mime type matcher to match the body. The file is
+/// read once into a reference counted buffer that is shared with any mock server started for the
+/// Pact, so the contents are not copied again until a pact file is written. The file is not memory
+/// mapped, as the body lives as long as the Pact and changing or truncating a mapped file in that
+/// time would change the body or crash the process. Returns false if the file can not be read or
+/// if the interaction or Pact can't be modified (i.e. the mock server for it has already started)
+///
+/// * `interaction` - Interaction handle to set the body for.
+/// * `part` - Request or response part.
+/// * `content_type` - Expected content type.
+/// * `file_path` - path to the file with the example body contents
+#[no_mangle]
+pub extern fn pactffi_with_binary_file_path(
+  interaction: handles::InteractionHandle,
+  part: InteractionPart,
+  content_type: *const c_char,
+  file_path: *const c_char
+) -> bool {
+  match (convert_cstr("content_type", content_type), convert_cstr("file_path", file_path)) {
+    (Some(content_type), Some(file_path)) => match read_body_file(file_path) {
+      Ok(body) => {
+        interaction.with_interaction(&|_, mock_server_started, inner| {
+          set_binary_body(inner, part, content_type, &body);
+          !mock_server_started
+        }).unwrap_or(false)
+      },
+      Err(err) => {
+        warn!("with_binary_file_path: {}", err);
+        false
+      }
+    },
+    (None, _) => {
+      warn!("with_binary_file_path: Content type value is not valid (NULL or non-UTF-8)");
+      false
+    },
+    (_, None) => {
+      warn!("with_binary_file_path: File path is not valid (NULL or non-UTF-8)");
+      false
+    }
+  }
+}
+
+fn set_binary_body(
+  inner: &mut RequestResponseInteraction,
+  part: InteractionPart,
+  content_type: &str,
+  body: &OptionalBody
+) {
+  let content_type_header = "Content-Type".to_string();
+  match part {
+    InteractionPart::Request => {
+      inner.request.body = body.clone();
+      if !inner.request.has_header(&content_type_header) {
+        match inner.request.headers {
+          Some(ref mut headers) => {
+            headers.insert(content_type_header.clone(), vec!["application/octet-stream".to_string()]);
+          },
+          None => {
+            inner.request.headers = Some(hashmap! { content_type_header.clone() => vec!["application/octet-stream".to_string()]});
+          }
+        }
+      };
+      inner.request.matching_rules.add_category("body").add_rule("$", MatchingRule::ContentType(content_type.into()), &RuleLogic::And);
+    },
+    InteractionPart::Response => {
+      inner.response.body = body.clone();
+      if !inner.response.has_header(&content_type_header) {
+        match inner.response.headers {
+          Some(ref mut headers) => {
+            headers.insert(content_type_header.clone(), vec!["application/octet-stream".to_string()]);
+          },
+          None => {
+            inner.response.headers = Some(hashmap! { content_type_header.clone() => vec!["application/octet-stream".to_string()]});
+          }
+        }
+      }
+      inner.response.matching_rules.add_category("body").add_rule("$", MatchingRule::ContentType(content_type.into()), &RuleLogic::And);
+    }
+  };
+}
+
+/// Reads the file into a body. The buffer the file is read into becomes the body without being
+/// copied, and clones of the body share it.
+fn read_body_file(file_path: &str) -> Result<OptionalBody, String> {
+  match std::fs::read(file_path) {
+    Ok(data) if data.is_empty() => Ok(OptionalBody::Empty),
+    Ok(data) => Ok(OptionalBody::Present(Bytes::from(data), None)),
+    Err(err) => Err(format!("Failed to read the body from file '{}' - {}", file_path, err))
+  }
+}
+
 /// Adds a binary file as the body as a MIME multipart with the expected content type and example contents. Will use
 /// a mime type matcher to match the body. Returns an error if the interaction or Pact can't be
 /// modified (i.e. the mock server for it has already started)
@@ -1123,6 +1817,16 @@ pub extern fn pactffi_new_message_pact(consumer_name: *const c_char, provider_na
   handles::MessagePactHandle::new(consumer, provider)
 }
 
+/// Deletes a Pact Message model and releases its memory. The handle, and any message handles
+/// created from it, can not be used after this call.
+///
+/// Returns true if the Pact Message model was deleted, or false if the handle does not refer to a
+/// Pact Message model (i.e. it has already been deleted).
+#[no_mangle]
+pub extern fn pactffi_free_message_pact_handle(pact: handles::MessagePactHandle) -> bool {
+  pact.free()
+}
+
 /// Creates a new Message and returns a handle to it.
 ///
 /// * `description` - The message description. It needs to be unique for each Message.
@@ -1233,6 +1937,38 @@ pub extern fn pactffi_message_with_contents(message: handles::MessageHandle, con
   });
 }
 
+/// Adds the contents of the Message, reading them from the file at the given path. The file is
+/// read once into a reference counted buffer, and the contents are not copied again until a pact
+/// file is written. Binary data will be base64 encoded when serialised. Matching rules can not be
+/// embedded in the contents. Returns false if the file can not be read.
+///
+/// * `message` - Message handle to set the contents for.
+/// * `content_type` - Expected content type (e.g. application/octet-stream)
+/// * `file_path` - path to the file with the message contents
+#[no_mangle]
+pub extern fn pactffi_message_with_contents_file(message: handles::MessageHandle, content_type: *const c_char, file_path: *const c_char) -> bool {
+  let content_type = convert_cstr("content_type", content_type).unwrap_or("application/octet-stream");
+  match convert_cstr("file_path", file_path) {
+    Some(file_path) => match read_body_file(file_path) {
+      Ok(body) => {
+        let body = match body {
+          OptionalBody::Present(data, _) => OptionalBody::Present(data, ContentType::parse(content_type).ok()),
+          _ => body
+        };
+        message.with_message(&|_, inner| inner.contents = body.clone()).is_some()
+      },
+      Err(err) => {
+        warn!("message_with_contents_file: {}", err);
+        false
+      }
+    },
+    None => {
+      warn!("message_with_contents_file: File path is not valid (NULL or non-UTF-8)");
+      false
+    }
+  }
+}
+
 /// Adds expected metadata to the Message
 ///
 /// * `key` - metadata key
@@ -1252,11 +1988,9 @@ pub extern fn pactffi_message_with_metadata(message: handles::MessageHandle, key
 #[no_mangle]
 pub extern fn pactffi_message_reify(message: handles::MessageHandle) -> *const c_char {
   let res = message.with_message(&|_, inner| {
-    match inner.body() {
-      Null => "null".to_string(),
-      Present(_, _) => inner.to_json(&PactSpecification::V3.into()).to_string(),
-      _ => "".to_string()
-    }
+    let mut buffer = vec![];
+    write_reified_message(inner, &mut buffer);
+    buffer
   });
 
   match res {
@@ -1268,6 +2002,75 @@ pub extern fn pactffi_message_reify(message: handles::MessageHandle) -> *const c
   }
 }
 
+/// Reifies all the messages of the message pact into the buffer supplied by the caller. The
+/// reified messages are written one after the other, each followed by a NULL byte, in the same
+/// form as returned by `pactffi_message_reify`, so that each one can be read as a C string.
+///
+/// * `pact` - Handle to the message pact
+/// * `buffer` - Buffer to write the messages to
+/// * `length` - Length of the buffer
+///
+/// Returns the number of bytes needed for all the messages, including the NULL bytes. If the
+/// buffer is NULL or shorter than that, nothing is written, and the function can be called again
+/// with a buffer of the returned length.
+///
+/// # Errors
+///
+/// Errors are returned as negative values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | -1 | The message pact for the given handle was not found |
+/// | -2 | The reified messages are too large to return their length |
+/// | -3 | The method panicked |
+#[no_mangle]
+pub extern fn pactffi_message_pact_reify_all(
+  pact: handles::MessagePactHandle,
+  buffer: *mut c_char,
+  length: size_t
+) -> i32 {
+  let result = catch_unwind(|| {
+    let reified = pact.with_pact(&|_, inner| {
+      let mut reified = vec![];
+      for message in &inner.messages {
+        write_reified_message(message, &mut reified);
+        reified.push(0);
+      }
+      reified
+    });
+
+    match reified {
+      Some(reified) if reified.len() > i32::MAX as usize => -2,
+      Some(reified) => {
+        if !buffer.is_null() && length >= reified.len() {
+          unsafe { ptr::copy_nonoverlapping(reified.as_ptr(), buffer as *mut u8, reified.len()) };
+        }
+        reified.len() as i32
+      },
+      None => -1
+    }
+  });
+
+  match result {
+    Ok(val) => val,
+    Err(cause) => {
+      error!("{}", error_message(cause, "pactffi_message_pact_reify_all"));
+      -3
+    }
+  }
+}
+
+/// Writes the message with any matchers stripped away to the buffer
+fn write_reified_message(message: &Message, buffer: &mut Vec<u8>) {
+  match message.body() {
+    Null => buffer.extend_from_slice(b"null"),
+    Present(_, _) => {
+      let _ = serde_json::to_writer(&mut *buffer, &message.to_json(&PactSpecification::V3.into()));
+    },
+    _ => {}
+  }
+}
+
 /// External interface to write out the message pact file. This function should
 /// be called if all the consumer tests have passed. The directory to write the file to is passed
 /// as the second parameter. If a NULL pointer is passed, the current working directory is used.
@@ -1308,6 +2111,84 @@ pub extern fn pactffi_write_message_pact_file(pact: handles::MessagePactHandle,
   }
 }
 
+/// External interface to append the interactions of the message pact to the journal for its
+/// pact file. The pact file is written out once all the tests have completed by calling
+/// `pactffi_finalise_pact_files`. The directory of the pact file is passed as the second
+/// parameter. If a NULL pointer is passed, the current working directory is used.
+///
+/// Returns 0 if the interactions were appended to the journal.
+///
+/// # Errors
+///
+/// Errors are returned as positive values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | 1 | The journal was not able to be written, or has conflicting interactions |
+/// | 2 | The message pact for the given handle was not found |
+#[no_mangle]
+pub extern fn pactffi_append_message_pact_file(pact: handles::MessagePactHandle, directory: *const c_char) -> i32 {
+  let result = pact.with_pact(&|_, inner| {
+    let file_name = inner.default_file_name();
+    let filename = path_from_dir(directory, Some(file_name.as_str()))
+      .unwrap_or_else(|| PathBuf::from(file_name.as_str()));
+    journal::append_pact(&*inner, &filename, inner.specification_version())
+  });
+
+  match result {
+    Some(append_result) => match append_result {
+      Ok(_) => 0,
+      Err(e) => {
+        log::error!("unable to append to the pact journal: {:}", e);
+        1
+      }
+    },
+    None => {
+      log::error!("unable to append to the pact journal, message pact for handle {:?} not found", &pact);
+      2
+    }
+  }
+}
+
+/// External interface to write out the pact files that have had interactions appended to their
+/// journals with `pactffi_append_pact_file` or `pactffi_append_message_pact_file`. This function
+/// should be called once all the consumer tests have passed. Each pact file is written once in
+/// the directory, and its journal removed. If a NULL pointer is passed for the directory, the
+/// current working directory is used.
+///
+/// If overwrite is true, the files will be overwritten with the interactions from the journals.
+/// Otherwise, they will be merged with any existing pact files.
+///
+/// Returns the number of pact files written.
+///
+/// # Errors
+///
+/// Errors are returned as negative values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | -1 | A general panic was caught |
+/// | -2 | A pact file was not able to be written |
+#[no_mangle]
+pub extern fn pactffi_finalise_pact_files(directory: *const c_char, overwrite: bool) -> i32 {
+  let result = catch_unwind(|| {
+    let dir = path_from_dir(directory, None).unwrap_or_else(|| PathBuf::from("."));
+    journal::finalise_pacts_in_dir(&dir, overwrite)
+  });
+
+  match result {
+    Ok(Ok(count)) => count as i32,
+    Ok(Err(err)) => {
+      log::error!("unable to write the pact files from their journals: {}", err);
+      -2
+    },
+    Err(cause) => {
+      log::error!("Caught a general panic: {:?}", cause);
+      -1
+    }
+  }
+}
+
 /// Sets the additional metadata on the Pact file. Common uses are to add the client library details such as the name and version
 ///
 /// * `pact` - Handle to a Pact model
@@ -8,7 +8,7 @@ use crate::models::pact_specification::PactSpecification;
 use crate::util::*;
 use crate::{as_mut, as_ref, cstr, ffi_fn, safe_str};
 use anyhow::{anyhow, Context};
-use libc::{c_char, c_int, c_uint, EXIT_FAILURE, EXIT_SUCCESS};
+use libc::{c_char, c_int, c_uint, size_t, EXIT_FAILURE, EXIT_SUCCESS};
 use pact_models::{content_types::ContentType};
 use pact_models::bodies::OptionalBody;
 use serde_json::from_str as from_json_str;
@@ -169,6 +169,33 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Get a borrowed pointer to the contents of a `Message`, and write the length of the
+    /// contents to `length`. Unlike `pactffi_message_get_contents`, the contents are not copied,
+    /// and can contain binary data.
+    ///
+    /// # Safety
+    ///
+    /// The returned pointer is owned by the message, and must not be deleted. It is only valid
+    /// until the message is modified or deleted. The contents are not null terminated.
+    ///
+    /// # Error Handling
+    ///
+    /// If the message is NULL, or the body of the message is missing, returns NULL. Empty
+    /// contents have a length of 0.
+    fn pactffi_message_get_contents_borrowed(message: *const Message, length: *mut size_t) -> *const u8 {
+        let message = as_ref!(message);
+
+        match &message.contents {
+            OptionalBody::Missing => ptr::null_to::<u8>(),
+            OptionalBody::Present(bytes, _) => ptr::borrow_bytes(bytes, length),
+            _ => ptr::borrow_bytes(&[], length)
+        }
+    } {
+        ptr::null_to::<u8>()
+    }
+}
+
 /*-----------------------------------------------------------------------------------------------
  * ## Description
  */
@@ -227,6 +254,26 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Get a borrowed pointer to the description, and write the length of the description to
+    /// `length`.
+    ///
+    /// # Safety
+    ///
+    /// The returned pointer is owned by the message, and must not be deleted. It is only valid
+    /// until the message is modified or deleted. The description is not null terminated.
+    ///
+    /// # Error Handling
+    ///
+    /// On failure, this function will return a NULL pointer.
+    fn pactffi_message_get_description_borrowed(message: *const Message, length: *mut size_t) -> *const u8 {
+        let message = as_ref!(message);
+        ptr::borrow_bytes(message.description.as_bytes(), length)
+    } {
+        ptr::null_to::<u8>()
+    }
+}
+
 /*-----------------------------------------------------------------------------------------------
  * ## Provider States
  */
@@ -365,6 +412,33 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Get a borrowed pointer to the metadata value indexed by `key`, and write the length of
+    /// the value to `length`.
+    ///
+    /// # Safety
+    ///
+    /// The returned pointer is owned by the message, and must not be deleted. It is only valid
+    /// until the message is modified or deleted. The value is not null terminated.
+    ///
+    /// # Error Handling
+    ///
+    /// On failure, this function will return a NULL pointer.
+    ///
+    /// This function may fail if the provided `key` string contains invalid UTF-8, if the
+    /// metadata does not contain the given key, or if the value is not a string.
+    fn pactffi_message_find_metadata_borrowed(message: *const Message, key: *const c_char, length: *mut size_t) -> *const u8 {
+        let message = as_ref!(message);
+        let key = safe_str!(key);
+        let value = message.metadata.get(key)
+            .and_then(|value| value.as_str())
+            .ok_or(anyhow::anyhow!("invalid metadata key"))?;
+        ptr::borrow_bytes(value.as_bytes(), length)
+    } {
+        ptr::null_to::<u8>()
+    }
+}
+
 ffi_fn! {
     /// Insert the (`key`, `value`) pair into this Message's
     /// `metadata` HashMap.
@@ -3,7 +3,7 @@
 use crate::util::*;
 use crate::{as_mut, as_ref, ffi_fn, safe_str};
 use anyhow::{anyhow, Context};
-use libc::c_char;
+use libc::{c_char, size_t};
 use std::iter::{self, Iterator};
 
 // Necessary to make 'cbindgen' generate an opaque struct on the C side.
@@ -186,6 +186,38 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Get a borrowed pointer to the metadata value indexed by `key1` and `key2`, and write the
+    /// length of the value to `length`.
+    ///
+    /// # Safety
+    ///
+    /// The returned pointer is owned by the message pact, and must not be deleted. It is only
+    /// valid until the message pact is modified or deleted. The value is not null terminated.
+    ///
+    /// # Error Handling
+    ///
+    /// On failure, this function will return a NULL pointer.
+    ///
+    /// This function may fail if the provided `key1` or `key2` strings contains
+    /// invalid UTF-8, or if the metadata does not contain the given keys.
+    fn pactffi_message_pact_find_metadata_borrowed(
+        message_pact: *const MessagePact,
+        key1: *const c_char,
+        key2: *const c_char,
+        length: *mut size_t
+    ) -> *const u8 {
+        let message_pact = as_ref!(message_pact);
+        let key1 = safe_str!(key1);
+        let key2 = safe_str!(key2);
+        let metadata = message_pact.metadata.get(key1).ok_or(anyhow::anyhow!("invalid metadata key (key 1)"))?;
+        let value = metadata.get(key2).ok_or(anyhow::anyhow!("invalid metadata key (key 2)"))?;
+        ptr::borrow_bytes(value.as_bytes(), length)
+    } {
+        ptr::null_to::<u8>()
+    }
+}
+
 ffi_fn! {
     /// Get an iterator over the metadata of a message pact.
     ///
@@ -36,6 +36,18 @@ pub(crate) fn null_mut_to<T>() -> *mut T {
     ptr::null_mut() as *mut T
 }
 
+/// Get a borrowed pointer to the bytes, writing their length to `length` if it is not null.
+///
+/// The bytes are not copied or null terminated, so the pointer is only valid for as long as the
+/// value that owns them is not modified or deleted.
+#[inline]
+pub(crate) fn borrow_bytes(bytes: &[u8], length: *mut usize) -> *const u8 {
+    if let Some(length) = unsafe { length.as_mut() } {
+        *length = bytes.len();
+    }
+    bytes.as_ptr()
+}
+
 /// Get an immutable reference from a raw pointer
 #[macro_export]
 macro_rules! as_ref {
@@ -1,10 +1,20 @@
 use clap::{App, Arg};
 use regex::Regex;
 
+use pact_verifier::shards::Shard;
+
 fn integer_value(v: String) -> Result<(), String> {
   v.parse::<u16>().map(|_| ()).map_err(|e| format!("'{}' is not a valid port value: {}", v, e) )
 }
 
+fn concurrency_value(v: String) -> Result<(), String> {
+  match v.parse::<usize>() {
+    Ok(0) => Err(format!("'{}' is not a valid concurrency value: it must be at least 1", v)),
+    Ok(_) => Ok(()),
+    Err(e) => Err(format!("'{}' is not a valid concurrency value: {}", v, e))
+  }
+}
+
 pub(crate) fn setup_app<'a, 'b>(program: String, version: &'b str) -> App<'a, 'b> {
   App::new(program)
     .version(version)
@@ -20,7 +30,7 @@ pub(crate) fn setup_app<'a, 'b>(program: String, version: &'b str) -> App<'a, 'b
     .arg(Arg::with_name("file")
       .short("f")
       .long("file")
-      .required_unless_one(&["dir", "url", "broker-url"])
+      .required_unless_one(&["dir", "url", "broker-url", "merge-shard-results"])
       .takes_value(true)
       .use_delimiter(false)
       .multiple(true)
@@ -30,7 +40,7 @@ pub(crate) fn setup_app<'a, 'b>(program: String, version: &'b str) -> App<'a, 'b
     .arg(Arg::with_name("dir")
       .short("d")
       .long("dir")
-      .required_unless_one(&["file", "url", "broker-url"])
+      .required_unless_one(&["file", "url", "broker-url", "merge-shard-results"])
       .takes_value(true)
       .use_delimiter(false)
       .multiple(true)
@@ -40,7 +50,7 @@ pub(crate) fn setup_app<'a, 'b>(program: String, version: &'b str) -> App<'a, 'b
     .arg(Arg::with_name("url")
       .short("u")
       .long("url")
-      .required_unless_one(&["file", "dir", "broker-url"])
+      .required_unless_one(&["file", "dir", "broker-url", "merge-shard-results"])
       .takes_value(true)
       .use_delimiter(false)
       .multiple(true)
@@ -51,7 +61,7 @@ pub(crate) fn setup_app<'a, 'b>(program: String, version: &'b str) -> App<'a, 'b
       .short("b")
       .long("broker-url")
       .env("PACT_BROKER_BASE_URL")
-      .required_unless_one(&["file", "dir", "url"])
+      .required_unless_one(&["file", "dir", "url", "merge-shard-results"])
       .requires("provider-name")
       .takes_value(true)
       .use_delimiter(false)
@@ -59,6 +69,12 @@ pub(crate) fn setup_app<'a, 'b>(program: String, version: &'b str) -> App<'a, 'b
       .number_of_values(1)
       .empty_values(false)
       .help("URL of the pact broker to fetch pacts from to verify (requires the provider name parameter)"))
+    .arg(Arg::with_name("pact-cache-dir")
+      .long("pact-cache-dir")
+      .takes_value(true)
+      .use_delimiter(false)
+      .empty_values(false)
+      .help("Directory to cache pacts fetched from the pact broker in. Pacts that have not changed on the broker are loaded from the cache."))
     .arg(Arg::with_name("hostname")
       .short("h")
       .long("hostname")
@@ -96,6 +112,13 @@ pub(crate) fn setup_app<'a, 'b>(program: String, version: &'b str) -> App<'a, 'b
     .arg(Arg::with_name("state-change-teardown")
       .long("state-change-teardown")
       .help("State change teardown requests are to be made after each interaction"))
+    .arg(Arg::with_name("state-change-batch")
+      .long("state-change-batch")
+      .conflicts_with("state-change-as-query")
+      .help("All the provider states of an interaction will be sent in a single state change request"))
+    .arg(Arg::with_name("group-provider-states")
+      .long("group-provider-states")
+      .help("Interactions with the same provider states will be verified together, with the state change requests only made once for each group"))
     .arg(Arg::with_name("filter-description")
       .long("filter-description")
       .env("PACT_DESCRIPTION")
@@ -226,6 +249,42 @@ pub(crate) fn setup_app<'a, 'b>(program: String, version: &'b str) -> App<'a, 'b
       .empty_values(false)
       .validator(integer_value)
       .help("Sets the HTTP request timeout in milliseconds for requests to the target API and for state change requests."))
+    .arg(Arg::with_name("interaction-concurrency")
+      .long("interaction-concurrency")
+      .takes_value(true)
+      .empty_values(false)
+      .validator(concurrency_value)
+      .help("Sets the maximum number of interactions without provider states that will be verified at the same time. Defaults to 1."))
+    .arg(Arg::with_name("pact-concurrency")
+      .long("pact-concurrency")
+      .takes_value(true)
+      .empty_values(false)
+      .validator(concurrency_value)
+      .help("Sets the maximum number of pacts that will be verified at the same time. Defaults to 1."))
+    .arg(Arg::with_name("shard")
+      .long("shard")
+      .takes_value(true)
+      .use_delimiter(false)
+      .empty_values(false)
+      .validator(|val| val.parse::<Shard>().map(|_| ()))
+      .requires("shard-results")
+      .help("Only verify the interactions assigned to this shard, given as index/total (e.g. 2/4). Running every shard verifies all the interactions. Results are not published, they are written to the --shard-results file and published with --merge-shard-results."))
+    .arg(Arg::with_name("shard-results")
+      .long("shard-results")
+      .takes_value(true)
+      .use_delimiter(false)
+      .empty_values(false)
+      .requires("shard")
+      .help("File to write the verification results of the shard to"))
+    .arg(Arg::with_name("merge-shard-results")
+      .long("merge-shard-results")
+      .takes_value(true)
+      .use_delimiter(false)
+      .multiple(true)
+      .number_of_values(1)
+      .empty_values(false)
+      .requires("provider-version")
+      .help("Merges the results written by each shard with --shard-results, and publishes them to the Pact Broker instead of verifying any pacts (can be repeated, once for each shard)"))
     }
 
 #[cfg(test)]
@@ -233,7 +292,7 @@ mod test {
 
   use quickcheck::{TestResult, quickcheck};
   use rand::Rng;
-  use super::integer_value;
+  use super::{concurrency_value, integer_value};
   use expectest::prelude::*;
   use expectest::expect;
   use pact_matching::s;
@@ -257,4 +316,13 @@ mod test {
     expect!(integer_value(s!("1234"))).to(be_ok());
     expect!(integer_value(s!("1234x"))).to(be_err());
   }
+
+  #[test]
+  fn validates_concurrency_value() {
+    expect!(concurrency_value(s!("1"))).to(be_ok());
+    expect!(concurrency_value(s!("100000"))).to(be_ok());
+    expect!(concurrency_value(s!("0"))).to(be_err());
+    expect!(concurrency_value(s!("-1"))).to(be_err());
+    expect!(concurrency_value(s!("2x"))).to(be_err());
+  }
 }
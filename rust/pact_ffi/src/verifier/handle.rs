@@ -0,0 +1,51 @@
+//! Handle that keeps the resources used for verifying providers across verifications
+
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex};
+
+use pact_verifier::create_provider_client;
+
+/// HTTP clients shared across verifications, keyed by the options needed to create them.
+#[derive(Debug, Default)]
+pub struct ClientCache {
+  clients: Mutex<HashMap<(bool, u64), Arc<reqwest::Client>>>,
+  broker_client: Mutex<Option<Arc<reqwest::Client>>>
+}
+
+impl ClientCache {
+  /// Returns the client for the options, creating it if this is the first time they are used.
+  pub fn client(&self, disable_ssl_verification: bool, request_timeout: u64) -> Arc<reqwest::Client> {
+    self.clients.lock().unwrap()
+      .entry((disable_ssl_verification, request_timeout))
+      .or_insert_with(|| Arc::new(create_provider_client(disable_ssl_verification, request_timeout)))
+      .clone()
+  }
+
+  /// Returns the client for the requests to the Pact Broker, creating it the first time it is used.
+  pub fn broker_client(&self) -> Arc<reqwest::Client> {
+    self.broker_client.lock().unwrap()
+      .get_or_insert_with(|| Arc::new(reqwest::Client::new()))
+      .clone()
+  }
+}
+
+/// Verifier handle. Keeps the runtime and HTTP clients used by the verification process, so they
+/// can be reused by each verification that is executed with the handle.
+#[derive(Debug)]
+pub struct VerifierHandle {
+  pub(crate) runtime: tokio::runtime::Runtime,
+  pub(crate) clients: ClientCache
+}
+
+impl VerifierHandle {
+  /// Creates a new handle, starting the runtime that verifications will be executed on
+  pub fn new() -> std::io::Result<VerifierHandle> {
+    let runtime = tokio::runtime::Builder::new_multi_thread()
+      .enable_all()
+      .build()?;
+    Ok(VerifierHandle {
+      runtime,
+      clients: ClientCache::default()
+    })
+  }
+}
@@ -4,12 +4,16 @@
 #![warn(missing_docs)]
 
 use std::ffi::CStr;
-use std::panic::catch_unwind;
+use std::panic::{AssertUnwindSafe, catch_unwind};
+use std::ptr;
 
 use libc::c_char;
 use log::*;
 
+use crate::verifier::handle::VerifierHandle;
+
 mod args;
+pub mod handle;
 pub mod verifier;
 
 /// External interface to verifier a provider
@@ -58,3 +62,82 @@ pub unsafe extern fn pactffi_verify(args: *const c_char) -> i32 {
     }
   }
 }
+
+/// Creates a new verifier handle. The handle keeps a multi-threaded runtime and a pool of HTTP
+/// connections to the provider, which are reused by each verification executed with
+/// `pactffi_verifier_execute`. The handle must be released with `pactffi_verifier_shutdown`.
+///
+/// Returns a NULL pointer if the runtime could not be started.
+#[no_mangle]
+pub extern fn pactffi_verifier_new() -> *mut VerifierHandle {
+  match VerifierHandle::new() {
+    Ok(handle) => Box::into_raw(Box::new(handle)),
+    Err(err) => {
+      error!("Failed to start the verifier runtime: {}", err);
+      ptr::null_mut()
+    }
+  }
+}
+
+/// Verifies a provider using the runtime and HTTP connections of the verifier handle.
+///
+/// * `handle` - handle created with `pactffi_verifier_new`
+/// * `args` - the same as the CLI interface, except newline delimited
+///
+/// # Errors
+///
+/// Errors are returned as non-zero numeric values.
+///
+/// | Error | Description |
+/// |-------|-------------|
+/// | 1 | The verification process failed, see output for errors |
+/// | 2 | A null pointer was received |
+/// | 3 | The method panicked |
+/// | 4 | Invalid arguments were provided to the verification process |
+///
+/// # Safety
+///
+/// The handle must be a valid pointer returned by `pactffi_verifier_new` that has not been shut down.
+#[no_mangle]
+pub unsafe extern fn pactffi_verifier_execute(handle: *mut VerifierHandle, args: *const c_char) -> i32 {
+  if handle.is_null() || args.is_null() {
+    return 2;
+  }
+
+  let handle = &*handle;
+  let result = catch_unwind(AssertUnwindSafe(|| {
+    handle.runtime.block_on(async {
+      let args_raw = CStr::from_ptr(args).to_string_lossy().into_owned();
+      let args: Vec<String> = args_raw.lines().map(|s| s.to_string()).collect();
+      let result = verifier::handle_args_with_clients(args, Some(&handle.clients)).await;
+
+      match result {
+        Ok(_) => 0,
+        Err(e) => e
+      }
+    })
+  }));
+
+  match result {
+    Ok(val) => val,
+    Err(cause) => {
+      log::error!("Caught a general panic: {:?}", cause);
+      3
+    }
+  }
+}
+
+/// Shuts down the verifier handle, stopping its runtime and releasing its resources. Passing a
+/// NULL pointer is allowed, and does nothing.
+///
+/// # Safety
+///
+/// The handle must be a valid pointer returned by `pactffi_verifier_new`, and must not be used
+/// after this call.
+#[no_mangle]
+pub unsafe extern fn pactffi_verifier_shutdown(handle: *mut VerifierHandle) {
+  if !handle.is_null() {
+    let handle = *Box::from_raw(handle);
+    handle.runtime.shutdown_background();
+  }
+}
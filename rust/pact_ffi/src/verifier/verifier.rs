@@ -1,12 +1,13 @@
 //! Exported verifier functions
 
 use std::env;
+use std::path::PathBuf;
 use std::str;
 use std::str::FromStr;
 use std::sync::Arc;
 
 use clap::{AppSettings, ArgMatches, ErrorKind};
-use log::{debug, LevelFilter};
+use log::{debug, error, LevelFilter};
 use simplelog::{Config, TerminalMode, TermLogger};
 
 use pact_matching::s;
@@ -14,8 +15,10 @@ use pact_models::http_utils::HttpAuth;
 use pact_models::PactSpecification;
 use pact_verifier::*;
 use pact_verifier::callback_executors::HttpRequestProviderStateExecutor;
+use pact_verifier::shards::{publish_shard_results, read_shard_results, Shard};
 
 use super::args;
+use super::handle::ClientCache;
 
 fn pact_source(matches: &ArgMatches) -> Vec<PactSource> {
   let mut sources = vec![];
@@ -91,6 +94,34 @@ fn pact_source(matches: &ArgMatches) -> Vec<PactSource> {
   sources
 }
 
+fn broker_auth(matches: &ArgMatches) -> Option<HttpAuth> {
+  if matches.is_present("token") {
+    matches.value_of("token").map(|token| HttpAuth::Token(token.to_string()))
+  } else {
+    matches.value_of("user").map(|user| {
+      HttpAuth::User(user.to_string(), matches.value_of("password").map(|p| p.to_string()))
+    })
+  }
+}
+
+async fn publish_merged_shard_results(
+  files: Vec<PathBuf>,
+  auth: Option<HttpAuth>,
+  options: &VerificationOptions<NullRequestFilterExecutor>
+) -> Result<(), i32> {
+  let shards = files.iter()
+    .map(|file| read_shard_results(file))
+    .collect::<anyhow::Result<Vec<_>>>()
+    .map_err(|err| {
+      error!("{}", err);
+      1
+    })?;
+  publish_shard_results(shards, auth, options).await.map_err(|err| {
+    error!("{}", err);
+    1
+  })
+}
+
 fn consumer_tags_to_selectors(tags: Vec<&str>) -> Vec<pact_verifier::ConsumerVersionSelector> {
   tags.iter().map(|t| {
     pact_verifier::ConsumerVersionSelector {
@@ -140,7 +171,7 @@ pub async fn handle_cli(version: &str) -> Result<(), i32> {
                   .get_matches_safe();
 
   match matches {
-    Ok(results) => handle_matches(&results).await,
+    Ok(results) => handle_matches(&results, None).await,
     Err(ref err) => {
       match err.kind {
           ErrorKind::HelpDisplayed => {
@@ -166,6 +197,11 @@ pub async fn handle_cli(version: &str) -> Result<(), i32> {
 // Currently, clap prints things out as if it were a CLI call
 #[allow(dead_code, missing_docs)]
 pub async fn handle_args(args: Vec<String>) -> Result<(), i32> {
+  handle_args_with_clients(args, None).await
+}
+
+/// Handles the arguments, using HTTP clients from the cache if one is provided
+pub(crate) async fn handle_args_with_clients(args: Vec<String>, clients: Option<&ClientCache>) -> Result<(), i32> {
   let program = "pact_verifier_cli".to_string();
   let version = format!("v{}", clap::crate_version!()).as_str().to_owned();
   let app = args::setup_app(program, &version);
@@ -175,7 +211,7 @@ pub async fn handle_args(args: Vec<String>) -> Result<(), i32> {
                   .get_matches_from_safe(args);
 
   match matches {
-    Ok(results) => handle_matches(&results).await,
+    Ok(results) => handle_matches(&results, clients).await,
     Err(ref err) => {
       log::error!("error verifying Pact: {:?} {:?}", err.message, err);
       Err(4)
@@ -183,7 +219,7 @@ pub async fn handle_args(args: Vec<String>) -> Result<(), i32> {
   }
 }
 
-async fn handle_matches(matches: &clap::ArgMatches<'_>) -> Result<(), i32> {
+async fn handle_matches(matches: &clap::ArgMatches<'_>, clients: Option<&ClientCache>) -> Result<(), i32> {
     let level = matches.value_of("loglevel").unwrap_or("warn");
     let log_level = match level {
         "none" => LevelFilter::Off,
@@ -202,20 +238,35 @@ async fn handle_matches(matches: &clap::ArgMatches<'_>) -> Result<(), i32> {
     let provider_state_executor = Arc::new(HttpRequestProviderStateExecutor {
       state_change_url: matches.value_of("state-change-url").map(|s| s.to_string()),
       state_change_body: !matches.is_present("state-change-as-query"),
-      state_change_teardown: matches.is_present("state-change-teardown")
+      state_change_teardown: matches.is_present("state-change-teardown"),
+      state_change_batch: matches.is_present("state-change-batch")
     });
 
+    let disable_ssl_verification = matches.is_present("disable-ssl-verification");
+    let request_timeout = matches.value_of("request-timeout").map(|t| t.parse::<u64>().unwrap_or(5000)).unwrap_or(5000);
     let options = VerificationOptions {
       publish: matches.is_present("publish"),
       provider_version: matches.value_of("provider-version").map(|v| v.to_string()),
       build_url: matches.value_of("build-url").map(|v| v.to_string()),
       request_filter: None::<Arc<NullRequestFilterExecutor>>,
       provider_tags: matches.values_of("provider-tags").map_or_else(Vec::new, |tags| tags.map(|tag| tag.to_string()).collect()),
-      disable_ssl_verification: matches.is_present("disable-ssl-verification"),
-      request_timeout: matches.value_of("request-timeout").map(|t| t.parse::<u64>().unwrap_or(5000)).unwrap_or(5000),
+      disable_ssl_verification,
+      request_timeout,
+      client: clients.map(|clients| clients.client(disable_ssl_verification, request_timeout)),
+      broker_client: clients.map(|clients| clients.broker_client()),
+      interaction_concurrency: matches.value_of("interaction-concurrency").map(|c| c.parse::<usize>().unwrap_or(1)).unwrap_or(1),
+      pact_cache_dir: matches.value_of("pact-cache-dir").map(PathBuf::from),
+      group_provider_states: matches.is_present("group-provider-states"),
+      pact_concurrency: matches.value_of("pact-concurrency").map(|c| c.parse::<usize>().unwrap_or(1)).unwrap_or(1),
+      shard: matches.value_of("shard").and_then(|shard| shard.parse::<Shard>().ok()),
+      shard_results: matches.value_of("shard-results").map(PathBuf::from),
       .. VerificationOptions::default()
     };
 
+    if let Some(files) = matches.values_of("merge-shard-results") {
+      return publish_merged_shard_results(files.map(PathBuf::from).collect(), broker_auth(matches), &options).await;
+    }
+
     for s in &source {
       debug!("Pact source to verify = {}", s);
     };
@@ -11,30 +11,51 @@ use reqwest::header::CONTENT_TYPE;
 use pact_models::bodies::OptionalBody;
 
 use pact_ffi::mock_server::{
+  pactffi_append_pact_file,
   pactffi_cleanup_mock_server,
   pactffi_create_mock_server,
   pactffi_create_mock_server_for_pact,
+  pactffi_create_mock_server_for_pact_with_options,
+  pactffi_create_mock_server_from_file,
+  pactffi_create_mock_server_from_snapshot,
+  pactffi_finalise_pact_files,
+  pactffi_free_pact_handle,
   pactffi_message_expects_to_receive,
   pactffi_message_given,
+  pactffi_message_pact_reify_all,
   pactffi_message_reify,
   pactffi_message_with_contents,
   pactffi_message_with_metadata,
+  pactffi_mock_server_matched,
+  pactffi_mock_server_metrics,
   pactffi_mock_server_mismatches,
+  pactffi_mock_server_reset,
   pactffi_new_interaction,
   pactffi_new_message,
   pactffi_new_message_pact,
   pactffi_new_pact,
   pactffi_response_status,
   pactffi_upon_receiving,
+  pactffi_with_binary_file_path,
   pactffi_with_body,
   pactffi_with_header,
+  pactffi_with_interactions,
   pactffi_with_multipart_file,
   pactffi_with_query_parameter,
   pactffi_with_request,
   pactffi_write_message_pact_file,
-  pactffi_write_pact_file
+  pactffi_write_mock_server_snapshot,
+  pactffi_write_pact_file,
+  MockServerOptions,
+  MockServerProtocols
 };
 use pact_ffi::mock_server::handles::InteractionPart;
+use pact_ffi::models::message::{
+  pactffi_message_delete,
+  pactffi_message_find_metadata_borrowed,
+  pactffi_message_get_contents_borrowed,
+  pactffi_message_new_from_body
+};
 
 #[test]
 fn post_to_mock_server_with_misatches() {
@@ -61,6 +82,180 @@ fn post_to_mock_server_with_misatches() {
   expect!(mismatches).to(be_equal_to("[{\"method\":\"POST\",\"mismatches\":[{\"actual\":\"\\\"no-very-bar\\\"\",\"expected\":\"\\\"bar\\\"\",\"mismatch\":\"Expected \'bar\' to be equal to \'no-very-bar\'\",\"path\":\"$.foo\",\"type\":\"BodyMismatch\"}],\"path\":\"/path\",\"type\":\"request-mismatch\"}]"));
 }
 
+#[test]
+fn create_mock_server_from_file() {
+  let address = CString::new("127.0.0.1:0").unwrap();
+  let missing_file = CString::new("tests/does-not-exist.json").unwrap();
+  expect!(pactffi_create_mock_server_from_file(missing_file.as_ptr(), address.as_ptr(), false)).to(be_equal_to(-7));
+
+  let file = CString::new("tests/post-pact.json").unwrap();
+  let port = pactffi_create_mock_server_from_file(file.as_ptr(), address.as_ptr(), false);
+  expect!(port).to(be_greater_than(0));
+
+  let _result = catch_unwind(|| {
+    let client = Client::default();
+    client.post(format!("http://127.0.0.1:{}/path", port).as_str())
+      .header(CONTENT_TYPE, "application/json")
+      .body(r#"{"foo":"bar"}"#)
+      .send()
+  });
+
+  let mismatches = unsafe {
+    CStr::from_ptr(pactffi_mock_server_mismatches(port)).to_string_lossy().into_owned()
+  };
+
+  pactffi_cleanup_mock_server(port);
+
+  expect!(mismatches).to(be_equal_to("[]"));
+}
+
+#[test]
+fn create_mock_server_from_snapshot() {
+  let pact_json = include_str!("post-pact.json");
+  let pact_json_c = CString::new(pact_json).expect("Could not construct C string from json");
+  let address = CString::new("127.0.0.1:0").unwrap();
+  let dir = std::env::temp_dir().join("pact_ffi_create_mock_server_from_snapshot");
+  let _ = std::fs::remove_dir_all(&dir);
+  std::fs::create_dir_all(&dir).unwrap();
+  let snapshot_path = dir.join("post-pact.snapshot");
+  let snapshot_path_c = CString::new(snapshot_path.to_string_lossy().as_ref()).unwrap();
+
+  let port = pactffi_create_mock_server(pact_json_c.as_ptr(), address.as_ptr(), false);
+  expect!(port).to(be_greater_than(0));
+  expect!(pactffi_write_mock_server_snapshot(port, snapshot_path_c.as_ptr())).to(be_equal_to(0));
+  pactffi_cleanup_mock_server(port);
+
+  let port = pactffi_create_mock_server_from_snapshot(snapshot_path_c.as_ptr(), address.as_ptr(), false);
+  expect!(port).to(be_greater_than(0));
+  let _result = catch_unwind(|| {
+    let client = Client::default();
+    client.post(format!("http://127.0.0.1:{}/path", port).as_str())
+      .header(CONTENT_TYPE, "application/json")
+      .body(r#"{"foo":"bar"}"#)
+      .send()
+  });
+  let matched = pactffi_mock_server_matched(port);
+  pactffi_cleanup_mock_server(port);
+  expect!(matched).to(be_true());
+
+  let pact_file_c = CString::new(concat!(env!("CARGO_MANIFEST_DIR"), "/tests/post-pact.json")).unwrap();
+  expect!(pactffi_create_mock_server_from_snapshot(pact_file_c.as_ptr(), address.as_ptr(), false)).to(be_equal_to(-8));
+  let missing_c = CString::new(dir.join("missing.snapshot").to_string_lossy().as_ref()).unwrap();
+  expect!(pactffi_create_mock_server_from_snapshot(missing_c.as_ptr(), address.as_ptr(), false)).to(be_equal_to(-7));
+
+  let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn mock_server_metrics() {
+  let pact_json = include_str!("post-pact.json");
+  let pact_json_c = CString::new(pact_json).expect("Could not construct C string from json");
+  let address = CString::new("127.0.0.1:0").unwrap();
+  let port = pactffi_create_mock_server(pact_json_c.as_ptr(), address.as_ptr(), false);
+  expect!(port).to(be_greater_than(0));
+
+  let _result = catch_unwind(|| {
+    let client = Client::default();
+    client.post(format!("http://127.0.0.1:{}/path", port).as_str())
+      .header(CONTENT_TYPE, "application/json")
+      .body(r#"{"foo":"bar"}"#)
+      .send()
+  });
+
+  // The string is owned by the caller, this is what pactffi_string_delete does to free it
+  let metrics = unsafe {
+    CString::from_raw(pactffi_mock_server_metrics(port)).to_string_lossy().into_owned()
+  };
+
+  pactffi_cleanup_mock_server(port);
+
+  let metrics: serde_json::Value = serde_json::from_str(metrics.as_str()).unwrap();
+  expect!(metrics["requests"].as_u64()).to(be_some().value(1));
+  expect!(metrics["requestBytes"].as_u64()).to(be_some().value(13));
+  expect!(metrics["latency"]["count"].as_u64()).to(be_some().value(1));
+  expect!(metrics["interactions"][0]["description"].as_str()).to(be_some().value("a post request"));
+  expect!(metrics["interactions"][0]["requests"].as_u64()).to(be_some().value(1));
+  expect!(pactffi_mock_server_metrics(port).is_null()).to(be_true());
+}
+
+#[test]
+fn append_pact_file_and_finalise() {
+  let pact_json = include_str!("post-pact.json");
+  let pact_json_c = CString::new(pact_json).expect("Could not construct C string from json");
+  let address = CString::new("127.0.0.1:0").unwrap();
+  let dir = std::env::temp_dir().join("pact_ffi_append_pact_file_and_finalise");
+  let _ = std::fs::remove_dir_all(&dir);
+  let dir_c = CString::new(dir.to_string_lossy().as_ref()).unwrap();
+
+  for _ in 0..2 {
+    let port = pactffi_create_mock_server(pact_json_c.as_ptr(), address.as_ptr(), false);
+    expect!(port).to(be_greater_than(0));
+    expect!(pactffi_append_pact_file(port, dir_c.as_ptr())).to(be_equal_to(0));
+    pactffi_cleanup_mock_server(port);
+  }
+
+  expect!(dir.join("RustTest-RustFFI.json").exists()).to(be_false());
+  expect!(pactffi_finalise_pact_files(dir_c.as_ptr(), true)).to(be_equal_to(1));
+  let pact_file = std::fs::read_to_string(dir.join("RustTest-RustFFI.json")).unwrap();
+  let pact: serde_json::Value = serde_json::from_str(pact_file.as_str()).unwrap();
+  expect!(pact["interactions"].as_array().map(|i| i.len())).to(be_some().value(1));
+  expect!(pactffi_finalise_pact_files(dir_c.as_ptr(), true)).to(be_equal_to(0));
+
+  let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn reset_mock_server_with_a_new_pact() {
+  let pact_json = include_str!("post-pact.json");
+  let pact_json_c = CString::new(pact_json).expect("Could not construct C string from json");
+  let address = CString::new("127.0.0.1:0").unwrap();
+  let port = pactffi_create_mock_server(pact_json_c.as_ptr(), address.as_ptr(), false);
+  expect!(port).to(be_greater_than(0));
+
+  let _result = catch_unwind(|| {
+    let client = Client::default();
+    client.post(format!("http://127.0.0.1:{}/path", port).as_str())
+      .header(CONTENT_TYPE, "application/json")
+      .body(r#"{"foo":"no-very-bar"}"#)
+      .send()
+  });
+
+  let get_pact_json = CString::new(r#"{
+    "consumer": { "name": "RustTest" },
+    "provider": { "name": "RustProvider" },
+    "interactions": [
+      {
+        "description": "a get request",
+        "request": { "method": "GET", "path": "/other" },
+        "response": { "status": 200 }
+      }
+    ]
+  }"#).unwrap();
+  let invalid_json = CString::new("{").unwrap();
+  let message_pact_json = CString::new(r#"{
+    "consumer": { "name": "RustTest" },
+    "provider": { "name": "RustProvider" },
+    "messages": [ { "description": "a message", "contents": {} } ]
+  }"#).unwrap();
+  expect!(pactffi_mock_server_reset(port, invalid_json.as_ptr())).to(be_equal_to(2));
+  expect!(pactffi_mock_server_reset(port, message_pact_json.as_ptr())).to(be_equal_to(4));
+  expect!(pactffi_mock_server_reset(port, get_pact_json.as_ptr())).to(be_equal_to(0));
+
+  let _result = catch_unwind(|| {
+    let client = Client::default();
+    client.get(format!("http://127.0.0.1:{}/other", port).as_str()).send()
+  });
+
+  let mismatches = unsafe {
+    CStr::from_ptr(pactffi_mock_server_mismatches(port)).to_string_lossy().into_owned()
+  };
+
+  pactffi_cleanup_mock_server(port);
+
+  expect!(mismatches).to(be_equal_to("[]"));
+  expect!(pactffi_mock_server_reset(port, get_pact_json.as_ptr())).to(be_equal_to(3));
+}
+
 #[test]
 fn create_header_with_multiple_values() {
   let consumer_name = CString::new("consumer").unwrap();
@@ -101,6 +296,42 @@ fn create_query_parameter_with_multiple_values() {
   });
 }
 
+#[test]
+fn free_pact_handle() {
+  let consumer_name = CString::new("consumer").unwrap();
+  let provider_name = CString::new("provider").unwrap();
+  let pact_handle = pactffi_new_pact(consumer_name.as_ptr(), provider_name.as_ptr());
+  let description = CString::new("free_pact_handle").unwrap();
+  let interaction = pactffi_new_interaction(pact_handle, description.as_ptr());
+
+  expect!(pactffi_free_pact_handle(pact_handle)).to(be_true());
+  expect!(pactffi_free_pact_handle(pact_handle)).to(be_false());
+  expect!(interaction.with_interaction(&|_, _, _| ())).to(be_none());
+
+  let next_handle = pactffi_new_pact(consumer_name.as_ptr(), provider_name.as_ptr());
+  expect!(next_handle.pact).to_not(be_equal_to(pact_handle.pact));
+}
+
+#[test]
+fn create_body_from_binary_file_path() {
+  let consumer_name = CString::new("consumer").unwrap();
+  let provider_name = CString::new("provider").unwrap();
+  let pact_handle = pactffi_new_pact(consumer_name.as_ptr(), provider_name.as_ptr());
+  let description = CString::new("create_body_from_binary_file_path").unwrap();
+  let interaction = pactffi_new_interaction(pact_handle, description.as_ptr());
+  let content_type = CString::new("application/json").unwrap();
+  let file = CString::new("tests/multipart-test-file.json").unwrap();
+  let missing_file = CString::new("tests/does-not-exist.bin").unwrap();
+
+  expect!(pactffi_with_binary_file_path(interaction.clone(), InteractionPart::Response, content_type.as_ptr(), file.as_ptr())).to(be_true());
+  expect!(pactffi_with_binary_file_path(interaction.clone(), InteractionPart::Request, content_type.as_ptr(), missing_file.as_ptr())).to(be_false());
+
+  interaction.with_interaction(&|_, _, i| {
+    expect!(i.response.body.clone()).to(be_equal_to(OptionalBody::Present(Bytes::from("true"), None)));
+    expect!(i.request.body.clone()).to(be_equal_to(OptionalBody::Missing));
+  });
+}
+
 #[test]
 fn create_multipart_file() {
   let consumer_name = CString::new("consumer").unwrap();
@@ -217,6 +448,135 @@ fn http_consumer_feature_test() {
   expect!(mismatches).to(be_equal_to("[]"));
 }
 
+#[test]
+fn create_mock_server_for_pact_with_multiple_workers() {
+  let consumer_name = CString::new("workers-consumer").unwrap();
+  let provider_name = CString::new("workers-provider").unwrap();
+  let pact_handle = pactffi_new_pact(consumer_name.as_ptr(), provider_name.as_ptr());
+  let description = CString::new("a request for the workers").unwrap();
+  let interaction = pactffi_new_interaction(pact_handle.clone(), description.as_ptr());
+  let method = CString::new("GET").unwrap();
+  let path = CString::new("/workers").unwrap();
+  let address = CString::new("127.0.0.1:0").unwrap();
+
+  pactffi_upon_receiving(interaction.clone(), description.as_ptr());
+  pactffi_with_request(interaction.clone(), method.as_ptr(), path.as_ptr());
+  pactffi_response_status(interaction.clone(), 200);
+  let options = MockServerOptions { workers: 2, .. MockServerOptions::default() };
+  let port = pactffi_create_mock_server_for_pact_with_options(pact_handle.clone(), address.as_ptr(), &options);
+
+  expect!(port).to(be_greater_than(0));
+
+  let client = Client::default();
+  let statuses = (0..4)
+    .map(|_| client.get(format!("http://127.0.0.1:{}/workers", port).as_str()).send().map(|res| res.status().as_u16()))
+    .collect::<Vec<_>>();
+
+  let matched = pactffi_mock_server_matched(port);
+  pactffi_cleanup_mock_server(port);
+  pactffi_free_pact_handle(pact_handle);
+
+  expect!(matched).to(be_true());
+  expect!(statuses.iter().all(|status| status.as_ref().ok() == Some(&200))).to(be_true());
+}
+
+#[test]
+fn create_mock_server_for_pact_with_options_checks_the_options_size() {
+  let consumer_name = CString::new("options-consumer").unwrap();
+  let provider_name = CString::new("options-provider").unwrap();
+  let pact_handle = pactffi_new_pact(consumer_name.as_ptr(), provider_name.as_ptr());
+  let address = CString::new("127.0.0.1:0").unwrap();
+
+  let options = MockServerOptions { size: 0, .. MockServerOptions::default() };
+  let port = pactffi_create_mock_server_for_pact_with_options(pact_handle.clone(), address.as_ptr(), &options);
+  expect!(port).to(be_equal_to(-7));
+
+  // An older caller that only knows about the size and TLS flags gets the defaults for the rest
+  let options = MockServerOptions { size: 8, workers: 1000, .. MockServerOptions::default() };
+  let port = pactffi_create_mock_server_for_pact_with_options(pact_handle.clone(), address.as_ptr(), &options);
+  expect!(port).to(be_greater_than(0));
+
+  pactffi_cleanup_mock_server(port);
+  pactffi_free_pact_handle(pact_handle);
+}
+
+#[test]
+fn create_mock_server_for_pact_with_options_checks_the_option_values() {
+  let consumer_name = CString::new("options-values-consumer").unwrap();
+  let provider_name = CString::new("options-values-provider").unwrap();
+  let pact_handle = pactffi_new_pact(consumer_name.as_ptr(), provider_name.as_ptr());
+  let address = CString::new("127.0.0.1:0").unwrap();
+  let defaults = MockServerOptions::default();
+  let base = &defaults as *const MockServerOptions as usize;
+
+  // Set the bytes of the options directly, as a C caller could, with an invalid value at the offset
+  for offset in [&defaults.tls as *const bool as usize - base, &defaults.protocols as *const MockServerProtocols as usize - base].iter() {
+    let mut bytes = [0u32; std::mem::size_of::<MockServerOptions>() / 4];
+    unsafe {
+      std::ptr::copy_nonoverlapping(&defaults as *const MockServerOptions as *const u8, bytes.as_mut_ptr() as *mut u8,
+        std::mem::size_of::<MockServerOptions>());
+      *(bytes.as_mut_ptr() as *mut u8).add(*offset) = 7;
+    }
+    let port = pactffi_create_mock_server_for_pact_with_options(pact_handle.clone(), address.as_ptr(),
+      bytes.as_ptr() as *const MockServerOptions);
+    expect!(port).to(be_equal_to(-8));
+  }
+
+  pactffi_free_pact_handle(pact_handle);
+}
+
+#[test]
+fn create_mock_server_with_interactions_from_json() {
+  let consumer_name = CString::new("bulk-consumer").unwrap();
+  let provider_name = CString::new("bulk-provider").unwrap();
+  let pact_handle = pactffi_new_pact(consumer_name.as_ptr(), provider_name.as_ptr());
+  let interactions = CString::new(r#"[
+    {
+      "description": "a request for an animal",
+      "providerStates": ["an animal exists"],
+      "request": {
+        "method": "GET",
+        "path": { "value": "/animals/1", "pact:matcher:type": "regex", "regex": "\\/animals\\/\\d+" },
+        "headers": { "Accept": "application/json" }
+      },
+      "response": {
+        "status": 200,
+        "body": { "name": { "value": "Rex", "pact:matcher:type": "type" } }
+      }
+    },
+    {
+      "description": "a request to create an animal",
+      "request": { "method": "POST", "path": "/animals", "body": { "name": "Fido" } },
+      "response": { "status": 201 }
+    }
+  ]"#).unwrap();
+  let invalid = CString::new(r#"[{ "description": "a request" }, { "request": {} }]"#).unwrap();
+  let address = CString::new("127.0.0.1:0").unwrap();
+
+  expect!(pactffi_with_interactions(pact_handle.clone(), invalid.as_ptr())).to(be_equal_to(-3));
+  expect!(pactffi_with_interactions(pact_handle.clone(), interactions.as_ptr())).to(be_equal_to(2));
+  let port = pactffi_create_mock_server_for_pact(pact_handle.clone(), address.as_ptr(), false);
+  expect!(port).to(be_greater_than(0));
+  expect!(pactffi_with_interactions(pact_handle.clone(), interactions.as_ptr())).to(be_equal_to(-2));
+
+  let client = Client::default();
+  let get = client.get(format!("http://127.0.0.1:{}/animals/22", port).as_str())
+    .header("Accept", "application/json")
+    .send();
+  let post = client.post(format!("http://127.0.0.1:{}/animals", port).as_str())
+    .header(CONTENT_TYPE, "application/json")
+    .body(r#"{"name": "Fido"}"#)
+    .send();
+
+  let matched = pactffi_mock_server_matched(port);
+  pactffi_cleanup_mock_server(port);
+  pactffi_free_pact_handle(pact_handle);
+
+  expect!(get.map(|res| res.status().as_u16())).to(be_ok().value(200));
+  expect!(post.map(|res| res.status().as_u16())).to(be_ok().value(201));
+  expect!(matched).to(be_true());
+}
+
 #[test]
 fn message_consumer_feature_test() {
   let consumer_name = CString::new("message-consumer").unwrap();
@@ -243,3 +603,58 @@ fn message_consumer_feature_test() {
   let res = pactffi_write_message_pact_file(message_pact_handle.clone(), file_path.as_ptr(), true);
   expect!(res).to(be_eq(0));
 }
+
+#[test]
+fn message_pact_reify_all() {
+  let consumer_name = CString::new("reify-consumer").unwrap();
+  let provider_name = CString::new("reify-provider").unwrap();
+  let content_type = CString::new("application/json").unwrap();
+  let first = CString::new("first message").unwrap();
+  let second = CString::new("second message").unwrap();
+
+  let message_pact_handle = pactffi_new_message_pact(consumer_name.as_ptr(), provider_name.as_ptr());
+  let mut reified_messages = vec![];
+  for (description, body) in &[(&first, "{\"id\": 1}"), (&second, "{\"id\": 2}")] {
+    let message_handle = pactffi_new_message(message_pact_handle.clone(), description.as_ptr());
+    pactffi_message_with_contents(message_handle.clone(), content_type.as_ptr(), body.as_ptr(), body.len());
+    let reified = pactffi_message_reify(message_handle.clone());
+    reified_messages.push(unsafe { CString::from_raw(reified as *mut c_char) });
+  }
+
+  let length = pactffi_message_pact_reify_all(message_pact_handle.clone(), std::ptr::null_mut(), 0);
+  let expected_length = reified_messages.iter().map(|m| m.as_bytes_with_nul().len()).sum::<usize>();
+  expect!(length as usize).to(be_equal_to(expected_length));
+
+  let mut short_buffer = vec![1u8; 4];
+  expect!(pactffi_message_pact_reify_all(message_pact_handle.clone(), short_buffer.as_mut_ptr() as *mut c_char, 4))
+    .to(be_equal_to(length));
+  expect!(short_buffer).to(be_equal_to(vec![1u8; 4]));
+
+  let mut buffer = vec![0u8; length as usize];
+  expect!(pactffi_message_pact_reify_all(message_pact_handle.clone(), buffer.as_mut_ptr() as *mut c_char, buffer.len()))
+    .to(be_equal_to(length));
+  let messages = buffer.split(|b| *b == 0).filter(|m| !m.is_empty()).collect::<Vec<_>>();
+  expect!(messages.len()).to(be_equal_to(2));
+  expect!(messages[0]).to(be_equal_to(reified_messages[0].as_bytes()));
+  expect!(messages[1]).to(be_equal_to(reified_messages[1].as_bytes()));
+}
+
+#[test]
+fn message_borrowed_accessors() {
+  let body = CString::new("{\"id\": 1}").unwrap();
+  let content_type = CString::new("application/json").unwrap();
+  let key = CString::new("contentType").unwrap();
+  let message = pactffi_message_new_from_body(body.as_ptr(), content_type.as_ptr());
+
+  let mut length = 0;
+  let contents = pactffi_message_get_contents_borrowed(message, &mut length);
+  expect!(unsafe { std::slice::from_raw_parts(contents, length) }).to(be_equal_to(body.as_bytes()));
+
+  let value = pactffi_message_find_metadata_borrowed(message, key.as_ptr(), &mut length);
+  expect!(unsafe { std::slice::from_raw_parts(value, length) }).to(be_equal_to(&b"application/json"[..]));
+
+  let missing = CString::new("missing").unwrap();
+  expect!(pactffi_message_find_metadata_borrowed(message, missing.as_ptr(), &mut length).is_null()).to(be_true());
+
+  pactffi_message_delete(message);
+}
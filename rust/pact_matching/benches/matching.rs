@@ -0,0 +1,138 @@
+//! Benchmarks for the request and body matching hot paths, using synthetic pacts of growing size.
+//!
+//! Run with `cargo bench -p pact_matching`. Criterion compares each run with the previous one and
+//! reports the cases that have regressed. To check a change against a fixed baseline, save one
+//! with `cargo bench -p pact_matching -- --save-baseline master` and compare with it using
+//! `cargo bench -p pact_matching -- --baseline master`.
+
+use std::hint::black_box;
+
+use criterion::{BenchmarkId, Criterion, criterion_group, criterion_main};
+use maplit::hashmap;
+use serde_json::{json, Value};
+
+use pact_matching::{DiffConfig, match_body, match_request_ref, MatchingContext};
+use pact_matching::json::match_json;
+use pact_models::bodies::OptionalBody;
+use pact_models::matchingrules::{MatchingRule, MatchingRuleCategory, MatchingRules, RuleLogic};
+use pact_models::request::Request;
+
+const SIZES: [usize; 3] = [10, 100, 1000];
+
+fn json_document(size: usize) -> Value {
+  let items = (0..size).map(|i| json!({
+    "id": i,
+    "name": format!("item {}", i),
+    "tags": ["a", "b", "c"],
+    "active": i % 2 == 0
+  })).collect::<Vec<Value>>();
+  json!({ "count": size, "items": items })
+}
+
+fn xml_document(size: usize) -> String {
+  let items = (0..size)
+    .map(|i| format!(r#"<item id="{}"><name>item {}</name><active>{}</active></item>"#, i, i, i % 2 == 0))
+    .collect::<String>();
+  format!(r#"<?xml version="1.0" encoding="UTF-8"?><items count="{}">{}</items>"#, size, items)
+}
+
+fn json_request(path: &str, body: &Value) -> Request {
+  Request {
+    method: "POST".to_string(),
+    path: path.to_string(),
+    headers: Some(hashmap!{ "Content-Type".to_string() => vec!["application/json".to_string()] }),
+    body: OptionalBody::Present(body.to_string().into(), None),
+    .. Request::default()
+  }
+}
+
+fn body_rules(size: usize) -> MatchingRules {
+  let mut rules = MatchingRules::default();
+  let category = rules.add_category("body");
+  category.add_rule("$.items", MatchingRule::MinType(1), &RuleLogic::And);
+  for i in 0..size {
+    category.add_rule(&format!("$.items[{}].name", i), MatchingRule::Regex("^item \\d+$".to_string()), &RuleLogic::And);
+  }
+  rules
+}
+
+fn bench_match_request(c: &mut Criterion) {
+  let mut group = c.benchmark_group("match_request");
+  for size in SIZES.iter().cloned() {
+    // Interactions with the same method and path, so that they are all candidates
+    let body = json_document(10);
+    let expected = (0..size).map(|i| {
+      let mut body = body.clone();
+      body["count"] = json!(i);
+      json_request("/items", &body)
+    }).collect::<Vec<Request>>();
+    let mut actual_body = body.clone();
+    actual_body["count"] = json!(size - 1);
+    let actual = json_request("/items", &actual_body);
+    group.bench_with_input(BenchmarkId::from_parameter(size), &actual, |b, actual| b.iter(|| {
+      for request in &expected {
+        black_box(match_request_ref(request, actual));
+      }
+    }));
+  }
+  group.finish();
+}
+
+fn bench_match_json(c: &mut Criterion) {
+  let mut group = c.benchmark_group("match_json");
+  for size in SIZES.iter().cloned() {
+    let body = json_document(size);
+    let expected = json_request("/items", &body);
+    let actual = json_request("/items", &body);
+    let context = MatchingContext::with_config(DiffConfig::NoUnexpectedKeys);
+    group.bench_function(BenchmarkId::new("without matching rules", size), |b| b.iter(|| {
+      black_box(match_json(&expected, &actual, &context)).ok();
+    }));
+
+    let context = MatchingContext::new(DiffConfig::NoUnexpectedKeys,
+      &body_rules(size).rules_for_category("body").unwrap_or_default());
+    group.bench_function(BenchmarkId::new("with matching rules", size), |b| b.iter(|| {
+      black_box(match_json(&expected, &actual, &context)).ok();
+    }));
+  }
+  group.finish();
+}
+
+fn bench_match_xml(c: &mut Criterion) {
+  let mut group = c.benchmark_group("match_xml");
+  for size in SIZES.iter().cloned() {
+    let body = xml_document(size);
+    let request = Request {
+      method: "POST".to_string(),
+      path: "/items".to_string(),
+      headers: Some(hashmap!{ "Content-Type".to_string() => vec!["application/xml".to_string()] }),
+      body: OptionalBody::Present(body.into(), None),
+      .. Request::default()
+    };
+    let context = MatchingContext::with_config(DiffConfig::NoUnexpectedKeys);
+    let header_context = MatchingContext::with_config(DiffConfig::NoUnexpectedKeys);
+    group.bench_function(BenchmarkId::from_parameter(size), |b| b.iter(|| {
+      black_box(match_body(&request, &request, &context, &header_context));
+    }));
+  }
+  group.finish();
+}
+
+fn bench_matcher_lookup(c: &mut Criterion) {
+  let mut group = c.benchmark_group("matcher rule lookup");
+  for size in SIZES.iter().cloned() {
+    let category: MatchingRuleCategory = body_rules(size).rules_for_category("body").unwrap_or_default();
+    let paths = (0..size).map(|i| i.to_string()).collect::<Vec<String>>();
+    group.bench_function(BenchmarkId::from_parameter(size), |b| b.iter(|| {
+      for index in &paths {
+        let path = vec!["$", "items", index.as_str(), "name"];
+        black_box(category.matcher_is_defined(&path));
+        black_box(category.select_best_matcher(&path));
+      }
+    }));
+  }
+  group.finish();
+}
+
+criterion_group!(benches, bench_match_request, bench_match_json, bench_match_xml, bench_matcher_lookup);
+criterion_main!(benches);
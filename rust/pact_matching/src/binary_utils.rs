@@ -1,5 +1,6 @@
 use std::collections::HashMap;
 use std::convert::TryInto;
+use std::io::Read;
 use std::str::from_utf8;
 
 use anyhow::anyhow;
@@ -7,7 +8,8 @@ use bytes::{Buf, Bytes};
 use http::header::{HeaderMap, HeaderName};
 use itertools::Itertools;
 use log::*;
-use onig::Regex;
+use memchr::memmem;
+use multipart::server::Multipart;
 use serde_json::Value;
 
 use pact_models::http_parts::HttpPart;
@@ -15,12 +17,34 @@ use pact_models::matchingrules::{MatchingRule, RuleLogic};
 
 use crate::{MatchingContext, Mismatch};
 use crate::matchers::{match_values, Matches};
+use crate::regex_cache::cached_regex;
 
 static ROOT: &str = "$";
 
+/// Maximum number of bytes used to detect the content type of binary data. The magic rules only
+/// look at the start of the data, so large bodies do not need to be passed in full.
+pub const CONTENT_TYPE_SNIFF_LIMIT: usize = 64 * 1024;
+
+/// Size of the chunks multipart file data is read in
+const MULTIPART_CHUNK_SIZE: usize = 64 * 1024;
+
+/// Returns the start of the data to use to detect the content type, without splitting a UTF-8
+/// character so that text is still detected as text
+fn sniff_prefix(data: &[u8]) -> &[u8] {
+  if data.len() <= CONTENT_TYPE_SNIFF_LIMIT {
+    data
+  } else {
+    let mut end = CONTENT_TYPE_SNIFF_LIMIT;
+    while end > CONTENT_TYPE_SNIFF_LIMIT - 3 && (data[end] & 0xC0) == 0x80 {
+      end -= 1;
+    }
+    &data[..end]
+  }
+}
+
 pub fn match_content_type<S>(data: &[u8], expected_content_type: S) -> anyhow::Result<()>
   where S: Into<String> {
-  let result = tree_magic_mini::from_u8(data);
+  let result = tree_magic_mini::from_u8(sniff_prefix(data));
   let expected = expected_content_type.into();
   let matches = result == expected;
   debug!("Matching binary contents by content type: expected '{}', detected '{}' -> {}",
@@ -118,7 +142,8 @@ struct MimeField {
   data: String
 }
 
-#[derive(Debug)]
+/// File part of a multipart body. The data is a slice of the body, so it is not copied when
+/// the body is parsed, and is compared and matched in place.
 struct MimeFile {
   name: String,
   content_type: Option<mime::Mime>,
@@ -126,12 +151,23 @@ struct MimeFile {
   data: Bytes
 }
 
+impl std::fmt::Debug for MimeFile {
+  fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+    f.debug_struct("MimeFile")
+      .field("name", &self.name)
+      .field("content_type", &self.content_type)
+      .field("filename", &self.filename)
+      .field("size", &self.data.len())
+      .finish()
+  }
+}
+
 pub fn match_mime_multipart(expected: &dyn HttpPart, actual: &dyn HttpPart, context: &MatchingContext) -> Result<(), Vec<super::Mismatch>> {
   let mut mismatches = vec![];
   debug!("matching MIME multipart contents");
 
-  let actual_parts = parse_multipart(actual.body().value().unwrap_or_default().reader(), actual.headers());
-  let expected_parts = parse_multipart(expected.body().value().unwrap_or_default().reader(), expected.headers());
+  let actual_parts = parse_multipart(actual.body().value().unwrap_or_default(), actual.headers());
+  let expected_parts = parse_multipart(expected.body().value().unwrap_or_default(), expected.headers());
 
   if expected_parts.is_err() || actual_parts.is_err() {
     match expected_parts {
@@ -252,9 +288,9 @@ impl Matches<&MimeFile> for &MimeFile {
     debug!("FilePart: comparing binary data to '{:?}' using {:?}", actual.content_type, matcher);
     match matcher {
       MatchingRule::Regex(ref regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
-            match from_utf8(&*actual.data) {
+            match from_utf8(&actual.data) {
               Ok(a) => if re.is_match(&a) {
                   Ok(())
                 } else {
@@ -277,7 +313,7 @@ impl Matches<&MimeFile> for &MimeFile {
         }
       },
       MatchingRule::Include(ref substr) => {
-        match from_utf8(&*actual.data) {
+        match from_utf8(&actual.data) {
           Ok(actual_contents) => if actual_contents.contains(substr) {
             Ok(())
           } else {
@@ -332,36 +368,52 @@ fn match_file(key: &String, expected: &MimeFile, actual: &MimeFile, context: &Ma
   matcher_result
 }
 
-fn parse_multipart<R: std::io::Read>(body: R, headers: &Option<HashMap<String, Vec<String>>>) -> Result<Vec<MimePart>, String> {
+fn parse_multipart(body: Bytes, headers: &Option<HashMap<String, Vec<String>>>) -> Result<Vec<MimePart>, String> {
   let boundary = get_multipart_boundary(headers)?;
-  let mut mp = multipart::server::Multipart::with_body(body, boundary);
+  let delimiter = format!("--{}", boundary);
+  // Positions of the boundary delimiters in the body. The data of a part ends just before the
+  // delimiter that follows it, so the file parts can be sliced out of the body.
+  let delimiters = memmem::find_iter(&body, delimiter.as_bytes()).collect::<Vec<usize>>();
+  let mut mp = Multipart::with_body(body.clone().reader(), boundary);
 
   let mut parts = vec![];
-
-  use std::io::Read;
+  let mut index = 0;
+  let mut chunk = vec![];
 
   loop {
     match mp.read_entry() {
       Ok(Some(mut entry)) => {
         let name = entry.headers.name.to_string();
-        let content_type = entry.headers.content_type;
-
-        let mut data = vec![];
-        entry.data.read_to_end(&mut data).map_err(|e| format!("Failed to read multipart data: {}", e))?;
-
-        if let Some(filename) = entry.headers.filename {
+        let content_type = entry.headers.content_type.clone();
+
+        if let Some(filename) = entry.headers.filename.clone() {
+          // The data is only read to find its size, and is then sliced out of the body
+          chunk.resize(MULTIPART_CHUNK_SIZE, 0);
+          let mut size = 0;
+          loop {
+            let read = entry.data.read(&mut chunk).map_err(|e| format!("Failed to read multipart data: {}", e))?;
+            if read == 0 {
+              break;
+            }
+            size += read;
+          }
+          let data = file_data(&body, delimiters.get(index + 1).cloned(), size)
+            .ok_or_else(|| format!("Failed to find the data of multipart file '{}' in the body", filename))?;
           parts.push(MimePart::File(MimeFile {
             name,
             content_type,
             filename,
-            data: Bytes::from(data),
+            data
           }));
         } else {
+          let mut data = vec![];
+          entry.data.read_to_end(&mut data).map_err(|e| format!("Failed to read multipart data: {}", e))?;
           parts.push(MimePart::Field(MimeField {
             name,
             data: String::from_utf8(data).map_err(|e| format!("Decode error: {}", e))?
           }))
         }
+        index += 1;
       },
       Ok(None) => return Ok(parts),
       Err(e) => return Err(format!("Failed to read multipart entry: {}", e)),
@@ -369,6 +421,21 @@ fn parse_multipart<R: std::io::Read>(body: R, headers: &Option<HashMap<String, V
   }
 }
 
+/// Returns the slice of the body with the data of a file part, given the position of the
+/// delimiter that follows the part and the size of the data. The line break before the
+/// delimiter belongs to the delimiter, not to the data.
+fn file_data(body: &Bytes, delimiter: Option<usize>, size: usize) -> Option<Bytes> {
+  let delimiter = delimiter?;
+  let end = if body[..delimiter].ends_with(b"\r\n") {
+    delimiter - 2
+  } else if body[..delimiter].ends_with(b"\n") {
+    delimiter - 1
+  } else {
+    delimiter
+  };
+  end.checked_sub(size).map(|start| body.slice(start..end))
+}
+
 fn get_multipart_boundary(headers: &Option<HashMap<String, Vec<String>>>) -> Result<String, String> {
   let header_map = get_http_header_map(headers);
   let content_type = header_map.get(http::header::CONTENT_TYPE)
@@ -770,4 +837,92 @@ mod tests {
       "MIME part \'file\': Expected binary contents to have content type \'application/jpeg\' but detected contents was \'text/plain\'"
     ]));
   }
+
+  fn multipart_file_request(boundary: &str, contents: &[u8]) -> Request {
+    let mut body = BytesMut::new();
+    body.extend_from_slice(format!("--{}\r\n\
+      Content-Type: application/octet-stream\r\n\
+      Content-Disposition: form-data; name=\"file\"; filename=\"data.bin\"\r\n\r\n", boundary).as_bytes());
+    body.extend_from_slice(contents);
+    body.extend_from_slice(format!("\r\n--{}--\r\n", boundary).as_bytes());
+    Request {
+      headers: Some(hashmap!{ "Content-Type".into() => vec![ format!("multipart/form-data; boundary={}", boundary) ] }),
+      body: OptionalBody::Present(body.freeze(), None),
+      ..Request::default()
+    }
+  }
+
+  #[test]
+  fn match_mime_multipart_compares_large_files() {
+    let contents = vec![7u8; 3 * super::MULTIPART_CHUNK_SIZE + 17];
+    let mut different = contents.clone();
+    *different.last_mut().unwrap() = 8;
+    let expected = multipart_file_request("1234", &contents);
+    let context = MatchingContext::with_config(DiffConfig::AllowUnexpectedKeys);
+
+    expect!(match_mime_multipart(&expected, &multipart_file_request("4567", &contents), &context)).to(be_ok());
+
+    let mismatches = match_mime_multipart(&expected, &multipart_file_request("4567", &different), &context).unwrap_err();
+    expect!(mismatches.iter().map(|m| mismatch(m)).collect::<Vec<&str>>()).to(be_equal_to(vec![
+      "MIME part 'file': Expected binary file (196625 bytes) starting with [7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7] to be equal to (196625 bytes) starting with [7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7]"
+    ]));
+  }
+
+  #[test]
+  fn match_mime_multipart_file_with_several_rules() {
+    let mut expected = multipart_file_request("1234", b"id,name\r\n1,one");
+    expected.matching_rules = matchingrules! {
+      "body" => {
+        "$.file" => [
+          MatchingRule::Regex(s!("^id,name")),
+          MatchingRule::Include(s!("1,one"))
+        ]
+      }
+    };
+    let actual = multipart_file_request("4567", b"id,name\r\n1,one\r\n2,two");
+    let context = MatchingContext::new(DiffConfig::AllowUnexpectedKeys,
+      &expected.matching_rules.rules_for_category("body").unwrap());
+
+    expect!(match_mime_multipart(&expected, &actual, &context)).to(be_ok());
+  }
+
+  #[test]
+  fn parse_multipart_slices_the_file_data_from_the_body() {
+    let mut body = BytesMut::new();
+    body.extend_from_slice(b"--1234\r\n\
+      Content-Disposition: form-data; name=\"field\"\r\n\r\n\
+      value\r\n\
+      --1234\r\n\
+      Content-Type: text/csv\r\n\
+      Content-Disposition: form-data; name=\"first\"; filename=\"first.csv\"\r\n\r\n\
+      id,name\r\n1,one\r\n\
+      --1234\r\n\
+      Content-Type: application/octet-stream\r\n\
+      Content-Disposition: form-data; name=\"second\"; filename=\"second.bin\"\r\n\r\n\
+      \x00\x01\r\x02\r\n\
+      --1234--\r\n");
+    let body = body.freeze();
+    let headers = Some(hashmap!{ "Content-Type".into() => vec![ "multipart/form-data; boundary=1234".into() ] });
+
+    let parts = super::parse_multipart(body.clone(), &headers).unwrap();
+    let files = parts.iter().filter_map(|part| match part {
+      super::MimePart::File(file) => Some(file),
+      _ => None
+    }).collect::<Vec<_>>();
+    expect!(files.len()).to(be_equal_to(2));
+    expect!(&files[0].data[..]).to(be_equal_to(&b"id,name\r\n1,one"[..]));
+    expect!(&files[1].data[..]).to(be_equal_to(&b"\x00\x01\r\x02"[..]));
+    let body_range = body.as_ptr() as usize..body.as_ptr() as usize + body.len();
+    expect!(body_range.contains(&(files[0].data.as_ptr() as usize))).to(be_true());
+  }
+
+  #[test]
+  fn sniff_prefix_does_not_split_utf8_characters() {
+    let mut data = vec![b'a'; super::CONTENT_TYPE_SNIFF_LIMIT - 1];
+    data.extend_from_slice("\u{e9}\u{e9}".as_bytes());
+    let prefix = super::sniff_prefix(&data);
+    expect!(prefix.len()).to(be_equal_to(super::CONTENT_TYPE_SNIFF_LIMIT - 1));
+    expect!(str::from_utf8(prefix).is_ok()).to(be_true());
+    expect!(super::sniff_prefix(b"small")).to(be_equal_to(&b"small"[..]));
+  }
 }
@@ -56,16 +56,20 @@ pub(crate) fn match_parameter_header(expected: &str, actual: &str, header: &str,
 }
 
 pub(crate) fn match_header_value(key: &str, expected: &str, actual: &str, context: &MatchingContext) -> Result<(), Vec<Mismatch>> {
-  let path = vec!["$", key];
   let expected: String = strip_whitespace(expected, ",");
   let actual: String = strip_whitespace(actual, ",");
+  match_stripped_header_value(key, &expected, &actual, context)
+}
 
+/// Matches header values that have already had the whitespace stripped
+fn match_stripped_header_value(key: &str, expected: &str, actual: &str, context: &MatchingContext) -> Result<(), Vec<Mismatch>> {
+  let path = vec!["$", key];
   let matcher_result = if context.matcher_is_defined(&path) {
-    matchers::match_values(&path, context, &expected, &actual)
-  } else if PARAMETERISED_HEADER_TYPES.contains(&key.to_lowercase().as_str()) {
-    match_parameter_header(expected.as_str(), actual.as_str(), key, "header")
+    matchers::match_values(&path, context, expected, actual)
+  } else if PARAMETERISED_HEADER_TYPES.iter().any(|header| key.eq_ignore_ascii_case(header)) {
+    match_parameter_header(expected, actual, key, "header")
   } else {
-    Matches::matches_with(&expected, &actual, &MatchingRule::Equality)
+    Matches::matches_with(&expected, actual, &MatchingRule::Equality)
       .map_err(|err| vec![err.to_string()])
   };
   matcher_result.map_err(|messages| {
@@ -80,26 +84,99 @@ pub(crate) fn match_header_value(key: &str, expected: &str, actual: &str, contex
   })
 }
 
-fn find_entry<T>(map: &HashMap<String, T>, key: &String) -> Option<(String, T)> where T: Clone {
-  match map.keys().find(|k| k.to_lowercase() == key.to_lowercase() ) {
-    Some(k) => map.get(k).map(|v| (key.clone(), v.clone()) ),
-    None => None
+/// A header with its name in lower case and its values in the form they are compared in
+#[derive(Debug, Clone, PartialEq)]
+struct NormalisedHeader {
+  /// Name of the header as it was given, which is used in mismatches
+  key: String,
+  /// Name of the header in lower case, which headers are looked up by
+  name: String,
+  /// Values as they were given
+  values: Vec<String>,
+  /// Values with the whitespace around any commas removed
+  stripped: Vec<String>
+}
+
+/// Headers in the form they are matched in, with lower case names and the values stripped of
+/// whitespace. Matching a request against many expected ones normalises the headers of the
+/// request only once, and the headers of the expected requests can be normalised up front.
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct NormalisedHeaders {
+  /// Headers sorted by lower case name
+  headers: Vec<NormalisedHeader>
+}
+
+impl NormalisedHeaders {
+  /// Normalises the headers
+  pub fn new(headers: &HashMap<String, Vec<String>>) -> Self {
+    Self::from_pairs(headers.iter().map(|(key, values)| (key.clone(), values.clone())))
+  }
+
+  /// Normalises the headers from pairs of names and values, taking ownership of them. This lets
+  /// headers read from somewhere else (i.e. a received request) be normalised without first
+  /// collecting them into a map.
+  pub fn from_pairs<I: IntoIterator<Item = (String, Vec<String>)>>(headers: I) -> Self {
+    let mut headers: Vec<NormalisedHeader> = headers.into_iter()
+      .map(|(key, values)| NormalisedHeader {
+        name: key.to_ascii_lowercase(),
+        stripped: values.iter().map(|value| strip_whitespace(value, ",")).collect(),
+        key,
+        values
+      })
+      .collect();
+    headers.sort_by(|a, b| a.name.cmp(&b.name));
+    NormalisedHeaders { headers }
+  }
+
+  /// Names and values of the headers as they were given, in order of the lower case names
+  pub fn iter(&self) -> impl Iterator<Item = (&str, &[String])> {
+    self.headers.iter().map(|header| (header.key.as_str(), header.values.as_slice()))
+  }
+
+  /// Returns the headers as they were given, as a map of names to values
+  pub fn to_map(&self) -> HashMap<String, Vec<String>> {
+    self.iter().map(|(key, values)| (key.to_string(), values.to_vec())).collect()
+  }
+
+  /// Looks up the stripped values of the header, ignoring the case of the name
+  pub fn get(&self, name: &str) -> Option<&[String]> {
+    self.find(name).map(|header| header.stripped.as_slice())
+  }
+
+  fn find(&self, name: &str) -> Option<&NormalisedHeader> {
+    self.headers.binary_search_by(|header| {
+      header.name.bytes().cmp(name.bytes().map(|b| b.to_ascii_lowercase()))
+    }).ok().map(|index| &self.headers[index])
+  }
+
+  /// Number of headers
+  pub fn len(&self) -> usize {
+    self.headers.len()
+  }
+
+  /// If there are no headers
+  pub fn is_empty(&self) -> bool {
+    self.headers.is_empty()
   }
 }
 
-fn match_header_maps(expected: HashMap<String, Vec<String>>, actual: HashMap<String, Vec<String>>, context: &MatchingContext) -> HashMap<String, Vec<Mismatch>> {
+fn missing_header_mismatch(header: &NormalisedHeader) -> Vec<Mismatch> {
+  vec![Mismatch::HeaderMismatch { key: header.key.clone(),
+    expected: format!("{:?}", header.values.join(", ")),
+    actual: "".to_string(),
+    mismatch: format!("Expected header '{}' but was missing", header.key) }]
+}
+
+fn match_header_maps(expected: &NormalisedHeaders, actual: &NormalisedHeaders, context: &MatchingContext) -> HashMap<String, Vec<Mismatch>> {
   let mut result = hashmap!{};
-  for (key, value) in &expected {
-    match find_entry(&actual, key) {
-      Some((_, actual_value)) => for (index, val) in value.iter().enumerate() {
-        result.insert(key.clone(), match_header_value(key, val,
-                                                      actual_value.get(index).unwrap_or(&String::default()), context).err().unwrap_or_default());
+  for header in &expected.headers {
+    match actual.get(&header.name) {
+      Some(actual_value) => for (index, val) in header.stripped.iter().enumerate() {
+        result.insert(header.key.clone(), match_stripped_header_value(&header.key, val,
+          actual_value.get(index).map(|v| v.as_str()).unwrap_or_default(), context).err().unwrap_or_default());
       },
       None => {
-        result.insert(key.clone(), vec![Mismatch::HeaderMismatch { key: key.clone(),
-          expected: format!("{:?}", value.join(", ")),
-          actual: "".to_string(),
-          mismatch: format!("Expected header '{}' but was missing", key) }]);
+        result.insert(header.key.clone(), missing_header_mismatch(header));
       }
     }
   }
@@ -110,15 +187,30 @@ fn match_header_maps(expected: HashMap<String, Vec<String>>, actual: HashMap<Str
 pub fn match_headers(expected: Option<HashMap<String, Vec<String>>>,
                      actual: Option<HashMap<String, Vec<String>>>,
                      context: &MatchingContext) -> HashMap<String, Vec<Mismatch>> {
+  match_headers_ref(expected.as_ref(), actual.as_ref(), context)
+}
+
+/// Matches the actual headers to the expected ones, without taking ownership of either
+pub fn match_headers_ref(expected: Option<&HashMap<String, Vec<String>>>,
+                         actual: Option<&HashMap<String, Vec<String>>>,
+                         context: &MatchingContext) -> HashMap<String, Vec<Mismatch>> {
+  match expected {
+    Some(expected) => match_normalised_headers(Some(&NormalisedHeaders::new(expected)),
+      actual.map(NormalisedHeaders::new).as_ref(), context),
+    None => hashmap!{}
+  }
+}
+
+/// Matches the actual headers to the expected ones, where both have already been normalised
+pub fn match_normalised_headers(expected: Option<&NormalisedHeaders>,
+                                actual: Option<&NormalisedHeaders>,
+                                context: &MatchingContext) -> HashMap<String, Vec<Mismatch>> {
   match (actual, expected) {
     (Some(aqm), Some(eqm)) => match_header_maps(eqm, aqm, context),
     (Some(_), None) => hashmap!{},
-    (None, Some(eqm)) => eqm.iter().map(|(key, value)| {
-      (key.clone(), vec![Mismatch::HeaderMismatch { key: key.clone(),
-        expected: format!("{:?}", value.join(", ")),
-        actual: "".to_string(),
-        mismatch: format!("Expected header '{}' but was missing", key) }])
-    }).collect(),
+    (None, Some(eqm)) => eqm.headers.iter()
+      .map(|header| (header.key.clone(), missing_header_mismatch(header)))
+      .collect(),
     (None, None) => hashmap!{}
   }
 }
@@ -132,7 +224,7 @@ mod tests {
   use pact_models::matchingrules::MatchingRule;
 
   use crate::{DiffConfig, MatchingContext, Mismatch};
-  use crate::headers::{match_header_value, match_headers};
+  use crate::headers::{match_header_value, match_headers, match_normalised_headers, NormalisedHeaders};
 
   #[test]
   fn matching_headers_be_true_when_headers_are_equal() {
@@ -334,4 +426,59 @@ mod tests {
       mismatch: s!(""),
     } ]));
   }
+
+  #[test]
+  fn normalised_headers_are_looked_up_ignoring_case() {
+    let headers = NormalisedHeaders::new(&hashmap! {
+      s!("Content-Type") => vec![s!("application/json")],
+      s!("X-Values") => vec![s!("a, b"), s!(" c ")]
+    });
+    expect!(headers.len()).to(be_equal_to(2));
+    expect!(headers.get("content-type")).to(be_some().value(&[s!("application/json")][..]));
+    expect!(headers.get("CONTENT-TYPE")).to(be_some().value(&[s!("application/json")][..]));
+    expect!(headers.get("x-values")).to(be_some().value(&[s!("ab"), s!("c")][..]));
+    expect!(headers.get("accept")).to(be_none());
+  }
+
+  #[test]
+  fn normalised_headers_keep_the_headers_as_they_were_given() {
+    let headers = NormalisedHeaders::from_pairs(vec![
+      (s!("X-Values"), vec![s!("a, b"), s!(" c ")]),
+      (s!("Content-Type"), vec![s!("application/json")])
+    ]);
+    expect!(headers.get("x-values")).to(be_some().value(&[s!("ab"), s!("c")][..]));
+    expect!(headers.iter().collect::<Vec<_>>()).to(be_equal_to(vec![
+      ("Content-Type", &[s!("application/json")][..]),
+      ("X-Values", &[s!("a, b"), s!(" c ")][..])
+    ]));
+    expect!(headers.to_map()).to(be_equal_to(hashmap! {
+      s!("Content-Type") => vec![s!("application/json")],
+      s!("X-Values") => vec![s!("a, b"), s!(" c ")]
+    }));
+  }
+
+  #[test]
+  fn matching_normalised_headers_gives_the_same_mismatches_as_matching_the_headers() {
+    let expected = hashmap! {
+      s!("Content-Type") => vec![s!("application/json; charset=UTF-8")],
+      s!("X-Expected") => vec![s!("1")],
+      s!("X-Missing") => vec![s!("a"), s!("b")]
+    };
+    let actual = hashmap! {
+      s!("content-type") => vec![s!("application/json;charset=utf-8")],
+      s!("x-expected") => vec![s!("2")],
+      s!("x-unexpected") => vec![s!("3")]
+    };
+    let context = MatchingContext::default();
+
+    let result = match_normalised_headers(Some(&NormalisedHeaders::new(&expected)),
+      Some(&NormalisedHeaders::new(&actual)), &context);
+    expect!(result.clone()).to(be_equal_to(match_headers(Some(expected.clone()), Some(actual), &context)));
+    expect!(result.get("Content-Type")).to(be_some().value(&vec![]));
+    expect!(result.get("X-Expected").map(|mismatches| mismatches.len())).to(be_some().value(1));
+    expect!(result.get("X-Missing").map(|mismatches| mismatches.len())).to(be_some().value(1));
+
+    expect!(match_normalised_headers(Some(&NormalisedHeaders::new(&expected)), None, &context))
+      .to(be_equal_to(match_headers(Some(expected), None, &context)));
+  }
 }
@@ -4,11 +4,12 @@ use std::str::FromStr;
 
 use ansi_term::Colour::*;
 use anyhow::anyhow;
+use bytes::Bytes;
 use difference::*;
 use log::*;
-use onig::Regex;
 use serde_json::{json, Value};
 
+use pact_models::bodies::OptionalBody;
 use pact_models::http_parts::HttpPart;
 use pact_models::json_utils::json_to_string;
 use pact_models::matchingrules::MatchingRule;
@@ -18,6 +19,7 @@ use crate::{DiffConfig, MatchingContext, merge_result};
 use crate::binary_utils::{convert_data, match_content_type};
 use crate::matchers::*;
 use crate::models::matchingrules::{compare_lists_with_matchingrule, compare_maps_with_matchingrule};
+use crate::regex_cache::cached_regex;
 
 use super::Mismatch;
 
@@ -48,7 +50,7 @@ impl Matches<&Value> for Value {
   fn matches_with(&self, actual: &Value, matcher: &MatchingRule) -> anyhow::Result<()> {
     let result = match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             let actual_str = match actual {
               &Value::String(ref s) => s.clone(),
@@ -190,10 +192,45 @@ impl Matches<&Value> for Value {
   }
 }
 
+/// Actual JSON body that has been parsed once, so that it can be matched against the bodies of
+/// multiple expected requests without being parsed again for each of them. The body is parsed with
+/// serde_json, as the matchers compare `serde_json::Value` trees.
+#[derive(Debug, Clone)]
+pub struct ParsedJsonBody {
+  body: Bytes,
+  json: Value
+}
+
+impl ParsedJsonBody {
+  /// Parses the body. Returns None if the body is not present or is not valid JSON.
+  pub fn parse(body: &OptionalBody) -> Option<ParsedJsonBody> {
+    match body {
+      OptionalBody::Present(bytes, _) => serde_json::from_slice(bytes).ok()
+        .map(|json| ParsedJsonBody { body: bytes.clone(), json }),
+      _ => None
+    }
+  }
+
+  /// Returns the parsed JSON if it was parsed from the same body contents
+  fn json_for(&self, body: &Bytes) -> Option<&Value> {
+    if self.body == *body {
+      Some(&self.json)
+    } else {
+      None
+    }
+  }
+}
+
 /// Matches the expected JSON to the actual, and populates the mismatches vector with any differences
 pub fn match_json(expected: &dyn HttpPart, actual: &dyn HttpPart, context: &MatchingContext) -> Result<(), Vec<super::Mismatch>> {
   let expected_json = serde_json::from_slice(&*expected.body().value().unwrap_or_default());
-  let actual_json = serde_json::from_slice(&*actual.body().value().unwrap_or_default());
+  let actual_body = actual.body().value().unwrap_or_default();
+  if let Some(actual_json) = context.parsed_json.as_ref().and_then(|parsed| parsed.json_for(&actual_body)) {
+    if let Ok(expected_json) = &expected_json {
+      return compare(&vec!["$"], expected_json, actual_json, context);
+    }
+  }
+  let actual_json = serde_json::from_slice(&*actual_body);
 
   if expected_json.is_err() || actual_json.is_err() {
     let mut mismatches = vec![];
@@ -328,6 +365,9 @@ fn compare_maps(path: &[&str], expected: &serde_json::Map<String, Value>, actual
     if context.matcher_is_defined(path) {
       debug!("compare_maps: Matcher is defined for path {}", spath);
       for matcher in context.select_best_matcher(path).unwrap().rules {
+        if context.early_exit && result.is_err() {
+          break;
+        }
         result = merge_result(result,compare_maps_with_matchingrule(&matcher, path, &expected, &actual, &context, &mut |p, expected, actual| {
           compare(&p, expected, actual, context)
         }));
@@ -335,6 +375,9 @@ fn compare_maps(path: &[&str], expected: &serde_json::Map<String, Value>, actual
     } else {
       result = merge_result(result, context.match_keys(path, &expected, &actual));
       for (key, value) in expected.iter() {
+        if context.early_exit && result.is_err() {
+          break;
+        }
         let mut p = path.to_vec();
         p.push(key.as_str());
         if actual.contains_key(key) {
@@ -353,6 +396,9 @@ fn compare_lists(path: &[&str], expected: &Vec<Value>, actual: &Vec<Value>,
     log::debug!("compare_lists: matcher defined for path '{}'", spath);
     let mut result = Ok(());
     for matcher in context.select_best_matcher(path).unwrap().rules {
+      if context.early_exit && result.is_err() {
+        break;
+      }
       let values_result = compare_lists_with_matchingrule(&matcher, path, expected, actual, context, &|p, expected, actual, context| {
         compare(p, expected, actual, context)
       });
@@ -385,6 +431,9 @@ fn compare_lists(path: &[&str], expected: &Vec<Value>, actual: &Vec<Value>,
 fn compare_list_content(path: &[&str], expected: &Vec<Value>, actual: &Vec<Value>, context: &MatchingContext) -> Result<(), Vec<Mismatch>> {
   let mut result = Ok(());
   for (index, value) in expected.iter().enumerate() {
+    if context.early_exit && result.is_err() {
+      break;
+    }
     let ps = index.to_string();
     log::debug!("Comparing list item {} with value '{:?}' to '{:?}'", index, actual.get(index), value);
     let mut p = path.to_vec();
@@ -1079,4 +1128,31 @@ mod tests {
     let result = compare_maps(&vec!["$"], expected, actual, &context);
     expect!(result).to(be_err());
   }
+
+  #[test]
+  fn match_json_with_early_exit_stops_at_the_first_mismatch() {
+    let expected = request!(r#"{"a": 1, "b": 2, "c": [1, 2, 3]}"#);
+    let actual = request!(r#"{"a": 10, "b": 20, "c": [10, 20, 30]}"#);
+
+    let result = match_json(&expected, &actual, &MatchingContext::with_config(DiffConfig::AllowUnexpectedKeys));
+    expect!(result.unwrap_err().len()).to(be_equal_to(5));
+
+    let context = MatchingContext::with_config(DiffConfig::AllowUnexpectedKeys).with_early_exit(true);
+    let result = match_json(&expected, &actual, &context);
+    expect!(result.unwrap_err().len()).to(be_equal_to(1));
+    expect!(match_json(&expected, &expected, &context)).to(be_ok());
+  }
+
+  #[test]
+  fn match_json_uses_the_parsed_json_only_for_the_same_body() {
+    let expected = request!(r#"{"a": 1}"#);
+    let actual = request!(r#"{"a": 1}"#);
+    let other = request!(r#"{"a": 2}"#);
+    let context = MatchingContext::with_config(DiffConfig::AllowUnexpectedKeys)
+      .with_parsed_json(ParsedJsonBody::parse(&actual.body).map(std::sync::Arc::new));
+
+    expect!(match_json(&expected, &actual, &context)).to(be_ok());
+    expect!(match_json(&expected, &other, &context)).to(be_err());
+    expect!(ParsedJsonBody::parse(&request!(r#"{"a": "#).body).is_none()).to(be_true());
+  }
 }
@@ -334,12 +334,14 @@
 
 #![warn(missing_docs)]
 
+use std::borrow::Cow;
 use std::collections::HashMap;
 use std::fmt::{Debug, Display};
 use std::fmt::Formatter;
 use std::hash::Hash;
 use std::str;
 use std::str::from_utf8;
+use std::sync::Arc;
 
 use ansi_term::*;
 use ansi_term::Colour::*;
@@ -354,12 +356,13 @@ use pact_models::content_types::ContentType;
 use pact_models::generators::{apply_generators, GenerateValue, GeneratorCategory, GeneratorTestMode, VariantMatcher};
 use pact_models::http_parts::HttpPart;
 use pact_models::json_utils::json_to_string;
-use pact_models::matchingrules::{calc_path_weight, Category, MatchingRule, MatchingRuleCategory, path_length, RuleList};
+use pact_models::matchingrules::{Category, MatchingRule, MatchingRuleCategory, MatchingRules, MatchingRuleTrie, RuleList};
 use pact_models::PactSpecification;
 use pact_models::request::Request;
 use pact_models::response::Response;
 
-use crate::headers::{match_header_value, match_headers};
+use crate::headers::{match_header_value, match_headers_ref, match_normalised_headers, NormalisedHeaders};
+use crate::json::ParsedJsonBody;
 use crate::matchers::*;
 use crate::models::generators::{DefaultVariantMatcher, generators_process_body};
 use crate::models::Interaction;
@@ -376,18 +379,27 @@ mod matchers;
 pub mod json;
 mod xml;
 mod binary_utils;
-mod headers;
+pub mod headers;
+pub mod regex_cache;
 pub mod logging;
 
 #[derive(Debug, Clone)]
 /// Context used to apply matching logic
 pub struct MatchingContext {
-  /// Matching rules that apply when matching with the context
+  /// Matching rules that apply when matching with the context. Lookups use the rules compiled when
+  /// the context was created, so use `clone_with` to match with different rules.
   pub matchers: MatchingRuleCategory,
   /// Configuration to apply when matching with the context
   pub config: DiffConfig,
   /// Specification version to apply when matching with the context
-  pub matching_spec: PactSpecification
+  pub matching_spec: PactSpecification,
+  /// If matching should stop at the first mismatch found. Set with `with_early_exit`.
+  pub(crate) early_exit: bool,
+  /// Actual JSON body that has already been parsed. Set with `with_parsed_json`.
+  pub(crate) parsed_json: Option<Arc<ParsedJsonBody>>,
+  /// Matching rules compiled into a trie by path, so looking up the rules for a path does not
+  /// need to weight every rule
+  pub(crate) rule_trie: Arc<MatchingRuleTrie>
 }
 
 impl MatchingContext {
@@ -396,6 +408,7 @@ impl MatchingContext {
     MatchingContext {
       matchers: matchers.clone(),
       config: config.clone(),
+      rule_trie: Arc::new(MatchingRuleTrie::new(matchers)),
       .. MatchingContext::default()
     }
   }
@@ -413,46 +426,65 @@ impl MatchingContext {
     MatchingContext {
       matchers: matchers.clone(),
       config: self.config.clone(),
-      matching_spec: self.matching_spec.clone()
+      matching_spec: self.matching_spec.clone(),
+      early_exit: self.early_exit,
+      parsed_json: self.parsed_json.clone(),
+      rule_trie: Arc::new(MatchingRuleTrie::new(matchers))
     }
   }
 
+  /// Returns the context set to stop matching at the first mismatch found. This is used when only
+  /// the outcome of the match is required, and not all the mismatches.
+  pub fn with_early_exit(self, early_exit: bool) -> Self {
+    MatchingContext { early_exit, .. self }
+  }
+
+  /// Returns the context with the actual JSON body already parsed, so it does not need to be
+  /// parsed again. It is only used if the actual body being matched has the same contents.
+  pub fn with_parsed_json(self, parsed_json: Option<Arc<ParsedJsonBody>>) -> Self {
+    MatchingContext { parsed_json, .. self }
+  }
+
+  /// If matching with this context stops at the first mismatch found
+  pub fn early_exit(&self) -> bool {
+    self.early_exit
+  }
+
   /// If there is a matcher defined at the path in this context
   pub fn matcher_is_defined(&self, path: &[&str]) -> bool {
-    self.matchers.matcher_is_defined(path)
+    self.rule_trie.matcher_is_defined(path)
   }
 
   /// Selected the best matcher from the context for the given path
   pub fn select_best_matcher(&self, path: &[&str]) -> Option<RuleList> {
-    self.matchers.select_best_matcher(path)
+    self.rule_trie.select_best_matcher(path)
   }
 
   /// If there is a wildcard matcher defined at the path in this context
   #[deprecated(since = "0.8.12", note = "Replaced with values matcher")]
   pub fn wildcard_matcher_is_defined(&self, path: &[&str]) -> bool {
-    !self.matchers_for_exact_path(path).filter(|&(val, _)| val.ends_with(".*")).is_empty()
+    self.exact_path_rules(path).iter().any(|(val, _)| val.ends_with(".*"))
   }
 
-  fn matchers_for_exact_path(&self, path: &[&str]) -> MatchingRuleCategory {
+  /// Returns the rules with a key that matches the whole path
+  fn exact_path_rules(&self, path: &[&str]) -> Vec<(&str, &RuleList)> {
     match self.matchers.name {
-      Category::HEADER | Category::QUERY => self.matchers.filter(|&(val, _)| {
-        path.len() == 1 && path[0] == *val
-      }),
-      Category::BODY => self.matchers.filter(|&(val, _)| {
-        calc_path_weight(val, path).0 > 0 && path_length(val) == path.len()
-      }),
-      _ => self.matchers.filter(|_| false)
+      Category::HEADER | Category::QUERY if path.len() == 1 => self.matchers.rules.get_key_value(path[0])
+        .map(|(val, rules)| (val.as_str(), rules))
+        .into_iter().collect(),
+      Category::BODY => self.rule_trie.rules_for_exact_path(path),
+      _ => vec![]
     }
   }
 
   /// If there is a type matcher defined at the path in this context
   pub fn type_matcher_defined(&self, path: &[&str]) -> bool {
-    self.matchers.resolve_matchers_for_path(path).type_matcher_defined()
+    self.rule_trie.type_matcher_defined(path)
   }
 
   /// If there is a values matcher defined at the path in this context
   pub fn values_matcher_defined(&self, path: &[&str]) -> bool {
-    self.matchers_for_exact_path(path).values_matcher_defined()
+    self.exact_path_rules(path).iter().any(|(_, rules)| rules.values_matcher_defined())
   }
 
   /// Matches the keys of the expected and actual maps
@@ -490,7 +522,10 @@ impl Default for MatchingContext {
     MatchingContext {
       matchers: Default::default(),
       config: DiffConfig::AllowUnexpectedKeys,
-      matching_spec: PactSpecification::V3
+      matching_spec: PactSpecification::V3,
+      early_exit: false,
+      parsed_json: None,
+      rule_trie: Default::default()
     }
   }
 }
@@ -898,6 +933,20 @@ impl RequestMatchResult {
     m
   }
 
+  /// Returns a ranking of the result based on which parts of the request matched. Unlike `score`,
+  /// it does not depend on the number of mismatches, so results from matching with early exit
+  /// (which stops at the first body mismatch) can be compared. The method matching outranks the
+  /// path, which outranks the query parameters, then the headers and lastly the body.
+  pub fn ranking(&self) -> u8 {
+    [
+      self.method.is_none(),
+      self.path.is_none(),
+      self.query.values().all(|m| m.is_empty()),
+      self.headers.values().all(|m| m.is_empty()),
+      self.body.all_matched()
+    ].iter().fold(0, |ranking, matched| (ranking << 1) | *matched as u8)
+  }
+
   /// Returns a score based on what was matched
   pub fn score(&self) -> i8 {
     let mut score = 0;
@@ -1114,9 +1163,9 @@ fn match_query_values(key: &String, expected: &Vec<String>, actual: &Vec<String>
   }
 }
 
-fn match_query_maps(expected: HashMap<String, Vec<String>>, actual: HashMap<String, Vec<String>>, context: &MatchingContext) -> HashMap<String, Vec<Mismatch>> {
+fn match_query_maps(expected: &HashMap<String, Vec<String>>, actual: &HashMap<String, Vec<String>>, context: &MatchingContext) -> HashMap<String, Vec<Mismatch>> {
   let mut result: HashMap<String, Vec<Mismatch>> = hashmap!{};
-  for (key, value) in &expected {
+  for (key, value) in expected {
     match actual.get(key) {
       Some(actual_value) => {
         let matches = match_query_values(key, value, actual_value, context);
@@ -1129,7 +1178,7 @@ fn match_query_maps(expected: HashMap<String, Vec<String>>, actual: HashMap<Stri
         mismatch: format!("Expected query parameter '{}' but was missing", key) })
     }
   }
-  for (key, value) in &actual {
+  for (key, value) in actual {
     match expected.get(key) {
       Some(_) => (),
       None => result.entry(key.clone()).or_default().push(Mismatch::QueryMismatch { parameter: key.clone(),
@@ -1143,6 +1192,15 @@ fn match_query_maps(expected: HashMap<String, Vec<String>>, actual: HashMap<Stri
 
 /// Matches the actual query parameters to the expected ones.
 pub fn match_query(expected: Option<HashMap<String, Vec<String>>>, actual: Option<HashMap<String, Vec<String>>>, context: &MatchingContext) -> HashMap<String, Vec<Mismatch>> {
+  match_query_ref(expected.as_ref(), actual.as_ref(), context)
+}
+
+/// Matches the actual query parameters to the expected ones, without taking ownership of either
+pub fn match_query_ref(
+  expected: Option<&HashMap<String, Vec<String>>>,
+  actual: Option<&HashMap<String, Vec<String>>>,
+  context: &MatchingContext
+) -> HashMap<String, Vec<Mismatch>> {
   match (actual, expected) {
     (Some(aqm), Some(eqm)) => match_query_maps(eqm, aqm, context),
     (Some(aqm), None) => aqm.iter().map(|(key, value)| {
@@ -1268,31 +1326,110 @@ pub fn match_body(
 
 /// Matches the expected and actual requests
 pub fn match_request(expected: Request, actual: Request) -> RequestMatchResult {
+  match_request_ref(&expected, &actual)
+}
+
+/// Matches the expected and actual requests, without taking ownership of either. This avoids
+/// having to clone the requests when matching one request against many expected ones.
+pub fn match_request_ref(expected: &Request, actual: &Request) -> RequestMatchResult {
+  match_request_with_options(expected, actual, &RequestMatchOptions::default())
+}
+
+/// Options that control how a request is matched by `match_request_with_options`
+#[derive(Debug, Clone, Default)]
+pub struct RequestMatchOptions {
+  /// Stop comparing the body at the first mismatch. The result will then only have some of the
+  /// body mismatches, but will still be correct about whether the request matched.
+  pub early_exit: bool,
+  /// The actual body parsed as JSON. Setting this avoids the body being parsed again each time
+  /// the request is matched against a different expected one.
+  pub parsed_json: Option<Arc<ParsedJsonBody>>,
+  /// The actual headers normalised for matching. Setting this avoids the headers being
+  /// normalised again each time the request is matched against a different expected one.
+  pub headers: Option<Arc<NormalisedHeaders>>
+}
+
+impl RequestMatchOptions {
+  /// Creates options for matching the actual request against multiple expected ones, with the
+  /// body of the request parsed only once if it is JSON, and the headers normalised only once
+  pub fn for_request(actual: &Request, early_exit: bool) -> Self {
+    let headers = actual.headers.as_ref().map(|headers| Arc::new(NormalisedHeaders::new(headers)));
+    Self::for_request_with_headers(actual, headers, early_exit)
+  }
+
+  /// Creates options for matching the actual request against multiple expected ones, where the
+  /// headers of the request have already been normalised (i.e. when the request was received)
+  pub fn for_request_with_headers(
+    actual: &Request,
+    headers: Option<Arc<NormalisedHeaders>>,
+    early_exit: bool
+  ) -> Self {
+    let parsed_json = if actual.content_type().map(|ct| ct.is_json()).unwrap_or(false) {
+      ParsedJsonBody::parse(&actual.body).map(Arc::new)
+    } else {
+      None
+    };
+    RequestMatchOptions { early_exit, parsed_json, headers }
+  }
+}
+
+/// Matches the expected and actual requests using the provided options
+pub fn match_request_with_options(
+  expected: &Request,
+  actual: &Request,
+  options: &RequestMatchOptions
+) -> RequestMatchResult {
+  let expected_headers = expected.headers.as_ref().map(NormalisedHeaders::new);
+  match_request_with_normalised_headers(expected, expected_headers.as_ref(), actual, options)
+}
+
+/// Matches the expected and actual requests using the provided options, where the headers of the
+/// expected request have already been normalised. If there are many requests to match against
+/// the same expected one, this avoids normalising its headers for each of them.
+pub fn match_request_with_normalised_headers(
+  expected: &Request,
+  expected_headers: Option<&NormalisedHeaders>,
+  actual: &Request,
+  options: &RequestMatchOptions
+) -> RequestMatchResult {
   log::info!("comparing to expected {}", expected);
   log::debug!("     body: '{}'", expected.body.str_value());
   log::debug!("     matching_rules: {:?}", expected.matching_rules);
   log::debug!("     generators: {:?}", expected.generators);
 
-  let path_context = MatchingContext::new(DiffConfig::NoUnexpectedKeys,
-                                          &expected.matching_rules.rules_for_category("path").unwrap_or_default());
-  let body_context = MatchingContext::new(DiffConfig::NoUnexpectedKeys,
-                                          &expected.matching_rules.rules_for_category("body").unwrap_or_default());
-  let query_context = MatchingContext::new(DiffConfig::NoUnexpectedKeys,
-                                          &expected.matching_rules.rules_for_category("query").unwrap_or_default());
-  let header_context = MatchingContext::new(DiffConfig::NoUnexpectedKeys,
-                                          &expected.matching_rules.rules_for_category("header").unwrap_or_default());
+  let path_context = category_context(DiffConfig::NoUnexpectedKeys, &expected.matching_rules, "path");
+  let body_context = category_context(DiffConfig::NoUnexpectedKeys, &expected.matching_rules, "body")
+    .with_early_exit(options.early_exit)
+    .with_parsed_json(options.parsed_json.clone());
+  let query_context = category_context(DiffConfig::NoUnexpectedKeys, &expected.matching_rules, "query");
+  let header_context = category_context(DiffConfig::NoUnexpectedKeys, &expected.matching_rules, "header");
+  let actual_headers = match options.headers {
+    Some(ref headers) => Some(Cow::Borrowed(headers.as_ref())),
+    None => actual.headers.as_ref().map(|headers| Cow::Owned(NormalisedHeaders::new(headers)))
+  };
   let result = RequestMatchResult {
     method: match_method(&expected.method, &actual.method).err(),
     path: match_path(&expected.path, &actual.path, &path_context).err(),
-    body: match_body(&expected, &actual, &body_context, &header_context),
-    query: match_query(expected.query, actual.query, &query_context),
-    headers: match_headers(expected.headers, actual.headers, &header_context)
+    body: match_body(expected, actual, &body_context, &header_context),
+    query: match_query_ref(expected.query.as_ref(), actual.query.as_ref(), &query_context),
+    headers: match_normalised_headers(expected_headers, actual_headers.as_deref(), &header_context)
   };
 
   log::debug!("--> Mismatches: {:?}", result.mismatches());
   result
 }
 
+/// Creates a matching context with the rules for the category, cloning them only once
+fn category_context(config: DiffConfig, rules: &MatchingRules, category: &str) -> MatchingContext {
+  let matchers = rules.rules_for_category(category).unwrap_or_default();
+  MatchingContext {
+    rule_trie: Arc::new(MatchingRuleTrie::new(&matchers)),
+    matchers,
+    config,
+    .. MatchingContext::default()
+  }
+}
+
 /// Matches the actual response status to the expected one.
 pub fn match_status(expected: u16, actual: u16, context: &MatchingContext) -> Result<(), Vec<Mismatch>> {
   let path = vec![];
@@ -1320,24 +1457,26 @@ pub fn match_status(expected: u16, actual: u16, context: &MatchingContext) -> Re
 
 /// Matches the actual and expected responses.
 pub fn match_response(expected: Response, actual: Response) -> Vec<Mismatch> {
+  match_response_ref(&expected, &actual)
+}
+
+/// Matches the actual and expected responses, without taking ownership of either.
+pub fn match_response_ref(expected: &Response, actual: &Response) -> Vec<Mismatch> {
   let mut mismatches = vec![];
 
   info!("comparing to expected response: {}", expected);
 
-  let status_context = MatchingContext::new(DiffConfig::AllowUnexpectedKeys,
-    &expected.matching_rules.rules_for_category("status").unwrap_or_default());
-  let body_context = MatchingContext::new(DiffConfig::AllowUnexpectedKeys,
-    &expected.matching_rules.rules_for_category("body").unwrap_or_default());
-  let header_context = MatchingContext::new(DiffConfig::AllowUnexpectedKeys,
-    &expected.matching_rules.rules_for_category("header").unwrap_or_default());
+  let status_context = category_context(DiffConfig::AllowUnexpectedKeys, &expected.matching_rules, "status");
+  let body_context = category_context(DiffConfig::AllowUnexpectedKeys, &expected.matching_rules, "body");
+  let header_context = category_context(DiffConfig::AllowUnexpectedKeys, &expected.matching_rules, "header");
 
-  mismatches.extend_from_slice(match_body(&expected, &actual, &body_context, &header_context)
+  mismatches.extend_from_slice(match_body(expected, actual, &body_context, &header_context)
     .mismatches().as_slice());
   if let Err(m) = match_status(expected.status, actual.status, &status_context) {
     mismatches.extend_from_slice(&m);
   }
-  let result = match_headers(expected.headers, actual.headers,
-                             &header_context);
+  let result = match_headers_ref(expected.headers.as_ref(), actual.headers.as_ref(),
+                                 &header_context);
   for values in result.values() {
     mismatches.extend_from_slice(values.as_slice());
   }
@@ -1469,9 +1608,9 @@ pub fn match_message(expected: &Box<dyn Interaction + Send>, actual: &Box<dyn In
     let matching_rules = expected.matching_rules().unwrap_or_default();
     let body_context = if expected.is_v4() {
       MatchingContext {
-        matchers: matching_rules.rules_for_category("content").unwrap_or_default(),
-        config: DiffConfig::AllowUnexpectedKeys,
-        matching_spec: PactSpecification::V4
+        matching_spec: PactSpecification::V4,
+        .. MatchingContext::new(DiffConfig::AllowUnexpectedKeys,
+                                &matching_rules.rules_for_category("content").unwrap_or_default())
       }
     } else {
       MatchingContext::new(DiffConfig::AllowUnexpectedKeys,
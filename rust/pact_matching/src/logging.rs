@@ -3,43 +3,169 @@
 //! entry
 
 use std::collections::HashMap;
-use std::sync::Mutex;
+use std::sync::{Arc, Mutex, RwLock};
+use std::sync::atomic::{AtomicUsize, Ordering};
 
-use bytes::{BufMut, Bytes, BytesMut};
+use bytes::{Buf, Bytes, BytesMut};
 use lazy_static::lazy_static;
 use tokio::task_local;
 
 lazy_static! {
-  /// Memory buffer for the buffer logger. This is needed here because there is no
+  /// Memory buffers for the buffer logger. This is needed here because there is no
   /// way to get the logger sync from the Dispatch struct. The buffer will be emptied
   /// when the contents is fetched via an FFI call.
   ///
   /// Accumulates the log entries against a task local ID. If the ID is not set, accumulates against
-  /// the "global" ID.
+  /// the "global" ID. Each ID has its own buffer, so writers for different IDs do not contend
+  /// with each other.
   /// cbindgen:ignore
-  static ref LOG_BUFFER: Mutex<HashMap<String, BytesMut>> = Mutex::new(HashMap::new());
+  static ref LOG_BUFFER: RwLock<HashMap<String, Arc<Mutex<LogBuffer>>>> = RwLock::new(HashMap::new());
 }
 
+/// Maximum number of bytes kept in each log buffer. Zero means no limit.
+static LOG_BUFFER_LIMIT: AtomicUsize = AtomicUsize::new(0);
+
 task_local! {
   /// Log ID to accumulate logs against
   #[allow(missing_docs)]
   pub static LOG_ID: String;
 }
 
+/// Log entries accumulated against a single ID. Offsets are absolute, counting every byte ever
+/// written to the buffer, so a cursor stays valid once older entries have been discarded.
+#[derive(Debug, Default)]
+struct LogBuffer {
+  /// Buffered contents
+  data: BytesMut,
+  /// Absolute offset of the first buffered byte
+  start: usize
+}
+
+impl LogBuffer {
+  /// Absolute offset of the end of the buffered contents
+  fn end(&self) -> usize {
+    self.start + self.data.len()
+  }
+
+  fn append(&mut self, buf: &[u8], limit: usize) {
+    self.data.extend_from_slice(buf);
+    if limit > 0 && self.data.len() > limit {
+      // Discard whole lines where possible so the buffer does not start part way through an entry
+      let excess = self.data.len() - limit;
+      let discard = match self.data[excess..].iter().position(|b| *b == b'\n') {
+        Some(pos) => excess + pos + 1,
+        None => excess
+      };
+      self.data.advance(discard);
+      self.start += discard;
+    }
+  }
+
+  fn take(&mut self) -> Bytes {
+    self.start = self.end();
+    self.data.split().freeze()
+  }
+
+  fn since(&self, cursor: usize) -> (Bytes, usize) {
+    let from = cursor.max(self.start).min(self.end()) - self.start;
+    (Bytes::copy_from_slice(&self.data[from..]), self.end())
+  }
+}
+
+fn log_buffer(id: &str) -> Arc<Mutex<LogBuffer>> {
+  if let Some(buffer) = LOG_BUFFER.read().unwrap().get(id) {
+    return buffer.clone();
+  }
+  LOG_BUFFER.write().unwrap().entry(id.to_string()).or_default().clone()
+}
+
+fn existing_log_buffer(id: &str) -> Option<Arc<Mutex<LogBuffer>>> {
+  LOG_BUFFER.read().unwrap().get(id).cloned()
+}
+
 /// Fetches the contents from the id scoped in-memory buffer and empties the buffer.
 pub fn fetch_buffer_contents(id: &String) -> Bytes {
-  let mut inner = LOG_BUFFER.lock().unwrap();
-  let buffer = inner.entry(id.clone())
-    .or_insert(BytesMut::with_capacity(256));
-  buffer.split().freeze()
+  match existing_log_buffer(id) {
+    Some(buffer) => buffer.lock().unwrap().take(),
+    None => Bytes::new()
+  }
+}
+
+/// Fetches the contents from the id scoped in-memory buffer that were written after the cursor
+/// position, without emptying the buffer. Returns the contents and the cursor to use for the next
+/// fetch. A cursor of zero fetches everything still in the buffer. If entries after the cursor have
+/// already been discarded because of the buffer limit, the contents start from the oldest entry
+/// still available.
+pub fn fetch_buffer_contents_since(id: &str, cursor: usize) -> (Bytes, usize) {
+  match existing_log_buffer(id) {
+    Some(buffer) => buffer.lock().unwrap().since(cursor),
+    None => (Bytes::new(), cursor)
+  }
+}
+
+/// Sets the maximum number of bytes that will be kept in each in-memory log buffer. Once a buffer
+/// is full, the oldest entries are discarded. A limit of zero means the buffers are unbounded.
+pub fn set_log_buffer_limit(limit: usize) {
+  LOG_BUFFER_LIMIT.store(limit, Ordering::Relaxed);
+}
+
+/// Removes the in-memory buffer for the ID, discarding any contents.
+pub fn remove_log_buffer(id: &str) {
+  LOG_BUFFER.write().unwrap().remove(id);
 }
 
 /// Writes the provided bytes to the task local ID scoped in-memory buffer. If there is no
 /// task local ID set, will write to the "global" buffer.
 pub fn write_to_log_buffer(buf: &[u8]) {
-  let id = LOG_ID.try_with(|id| id.clone()).unwrap_or("global".into());
-  let mut inner = LOG_BUFFER.lock().unwrap();
-  let buffer = inner.entry(id)
-    .or_insert(BytesMut::with_capacity(256));
-  buffer.put(buf);
+  let buffer = LOG_ID.try_with(|id| log_buffer(id))
+    .unwrap_or_else(|_| log_buffer("global"));
+  let limit = LOG_BUFFER_LIMIT.load(Ordering::Relaxed);
+  buffer.lock().unwrap().append(buf, limit);
+}
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+
+  use super::*;
+
+  #[test]
+  fn log_buffer_discards_the_oldest_lines_when_full() {
+    let mut buffer = LogBuffer::default();
+    buffer.append(b"line one\n", 20);
+    buffer.append(b"line two\n", 20);
+    buffer.append(b"line three\n", 20);
+    expect!(buffer.data.as_ref()).to(be_equal_to(b"line three\n".as_ref()));
+    expect!(buffer.start).to(be_equal_to(18));
+    expect!(buffer.end()).to(be_equal_to(29));
+  }
+
+  #[test]
+  fn log_buffer_returns_the_contents_since_the_cursor() {
+    let mut buffer = LogBuffer::default();
+    buffer.append(b"line one\n", 0);
+    let (contents, cursor) = buffer.since(0);
+    expect!(contents.as_ref()).to(be_equal_to(b"line one\n".as_ref()));
+    expect!(cursor).to(be_equal_to(9));
+
+    buffer.append(b"line two\n", 0);
+    let (contents, cursor) = buffer.since(cursor);
+    expect!(contents.as_ref()).to(be_equal_to(b"line two\n".as_ref()));
+    expect!(cursor).to(be_equal_to(18));
+
+    let (contents, cursor) = buffer.since(cursor);
+    expect!(contents.is_empty()).to(be_true());
+    expect!(cursor).to(be_equal_to(18));
+  }
+
+  #[test]
+  fn log_buffer_cursor_is_still_valid_after_the_buffer_is_emptied() {
+    let mut buffer = LogBuffer::default();
+    buffer.append(b"line one\n", 0);
+    expect!(buffer.take().as_ref()).to(be_equal_to(b"line one\n".as_ref()));
+    buffer.append(b"line two\n", 0);
+    let (contents, cursor) = buffer.since(0);
+    expect!(contents.as_ref()).to(be_equal_to(b"line two\n".as_ref()));
+    expect!(cursor).to(be_equal_to(18));
+  }
 }
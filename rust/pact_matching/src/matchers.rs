@@ -4,7 +4,6 @@ use anyhow::anyhow;
 use bytes::Bytes;
 use itertools::Itertools;
 use log::*;
-use onig::Regex;
 
 use pact_models::HttpStatus;
 use pact_models::matchingrules::{MatchingRule, RuleLogic};
@@ -12,6 +11,7 @@ use pact_models::time_utils::validate_datetime;
 
 use crate::binary_utils::match_content_type;
 use crate::MatchingContext;
+use crate::regex_cache::cached_regex;
 
 /// Trait for matching rule implementation
 pub trait Matches<A: Clone> {
@@ -52,7 +52,7 @@ impl Matches<&str> for &str {
     debug!("String -> String: comparing '{}' to '{}' using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(actual) {
               Ok(())
@@ -140,7 +140,7 @@ impl Matches<u64> for &str {
     log::debug!("String -> u64: comparing '{}' to {} using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(&actual.to_string()) {
               Ok(())
@@ -177,7 +177,7 @@ impl Matches<u64> for u64 {
     debug!("u64 -> u64: comparing {} to {} using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(&actual.to_string()) {
               Ok(())
@@ -219,7 +219,7 @@ impl Matches<f64> for u64 {
     debug!("u64 -> f64: comparing {} to {} using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(&actual.to_string()) {
               Ok(())
@@ -256,7 +256,7 @@ impl Matches<f64> for f64 {
     debug!("f64 -> f64: comparing {} to {} using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(&actual.to_string()) {
               Ok(())
@@ -297,7 +297,7 @@ impl Matches<u64> for f64 {
     debug!("f64 -> u64: comparing {} to {} using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(ref regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(&actual.to_string()) {
               Ok(())
@@ -360,7 +360,7 @@ impl Matches<i64> for &str {
     debug!("String -> i32: comparing '{}' to {} using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(&actual.to_string()) {
               Ok(())
@@ -396,7 +396,7 @@ impl Matches<i64> for i64 {
     debug!("i64 -> i64: comparing {} to {} using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(&actual.to_string()) {
               Ok(())
@@ -455,7 +455,7 @@ impl Matches<bool> for bool {
     debug!("bool -> bool: comparing '{}' to {} using {:?}", self, actual, matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             if re.is_match(&actual.to_string()) {
               Ok(())
@@ -486,7 +486,7 @@ impl Matches<&Bytes> for Bytes {
     debug!("Bytes -> Bytes: comparing {} bytes to {} bytes using {:?}", self.len(), actual.len(), matcher);
     match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             match from_utf8(actual) {
               Ok(s) => if re.is_match(s) {
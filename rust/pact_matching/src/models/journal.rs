@@ -0,0 +1,371 @@
+//! The `journal` module provides incremental writing of pact files.
+//!
+//! Merging a pact into an existing pact file requires the whole file to be read, parsed, merged
+//! and written out again, so test suites that write into the same pact file from many tests do
+//! work that grows with the square of the number of interactions. Instead, the interactions of
+//! each pact can be appended to a journal next to the pact file, and the pact file written out
+//! once at the end with `finalise_pact`.
+//!
+//! The journal (`<pact file>.journal`) has the JSON of one interaction per line. A sidecar index
+//! (`<pact file>.journal-index`) has a header line with the pact JSON without the interactions,
+//! followed by a line for each interaction in the journal with its key (provider states and
+//! description), a hash of its JSON and its location in the journal. Appending only needs to read
+//! the index. Both files are only read or updated while holding an exclusive lock on a third file
+//! (`<pact file>.journal-lock`), so test processes running in parallel can append to the same
+//! journal. The lock file is never removed, so a process waiting for the lock while the journal is
+//! finalised takes the same lock afterwards and starts a new journal, rather than locking a file
+//! that has already been removed.
+
+use std::collections::HashMap;
+use std::fs;
+use std::fs::{File, OpenOptions};
+use std::io::{BufRead, BufReader, Read, Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+
+use anyhow::{anyhow, Context};
+use log::*;
+use serde::{Deserialize, Serialize};
+use serde_json::Value;
+
+use pact_models::file_utils::with_write_lock;
+use pact_models::hash_utils::fnv1a;
+use pact_models::PactSpecification;
+
+use crate::models::{load_pact_from_json, Pact, write_pact};
+
+/// Extension added to the pact file name for the journal
+const JOURNAL_EXTENSION: &str = "journal";
+/// Extension added to the pact file name for the journal index
+const INDEX_EXTENSION: &str = "journal-index";
+/// Extension added to the pact file name for the file that is locked while using the journal
+const LOCK_EXTENSION: &str = "journal-lock";
+/// Number of attempts to lock the journal. Parallel test processes can hold the lock in turn, so
+/// more attempts are made than for the pact file.
+const LOCK_ATTEMPTS: u32 = 6;
+
+/// First line of the journal index
+#[derive(Debug, Clone, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+struct IndexHeader {
+  /// Specification version the interactions were written with
+  specification: PactSpecification,
+  /// Attribute of the pact JSON that has the interactions
+  attribute: String,
+  /// Pact JSON without the interactions
+  pact: Value
+}
+
+/// Entry in the journal index for an interaction
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct IndexEntry {
+  /// Provider states (with their parameters) and description of the interaction
+  key: String,
+  /// Hash of the interaction JSON
+  hash: u64,
+  /// Location of the interaction JSON in the journal
+  offset: u64,
+  /// Length of the interaction JSON
+  length: u64
+}
+
+/// Returns the path of the sidecar file for the pact file
+fn sidecar_path(path: &Path, extension: &str) -> PathBuf {
+  let mut file_name = path.file_name().unwrap_or_default().to_os_string();
+  file_name.push(".");
+  file_name.push(extension);
+  path.with_file_name(file_name)
+}
+
+/// Returns the key of the interaction JSON, made from the provider states and description. The
+/// parameters of the provider states are part of the key, as interactions for the same state
+/// with different parameters are different interactions.
+fn interaction_key(interaction: &Value) -> String {
+  let states = match interaction.get("providerStates") {
+    Some(Value::Array(states)) => states.iter()
+      .map(|state| Value::Array(vec![
+        state.get("name").cloned().unwrap_or_default(),
+        state.get("params").cloned().unwrap_or_else(|| Value::Object(Default::default()))
+      ]))
+      .collect(),
+    _ => interaction.get("providerState").cloned().into_iter().collect::<Vec<Value>>()
+  };
+  Value::Array(vec![
+    Value::Array(states),
+    interaction.get("description").cloned().unwrap_or_default()
+  ]).to_string()
+}
+
+/// Splits the pact JSON into the attribute with the interactions, the interactions and the rest
+/// of the pact
+fn split_pact_json(mut pact_json: Value) -> anyhow::Result<(String, Vec<Value>, Value)> {
+  let attribute = if pact_json.get("interactions").is_none() && pact_json.get("messages").is_some() {
+    "messages"
+  } else {
+    "interactions"
+  };
+  let interactions = match pact_json.as_object_mut().and_then(|pact| pact.remove(attribute)) {
+    Some(Value::Array(interactions)) => interactions,
+    Some(_) => return Err(anyhow!("Pact JSON attribute '{}' is not an array", attribute)),
+    None => vec![]
+  };
+  Ok((attribute.to_string(), interactions, pact_json))
+}
+
+fn read_index(index: &File) -> anyhow::Result<(Option<IndexHeader>, Vec<IndexEntry>)> {
+  let mut lines = BufReader::new(index).lines();
+  let header = match lines.next() {
+    Some(line) => Some(serde_json::from_str(&line?).context("Failed to parse the journal index header")?),
+    None => None
+  };
+  let entries = lines
+    .map(|line| line.map_err(|err| anyhow!(err))
+      .and_then(|line| serde_json::from_str(&line).context("Failed to parse the journal index")))
+    .collect::<anyhow::Result<Vec<IndexEntry>>>()?;
+  Ok((header, entries))
+}
+
+fn read_entry(journal: &mut File, entry: &IndexEntry) -> anyhow::Result<String> {
+  journal.seek(SeekFrom::Start(entry.offset))?;
+  let mut buffer = vec![0; entry.length as usize];
+  journal.read_exact(&mut buffer)?;
+  String::from_utf8(buffer).context("Journal entry is not valid UTF-8")
+}
+
+/// Appends the interactions of the pact to the journal for the pact file at the path, creating
+/// the journal if it does not exist. Interactions that are already in the journal are skipped.
+/// Returns an error if an interaction with the same provider states and description but
+/// different contents is already in the journal, or the pact was written with a different
+/// specification version. The pact file itself is only written by `finalise_pact`.
+pub fn append_pact(pact: &dyn Pact, path: &Path, pact_spec: PactSpecification) -> anyhow::Result<()> {
+  fs::create_dir_all(path.parent().unwrap())?;
+  let (attribute, interactions, pact_json) = split_pact_json(pact.to_json(pact_spec)?)?;
+
+  let lock_path = sidecar_path(path, LOCK_EXTENSION);
+  let mut lock = OpenOptions::new().write(true).create(true).open(&lock_path)?;
+  with_write_lock(&lock_path, &mut lock, LOCK_ATTEMPTS, &mut |_| {
+    let mut journal = OpenOptions::new().read(true).write(true).create(true)
+      .open(sidecar_path(path, JOURNAL_EXTENSION))?;
+    let mut index = OpenOptions::new().read(true).write(true).create(true)
+      .open(sidecar_path(path, INDEX_EXTENSION))?;
+    let (header, entries) = read_index(&index)?;
+    let mut pending = String::new();
+    match header {
+      Some(header) => if header.specification != pact_spec {
+        return Err(anyhow!("Unable to append to the pact journal for {:?}, as it was written with specification {}, not {}",
+          path, header.specification.version_str(), pact_spec.version_str()));
+      },
+      None => {
+        pending.push_str(&serde_json::to_string(&IndexHeader {
+          specification: pact_spec,
+          attribute: attribute.clone(),
+          pact: pact_json.clone()
+        })?);
+        pending.push('\n');
+      }
+    }
+
+    let mut known = entries.into_iter()
+      .map(|entry| (entry.key.clone(), entry))
+      .collect::<HashMap<String, IndexEntry>>();
+    let mut offset = journal.seek(SeekFrom::End(0))?;
+    let mut lines = String::new();
+    let mut conflicts = vec![];
+    for interaction in &interactions {
+      let key = interaction_key(interaction);
+      let json = interaction.to_string();
+      // This needs to be stable between test processes that may have been built with different
+      // compilers, so the standard library hasher is not used
+      let hash = fnv1a(json.as_bytes());
+      if let Some(entry) = known.get(&key) {
+        if entry.hash != hash {
+          warn!("Interaction {} conflicts with the interaction already in the pact journal", key);
+          conflicts.push(key);
+        }
+        continue;
+      }
+
+      let entry = IndexEntry { key: key.clone(), hash, offset, length: json.len() as u64 };
+      pending.push_str(&serde_json::to_string(&entry)?);
+      pending.push('\n');
+      lines.push_str(&json);
+      lines.push('\n');
+      offset += json.len() as u64 + 1;
+      known.insert(key, entry);
+    }
+
+    if !conflicts.is_empty() {
+      return Err(anyhow!("Unable to merge pacts, as there were {} conflict(s) between the interactions. Please clean out your pact directory before running the tests.",
+        conflicts.len()));
+    }
+
+    // The journal is written before the index, so the index never refers to missing entries
+    journal.seek(SeekFrom::End(0))?;
+    journal.write_all(lines.as_bytes())?;
+    journal.flush()?;
+    index.seek(SeekFrom::End(0))?;
+    index.write_all(pending.as_bytes())?;
+    index.flush()?;
+    Ok(())
+  })
+}
+
+/// Writes out the pact file at the path from its journal, and then removes the journal. If
+/// overwrite is false, the interactions are merged with any existing pact file. The metadata of
+/// the pact is taken from the first pact that was appended to the journal. Returns false if
+/// there is no journal for the pact file.
+pub fn finalise_pact(path: &Path, overwrite: bool) -> anyhow::Result<bool> {
+  let journal_path = sidecar_path(path, JOURNAL_EXTENSION);
+  let index_path = sidecar_path(path, INDEX_EXTENSION);
+  let lock_path = sidecar_path(path, LOCK_EXTENSION);
+  // There can not be a journal without the lock file, so this avoids creating lock files for pact
+  // files that have never had a journal. Whether the journal exists is checked again once the
+  // lock is held, as another process could finalise it first.
+  if !lock_path.exists() {
+    return Ok(false);
+  }
+
+  let mut lock = OpenOptions::new().write(true).create(true).open(&lock_path)?;
+  with_write_lock(&lock_path, &mut lock, LOCK_ATTEMPTS, &mut |_| {
+    let (mut journal, index) = match (File::open(&journal_path), File::open(&index_path)) {
+      (Ok(journal), Ok(index)) => (journal, index),
+      _ => return Ok(false)
+    };
+    let (header, entries) = read_index(&index)?;
+    let header = match header {
+      Some(header) => header,
+      None => return Ok(false)
+    };
+
+    let interactions = entries.iter()
+      .map(|entry| read_entry(&mut journal, entry)
+        .and_then(|json| serde_json::from_str(&json).context("Failed to parse the journal entry")))
+      .collect::<anyhow::Result<Vec<Value>>>()?;
+    let mut pact_json = header.pact.clone();
+    if let Some(pact) = pact_json.as_object_mut() {
+      pact.insert(header.attribute.clone(), Value::Array(interactions));
+    }
+    let pact = load_pact_from_json(&*path.to_string_lossy(), &pact_json)?;
+
+    debug!("Writing pact file {:?} with {} interaction(s) from the journal", path, entries.len());
+    write_pact(pact, path, header.specification, overwrite)?;
+
+    fs::remove_file(&index_path)?;
+    fs::remove_file(&journal_path)?;
+    Ok(true)
+  })
+}
+
+/// Writes out all the pact files in the directory that have journals, using `finalise_pact`.
+/// Returns the number of pact files written.
+pub fn finalise_pacts_in_dir(dir: &Path, overwrite: bool) -> anyhow::Result<usize> {
+  let suffix = format!(".{}", JOURNAL_EXTENSION);
+  let mut count = 0;
+  for entry in fs::read_dir(dir)? {
+    let entry = entry?;
+    let file_name = entry.file_name().to_string_lossy().to_string();
+    if let Some(pact_file_name) = file_name.strip_suffix(suffix.as_str()) {
+      if finalise_pact(&dir.join(pact_file_name), overwrite)? {
+        count += 1;
+      }
+    }
+  }
+  Ok(count)
+}
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+  use maplit::hashmap;
+  use serde_json::json;
+
+  use pact_models::{Consumer, Provider};
+  use pact_models::provider_states::ProviderState;
+  use pact_models::request::Request;
+
+  use crate::models::{read_pact, RequestResponseInteraction, RequestResponsePact};
+
+  use super::*;
+
+  fn pact_with(interactions: Vec<RequestResponseInteraction>) -> RequestResponsePact {
+    RequestResponsePact {
+      consumer: Consumer { name: "journal_consumer".into() },
+      provider: Provider { name: "journal_provider".into() },
+      interactions,
+      .. RequestResponsePact::default()
+    }
+  }
+
+  fn interaction(description: &str, path: &str) -> RequestResponseInteraction {
+    RequestResponseInteraction {
+      description: description.into(),
+      request: Request { path: path.into(), .. Request::default() },
+      .. RequestResponseInteraction::default()
+    }
+  }
+
+  #[test]
+  fn appends_interactions_and_writes_the_pact_file_once() {
+    let dir = std::env::temp_dir().join("pact_journal_appends_interactions");
+    let _ = fs::remove_dir_all(&dir);
+    let path = dir.join("journal_consumer-journal_provider.json");
+
+    let pact1 = pact_with(vec![interaction("first", "/one")]);
+    let pact2 = pact_with(vec![interaction("first", "/one"), interaction("second", "/two")]);
+    expect!(append_pact(&pact1, &path, PactSpecification::V3)).to(be_ok());
+    expect!(append_pact(&pact2, &path, PactSpecification::V3)).to(be_ok());
+    expect!(path.exists()).to(be_false());
+
+    expect!(finalise_pacts_in_dir(&dir, false).unwrap()).to(be_equal_to(1));
+    expect!(sidecar_path(&path, JOURNAL_EXTENSION).exists()).to(be_false());
+    expect!(sidecar_path(&path, INDEX_EXTENSION).exists()).to(be_false());
+
+    let pact = read_pact(&path).unwrap();
+    let descriptions = pact.interactions().iter()
+      .map(|interaction| interaction.description())
+      .collect::<Vec<String>>();
+    expect!(descriptions).to(be_equal_to(vec!["first".to_string(), "second".to_string()]));
+    expect!(finalise_pact(&path, false).unwrap()).to(be_false());
+    expect!(sidecar_path(&path, LOCK_EXTENSION).exists()).to(be_true());
+
+    expect!(append_pact(&pact_with(vec![interaction("third", "/three")]), &path, PactSpecification::V3)).to(be_ok());
+    expect!(finalise_pact(&path, false).unwrap()).to(be_true());
+    expect!(read_pact(&path).unwrap().interactions().len()).to(be_equal_to(3));
+
+    let _ = fs::remove_dir_all(&dir);
+  }
+
+  #[test]
+  fn interactions_with_different_provider_state_parameters_are_kept() {
+    let dir = std::env::temp_dir().join("pact_journal_provider_state_parameters");
+    let _ = fs::remove_dir_all(&dir);
+    let path = dir.join("journal_consumer-journal_provider.json");
+    let with_state = |id: i64, path: &str| RequestResponseInteraction {
+      provider_states: vec![ProviderState {
+        name: "an item exists".into(),
+        params: hashmap!{ "id".to_string() => json!(id) }
+      }],
+      .. interaction("get an item", path)
+    };
+
+    expect!(append_pact(&pact_with(vec![with_state(1, "/items/1")]), &path, PactSpecification::V3)).to(be_ok());
+    expect!(append_pact(&pact_with(vec![with_state(2, "/items/2")]), &path, PactSpecification::V3)).to(be_ok());
+    expect!(append_pact(&pact_with(vec![with_state(2, "/items/two")]), &path, PactSpecification::V3)).to(be_err());
+    expect!(finalise_pact(&path, false).unwrap()).to(be_true());
+    expect!(read_pact(&path).unwrap().interactions().len()).to(be_equal_to(2));
+
+    let _ = fs::remove_dir_all(&dir);
+  }
+
+  #[test]
+  fn append_fails_for_conflicting_interactions() {
+    let dir = std::env::temp_dir().join("pact_journal_conflicting_interactions");
+    let _ = fs::remove_dir_all(&dir);
+    let path = dir.join("journal_consumer-journal_provider.json");
+
+    expect!(append_pact(&pact_with(vec![interaction("first", "/one")]), &path, PactSpecification::V3)).to(be_ok());
+    expect!(append_pact(&pact_with(vec![interaction("first", "/two")]), &path, PactSpecification::V3)).to(be_err());
+    expect!(append_pact(&pact_with(vec![interaction("second", "/two")]), &path, PactSpecification::V2)).to(be_err());
+
+    let _ = fs::remove_dir_all(&dir);
+  }
+}
@@ -6,7 +6,6 @@ use std::str::{self, from_utf8};
 
 use anyhow::anyhow;
 use log::*;
-use onig::Regex;
 use serde_json::{self, json, Value};
 
 use pact_models::matchingrules::{MatchingRule, MatchingRuleCategory};
@@ -14,12 +13,13 @@ use pact_models::matchingrules::{MatchingRule, MatchingRuleCategory};
 use crate::{MatchingContext, merge_result, Mismatch};
 use crate::binary_utils::match_content_type;
 use crate::matchers::{match_values, Matches};
+use crate::regex_cache::cached_regex;
 
 impl <T: Debug + Display + PartialEq + Clone> Matches<&Vec<T>> for &Vec<T> {
   fn matches_with(&self, actual: &Vec<T>, matcher: &MatchingRule) -> anyhow::Result<()> {
     let result = match matcher {
       MatchingRule::Regex(ref regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             let text: String = actual.iter().map(|v| v.to_string()).collect();
             if re.is_match(text.as_str()) {
@@ -73,7 +73,7 @@ impl Matches<&[u8]> for Vec<u8> {
   fn matches_with(&self, actual: &[u8], matcher: &MatchingRule) -> anyhow::Result<()> {
     let result = match matcher {
       MatchingRule::Regex(regex) => {
-        match Regex::new(regex) {
+        match cached_regex(regex) {
           Ok(re) => {
             let text = from_utf8(actual).unwrap_or_default();
             if re.is_match(text) {
@@ -469,6 +469,7 @@ pub trait Pact: Debug + ReadWritePact {
 pub mod message;
 pub mod message_pact;
 pub mod v4;
+pub mod journal;
 
 /// Struct that represents a pact between the consumer and provider of a service.
 #[derive(Debug, Clone, Default, PartialEq)]
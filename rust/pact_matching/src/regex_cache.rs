@@ -0,0 +1,56 @@
+//! Process-wide cache of compiled regular expressions. Matching rules are evaluated for every
+//! value they apply to (i.e. each item of an `eachLike` array), so the same pattern would otherwise
+//! be recompiled many times per request.
+
+use std::collections::HashMap;
+use std::sync::{Arc, RwLock};
+
+use lazy_static::lazy_static;
+use onig::Regex;
+
+/// Maximum number of distinct patterns that will be kept in the cache. Once the cache is full it
+/// is cleared before the next new pattern is added.
+pub const MAX_CACHED_REGEXES: usize = 1024;
+
+lazy_static! {
+  static ref REGEX_CACHE: RwLock<HashMap<String, Arc<Regex>>> = RwLock::new(HashMap::new());
+}
+
+/// Returns the compiled regular expression for the pattern, compiling and caching it if it has
+/// not been seen before. Patterns that fail to compile are not cached.
+pub fn cached_regex(pattern: &str) -> Result<Arc<Regex>, onig::Error> {
+  if let Some(re) = REGEX_CACHE.read().ok().and_then(|cache| cache.get(pattern).cloned()) {
+    return Ok(re);
+  }
+
+  let re = Arc::new(Regex::new(pattern)?);
+  if let Ok(mut cache) = REGEX_CACHE.write() {
+    if cache.len() >= MAX_CACHED_REGEXES && !cache.contains_key(pattern) {
+      cache.clear();
+    }
+    cache.insert(pattern.to_string(), re.clone());
+  }
+  Ok(re)
+}
+
+#[cfg(test)]
+mod tests {
+  use std::sync::Arc;
+
+  use expectest::prelude::*;
+
+  use super::*;
+
+  #[test]
+  fn cached_regex_returns_the_same_compiled_regex_for_a_pattern() {
+    let re1 = cached_regex("^cached-[0-9]+$").unwrap();
+    let re2 = cached_regex("^cached-[0-9]+$").unwrap();
+    expect!(Arc::ptr_eq(&re1, &re2)).to(be_true());
+    expect!(re1.is_match("cached-100")).to(be_true());
+  }
+
+  #[test]
+  fn cached_regex_returns_an_error_for_an_invalid_pattern() {
+    expect!(cached_regex("[invalid").is_err()).to(be_true());
+  }
+}
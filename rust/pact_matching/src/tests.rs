@@ -635,3 +635,52 @@ fn values_matcher_defined() {
   expect!(context.values_matcher_defined(&["$", "x", "0", "z"])).to(be_false());
   expect!(context.values_matcher_defined(&["$", "y", "0", "y"])).to(be_false());
 }
+
+#[test]
+fn match_request_ref_returns_the_same_result_as_match_request() {
+  let expected = Request {
+    method: s!("POST"),
+    path: s!("/path"),
+    query: Some(hashmap! { s!("a") => vec![s!("b")] }),
+    headers: Some(hashmap! { s!("Content-Type") => vec![s!("application/json")] }),
+    body: OptionalBody::Present(Bytes::from("{\"a\": 100}"), None),
+    ..Request::default()
+  };
+  let actual = Request {
+    method: s!("POST"),
+    path: s!("/path"),
+    query: Some(hashmap! { s!("a") => vec![s!("c")] }),
+    headers: Some(hashmap! { s!("content-type") => vec![s!("application/json")] }),
+    body: OptionalBody::Present(Bytes::from("{\"a\": 200}"), None),
+    ..Request::default()
+  };
+  let result = match_request_ref(&expected, &actual);
+  expect!(result.clone()).to(be_equal_to(match_request(expected.clone(), actual.clone())));
+  expect!(result.all_matched()).to(be_false());
+  expect!(result.headers.values().all(|m| m.is_empty())).to(be_true());
+}
+
+#[test]
+fn request_match_ranking_does_not_depend_on_the_number_of_mismatches() {
+  let expected = Request {
+    method: s!("POST"),
+    path: s!("/path"),
+    headers: Some(hashmap! { s!("Content-Type") => vec![s!("application/json")] }),
+    body: OptionalBody::Present(Bytes::from("{\"a\": 1, \"b\": 2}"), None),
+    ..Request::default()
+  };
+  let one_mismatch = Request {
+    body: OptionalBody::Present(Bytes::from("{\"a\": 1, \"b\": 3}"), None),
+    ..expected.clone()
+  };
+  let two_mismatches = Request {
+    body: OptionalBody::Present(Bytes::from("{\"a\": 2, \"b\": 3}"), None),
+    ..expected.clone()
+  };
+  let wrong_path = Request { path: s!("/other"), ..expected.clone() };
+
+  let ranking = |actual: &Request| match_request_ref(&expected, actual).ranking();
+  expect!(ranking(&one_mismatch)).to(be_equal_to(ranking(&two_mismatches)));
+  expect!(ranking(&expected)).to(be_greater_than(ranking(&one_mismatch)));
+  expect!(ranking(&one_mismatch)).to(be_greater_than(ranking(&wrong_path)));
+}
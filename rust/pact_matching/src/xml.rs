@@ -5,7 +5,9 @@ use bytes::Bytes;
 use itertools::{EitherOrBoth, Itertools};
 use log::*;
 use maplit::*;
-use onig::Regex;
+use quick_xml::events::Event;
+use quick_xml::name::{Namespace, ResolveResult};
+use quick_xml::NsReader;
 use sxd_document::dom::*;
 use sxd_document::QName;
 
@@ -16,6 +18,7 @@ use pact_models::xml_utils::parse_bytes;
 
 use crate::matchers::*;
 use crate::MatchingContext;
+use crate::regex_cache::cached_regex;
 
 use super::DiffConfig;
 use super::Mismatch;
@@ -27,6 +30,17 @@ pub fn match_xml(expected: &dyn HttpPart, actual: &dyn HttpPart, context: &Match
     (OptionalBody::Empty, _) => (),
     (OptionalBody::Null, _) => (),
     (OptionalBody::Present(expected_body, _), OptionalBody::Present(actual_body, _)) => {
+      // The streaming comparison only keeps the elements that are open in memory. It stops at the
+      // first mismatch, so it is only used when that is all that is needed. Otherwise the bodies
+      // are parsed into documents straight away, rather than being read twice.
+      if context.early_exit {
+        match compare_streaming(expected_body, actual_body, context) {
+          StreamingResult::Matched => return Ok(()),
+          StreamingResult::Mismatched(found) => return Err(found),
+          StreamingResult::Undecided => ()
+        }
+      }
+
       let expected_result = parse_bytes(expected_body);
       let actual_result = parse_bytes(actual_body);
 
@@ -93,7 +107,7 @@ impl<'a> Matches<&'a Element<'a>> for &'a Element<'a> {
     fn matches_with(&self, actual: &Element, matcher: &MatchingRule) -> anyhow::Result<()> {
         let result = match *matcher {
           MatchingRule::Regex(ref regex) => {
-            match Regex::new(regex) {
+            match cached_regex(regex) {
               Ok(re) => {
                 if re.is_match(actual.name().local_part()) {
                   Ok(())
@@ -186,6 +200,12 @@ fn compare_attributes(path: &Vec<&str>, expected: &Element, actual: &Element,
         .iter().map(|attr| (name(attr.name()), s!(attr.value()))).collect();
     let actual_attributes: BTreeMap<String, String> = actual.attributes()
         .iter().map(|attr| (name(attr.name()), s!(attr.value()))).collect();
+    compare_attribute_maps(path, &expected_attributes, &actual_attributes, mismatches, context);
+}
+
+fn compare_attribute_maps(path: &Vec<&str>, expected_attributes: &BTreeMap<String, String>,
+    actual_attributes: &BTreeMap<String, String>, mismatches: &mut Vec<super::Mismatch>,
+    context: &MatchingContext) {
     if expected_attributes.is_empty() && !actual_attributes.is_empty() && context.config == DiffConfig::NoUnexpectedKeys {
       mismatches.push(Mismatch::BodyMismatch { path: path_to_string(path),
           expected: Some(format!("{:?}", expected_attributes).into()),
@@ -332,6 +352,11 @@ fn compare_text(path: &Vec<&str>, expected: &Element, actual: &Element,
         .filter(|child| child.text().is_some())
         .map(|child| child.text().unwrap().text().trim())
         .collect::<String>();
+    compare_text_values(path, &expected_text, &actual_text, mismatches, context);
+}
+
+fn compare_text_values(path: &Vec<&str>, expected_text: &String, actual_text: &String,
+    mismatches: &mut Vec<super::Mismatch>, context: &MatchingContext) {
     let mut p = path.to_vec();
     p.push("#text");
     let matcher_result = if context.matcher_is_defined(&p) {
@@ -376,6 +401,234 @@ fn compare_value(path: &Vec<&str>, expected: &String, actual: &String, context:
   })
 }
 
+/// Result of comparing XML bodies with the streaming reader
+enum StreamingResult {
+  /// The bodies matched
+  Matched,
+  /// The bodies did not match. Only the first mismatch found is returned.
+  Mismatched(Vec<Mismatch>),
+  /// The result could not be determined by walking the bodies in lockstep, so they need to be
+  /// compared as documents. This is the case when the children are not in the same order, or
+  /// the body can not be read by the streaming reader.
+  Undecided
+}
+
+/// Element, text and end events read from an XML body, with names resolved in the same form as
+/// `name`
+enum XmlEvent {
+  Start(String, BTreeMap<String, String>),
+  Text(String),
+  End,
+  Eof
+}
+
+/// Pull reader over an XML body that only keeps the currently open elements in memory
+struct XmlEventReader<'a> {
+  reader: NsReader<&'a [u8]>
+}
+
+impl<'a> XmlEventReader<'a> {
+  fn new(xml: &'a [u8]) -> Self {
+    let mut reader = NsReader::from_reader(xml);
+    reader.config_mut().expand_empty_elements = true;
+    XmlEventReader { reader }
+  }
+
+  /// Returns the next event, or None if the body could not be read. Document type declarations
+  /// are not supported, as they can declare entities.
+  fn next(&mut self) -> Option<XmlEvent> {
+    loop {
+      let (resolved, event) = self.reader.read_resolved_event().ok()?;
+      match event {
+        Event::Start(start) => {
+          let element_name = resolved_name(resolved, start.local_name().as_ref())?;
+          let mut attributes = BTreeMap::new();
+          for attr in start.attributes() {
+            let attr = attr.ok()?;
+            if attr.key.as_namespace_binding().is_none() {
+              let (resolved, local_name) = self.reader.resolve_attribute(attr.key);
+              let key = resolved_name(resolved, local_name.as_ref())?;
+              attributes.insert(key, attr.unescape_value().ok()?.to_string());
+            }
+          }
+          return Some(XmlEvent::Start(element_name, attributes));
+        },
+        Event::Text(text) => return Some(XmlEvent::Text(text.unescape().ok()?.trim().to_string())),
+        Event::CData(data) => {
+          let data = data.into_inner();
+          return Some(XmlEvent::Text(std::str::from_utf8(&data).ok()?.trim().to_string()));
+        },
+        Event::End(_) => return Some(XmlEvent::End),
+        Event::Eof => return Some(XmlEvent::Eof),
+        Event::DocType(_) => return None,
+        _ => ()
+      }
+    }
+  }
+
+  /// Returns the next start or end event, appending any text before it
+  fn next_tag(&mut self, text: &mut String) -> Option<XmlEvent> {
+    loop {
+      match self.next()? {
+        XmlEvent::Text(t) => text.push_str(&t),
+        event => return Some(event)
+      }
+    }
+  }
+}
+
+fn resolved_name(resolved: ResolveResult, local_name: &[u8]) -> Option<String> {
+  let local_name = std::str::from_utf8(local_name).ok()?;
+  match resolved {
+    ResolveResult::Bound(Namespace(namespace)) =>
+      Some(format!("{}:{}", std::str::from_utf8(namespace).ok()?, local_name)),
+    ResolveResult::Unbound => Some(local_name.to_string()),
+    ResolveResult::Unknown(_) => None
+  }
+}
+
+/// Compares the XML bodies by walking them in lockstep, so that memory use is proportional to the
+/// nesting depth and not the size of the bodies. Matching rules are applied to the elements,
+/// attributes and text in the same way as `compare_element`. Rules that need the whole element
+/// (the number of children, or children that are matched by type against the first expected one)
+/// make the result undecided, so the bodies are then compared as documents.
+fn compare_streaming(expected: &[u8], actual: &[u8], context: &MatchingContext) -> StreamingResult {
+  let mut expected_reader = XmlEventReader::new(expected);
+  let mut actual_reader = XmlEventReader::new(actual);
+  let mut text = String::new();
+  let result = match (expected_reader.next_tag(&mut text), actual_reader.next_tag(&mut text)) {
+    (Some(XmlEvent::Start(expected_name, expected_attributes)), Some(XmlEvent::Start(actual_name, actual_attributes))) => {
+      let path = vec!["$", expected_name.as_str()];
+      let mut mismatches = vec![];
+      match compare_streaming_element(&path, (&expected_name, &expected_attributes),
+        (&actual_name, &actual_attributes), &mut expected_reader, &mut actual_reader,
+        &mut mismatches, context) {
+        Some(true) => StreamingResult::Matched,
+        Some(false) => return StreamingResult::Mismatched(mismatches),
+        None => return StreamingResult::Undecided
+      }
+    },
+    _ => return StreamingResult::Undecided
+  };
+
+  // Anything after the root element needs to be checked, as the documents would fail to parse
+  // if it was invalid
+  match (expected_reader.next_tag(&mut text), actual_reader.next_tag(&mut text)) {
+    (Some(XmlEvent::Eof), Some(XmlEvent::Eof)) if text.is_empty() => result,
+    _ => StreamingResult::Undecided
+  }
+}
+
+/// Name of an element read by the streaming reader, for applying the matching rules defined for
+/// the element. Only the rules that can be applied to the name are supported.
+struct StreamedElement<'a>(&'a String);
+
+impl<'a> StreamedElement<'a> {
+  /// Name without the namespace, in the same way as `local_part` of a document element
+  fn local_part(&self) -> &str {
+    self.0.rsplit(':').next().unwrap_or_default()
+  }
+}
+
+impl<'a> Matches<&'a StreamedElement<'a>> for &'a StreamedElement<'a> {
+  fn matches_with(&self, actual: &StreamedElement, matcher: &MatchingRule) -> anyhow::Result<()> {
+    let result = match *matcher {
+      MatchingRule::Regex(ref regex) => match cached_regex(regex) {
+        Ok(re) => if re.is_match(actual.local_part()) {
+          Ok(())
+        } else {
+          Err(anyhow!("Expected '{}' to match '{}'", actual.0, regex))
+        },
+        Err(err) => Err(anyhow!("'{}' is not a valid regular expression - {}", regex, err))
+      },
+      MatchingRule::Type => if self.0 == actual.0 {
+        Ok(())
+      } else {
+        Err(anyhow!("Expected '{}' to be the same type as '{}'", self.0, actual.0))
+      },
+      MatchingRule::Equality => if self.0 == actual.0 {
+        Ok(())
+      } else {
+        Err(anyhow!("Expected '{}' to be equal to '{}'", self.0, actual.0))
+      },
+      _ => Err(anyhow!("Unable to match '{}' using {:?}", self.0, matcher))
+    };
+    debug!("Comparing '{}' to '{}' using {:?} -> {:?}", self.0, actual.0, matcher, result);
+    result
+  }
+}
+
+/// Compares the elements and their children. Returns Some(true) if they match, Some(false) with
+/// the first mismatch added if they do not, and None if they need to be compared as documents.
+fn compare_streaming_element(
+  path: &Vec<&str>,
+  expected: (&String, &BTreeMap<String, String>),
+  actual: (&String, &BTreeMap<String, String>),
+  expected_reader: &mut XmlEventReader,
+  actual_reader: &mut XmlEventReader,
+  mismatches: &mut Vec<Mismatch>,
+  context: &MatchingContext
+) -> Option<bool> {
+  let expected_element = StreamedElement(expected.0);
+  let actual_element = StreamedElement(actual.0);
+  let matcher_result = if context.matcher_is_defined(path) {
+    let needs_children = context.select_best_matcher(path)
+      .map(|rules| rules.rules.iter().any(|rule| match rule {
+        MatchingRule::MinType(_) | MatchingRule::MaxType(_) | MatchingRule::MinMaxType(_, _) => true,
+        _ => false
+      }))
+      .unwrap_or(false);
+    if needs_children {
+      return None;
+    }
+    match_values(path, context, &expected_element, &actual_element)
+  } else {
+    (&expected_element).matches_with(&actual_element, &MatchingRule::Equality)
+      .map_err(|err| vec![err.to_string()])
+  };
+  if let Err(messages) = matcher_result {
+    for message in messages {
+      mismatches.push(Mismatch::BodyMismatch {
+        path: path_to_string(path),
+        expected: Some(expected.0.clone().into()),
+        actual: Some(actual.0.clone().into()),
+        mismatch: message
+      });
+    }
+    return Some(false);
+  }
+  compare_attribute_maps(path, expected.1, actual.1, mismatches, context);
+  if !mismatches.is_empty() {
+    return Some(false);
+  }
+
+  let mut expected_text = String::new();
+  let mut actual_text = String::new();
+  loop {
+    match (expected_reader.next_tag(&mut expected_text)?, actual_reader.next_tag(&mut actual_text)?) {
+      (XmlEvent::Start(expected_name, expected_attributes), XmlEvent::Start(actual_name, actual_attributes)) => {
+        if expected_name != actual_name {
+          return None;
+        }
+        let mut p = path.to_vec();
+        p.push(expected_name.as_str());
+        if context.type_matcher_defined(&p) {
+          return None;
+        }
+        if !compare_streaming_element(&p, (&expected_name, &expected_attributes),
+          (&actual_name, &actual_attributes), expected_reader, actual_reader, mismatches, context)? {
+          return Some(false);
+        }
+      },
+      (XmlEvent::End, XmlEvent::End) => break,
+      _ => return None
+    }
+  }
+
+  compare_text_values(path, &expected_text, &actual_text, mismatches, context);
+  Some(mismatches.is_empty())
+}
+
 #[cfg(test)]
 mod tests {
   use bytes::Bytes;
@@ -1142,4 +1395,79 @@ mod tests {
       }
     ]));
   }
+
+  #[test]
+  fn compare_streaming_matches_identical_bodies() {
+    let xml = r#"<?xml version="1.0" encoding="UTF-8"?>
+    <s:Envelope xmlns:s="urn:soap" version="1"><s:Body><item id="1">one &amp; two</item><item id="2"/></s:Body></s:Envelope>
+    "#;
+    let context = MatchingContext::with_config(DiffConfig::NoUnexpectedKeys);
+    expect!(matches!(compare_streaming(xml.as_bytes(), xml.as_bytes(), &context), StreamingResult::Matched)).to(be_true());
+  }
+
+  #[test]
+  fn compare_streaming_returns_the_first_mismatch() {
+    let expected = r#"<foo><item id="1">one</item><item id="2">two</item></foo>"#;
+    let actual = r#"<foo><item id="1">uno</item><item id="3">dos</item></foo>"#;
+    let context = MatchingContext::with_config(DiffConfig::NoUnexpectedKeys);
+    match compare_streaming(expected.as_bytes(), actual.as_bytes(), &context) {
+      StreamingResult::Mismatched(mismatches) => {
+        expect!(mismatches.len()).to(be_equal_to(1));
+        expect!(mismatches[0].clone()).to(be_equal_to(Mismatch::BodyMismatch {
+          path: "$.foo.item.#text".into(), expected: Some("one".into()), actual: Some("uno".into()),
+          mismatch: "Expected 'one' to be equal to 'uno'".into() }));
+      },
+      _ => panic!("Expected a mismatch")
+    }
+
+    let early_exit_context = context.clone().with_early_exit(true);
+    expect!(match_xml(&request!(expected), &request!(actual), &early_exit_context).unwrap_err().len()).to(be_equal_to(1));
+    expect!(match_xml(&request!(expected), &request!(actual), &context).unwrap_err().len()).to(be_greater_than(1));
+  }
+
+  #[test]
+  fn compare_streaming_applies_the_matching_rules_for_attributes_and_text() {
+    let expected = r#"<foo><item id="1">one</item><item id="2">two</item></foo>"#;
+    let actual = r#"<foo><item id="100">uno</item><item id="200">dos</item></foo>"#;
+    let context = MatchingContext::new(DiffConfig::NoUnexpectedKeys, &matchingrules!{
+      "body" => {
+        "$.foo.item['@id']" => [ MatchingRule::Regex(s!("\\d+")) ],
+        "$.foo.item['#text']" => [ MatchingRule::Regex(s!("[a-z]+")) ]
+      }
+    }.rules_for_category("body").unwrap());
+    expect!(matches!(compare_streaming(expected.as_bytes(), actual.as_bytes(), &context), StreamingResult::Matched)).to(be_true());
+
+    let actual = r#"<foo><item id="100">uno</item><item id="x">dos</item></foo>"#;
+    match compare_streaming(expected.as_bytes(), actual.as_bytes(), &context) {
+      StreamingResult::Mismatched(mismatches) => {
+        expect!(mismatches.len()).to(be_equal_to(1));
+        expect!(mismatches[0].clone()).to(be_equal_to(Mismatch::BodyMismatch {
+          path: "$.foo.item.@id".into(), expected: Some("2".into()), actual: Some("x".into()),
+          mismatch: "Expected 'x' to match '\\d+'".into() }));
+      },
+      _ => panic!("Expected a mismatch")
+    }
+  }
+
+  #[test]
+  fn compare_streaming_defers_to_documents_when_children_are_matched_by_type() {
+    let expected = r#"<foo><one/></foo>"#;
+    let actual = r#"<foo><one/><one/><one/></foo>"#;
+    let context = MatchingContext::new(DiffConfig::NoUnexpectedKeys, &matchingrules!{
+      "body" => {
+        "$.foo" => [ MatchingRule::Type ]
+      }
+    }.rules_for_category("body").unwrap()).with_early_exit(true);
+    expect!(matches!(compare_streaming(expected.as_bytes(), actual.as_bytes(), &context), StreamingResult::Undecided)).to(be_true());
+    expect!(match_xml(&request!(expected), &request!(actual), &context)).to(be_ok());
+  }
+
+  #[test]
+  fn compare_streaming_defers_to_documents_when_the_children_are_in_a_different_order() {
+    let expected = r#"<foo><a/><b/></foo>"#;
+    let actual = r#"<foo><b/><a/></foo>"#;
+    let context = MatchingContext::with_config(DiffConfig::NoUnexpectedKeys);
+    expect!(matches!(compare_streaming(expected.as_bytes(), actual.as_bytes(), &context), StreamingResult::Undecided)).to(be_true());
+    expect!(match_xml(&request!(expected), &request!(actual), &context)).to(be_ok());
+  }
 }
@@ -0,0 +1,56 @@
+//! Benchmarks for selecting and matching the interactions of a mock server for a request, with
+//! synthetic pacts of growing size.
+//!
+//! Run with `cargo bench -p pact_mock_server`. Criterion reports the cases that have regressed
+//! since the previous run, and `-- --save-baseline <name>` and `-- --baseline <name>` can be used
+//! to compare a change with a saved baseline instead.
+
+use std::hint::black_box;
+
+use criterion::{BenchmarkId, Criterion, criterion_group, criterion_main};
+use maplit::hashmap;
+
+use pact_matching::models::{RequestResponseInteraction, RequestResponsePact};
+use pact_mock_server::matching::InteractionIndex;
+use pact_models::bodies::OptionalBody;
+use pact_models::request::Request;
+
+fn request(path: String, body: String) -> Request {
+  Request {
+    method: "POST".to_string(),
+    path,
+    headers: Some(hashmap!{ "Content-Type".to_string() => vec!["application/json".to_string()] }),
+    body: OptionalBody::Present(body.into(), None),
+    .. Request::default()
+  }
+}
+
+/// Pact with interactions for `size` different paths, with 5 interactions for each path that
+/// differ only by their body
+fn pact(size: usize) -> RequestResponsePact {
+  let interactions = (0..size).flat_map(|path| (0..5).map(move |variant| RequestResponseInteraction {
+    description: format!("interaction {} {}", path, variant),
+    request: request(format!("/items/{}", path), format!(r#"{{"id": {}, "variant": {}}}"#, path, variant)),
+    .. RequestResponseInteraction::default()
+  })).collect();
+  RequestResponsePact { interactions, .. RequestResponsePact::default() }
+}
+
+fn bench_match_request(c: &mut Criterion) {
+  let mut group = c.benchmark_group("match_request");
+  for size in [10, 100, 1000].iter().cloned() {
+    let index = InteractionIndex::new(&pact(size));
+    let matching = request(format!("/items/{}", size / 2), format!(r#"{{"id": {}, "variant": 4}}"#, size / 2));
+    let mismatching = request(format!("/items/{}", size / 2), format!(r#"{{"id": {}, "variant": 9}}"#, size / 2));
+
+    for (name, req) in [("matched", &matching), ("mismatched", &mismatching)].iter() {
+      group.bench_with_input(BenchmarkId::new(*name, size), *req, |b, req| b.iter(|| {
+        black_box(index.match_request(req));
+      }));
+    }
+  }
+  group.finish();
+}
+
+criterion_group!(benches, bench_match_request);
+criterion_main!(benches);
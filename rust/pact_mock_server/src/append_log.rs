@@ -0,0 +1,190 @@
+//!
+//! Append-only log that can be appended to from any number of threads without taking a lock.
+//!
+
+use std::cell::UnsafeCell;
+use std::mem::MaybeUninit;
+use std::ptr;
+use std::sync::atomic::{AtomicBool, AtomicPtr, AtomicUsize, Ordering};
+
+/// Number of slots in the first segment. Each segment after it is twice the size of the one
+/// before, so the log never has to move values that have already been appended.
+const FIRST_SEGMENT: usize = 32;
+const FIRST_SEGMENT_BITS: usize = 5;
+const SEGMENTS: usize = std::mem::size_of::<usize>() * 8 - FIRST_SEGMENT_BITS;
+
+struct Slot<T> {
+  ready: AtomicBool,
+  value: UnsafeCell<MaybeUninit<T>>
+}
+
+/// Append-only log of values. Appending reserves the next index with an atomic increment and
+/// writes the value into its slot, so appending never waits on another thread. Reading a value
+/// that is still being written waits for the write to finish.
+pub(crate) struct AppendLog<T> {
+  segments: Vec<AtomicPtr<Slot<T>>>,
+  reserved: AtomicUsize
+}
+
+unsafe impl<T: Send> Send for AppendLog<T> {}
+unsafe impl<T: Send + Sync> Sync for AppendLog<T> {}
+
+/// Returns the segment and the offset in the segment for the index
+fn location(index: usize) -> (usize, usize) {
+  let position = index + FIRST_SEGMENT;
+  let segment = (std::mem::size_of::<usize>() * 8 - 1 - position.leading_zeros() as usize) - FIRST_SEGMENT_BITS;
+  (segment, position - (FIRST_SEGMENT << segment))
+}
+
+fn segment_len(segment: usize) -> usize {
+  FIRST_SEGMENT << segment
+}
+
+impl<T> AppendLog<T> {
+  /// Creates a new empty log
+  pub fn new() -> Self {
+    AppendLog {
+      segments: (0..SEGMENTS).map(|_| AtomicPtr::new(ptr::null_mut())).collect(),
+      reserved: AtomicUsize::new(0)
+    }
+  }
+
+  /// Appends the value to the log, returning its index
+  pub fn push(&self, value: T) -> usize {
+    let index = self.reserved.fetch_add(1, Ordering::AcqRel);
+    let (segment, offset) = location(index);
+    let slot = unsafe { &*self.segment(segment).add(offset) };
+    unsafe { ptr::write(slot.value.get(), MaybeUninit::new(value)) };
+    slot.ready.store(true, Ordering::Release);
+    index
+  }
+
+  /// Number of values appended to the log, including any that are still being written
+  pub fn len(&self) -> usize {
+    self.reserved.load(Ordering::Acquire)
+  }
+
+  /// Returns the value at the index, waiting for it to be written if it is still being appended
+  pub fn get(&self, index: usize) -> Option<&T> {
+    if index >= self.len() {
+      return None;
+    }
+    let (segment, offset) = location(index);
+    let slot = unsafe { &*self.segment(segment).add(offset) };
+    while !slot.ready.load(Ordering::Acquire) {
+      std::thread::yield_now();
+    }
+    Some(unsafe { &*(*slot.value.get()).as_ptr() })
+  }
+
+  /// Iterates over the values appended before this was called, starting from the index
+  pub fn iter_from(&self, index: usize) -> impl Iterator<Item = &T> + '_ {
+    let len = self.len();
+    (index..len).filter_map(move |i| self.get(i))
+  }
+
+  /// Returns the segment, allocating it if no thread has yet
+  fn segment(&self, segment: usize) -> *mut Slot<T> {
+    let current = self.segments[segment].load(Ordering::Acquire);
+    if !current.is_null() {
+      return current;
+    }
+    let slots: Box<[Slot<T>]> = (0..segment_len(segment))
+      .map(|_| Slot { ready: AtomicBool::new(false), value: UnsafeCell::new(MaybeUninit::uninit()) })
+      .collect();
+    let allocated = Box::into_raw(slots) as *mut Slot<T>;
+    match self.segments[segment].compare_exchange(ptr::null_mut(), allocated, Ordering::AcqRel, Ordering::Acquire) {
+      Ok(_) => allocated,
+      Err(existing) => {
+        unsafe { drop(Box::from_raw(ptr::slice_from_raw_parts_mut(allocated, segment_len(segment)))) };
+        existing
+      }
+    }
+  }
+}
+
+impl<T> Default for AppendLog<T> {
+  fn default() -> Self {
+    AppendLog::new()
+  }
+}
+
+impl<T> Drop for AppendLog<T> {
+  fn drop(&mut self) {
+    for (segment, pointer) in self.segments.iter_mut().enumerate() {
+      let pointer = *pointer.get_mut();
+      if pointer.is_null() {
+        continue;
+      }
+      let mut slots = unsafe { Box::from_raw(ptr::slice_from_raw_parts_mut(pointer, segment_len(segment))) };
+      for slot in slots.iter_mut() {
+        if *slot.ready.get_mut() {
+          unsafe { ptr::drop_in_place((*slot.value.get()).as_mut_ptr()) };
+        }
+      }
+    }
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use std::sync::Arc;
+  use std::thread;
+
+  use expectest::prelude::*;
+
+  use super::*;
+
+  #[test]
+  fn location_test() {
+    expect!(location(0)).to(be_equal_to((0, 0)));
+    expect!(location(31)).to(be_equal_to((0, 31)));
+    expect!(location(32)).to(be_equal_to((1, 0)));
+    expect!(location(95)).to(be_equal_to((1, 63)));
+    expect!(location(96)).to(be_equal_to((2, 0)));
+  }
+
+  #[test]
+  fn push_returns_the_index_of_the_value() {
+    let log = AppendLog::new();
+    for i in 0..100 {
+      expect!(log.push(i.to_string())).to(be_equal_to(i));
+    }
+    expect!(log.len()).to(be_equal_to(100));
+    expect!(log.get(64)).to(be_some().value(&"64".to_string()));
+    expect!(log.get(100)).to(be_none());
+    expect!(log.iter_from(98).cloned().collect::<Vec<_>>()).to(be_equal_to(vec!["98".to_string(), "99".to_string()]));
+  }
+
+  #[test]
+  fn values_can_be_pushed_from_many_threads() {
+    let log = Arc::new(AppendLog::new());
+    let threads: Vec<_> = (0..8).map(|t| {
+      let log = log.clone();
+      thread::spawn(move || {
+        for i in 0..1000 {
+          log.push(t * 1000 + i);
+        }
+      })
+    }).collect();
+    for thread in threads {
+      thread.join().unwrap();
+    }
+    let mut values: Vec<usize> = log.iter_from(0).cloned().collect();
+    values.sort();
+    expect!(values).to(be_equal_to((0..8000).collect::<Vec<_>>()));
+  }
+
+  #[test]
+  fn dropping_the_log_drops_the_values() {
+    let value = Arc::new(());
+    {
+      let log = AppendLog::new();
+      for _ in 0..40 {
+        log.push(value.clone());
+      }
+      expect!(Arc::strong_count(&value)).to(be_equal_to(41));
+    }
+    expect!(Arc::strong_count(&value)).to(be_equal_to(1));
+  }
+}
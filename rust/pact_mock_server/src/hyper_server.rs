@@ -1,15 +1,18 @@
-use std::borrow::BorrowMut;
 use std::collections::HashMap;
 use std::io;
 use std::net::SocketAddr;
 use std::pin::Pin;
-use std::sync::{Arc, Mutex};
+use std::sync::Arc;
+use std::sync::atomic::Ordering;
+use std::time::Instant;
 
 use futures::prelude::*;
 use futures::StreamExt;
 use futures::task::{Context, Poll};
-use hyper::{Body, Error, Response, Server};
-use hyper::http::header::{HeaderName, HeaderValue};
+use bytes::Bytes;
+use hyper::{Body, Error, Response, Server, StatusCode};
+use hyper::body::HttpBody;
+use hyper::http::header::{HeaderMap, HeaderName, HeaderValue};
 use hyper::http::response::Builder as ResponseBuilder;
 use hyper::service::make_service_fn;
 use hyper::service::service_fn;
@@ -21,16 +24,46 @@ use tokio::net::{TcpListener, TcpStream};
 use tokio_rustls::server::TlsStream;
 use tokio_rustls::TlsAcceptor;
 
+use pact_matching::headers::NormalisedHeaders;
 use pact_matching::logging::LOG_ID;
-use pact_matching::models::{Pact, RequestResponsePact};
 use pact_models::bodies::OptionalBody;
 use pact_models::generators::GeneratorTestMode;
 use pact_models::http_parts::HttpPart;
 use pact_models::query_strings::parse_query_string;
 use pact_models::request::Request;
 
-use crate::matching::{match_request, MatchResult};
-use crate::mock_server::MockServer;
+use crate::matching::MatchResult;
+use crate::metrics::{MetricsCounters, RequestSample};
+use crate::mock_server::{HttpProtocols, MockServerConfig, MockServerScheme, server_url, SharedSession};
+
+/// Details of a bound mock server that the request handler needs. This is built once the server
+/// is bound and is read-only from then on, apart from the metrics counters and match log which
+/// can be updated without a lock, and the session which is replaced when the mock server is reset.
+struct ServerContext {
+  session: SharedSession,
+  metrics: Arc<MetricsCounters>,
+  config: MockServerConfig,
+  url: String,
+  port: u16
+}
+
+impl ServerContext {
+  fn new(
+    session: SharedSession,
+    metrics: Arc<MetricsCounters>,
+    config: &MockServerConfig,
+    scheme: MockServerScheme,
+    socket_addr: &SocketAddr
+  ) -> Self {
+    ServerContext {
+      session,
+      metrics,
+      config: config.clone(),
+      url: server_url(&scheme, socket_addr.ip().to_string().as_str(), socket_addr.port()),
+      port: socket_addr.port()
+    }
+  }
+}
 
 #[derive(Debug, Clone)]
 enum InteractionError {
@@ -57,35 +90,28 @@ fn extract_query_string(uri: &hyper::Uri) -> Option<HashMap<String, Vec<String>>
     .and_then(|query| parse_query_string(query))
 }
 
-fn extract_headers(headers: &hyper::HeaderMap) -> Result<Option<HashMap<String, Vec<String>>>, InteractionError> {
-  if !headers.is_empty() {
-    let result: Result<HashMap<String, Vec<String>>, InteractionError> = headers.keys()
-      .map(|name| -> Result<(String, Vec<String>), InteractionError> {
-        let values = headers.get_all(name);
-        let parsed_vals: Vec<Result<String, InteractionError>> = values.iter()
-          .map(|val| val.to_str()
-            .map(|v| v.to_string())
-            .map_err(|err| {
-              warn!("Failed to parse HTTP header value: {}", err);
-              InteractionError::RequestHeaderEncodingError
-            })
-          ).collect();
-        if parsed_vals.iter().find(|val| val.is_err()).is_some() {
-          Err(InteractionError::RequestHeaderEncodingError)
-        } else {
-          Ok((name.as_str().into(), parsed_vals.iter().cloned()
-            .map(|val| val.unwrap_or_default())
-            .flat_map(|val| val.split(",").map(|v| v.to_string()).collect::<Vec<String>>())
-            .map(|val| val.trim().to_string())
-            .collect()))
-        }
-      })
-      .collect();
+/// Extracts the headers in one pass over the header map, normalised for matching. This is the only
+/// time the headers of a request are normalised, the headers of the Pact request are taken from
+/// these. Hyper gives the header names in lower case, so the names of the extracted headers are
+/// all lower case as well.
+fn extract_headers(headers: &hyper::HeaderMap) -> Result<Option<NormalisedHeaders>, InteractionError> {
+  if headers.is_empty() {
+    return Ok(None);
+  }
 
-    result.map(|map| Some(map))
-  } else {
-    Ok(None)
+  let mut result = Vec::with_capacity(headers.keys_len());
+  for name in headers.keys() {
+    let mut values = vec![];
+    for value in headers.get_all(name) {
+      let value = value.to_str().map_err(|err| {
+        warn!("Failed to parse HTTP header value: {}", err);
+        InteractionError::RequestHeaderEncodingError
+      })?;
+      values.extend(value.split(',').map(|v| v.trim().to_string()));
+    }
+    result.push((name.as_str().to_string(), values));
   }
+  Ok(Some(NormalisedHeaders::from_pairs(result)))
 }
 
 fn extract_body(bytes: bytes::Bytes, request: &Request) -> OptionalBody {
@@ -96,44 +122,48 @@ fn extract_body(bytes: bytes::Bytes, request: &Request) -> OptionalBody {
     }
 }
 
-async fn hyper_request_to_pact_request(req: hyper::Request<Body>) -> Result<Request, InteractionError> {
+/// Converts the hyper request to a Pact request. The normalised headers of the request are
+/// returned with it, so they can be used to match the request.
+async fn hyper_request_to_pact_request(
+  req: hyper::Request<Body>
+) -> Result<(Request, Option<Arc<NormalisedHeaders>>), InteractionError> {
     let method = req.method().to_string();
     let path = extract_path(req.uri());
     let query = extract_query_string(req.uri());
-    let headers = extract_headers(req.headers())?;
+    let normalised_headers = extract_headers(req.headers())?.map(Arc::new);
+    let headers = normalised_headers.as_ref().map(|headers| headers.to_map());
 
     let body_bytes = hyper::body::to_bytes(req.into_body())
         .await
         .map_err(|_| InteractionError::RequestBodyError)?;
 
-    let request = Request {
+    let mut request = Request {
       method,
       path,
       query,
       headers,
       .. Request::default()
     };
+    request.body = extract_body(body_bytes, &request);
 
-    Ok(Request {
-      body: extract_body(body_bytes, &request),
-      .. request.clone()
-    })
+    Ok((request, normalised_headers))
 }
 
-fn set_hyper_headers(builder: &mut ResponseBuilder, headers: &Option<HashMap<String, Vec<String>>>) -> Result<(), InteractionError> {
+fn set_hyper_headers(builder: &mut ResponseBuilder, headers: Option<&NormalisedHeaders>) -> Result<(), InteractionError> {
     let hyper_headers = builder.headers_mut().unwrap();
     match headers {
-        Some(header_map) => {
-            for (k, v) in header_map {
+        Some(headers) => {
+            for (k, v) in headers.iter() {
+                // FIXME?: Headers are not sent in "raw" mode.
+                // Names are converted to lower case and values are parsed.
+                let name = HeaderName::from_bytes(k.as_bytes())
+                    .map_err(|err| {
+                        error!("Invalid header name '{}' ({})", k, err);
+                        InteractionError::ResponseHeaderEncodingError
+                    })?;
                 for val in v {
-                    // FIXME?: Headers are not sent in "raw" mode.
-                    // Names are converted to lower case and values are parsed.
                     hyper_headers.append(
-                        HeaderName::from_bytes(k.as_bytes())
-                            .map_err(|err| {
-                                error!("Invalid header name '{}' ({})", k, err);
-                                InteractionError::ResponseHeaderEncodingError
-                            })?,
+                        name.clone(),
                         val.parse::<HeaderValue>()
                             .map_err(|err| {
                                 error!("Invalid header value '{}': '{}' ({})", k, val, err);
@@ -148,6 +178,58 @@ fn set_hyper_headers(builder: &mut ResponseBuilder, headers: &Option<HashMap<Str
     Ok(())
 }
 
+/// Creates a builder for the response to a matched request, with the CORS headers set
+fn matched_response_builder(status: u16) -> ResponseBuilder {
+  Response::builder()
+    .status(status)
+    .header(hyper::header::ACCESS_CONTROL_ALLOW_ORIGIN, "*")
+    .header(hyper::header::ACCESS_CONTROL_ALLOW_HEADERS, "*")
+    .header(hyper::header::ACCESS_CONTROL_ALLOW_METHODS, "GET, HEAD, POST, PUT, DELETE, CONNECT, OPTIONS, TRACE, PATCH")
+    .header(hyper::header::ACCESS_CONTROL_EXPOSE_HEADERS, "Location, Link")
+}
+
+/// Response to an interaction that has no generators. As it will be the same for every request
+/// that matches the interaction, it is built once when the mock server starts, and only the
+/// headers and a reference to the body are cloned for each request.
+#[derive(Debug, Clone)]
+pub(crate) struct PreRenderedResponse {
+  status: StatusCode,
+  headers: HeaderMap,
+  body: Option<Bytes>
+}
+
+impl PreRenderedResponse {
+  /// Builds the response for the interaction. Returns None if the response has generators, or
+  /// can not be built, in which case it needs to be generated for each request.
+  pub(crate) fn new(response: &pact_models::response::Response) -> Option<Self> {
+    if response.generators.is_not_empty() {
+      return None;
+    }
+    let mut builder = matched_response_builder(response.status);
+    let headers = response.headers.as_ref().map(NormalisedHeaders::new);
+    set_hyper_headers(&mut builder, headers.as_ref()).ok()?;
+    let (parts, _) = builder.body(()).ok()?.into_parts();
+    Some(PreRenderedResponse {
+      status: parts.status,
+      headers: parts.headers,
+      body: match response.body {
+        OptionalBody::Present(ref b, _) => Some(b.clone()),
+        _ => None
+      }
+    })
+  }
+
+  fn to_response(&self) -> Response<Body> {
+    let mut response = Response::new(match self.body {
+      Some(ref b) => Body::from(b.clone()),
+      None => Body::empty()
+    });
+    *response.status_mut() = self.status;
+    *response.headers_mut() = self.headers.clone();
+    response
+  }
+}
+
 fn error_body(request: &Request, error: &String) -> String {
     let body = json!({ "error" : format!("{} : {:?}", error, request) });
     body.to_string()
@@ -156,37 +238,29 @@ fn error_body(request: &Request, error: &String) -> String {
 fn match_result_to_hyper_response(
   request: &Request,
   match_result: MatchResult,
-  mock_server: Arc<Mutex<MockServer>>
+  context: &ServerContext
 ) -> Result<Response<Body>, InteractionError> {
-  let cors_preflight = {
-    let ms = mock_server.lock().unwrap();
-    ms.config.cors_preflight
-  };
+  let cors_preflight = context.config.cors_preflight;
 
   match match_result {
     MatchResult::RequestMatch(_, ref response) => {
-      let ms = mock_server.lock().unwrap();
-      let context = hashmap!{
+      let test_context = hashmap!{
         "mockServer" => json!({
-          "href": ms.url(),
-          "port": ms.port
+          "href": context.url,
+          "port": context.port
         })
       };
-      debug!("Test context = {:?}", context);
-      let response = pact_matching::generate_response(response, &GeneratorTestMode::Consumer, &context);
+      debug!("Test context = {:?}", test_context);
+      let response = pact_matching::generate_response(response, &GeneratorTestMode::Consumer, &test_context);
       info!("Request matched, sending response {}", response);
       if response.has_text_body() {
         debug!("     body: '{}'", response.body.str_value());
       }
 
-      let mut builder = Response::builder()
-        .status(response.status)
-        .header(hyper::header::ACCESS_CONTROL_ALLOW_ORIGIN, "*")
-        .header(hyper::header::ACCESS_CONTROL_ALLOW_HEADERS, "*")
-        .header(hyper::header::ACCESS_CONTROL_ALLOW_METHODS, "GET, HEAD, POST, PUT, DELETE, CONNECT, OPTIONS, TRACE, PATCH")
-        .header(hyper::header::ACCESS_CONTROL_EXPOSE_HEADERS, "Location, Link");
+      let mut builder = matched_response_builder(response.status);
 
-      set_hyper_headers(&mut builder, &response.headers)?;
+      let headers = response.headers.as_ref().map(NormalisedHeaders::new);
+      set_hyper_headers(&mut builder, headers.as_ref())?;
 
       builder.body(match response.body {
         OptionalBody::Present(ref s, _) => Body::from(s.clone()),
@@ -198,18 +272,13 @@ fn match_result_to_hyper_response(
       debug!("Request did not match: {}", match_result);
       if cors_preflight && request.method.to_uppercase() == "OPTIONS" {
         info!("Responding to CORS pre-flight request");
-        let origin = match request.headers.clone() {
-          Some(ref h) => h.iter()
-            .find(|kv| kv.0.to_lowercase() == "referer")
-            .map(|kv| kv.1.clone().join(", ")).unwrap_or("*".to_string()),
-          None => "*".to_string()
-        };
-        let cors_headers = match request.headers.clone() {
-          Some(ref h) => h.iter()
-            .find(|kv| kv.0.to_lowercase() == "access-control-request-headers")
-            .map(|kv| kv.1.clone().join(", ") + ", *").unwrap_or("*".to_string()),
-          None => "*".to_string()
-        };
+        // The header names of the request are lower case, so they can be looked up directly
+        let origin = request.headers.as_ref()
+          .and_then(|h| h.get("referer"))
+          .map(|values| values.join(", ")).unwrap_or("*".to_string());
+        let cors_headers = request.headers.as_ref()
+          .and_then(|h| h.get("access-control-request-headers"))
+          .map(|values| values.join(", ") + ", *").unwrap_or("*".to_string());
 
         Response::builder()
           .status(204)
@@ -234,29 +303,53 @@ fn match_result_to_hyper_response(
 
 async fn handle_request(
   req: hyper::Request<Body>,
-  pact: Arc<RequestResponsePact>,
-  matches: Arc<Mutex<Vec<MatchResult>>>,
-  mock_server: Arc<Mutex<MockServer>>
+  context: Arc<ServerContext>
 ) -> Result<Response<Body>, InteractionError> {
   debug!("Creating pact request from hyper request");
 
-  {
-    let mut guard = mock_server.lock().unwrap();
-    let mock_server = guard.borrow_mut();
-    mock_server.metrics.requests = mock_server.metrics.requests + 1;
-  }
+  let start = Instant::now();
+  context.metrics.requests.fetch_add(1, Ordering::Relaxed);
 
-  let pact_request = hyper_request_to_pact_request(req).await?;
+  let (pact_request, headers) = hyper_request_to_pact_request(req).await?;
+  let read_request = start.elapsed();
   info!("Received request {}", pact_request);
   if pact_request.has_text_body() {
     debug!("     body: '{}'", pact_request.body.str_value());
   }
 
-  let match_result = match_request(&pact_request, pact.interactions());
+  let session = context.session.current();
+  let matching_start = Instant::now();
+  let index_match = session.interactions.match_request_with_headers(&pact_request, headers);
+  let matching = matching_start.elapsed();
 
-  matches.lock().unwrap().push(match_result.clone());
+  session.record_match(index_match.result.clone(), index_match.position);
 
-  match_result_to_hyper_response(&pact_request, match_result, mock_server)
+  let response_start = Instant::now();
+  let response = match index_match.position
+    .and_then(|i| session.responses.get(i))
+    .and_then(|response| response.as_ref()) {
+    Some(response) => {
+      info!("Request matched, sending pre-rendered response");
+      response.to_response()
+    },
+    None => match_result_to_hyper_response(&pact_request, index_match.result, &context)?
+  };
+
+  let sample = RequestSample {
+    read_request,
+    matching,
+    response: response_start.elapsed(),
+    total: start.elapsed(),
+    candidates: index_match.candidates,
+    request_bytes: pact_request.body.value().map(|body| body.len()).unwrap_or_default(),
+    response_bytes: response.body().size_hint().exact().unwrap_or_default() as usize
+  };
+  context.metrics.record(&sample);
+  if let Some(counters) = index_match.position.and_then(|i| session.interaction_metrics.get(i)) {
+    counters.record(&sample);
+  }
+
+  Ok(response)
 }
 
 // TODO: Should instead use some form of X-Pact headers
@@ -283,55 +376,123 @@ fn handle_mock_request_error(result: Result<Response<Body>, InteractionError>) -
     }
 }
 
+/// Binds the listeners for the mock server. When more than one listener is requested, they are all
+/// bound to the same port with `SO_REUSEPORT`, so that the kernel spreads the incoming connections
+/// over them.
+#[cfg(unix)]
+fn bind_listeners(addr: &SocketAddr, count: usize) -> io::Result<Vec<std::net::TcpListener>> {
+  use socket2::{Domain, Protocol, Socket, Type};
+
+  if count <= 1 {
+    return std::net::TcpListener::bind(addr).map(|listener| vec![listener]);
+  }
+
+  let mut listeners = Vec::with_capacity(count);
+  let mut bind_addr = *addr;
+  for _ in 0..count {
+    let socket = Socket::new(Domain::for_address(bind_addr), Type::STREAM, Some(Protocol::TCP))?;
+    socket.set_reuse_address(true)?;
+    socket.set_reuse_port(true)?;
+    socket.bind(&bind_addr.into())?;
+    socket.listen(1024)?;
+    let listener: std::net::TcpListener = socket.into();
+    // If the port was 0, the first listener gets a random one which the others need to bind to
+    bind_addr = listener.local_addr()?;
+    listeners.push(listener);
+  }
+  Ok(listeners)
+}
+
+/// Binds the listener for the mock server. `SO_REUSEPORT` is not available on this platform, so
+/// there is only ever one listener.
+#[cfg(not(unix))]
+fn bind_listeners(addr: &SocketAddr, count: usize) -> io::Result<Vec<std::net::TcpListener>> {
+  if count > 1 {
+    warn!("Multiple listeners are not supported on this platform, using a single listener");
+  }
+  std::net::TcpListener::bind(addr).map(|listener| vec![listener])
+}
+
+/// Applies the HTTP protocol and connection settings from the mock server config to the server
+fn configure_server<I>(builder: hyper::server::Builder<I>, config: &MockServerConfig) -> hyper::server::Builder<I> {
+  let builder = builder
+    .http1_keepalive(!config.disable_keep_alive)
+    .http1_pipeline_flush(config.pipeline_flush)
+    .http2_keep_alive_interval(config.http2_keep_alive_interval);
+  match config.protocols {
+    HttpProtocols::Auto => builder,
+    HttpProtocols::Http1 => builder.http1_only(true),
+    HttpProtocols::Http2 => builder.http2_only(true)
+  }
+}
+
+/// Returns the future that drives the servers for the listeners. With more than one server, each
+/// one is spawned as a separate task so they can accept connections on different worker threads.
+fn drive_servers<F>(mut servers: Vec<F>) -> impl std::future::Future<Output = ()>
+  where F: std::future::Future<Output = Result<(), hyper::Error>> + Send + 'static {
+  async move {
+    if servers.len() == 1 {
+      let _ = servers.remove(0).await;
+    } else {
+      let handles = servers.into_iter().map(tokio::spawn).collect::<Vec<_>>();
+      for handle in handles {
+        let _ = handle.await;
+      }
+    }
+  }
+}
+
 // Create and bind the server, but do not start it.
 // Returns a future that drives the server.
 // The reason that the function itself is still async (even if it performs
-// no async operations) is that it needs a tokio context to be able to call try_bind.
+// no async operations) is that it needs a tokio context to be able to bind the listener.
 pub(crate) async fn create_and_bind(
-  pact: RequestResponsePact,
   addr: SocketAddr,
-  shutdown: impl std::future::Future<Output = ()>,
-  matches: Arc<Mutex<Vec<MatchResult>>>,
-  mock_server: Arc<Mutex<MockServer>>,
+  shutdown: impl std::future::Future<Output = ()> + Send + 'static,
+  session: SharedSession,
+  metrics: Arc<MetricsCounters>,
+  config: &MockServerConfig,
   mock_server_id: &String
-) -> Result<(impl std::future::Future<Output = ()>, SocketAddr), hyper::Error> {
-  let pact = Arc::new(pact);
+) -> anyhow::Result<(impl std::future::Future<Output = ()>, SocketAddr)> {
+  let listeners = bind_listeners(&addr, config.workers)?;
+  let socket_addr = listeners[0].local_addr()?;
+  let context = Arc::new(ServerContext::new(session, metrics, config,
+    MockServerScheme::HTTP, &socket_addr));
   let ms_id = Arc::new(mock_server_id.clone());
-
-  let server = Server::try_bind(&addr)?
-    .serve(make_service_fn(move |_| {
-      let pact = pact.clone();
-      let matches = matches.clone();
-      let mock_server = mock_server.clone();
-      let mock_server_id = ms_id.clone();
-
-      LOG_ID.scope(mock_server_id.to_string(), async {
-        Ok::<_, hyper::Error>(
-          service_fn(move |req| {
-            let pact = pact.clone();
-            let matches = matches.clone();
-            let mock_server = mock_server.clone();
-            let mock_server_id = mock_server_id.clone();
-
-            LOG_ID.scope(mock_server_id.to_string(), async {
-              handle_mock_request_error(
-                handle_request(req, pact, matches, mock_server).await
-              )
+  let shutdown = shutdown.shared();
+
+  let mut servers = Vec::with_capacity(listeners.len());
+  for listener in listeners {
+    let context = context.clone();
+    let ms_id = ms_id.clone();
+    let builder = Server::from_tcp(listener)?.tcp_nodelay(config.tcp_nodelay);
+    let server = configure_server(builder, config)
+      .serve(make_service_fn(move |_| {
+        let context = context.clone();
+        let mock_server_id = ms_id.clone();
+
+        LOG_ID.scope(mock_server_id.to_string(), async {
+          Ok::<_, hyper::Error>(
+            service_fn(move |req| {
+              let context = context.clone();
+              let mock_server_id = mock_server_id.clone();
+
+              LOG_ID.scope(mock_server_id.to_string(), async {
+                handle_mock_request_error(
+                  handle_request(req, context).await
+                )
+              })
             })
-          })
-        )
-      })
-    }));
-
-  let socket_addr = server.local_addr();
+          )
+        })
+      }))
+      .with_graceful_shutdown(shutdown.clone());
+    servers.push(server);
+  }
 
   Ok((
       // This is the future that drives the server:
-      async {
-          let _ = server
-              .with_graceful_shutdown(shutdown)
-              .await;
-      },
+      drive_servers(servers),
       socket_addr
   ))
 }
@@ -354,61 +515,75 @@ impl hyper::server::accept::Accept for HyperAcceptor {
 }
 
 pub(crate) async fn create_and_bind_tls(
-  pact: RequestResponsePact,
   addr: SocketAddr,
-  shutdown: impl std::future::Future<Output = ()>,
-  matches: Arc<Mutex<Vec<MatchResult>>>,
-  tls_cfg: ServerConfig,
-  mock_server: Arc<Mutex<MockServer>>
+  shutdown: impl std::future::Future<Output = ()> + Send + 'static,
+  session: SharedSession,
+  metrics: Arc<MetricsCounters>,
+  mut tls_cfg: ServerConfig,
+  config: &MockServerConfig
 ) -> Result<(impl std::future::Future<Output = ()>, SocketAddr), io::Error> {
-  let pact = Arc::new(pact);
-
-  let tcp = TcpListener::bind(&addr).await?;
-  let socket_addr = tcp.local_addr()?;
+  let listeners = bind_listeners(&addr, config.workers)?;
+  let socket_addr = listeners[0].local_addr()?;
+  let context = Arc::new(ServerContext::new(session, metrics, config,
+    MockServerScheme::HTTPS, &socket_addr));
+  match config.protocols {
+    HttpProtocols::Auto => {},
+    HttpProtocols::Http1 => tls_cfg.set_protocols(&["http/1.1".into()]),
+    HttpProtocols::Http2 => tls_cfg.set_protocols(&["h2".into()])
+  }
   let tls_acceptor = Arc::new(TlsAcceptor::from(Arc::new(tls_cfg)));
-  let tls_stream = stream::unfold((Arc::new(tcp), tls_acceptor.clone()), |(listener, acceptor)| {
-    async move {
-      let (socket, _) = listener.accept().await.map_err(|err| {
-        error!("Failed to accept TLS connection - {:?}", err);
-        err
-      }).ok()?;
-      let stream = acceptor.accept(socket);
-      Some((stream.await, (listener.clone(), acceptor.clone())))
-    }
-  });
-
-  let server = Server::builder(HyperAcceptor {
-    stream: tls_stream.boxed()
-  })
-    .serve(make_service_fn(move |_| {
-      let pact = pact.clone();
-      let matches = matches.clone();
-      let mock_server = mock_server.clone();
-
-      async {
-        Ok::<_, hyper::Error>(
-          service_fn(move |req| {
-            let pact = pact.clone();
-            let matches = matches.clone();
-            let mock_server = mock_server.clone();
-
-            async {
-              handle_mock_request_error(
-                handle_request(req, pact, matches, mock_server).await
-              )
-            }
-          })
-        )
+  let tcp_nodelay = config.tcp_nodelay;
+  let shutdown = shutdown.shared();
+
+  let mut servers = Vec::with_capacity(listeners.len());
+  for listener in listeners {
+    listener.set_nonblocking(true)?;
+    let tcp = TcpListener::from_std(listener)?;
+    let tls_stream = stream::unfold((Arc::new(tcp), tls_acceptor.clone()), move |(listener, acceptor)| {
+      async move {
+        let (socket, _) = listener.accept().await.map_err(|err| {
+          error!("Failed to accept TLS connection - {:?}", err);
+          err
+        }).ok()?;
+        if tcp_nodelay {
+          if let Err(err) = socket.set_nodelay(true) {
+            warn!("Failed to set TCP_NODELAY on TLS connection - {:?}", err);
+          }
+        }
+        let stream = acceptor.accept(socket);
+        Some((stream.await, (listener.clone(), acceptor.clone())))
       }
-    }));
+    });
+
+    let context = context.clone();
+    let builder = Server::builder(HyperAcceptor {
+      stream: tls_stream.boxed()
+    });
+    let server = configure_server(builder, config)
+      .serve(make_service_fn(move |_| {
+        let context = context.clone();
+
+        async {
+          Ok::<_, hyper::Error>(
+            service_fn(move |req| {
+              let context = context.clone();
+
+              async {
+                handle_mock_request_error(
+                  handle_request(req, context).await
+                )
+              }
+            })
+          )
+        }
+      }))
+      .with_graceful_shutdown(shutdown.clone());
+    servers.push(server);
+  }
 
   Ok((
     // This is the future that drives the server:
-    async {
-      let _ = server
-        .with_graceful_shutdown(shutdown)
-        .await;
-    },
+    drive_servers(servers),
     socket_addr
   ))
 }
@@ -420,21 +595,25 @@ mod tests {
   use hyper::header::{ACCEPT, CONTENT_TYPE, USER_AGENT};
   use hyper::HeaderMap;
 
+  use pact_matching::models::RequestResponsePact;
+
+  use crate::mock_server::shared_session;
+
   use super::*;
 
   #[tokio::test]
   async fn can_fetch_results_on_current_thread() {
     let (shutdown_tx, shutdown_rx) = futures::channel::oneshot::channel();
-    let matches = Arc::new(Mutex::new(vec![]));
+    let session = shared_session(&RequestResponsePact::default());
 
     let (future, _) = create_and_bind(
-      RequestResponsePact::default(),
       ([0, 0, 0, 0], 0 as u16).into(),
       async {
           shutdown_rx.await.ok();
       },
-      matches.clone(),
-      Arc::new(Mutex::new(MockServer::default())),
+      session.clone(),
+      Arc::new(MetricsCounters::default()),
+      &MockServerConfig::default(),
       &String::default()
     ).await.unwrap();
 
@@ -446,7 +625,7 @@ mod tests {
     join_handle.await.unwrap();
 
     // 0 matches have been produced
-    let all_matches = matches.lock().unwrap().clone();
+    let all_matches = session.current().matches.to_vec();
     assert_eq!(all_matches, vec![]);
   }
 
@@ -457,11 +636,30 @@ mod tests {
     headers.append(USER_AGENT, "test".parse().unwrap());
     headers.append(USER_AGENT, "test2".parse().unwrap());
     headers.append(CONTENT_TYPE, "text/plain".parse().unwrap());
-    let result = extract_headers(&headers);
+    let result = extract_headers(&headers).map(|headers| headers.map(|headers| headers.to_map()));
     expect!(result).to(be_ok().value(Some(hashmap! {
       "accept".to_string() => vec!["application/xml".to_string(), "application/json".to_string()],
       "user-agent".to_string() => vec!["test".to_string(), "test2".to_string()],
       "content-type".to_string() => vec!["text/plain".to_string()]
     })));
   }
+
+  #[test]
+  fn pre_rendered_response_is_only_built_for_responses_without_generators() {
+    let response = pact_models::response::Response {
+      status: 201,
+      headers: Some(hashmap! { "Content-Type".to_string() => vec!["text/plain".to_string()] }),
+      body: OptionalBody::Present("hello".into(), None),
+      .. pact_models::response::Response::default()
+    };
+    let rendered = PreRenderedResponse::new(&response).unwrap().to_response();
+    expect!(rendered.status()).to(be_equal_to(StatusCode::CREATED));
+    expect!(rendered.headers().get(CONTENT_TYPE).unwrap().to_str().unwrap()).to(be_equal_to("text/plain"));
+    expect!(rendered.headers().get(hyper::header::ACCESS_CONTROL_ALLOW_ORIGIN).unwrap().to_str().unwrap()).to(be_equal_to("*"));
+
+    let mut response_with_generators = response.clone();
+    response_with_generators.generators.add_generator(&pact_models::generators::GeneratorCategory::STATUS,
+      pact_models::generators::Generator::RandomInt(200, 299));
+    expect!(PreRenderedResponse::new(&response_with_generators).is_none()).to(be_true());
+  }
 }
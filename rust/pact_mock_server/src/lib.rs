@@ -7,6 +7,7 @@
 
 #![warn(missing_docs)]
 
+use std::path::Path;
 use std::sync::Mutex;
 
 use lazy_static::*;
@@ -15,14 +16,18 @@ use rustls::ServerConfig;
 use serde_json::json;
 use uuid::Uuid;
 
-use pact_matching::models::{load_pact_from_json, Pact};
+use pact_matching::models::{load_pact_from_json, Pact, RequestResponsePact};
 
+use crate::matching::InteractionIndex;
 use crate::mock_server::MockServerConfig;
 use crate::server_manager::ServerManager;
 
+mod append_log;
 pub mod matching;
 pub mod mock_server;
+pub mod metrics;
 pub mod server_manager;
+pub mod snapshot;
 mod hyper_server;
 pub mod tls;
 
@@ -154,20 +159,7 @@ pub fn create_mock_server(
   pact_json: &str,
   addr: std::net::SocketAddr
 ) -> anyhow::Result<i32> {
-  match serde_json::from_str(pact_json) {
-    Ok(pact_json) => {
-      let pact = load_pact_from_json("<create_mock_server>", &pact_json)?;
-      start_mock_server(Uuid::new_v4().to_string(), pact, addr)
-        .map_err(|err| {
-          error!("Could not start mock server: {}", err);
-          MockServerError::MockServerFailedToStart.into()
-        })
-    },
-    Err(err) => {
-      error!("Could not parse pact json: {}", err);
-      Err(MockServerError::InvalidPactJson.into())
-    }
-  }
+  create_mock_server_from_slice(pact_json.as_bytes(), addr, None)
 }
 
 /// Creates a TLS mock server. Requires the pact JSON as a string as well as the port for the mock
@@ -182,14 +174,33 @@ pub fn create_tls_mock_server(
   addr: std::net::SocketAddr,
   tls: &ServerConfig
 ) -> anyhow::Result<i32> {
-  match serde_json::from_str(pact_json) {
+  create_mock_server_from_slice(pact_json.as_bytes(), addr, Some(tls))
+}
+
+/// Creates a mock server from the UTF-8 encoded pact JSON, without having to convert it to a
+/// string first. If the TLS config is given, a TLS mock server is created. A value of 0 for the
+/// port will result in a port being allocated by the operating system. The port of the mock server
+/// is returned.
+///
+/// * `pact_json` - Pact in JSON format
+/// * `addr` - Socket address to listen on
+/// * `tls` - Optional TLS config
+pub fn create_mock_server_from_slice(
+  pact_json: &[u8],
+  addr: std::net::SocketAddr,
+  tls: Option<&ServerConfig>
+) -> anyhow::Result<i32> {
+  match serde_json::from_slice(pact_json) {
     Ok(pact_json) => {
       let pact = load_pact_from_json("<create_mock_server>", &pact_json)?;
-      start_tls_mock_server(Uuid::new_v4().to_string(), pact, addr, tls)
-        .map_err(|err| {
-          error!("Could not start mock server: {}", err);
-          MockServerError::MockServerFailedToStart.into()
-        })
+      let id = Uuid::new_v4().to_string();
+      match tls {
+        Some(tls) => start_tls_mock_server(id, pact, addr, tls),
+        None => start_mock_server(id, pact, addr)
+      }.map_err(|err| {
+        error!("Could not start mock server: {}", err);
+        MockServerError::MockServerFailedToStart.into()
+      })
     },
     Err(err) => {
       error!("Could not parse pact json: {}", err);
@@ -198,6 +209,58 @@ pub fn create_tls_mock_server(
   }
 }
 
+/// Creates a mock server from a Pact snapshot created with `snapshot::to_snapshot`. If the TLS
+/// config is given, a TLS mock server is created. A value of 0 for the port will result in a
+/// port being allocated by the operating system. The port of the mock server is returned.
+///
+/// Returns a `snapshot::SnapshotError` if the snapshot is not valid or was written by a different
+/// version of this library.
+///
+/// * `snapshot` - Pact snapshot
+/// * `addr` - Socket address to listen on
+/// * `tls` - Optional TLS config
+pub fn create_mock_server_from_snapshot(
+  snapshot: &[u8],
+  addr: std::net::SocketAddr,
+  tls: Option<&ServerConfig>
+) -> anyhow::Result<i32> {
+  let (pact, index) = snapshot::load_snapshot(snapshot)?;
+  start_indexed_mock_server(pact, index, addr, tls)
+}
+
+/// Creates a mock server from a Pact snapshot file written with `snapshot::write_snapshot`. This
+/// is the same as `create_mock_server_from_snapshot`, except that an IO error is returned if the
+/// file can not be read.
+///
+/// * `path` - Path to the snapshot file
+/// * `addr` - Socket address to listen on
+/// * `tls` - Optional TLS config
+pub fn create_mock_server_from_snapshot_file(
+  path: &Path,
+  addr: std::net::SocketAddr,
+  tls: Option<&ServerConfig>
+) -> anyhow::Result<i32> {
+  let (pact, index) = snapshot::read_snapshot_file(path)?;
+  start_indexed_mock_server(pact, index, addr, tls)
+}
+
+fn start_indexed_mock_server(
+  pact: RequestResponsePact,
+  index: InteractionIndex,
+  addr: std::net::SocketAddr,
+  tls: Option<&ServerConfig>
+) -> anyhow::Result<i32> {
+  let id = Uuid::new_v4().to_string();
+  MANAGER.lock().unwrap()
+    .get_or_insert_with(ServerManager::new)
+    .start_indexed_mock_server(id, Box::new(pact), index, addr, tls, MockServerConfig::default())
+    .map(|addr| addr.port() as i32)
+    .map_err(|err| {
+      error!("Could not start mock server: {}", err);
+      MockServerError::MockServerFailedToStart.into()
+    })
+}
+
 /// Function to check if a mock server has matched all its requests. The port number is
 /// passed in, and if all requests have been matched, true is returned. False is returned if there
 /// is no mock server on the given port, or if any request has not been successfully matched.
@@ -205,7 +268,7 @@ pub fn mock_server_matched(mock_server_port: i32) -> bool {
     MANAGER.lock().unwrap()
         .get_or_insert_with(ServerManager::new)
         .find_mock_server_by_port_mut(mock_server_port as u16, &|mock_server| {
-            mock_server.mismatches().is_empty()
+            mock_server.all_matched()
         })
         .unwrap_or(false)
 }
@@ -267,6 +330,81 @@ pub fn write_pact_file(
     }
 }
 
+/// Trigger a mock server to append the interactions of its pact to the journal for the pact
+/// file. This can be used instead of `write_pact_file` when many tests write to the same pact
+/// file, with the pact file written out once at the end with
+/// `pact_matching::models::journal::finalise_pact`. The directory of the pact file is passed
+/// as the second parameter. If `None` is passed in, the current working directory is used.
+///
+/// Returns `Ok` if the interactions were appended. Returns an `Err` if the journal can not be
+/// written, or there is no mock server running on that port.
+pub fn append_pact_file(
+  mock_server_port: i32,
+  directory: Option<String>
+) -> Result<(), WritePactFileErr> {
+  let opt_result = MANAGER.lock().unwrap()
+    .get_or_insert_with(ServerManager::new)
+    .find_mock_server_by_port_mut(mock_server_port as u16, &|mock_server| {
+      mock_server.append_pact(&directory)
+        .map_err(|err| {
+          log::error!("Failed to append pact to the journal - {}", err);
+          WritePactFileErr::IOError
+        })
+    });
+
+  match opt_result {
+    Some(result) => result,
+    None => {
+      log::error!("No mock server running on port {}", mock_server_port);
+      Err(WritePactFileErr::NoMockServer)
+    }
+  }
+}
+
+/// Reset Mock Server Errors
+pub enum ResetMockServerErr {
+  /// The pact JSON could not be parsed
+  InvalidPactJson,
+  /// No mock server was running on the port
+  NoMockServer,
+  /// The pact is not a request/response Pact, so the mock server can not serve it
+  UnsupportedPact
+}
+
+/// Resets the mock server running on the provided port to serve the interactions of a new Pact.
+/// All the matches collected so far are discarded. The mock server keeps its listener (and TLS
+/// configuration), so this is much cheaper than shutting it down and starting a new one.
+///
+/// Returns an `Err` if the pact JSON is not valid, the pact is not a request/response Pact, or
+/// there is no mock server running on that port.
+pub fn reset_mock_server(mock_server_port: i32, pact_json: &[u8]) -> Result<(), ResetMockServerErr> {
+  let pact = serde_json::from_slice(pact_json)
+    .map_err(anyhow::Error::from)
+    .and_then(|json| load_pact_from_json("<reset_mock_server>", &json))
+    .map_err(|err| {
+      error!("Could not parse pact json: {}", err);
+      ResetMockServerErr::InvalidPactJson
+    })?;
+
+  let opt_result = MANAGER.lock().unwrap()
+    .get_or_insert_with(ServerManager::new)
+    .find_mock_server_by_port_mut(mock_server_port as u16, &|mock_server| {
+      mock_server.reset(pact.as_ref())
+        .map_err(|err| {
+          error!("Failed to reset mock server - {}", err);
+          ResetMockServerErr::UnsupportedPact
+        })
+    });
+
+  match opt_result {
+    Some(result) => result,
+    None => {
+      error!("No mock server running on port {}", mock_server_port);
+      Err(ResetMockServerErr::NoMockServer)
+    }
+  }
+}
+
 /// Shuts down the mock server with the provided port. Returns a boolean value to indicate if
 /// the mock server was successfully shut down.
 pub fn shutdown_mock_server(mock_server_port: i32) -> bool {
@@ -3,17 +3,24 @@
 //! against a list of potential interactions.
 //!
 
+use std::collections::HashMap;
 use std::fmt::{Debug, Display, Formatter};
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
 
 use itertools::Itertools;
+use log::*;
 use serde_json::json;
 
-use pact_matching::Mismatch;
-use pact_matching::models::Interaction;
+use pact_matching::{Mismatch, RequestMatchOptions};
+use pact_matching::headers::NormalisedHeaders;
+use pact_matching::models::{Interaction, RequestResponseInteraction, RequestResponsePact};
 use pact_models::PactSpecification;
 use pact_models::request::Request;
 use pact_models::response::Response;
 
+use crate::append_log::AppendLog;
+
 /// Enum to define a match result
 #[derive(Debug, Clone, PartialEq)]
 pub enum MatchResult {
@@ -98,6 +105,97 @@ impl Display for MatchResult {
   }
 }
 
+/// Append-only log of the match results of a mock server, which can be appended to from any
+/// number of threads. Each result is assigned a sequence number (starting at 1) in the order it
+/// was appended. Appending a result does not take a lock, so request handlers never wait on each
+/// other or on the results being read.
+///
+/// The log also counts the failed results and which of the expected requests have been received,
+/// so whether all the requests matched can be checked without going through the results.
+pub struct MatchLog {
+  results: AppendLog<MatchResult>,
+  failures: AtomicUsize,
+  received: Vec<AtomicBool>,
+  missing: AtomicUsize
+}
+
+impl MatchLog {
+  /// Creates a new empty log, not expecting any requests
+  pub fn new() -> Self {
+    MatchLog::expecting(0)
+  }
+
+  /// Creates a new empty log, expecting the given number of distinct requests
+  pub fn expecting(requests: usize) -> Self {
+    MatchLog {
+      results: AppendLog::new(),
+      failures: AtomicUsize::new(0),
+      received: (0..requests).map(|_| AtomicBool::new(false)).collect(),
+      missing: AtomicUsize::new(requests)
+    }
+  }
+
+  /// Appends the match result to the log, returning its sequence number
+  pub fn push(&self, result: MatchResult) -> usize {
+    self.push_received(result, None)
+  }
+
+  /// Appends the match result to the log, returning its sequence number. If the request matched,
+  /// the index of the expected request it matched (less than the number the log was created
+  /// expecting) is passed in and marked as received.
+  pub fn push_received(&self, result: MatchResult, request: Option<usize>) -> usize {
+    if !result.matched() && !result.cors_preflight() {
+      self.failures.fetch_add(1, Ordering::AcqRel);
+    }
+    if let Some(received) = request.and_then(|i| self.received.get(i)) {
+      if !received.swap(true, Ordering::AcqRel) {
+        self.missing.fetch_sub(1, Ordering::AcqRel);
+      }
+    }
+    self.results.push(result) + 1
+  }
+
+  /// If no request has failed to match, and all the expected requests have been received
+  pub fn all_matched(&self) -> bool {
+    self.failures.load(Ordering::Acquire) == 0 && self.missing.load(Ordering::Acquire) == 0
+  }
+
+  /// Number of match results in the log
+  pub fn len(&self) -> usize {
+    self.results.len()
+  }
+
+  /// If there are no match results in the log
+  pub fn is_empty(&self) -> bool {
+    self.len() == 0
+  }
+
+  /// Returns all the match results with a sequence number greater than the given one, in the
+  /// order they were appended
+  pub fn since(&self, seq: usize) -> Vec<(usize, MatchResult)> {
+    self.results.iter_from(seq).enumerate()
+      .map(|(index, result)| (seq + index + 1, result.clone()))
+      .collect()
+  }
+
+  /// Returns all the match results in the order they were appended
+  pub fn to_vec(&self) -> Vec<MatchResult> {
+    self.results.iter_from(0).cloned().collect()
+  }
+}
+
+impl Default for MatchLog {
+  fn default() -> Self {
+    MatchLog::new()
+  }
+}
+
+impl Debug for MatchLog {
+  fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+    f.debug_list().entries(self.to_vec()).finish()
+  }
+}
+
 fn mismatches_to_json(request: &Request, mismatches: &Vec<Mismatch>) -> serde_json::Value {
     json!({
         "type" : "request-mismatch",
@@ -111,27 +209,191 @@ fn mismatches_to_json(request: &Request, mismatches: &Vec<Mismatch>) -> serde_js
 /// Matches a request against a list of interactions
 ///
 pub fn match_request(req: &Request, interactions: Vec<&dyn Interaction>) -> MatchResult {
-  let mut match_results = interactions
+  let interactions = interactions
     .into_iter()
     .filter(|i| i.is_request_response())
-    .map(|i| {
-      let interaction = i.as_request_response().unwrap();
-      (interaction.clone(), pact_matching::match_request(interaction.request.clone(), req.clone()))
-    })
-    .sorted_by(|(_, i1), (_, i2)| {
-      Ord::cmp(&i2.score(), &i1.score())
+    .map(|i| i.as_request_response().unwrap())
+    .collect::<Vec<RequestResponseInteraction>>();
+  let headers = interactions.iter()
+    .map(|interaction| interaction.request.headers.as_ref().map(NormalisedHeaders::new))
+    .collect::<Vec<_>>();
+  match_candidates(req, None, interactions.iter().zip(headers.iter()).enumerate()
+    .map(|(position, (interaction, headers))| (position, interaction, headers.as_ref()))).0
+}
+
+/// Matches the request against the candidates, which are paired with their position and their
+/// normalised request headers. The headers of the request are normalised here if they have not
+/// been already. The position of the interaction is also returned if the request matched.
+fn match_candidates<'a>(
+  req: &Request,
+  req_headers: Option<Arc<NormalisedHeaders>>,
+  interactions: impl Iterator<Item = (usize, &'a RequestResponseInteraction, Option<&'a NormalisedHeaders>)>
+) -> (MatchResult, Option<usize>) {
+  // The candidates are ranked by which parts of the request matched with early exit. Candidates
+  // with the same ranking are ordered by their score, so the one that matched the most query
+  // parameters and headers (the most specific one) wins. The request body is only parsed and the
+  // request headers normalised once. All the mismatches are only collected for the candidate that
+  // gets reported.
+  let options = match req_headers {
+    Some(headers) => RequestMatchOptions::for_request_with_headers(req, Some(headers), true),
+    None => RequestMatchOptions::for_request(req, true)
+  };
+  let mut match_results = interactions
+    .map(|(position, interaction, headers)| (position, interaction, headers,
+      pact_matching::match_request_with_normalised_headers(&interaction.request, headers, req, &options)))
+    .sorted_by(|(_, _, _, i1), (_, _, _, i2)| {
+      Ord::cmp(&(i2.ranking(), i2.score()), &(i1.ranking(), i1.score()))
     });
   match match_results.next() {
-    Some((interaction, result)) => {
-      let request_response_interaction = interaction.as_request_response().unwrap();
+    Some((position, interaction, headers, result)) => {
       if result.all_matched() {
-        MatchResult::RequestMatch(request_response_interaction.request, request_response_interaction.response)
+        (MatchResult::RequestMatch(interaction.request.clone(), interaction.response.clone()), Some(position))
       } else if result.method_or_path_mismatch() {
-        MatchResult::RequestNotFound(req.clone())
+        (MatchResult::RequestNotFound(req.clone()), None)
       } else {
-        MatchResult::RequestMismatch(request_response_interaction.request, result.mismatches())
+        let options = RequestMatchOptions { early_exit: false, .. options };
+        let result = pact_matching::match_request_with_normalised_headers(&interaction.request, headers, req, &options);
+        (MatchResult::RequestMismatch(interaction.request.clone(), result.mismatches()), None)
       }
     },
-    None => MatchResult::RequestNotFound(req.clone())
+    None => (MatchResult::RequestNotFound(req.clone()), None)
+  }
+}
+
+/// Result of matching a request against the candidate interactions from an `InteractionIndex`
+#[derive(Debug, Clone)]
+pub struct IndexMatch {
+  /// Result of the match
+  pub result: MatchResult,
+  /// Position of the interaction in the index, if the request matched
+  pub position: Option<usize>,
+  /// Number of candidate interactions the request was matched against
+  pub candidates: usize
+}
+
+/// Index over the request/response interactions of a Pact, keyed by request method and path.
+/// It is built once when the mock server starts, and is used to select the candidate
+/// interactions for an incoming request, so that only those need to be fully matched.
+#[derive(Debug, Clone, Default)]
+pub struct InteractionIndex {
+  /// Interactions that are indexed, in the order they occur in the Pact
+  interactions: Vec<RequestResponseInteraction>,
+  /// Request headers of the interactions, normalised for matching when the index is built
+  headers: Vec<Option<NormalisedHeaders>>,
+  /// Indices of interactions with a literal path, keyed by upper-cased method and then path
+  by_method_and_path: HashMap<String, HashMap<String, Vec<usize>>>,
+  /// Indices of interactions that have matching rules defined for the path, keyed by
+  /// upper-cased method. These need to be considered for any path.
+  by_method: HashMap<String, Vec<usize>>
+}
+
+impl InteractionIndex {
+  /// Builds the index from the interactions of the Pact
+  pub fn new(pact: &RequestResponsePact) -> Self {
+    let mut index = InteractionIndex {
+      interactions: pact.interactions.clone(),
+      .. InteractionIndex::default()
+    };
+    index.headers = index.interactions.iter()
+      .map(|interaction| interaction.request.headers.as_ref().map(NormalisedHeaders::new))
+      .collect();
+
+    for (i, interaction) in index.interactions.iter().enumerate() {
+      let method = interaction.request.method.to_uppercase();
+      let path_rules = interaction.request.matching_rules.rules_for_category("path");
+      if path_rules.map(|rules| rules.is_not_empty()).unwrap_or(false) {
+        index.by_method.entry(method).or_default().push(i);
+      } else {
+        index.by_method_and_path.entry(method).or_default()
+          .entry(interaction.request.path.clone()).or_default()
+          .push(i);
+      }
+    }
+
+    index
+  }
+
+  /// Builds the index from interactions and buckets that have already been worked out, such as
+  /// the ones stored in a snapshot. Returns an error if a bucket refers to an interaction that
+  /// is not in the index.
+  pub(crate) fn from_parts(
+    interactions: Vec<RequestResponseInteraction>,
+    by_method_and_path: HashMap<String, HashMap<String, Vec<usize>>>,
+    by_method: HashMap<String, Vec<usize>>
+  ) -> Result<Self, String> {
+    let count = interactions.len();
+    let invalid = by_method_and_path.values()
+      .flat_map(|paths| paths.values())
+      .chain(by_method.values())
+      .flatten()
+      .find(|position| **position >= count);
+    if let Some(position) = invalid {
+      return Err(format!("index refers to interaction {}, but there are only {}", position, count));
+    }
+
+    let headers = interactions.iter()
+      .map(|interaction| interaction.request.headers.as_ref().map(NormalisedHeaders::new))
+      .collect();
+    Ok(InteractionIndex { interactions, headers, by_method_and_path, by_method })
+  }
+
+  /// Indices of interactions with a literal path, keyed by upper-cased method and then path
+  pub(crate) fn by_method_and_path(&self) -> &HashMap<String, HashMap<String, Vec<usize>>> {
+    &self.by_method_and_path
+  }
+
+  /// Indices of interactions that have matching rules defined for the path, keyed by
+  /// upper-cased method
+  pub(crate) fn by_method(&self) -> &HashMap<String, Vec<usize>> {
+    &self.by_method
+  }
+
+  /// All the interactions in the index
+  pub fn interactions(&self) -> &Vec<RequestResponseInteraction> {
+    &self.interactions
+  }
+
+  /// Returns the interactions that could match a request with the given method and path, in
+  /// the order they occur in the Pact
+  pub fn candidates(&self, method: &str, path: &str) -> Vec<&RequestResponseInteraction> {
+    self.candidate_positions(method, path).iter().map(|i| &self.interactions[*i]).collect()
+  }
+
+  fn candidate_positions(&self, method: &str, path: &str) -> Vec<usize> {
+    let method = method.to_uppercase();
+    let mut indices = self.by_method_and_path.get(&method)
+      .and_then(|paths| paths.get(path))
+      .cloned()
+      .unwrap_or_default();
+    if let Some(dynamic) = self.by_method.get(&method) {
+      indices.extend_from_slice(dynamic);
+      indices.sort_unstable();
+    }
+    indices
+  }
+
+  /// Matches a request against the candidate interactions from the index. Requests with a method
+  /// and path that do not correspond to any interaction are not found.
+  pub fn match_request(&self, req: &Request) -> MatchResult {
+    self.match_request_with_details(req).result
+  }
+
+  /// Matches a request against the candidate interactions from the index, also returning the
+  /// position of the interaction in the index if the request matched and the number of
+  /// candidates the request was matched against
+  pub fn match_request_with_details(&self, req: &Request) -> IndexMatch {
+    self.match_request_with_headers(req, None)
+  }
+
+  /// Matches a request against the candidate interactions from the index, in the same way as
+  /// `match_request_with_details`. The headers of the request can be passed in already
+  /// normalised, so they are not normalised again from the headers of the request.
+  pub fn match_request_with_headers(&self, req: &Request, headers: Option<Arc<NormalisedHeaders>>) -> IndexMatch {
+    let candidates = self.candidate_positions(&req.method, &req.path);
+    debug!("Found {} candidate interaction(s) for {} {}", candidates.len(), req.method, req.path);
+    let count = candidates.len();
+    let (result, position) = match_candidates(req, headers, candidates.into_iter()
+      .map(|i| (i, &self.interactions[i], self.headers[i].as_ref())));
+    IndexMatch { result, position, candidates: count }
   }
 }
@@ -0,0 +1,336 @@
+//!
+//! The metrics module defines the counters that the request handler updates for each request, and
+//! the snapshot of them that is returned to callers.
+//!
+//! All the counters are atomics, so updating them does not take any lock and they can be left on
+//! under load. Latencies are recorded in log-linear histograms with four buckets for each power of
+//! two microseconds, so percentiles are reported to within 25% of the actual value.
+//!
+
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::time::Duration;
+
+use serde::{Deserialize, Serialize};
+
+/// Number of buckets for each power of two
+const SUB_BUCKETS: usize = 4;
+/// Number of bits used to select the bucket within a power of two
+const SUB_BUCKET_BITS: u32 = 2;
+/// Number of buckets needed for latencies up to `u32::MAX` microseconds
+const BUCKETS: usize = SUB_BUCKETS + (32 - SUB_BUCKET_BITS as usize) * SUB_BUCKETS;
+
+/// Returns the bucket for the latency in microseconds
+fn bucket_for(micros: u64) -> usize {
+  let micros = micros.min(u32::MAX as u64);
+  if micros < SUB_BUCKETS as u64 {
+    micros as usize
+  } else {
+    let msb = 63 - micros.leading_zeros();
+    let sub_bucket = (micros >> (msb - SUB_BUCKET_BITS)) as usize & (SUB_BUCKETS - 1);
+    SUB_BUCKETS + (msb - SUB_BUCKET_BITS) as usize * SUB_BUCKETS + sub_bucket
+  }
+}
+
+/// Returns the largest latency in microseconds that falls in the bucket
+fn bucket_upper_bound(bucket: usize) -> u64 {
+  if bucket < SUB_BUCKETS {
+    bucket as u64
+  } else {
+    let shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    let sub_bucket = (bucket % SUB_BUCKETS) as u64;
+    ((SUB_BUCKETS as u64 + sub_bucket + 1) << shift) - 1
+  }
+}
+
+/// Summary of the latencies recorded in a histogram, in microseconds
+#[derive(Debug, Default, Clone, Serialize, Deserialize, Eq, PartialEq)]
+#[serde(rename_all = "camelCase")]
+pub struct LatencySummary {
+  /// Number of latencies recorded
+  pub count: usize,
+  /// Mean latency
+  pub mean_micros: u64,
+  /// Median latency
+  pub p50_micros: u64,
+  /// 99th percentile latency
+  pub p99_micros: u64,
+  /// Maximum latency
+  pub max_micros: u64
+}
+
+/// Lock-free histogram of latencies
+#[derive(Debug)]
+pub(crate) struct LatencyHistogram {
+  buckets: Vec<AtomicUsize>,
+  count: AtomicUsize,
+  total_micros: AtomicU64,
+  max_micros: AtomicU64
+}
+
+impl Default for LatencyHistogram {
+  fn default() -> Self {
+    LatencyHistogram {
+      buckets: (0..BUCKETS).map(|_| AtomicUsize::new(0)).collect(),
+      count: AtomicUsize::new(0),
+      total_micros: AtomicU64::new(0),
+      max_micros: AtomicU64::new(0)
+    }
+  }
+}
+
+impl LatencyHistogram {
+  /// Records a latency
+  pub fn record(&self, latency: Duration) {
+    let micros = latency.as_micros().min(u64::MAX as u128) as u64;
+    self.buckets[bucket_for(micros)].fetch_add(1, Ordering::Relaxed);
+    self.count.fetch_add(1, Ordering::Relaxed);
+    self.total_micros.fetch_add(micros, Ordering::Relaxed);
+    self.max_micros.fetch_max(micros, Ordering::Relaxed);
+  }
+
+  /// Returns the summary of the latencies recorded so far. Latencies recorded while the summary
+  /// is being calculated may only be partially included.
+  pub fn summary(&self) -> LatencySummary {
+    let counts = self.buckets.iter()
+      .map(|bucket| bucket.load(Ordering::Relaxed))
+      .collect::<Vec<usize>>();
+    let count = self.count.load(Ordering::Relaxed);
+    let max_micros = self.max_micros.load(Ordering::Relaxed);
+    LatencySummary {
+      count,
+      mean_micros: if count > 0 { self.total_micros.load(Ordering::Relaxed) / count as u64 } else { 0 },
+      p50_micros: percentile(&counts, 50).min(max_micros),
+      p99_micros: percentile(&counts, 99).min(max_micros),
+      max_micros
+    }
+  }
+
+  /// Resets the histogram
+  pub fn reset(&self) {
+    for bucket in &self.buckets {
+      bucket.store(0, Ordering::Relaxed);
+    }
+    self.count.store(0, Ordering::Relaxed);
+    self.total_micros.store(0, Ordering::Relaxed);
+    self.max_micros.store(0, Ordering::Relaxed);
+  }
+}
+
+/// Returns the upper bound of the bucket the percentile falls in
+fn percentile(counts: &[usize], pct: usize) -> u64 {
+  let total: usize = counts.iter().sum();
+  if total == 0 {
+    return 0;
+  }
+  let rank = ((total * pct + 99) / 100).max(1);
+  let mut seen = 0;
+  for (bucket, count) in counts.iter().enumerate() {
+    seen += count;
+    if seen >= rank {
+      return bucket_upper_bound(bucket);
+    }
+  }
+  bucket_upper_bound(counts.len() - 1)
+}
+
+/// Measurements taken by the request handler for a single request
+#[derive(Debug, Default, Clone)]
+pub(crate) struct RequestSample {
+  /// Time taken to read the request and convert it to a Pact request
+  pub read_request: Duration,
+  /// Time taken to match the request against the candidate interactions
+  pub matching: Duration,
+  /// Time taken to build the response
+  pub response: Duration,
+  /// Total time spent handling the request
+  pub total: Duration,
+  /// Number of interactions the request was matched against
+  pub candidates: usize,
+  /// Size of the request body
+  pub request_bytes: usize,
+  /// Size of the response body, if known
+  pub response_bytes: usize
+}
+
+/// Metrics for a single interaction of the mock server
+#[derive(Debug, Default, Clone, Serialize, Deserialize, Eq, PartialEq)]
+#[serde(rename_all = "camelCase")]
+pub struct InteractionMetrics {
+  /// Description of the interaction
+  pub description: String,
+  /// Number of requests that matched the interaction
+  pub requests: usize,
+  /// Total size of the request bodies
+  pub request_bytes: u64,
+  /// Total size of the response bodies
+  pub response_bytes: u64,
+  /// Latency of the requests that matched the interaction
+  pub latency: LatencySummary,
+  /// Time taken to match the requests that matched the interaction
+  pub matching: LatencySummary
+}
+
+/// Counters for a single interaction, for the requests that matched it
+#[derive(Debug, Default)]
+pub(crate) struct InteractionCounters {
+  requests: AtomicUsize,
+  request_bytes: AtomicU64,
+  response_bytes: AtomicU64,
+  latency: LatencyHistogram,
+  matching: LatencyHistogram
+}
+
+impl InteractionCounters {
+  /// Records a request that matched the interaction
+  pub fn record(&self, sample: &RequestSample) {
+    self.requests.fetch_add(1, Ordering::Relaxed);
+    self.request_bytes.fetch_add(sample.request_bytes as u64, Ordering::Relaxed);
+    self.response_bytes.fetch_add(sample.response_bytes as u64, Ordering::Relaxed);
+    self.latency.record(sample.total);
+    self.matching.record(sample.matching);
+  }
+
+  /// Returns the current values of the counters
+  pub fn snapshot(&self, description: &str) -> InteractionMetrics {
+    InteractionMetrics {
+      description: description.to_string(),
+      requests: self.requests.load(Ordering::Relaxed),
+      request_bytes: self.request_bytes.load(Ordering::Relaxed),
+      response_bytes: self.response_bytes.load(Ordering::Relaxed),
+      latency: self.latency.summary(),
+      matching: self.matching.summary()
+    }
+  }
+}
+
+/// Metrics for the mock server
+#[derive(Debug, Default, Clone, Serialize, Deserialize, Eq, PartialEq)]
+#[serde(rename_all = "camelCase")]
+pub struct MockServerMetrics {
+  /// Total requests
+  pub requests: usize,
+  /// Total size of the request bodies
+  pub request_bytes: u64,
+  /// Total size of the response bodies
+  pub response_bytes: u64,
+  /// Total number of candidate interactions the requests were matched against
+  pub candidates: u64,
+  /// Largest number of candidate interactions a single request was matched against
+  pub max_candidates: usize,
+  /// Total time spent handling each request
+  pub latency: LatencySummary,
+  /// Time spent reading each request
+  pub read_request: LatencySummary,
+  /// Time spent matching each request against the candidate interactions
+  pub matching: LatencySummary,
+  /// Time spent building each response
+  pub response: LatencySummary,
+  /// Metrics for each interaction, in the order of the interactions in the Pact
+  #[serde(default)]
+  pub interactions: Vec<InteractionMetrics>
+}
+
+/// Counters for the mock server metrics. These are updated by the request handler without
+/// taking the mock server lock.
+#[derive(Debug, Default)]
+pub(crate) struct MetricsCounters {
+  /// Total requests
+  pub requests: AtomicUsize,
+  request_bytes: AtomicU64,
+  response_bytes: AtomicU64,
+  candidates: AtomicU64,
+  max_candidates: AtomicUsize,
+  latency: LatencyHistogram,
+  read_request: LatencyHistogram,
+  matching: LatencyHistogram,
+  response: LatencyHistogram
+}
+
+impl MetricsCounters {
+  /// Records the measurements for a request that was handled
+  pub fn record(&self, sample: &RequestSample) {
+    self.request_bytes.fetch_add(sample.request_bytes as u64, Ordering::Relaxed);
+    self.response_bytes.fetch_add(sample.response_bytes as u64, Ordering::Relaxed);
+    self.candidates.fetch_add(sample.candidates as u64, Ordering::Relaxed);
+    self.max_candidates.fetch_max(sample.candidates, Ordering::Relaxed);
+    self.latency.record(sample.total);
+    self.read_request.record(sample.read_request);
+    self.matching.record(sample.matching);
+    self.response.record(sample.response);
+  }
+
+  /// Returns the current values of the counters. The per-interaction metrics are not included.
+  pub fn snapshot(&self) -> MockServerMetrics {
+    MockServerMetrics {
+      requests: self.requests.load(Ordering::Relaxed),
+      request_bytes: self.request_bytes.load(Ordering::Relaxed),
+      response_bytes: self.response_bytes.load(Ordering::Relaxed),
+      candidates: self.candidates.load(Ordering::Relaxed),
+      max_candidates: self.max_candidates.load(Ordering::Relaxed),
+      latency: self.latency.summary(),
+      read_request: self.read_request.summary(),
+      matching: self.matching.summary(),
+      response: self.response.summary(),
+      interactions: vec![]
+    }
+  }
+
+  /// Resets all the counters to zero
+  pub fn reset(&self) {
+    self.requests.store(0, Ordering::Relaxed);
+    self.request_bytes.store(0, Ordering::Relaxed);
+    self.response_bytes.store(0, Ordering::Relaxed);
+    self.candidates.store(0, Ordering::Relaxed);
+    self.max_candidates.store(0, Ordering::Relaxed);
+    self.latency.reset();
+    self.read_request.reset();
+    self.matching.reset();
+    self.response.reset();
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use std::time::Duration;
+
+  use expectest::prelude::*;
+
+  use super::*;
+
+  #[test]
+  fn buckets_cover_the_latency_range() {
+    expect!(bucket_for(0)).to(be_equal_to(0));
+    expect!(bucket_for(3)).to(be_equal_to(3));
+    expect!(bucket_for(4)).to(be_equal_to(4));
+    expect!(bucket_for(7)).to(be_equal_to(7));
+    expect!(bucket_for(8)).to(be_equal_to(8));
+    expect!(bucket_for(u32::MAX as u64)).to(be_equal_to(BUCKETS - 1));
+    expect!(bucket_for(u64::MAX)).to(be_equal_to(BUCKETS - 1));
+    for micros in [5, 100, 1_000, 123_456, 10_000_000].iter() {
+      let bucket = bucket_for(*micros);
+      expect!(bucket_upper_bound(bucket) >= *micros).to(be_true());
+      expect!(bucket_upper_bound(bucket - 1) < *micros).to(be_true());
+    }
+  }
+
+  #[test]
+  fn histogram_summary() {
+    let histogram = LatencyHistogram::default();
+    expect!(histogram.summary()).to(be_equal_to(LatencySummary::default()));
+
+    for _ in 0..99 {
+      histogram.record(Duration::from_micros(100));
+    }
+    histogram.record(Duration::from_millis(50));
+
+    let summary = histogram.summary();
+    expect!(summary.count).to(be_equal_to(100));
+    expect!(summary.mean_micros).to(be_equal_to(599));
+    expect!(summary.p50_micros).to(be_equal_to(111));
+    expect!(summary.p99_micros).to(be_equal_to(111));
+    expect!(summary.max_micros).to(be_equal_to(50_000));
+
+    histogram.reset();
+    expect!(histogram.summary()).to(be_equal_to(LatencySummary::default()));
+  }
+}
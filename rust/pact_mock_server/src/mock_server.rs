@@ -4,27 +4,68 @@
 //!
 
 use std::cell::RefCell;
+use std::collections::HashMap;
 use std::ffi::CString;
-use std::ops::DerefMut;
-use std::path::PathBuf;
-use std::sync::{Arc, Mutex};
+use std::fmt::{Debug, Formatter};
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex, RwLock};
+use std::time::Duration;
 
 use log::*;
 use rustls::ServerConfig;
-use serde::{Deserialize, Serialize};
 use serde_json::json;
 
 use pact_matching::models::{Pact, RequestResponsePact, write_pact};
+use pact_matching::models::journal;
 use pact_models::request::Request;
 
 use crate::hyper_server;
-use crate::matching::MatchResult;
+use crate::hyper_server::PreRenderedResponse;
+use crate::matching::{InteractionIndex, MatchLog, MatchResult};
+use crate::metrics::{InteractionCounters, MetricsCounters};
+use crate::snapshot;
+pub use crate::metrics::MockServerMetrics;
 
 /// Mock server configuration
 #[derive(Debug, Default, Clone)]
 pub struct MockServerConfig {
   /// If CORS Pre-Flight requests should be responded to
-  pub cors_preflight: bool
+  pub cors_preflight: bool,
+  /// Number of worker threads to serve the mock server with. If more than one, the mock server
+  /// gets its own runtime with this many threads and the same number of listeners bound to the
+  /// port with `SO_REUSEPORT`. The default of 0 serves the mock server from the shared runtime
+  /// of the server manager.
+  pub workers: usize,
+  /// HTTP versions the mock server accepts
+  pub protocols: HttpProtocols,
+  /// If HTTP/1 connections should be closed after each response instead of being kept alive
+  pub disable_keep_alive: bool,
+  /// If responses on HTTP/1 connections should be flushed together, which reduces the writes
+  /// needed for clients that pipeline requests
+  pub pipeline_flush: bool,
+  /// Interval for sending HTTP/2 keep-alive pings. `None` does not send pings.
+  pub http2_keep_alive_interval: Option<Duration>,
+  /// If TCP_NODELAY should be set on accepted connections, so small responses on kept alive
+  /// connections are not delayed
+  pub tcp_nodelay: bool
+}
+
+/// HTTP versions that a mock server accepts
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum HttpProtocols {
+  /// HTTP/1.1 and HTTP/2. For TLS mock servers, the version is negotiated with ALPN, otherwise
+  /// HTTP/2 needs to be used with prior knowledge.
+  Auto,
+  /// Only HTTP/1.1
+  Http1,
+  /// Only HTTP/2
+  Http2
+}
+
+impl Default for HttpProtocols {
+  fn default() -> Self {
+    HttpProtocols::Auto
+  }
 }
 
 /// Mock server scheme
@@ -51,11 +92,120 @@ impl ToString for MockServerScheme {
   }
 }
 
-/// Metrics for the mock server
-#[derive(Debug, Default, Clone, Serialize, Deserialize, Eq, PartialEq)]
-pub struct MockServerMetrics {
-  /// Total requests
-  pub requests: usize
+/// The interactions a mock server is serving and the results of matching requests against them.
+/// Both are replaced together when the mock server is reset with a new Pact.
+#[derive(Debug)]
+pub(crate) struct MockServerSession {
+  /// Index of the interactions to match requests against
+  pub interactions: InteractionIndex,
+  /// Match results for the requests received
+  pub matches: MatchLog,
+  /// Responses for the interactions in the index that do not have generators, in the same order
+  pub responses: Vec<Option<PreRenderedResponse>>,
+  /// Metrics for the interactions in the index, in the same order
+  pub interaction_metrics: Vec<InteractionCounters>,
+  /// Index of the distinct request of each interaction in the index, in the same order.
+  /// Interactions with the same request share an index, so receiving the request once is enough
+  /// for all of them.
+  pub requests: Vec<usize>
+}
+
+impl MockServerSession {
+  /// Creates a session for the interactions of the Pact, with no match results
+  pub fn new(pact: &RequestResponsePact) -> Self {
+    MockServerSession::from_index(InteractionIndex::new(pact))
+  }
+
+  /// Creates a session for the interactions of an index that has already been built, with no
+  /// match results
+  pub fn from_index(interactions: InteractionIndex) -> Self {
+    let responses = interactions.interactions().iter()
+      .map(|interaction| PreRenderedResponse::new(&interaction.response))
+      .collect();
+    let interaction_metrics = interactions.interactions().iter()
+      .map(|_| InteractionCounters::default())
+      .collect();
+    let mut distinct: HashMap<&Request, usize> = HashMap::new();
+    let requests = interactions.interactions().iter()
+      .map(|interaction| {
+        let next = distinct.len();
+        *distinct.entry(&interaction.request).or_insert(next)
+      })
+      .collect();
+    let matches = MatchLog::expecting(distinct.len());
+    MockServerSession {
+      interactions,
+      matches,
+      responses,
+      interaction_metrics,
+      requests
+    }
+  }
+
+  /// Appends the result of matching a request to the match log. The position of the interaction
+  /// in the index is passed in if the request matched.
+  pub fn record_match(&self, result: MatchResult, position: Option<usize>) -> usize {
+    self.matches.push_received(result, position.and_then(|i| self.requests.get(i).cloned()))
+  }
+}
+
+/// Sessions of a mock server, shared between the mock server and its request handler. Requests
+/// take the current session once when they are received, so resetting the mock server only swaps
+/// in a new session and requests that are already being handled keep using the session they
+/// started with. An old session is dropped once the last of those requests completes.
+pub(crate) struct Sessions {
+  current: RwLock<Arc<MockServerSession>>
+}
+
+impl Sessions {
+  /// Returns the current session
+  pub fn current(&self) -> Arc<MockServerSession> {
+    self.current.read().unwrap().clone()
+  }
+
+  /// Makes the session the current one
+  pub fn replace(&self, session: MockServerSession) {
+    let session = Arc::new(session);
+    *self.current.write().unwrap() = session;
+  }
+}
+
+impl Debug for Sessions {
+  fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+    self.current().fmt(f)
+  }
+}
+
+/// Current session of a mock server, shared between the mock server and its request handler
+pub(crate) type SharedSession = Arc<Sessions>;
+
+/// Creates a shared session for the interactions of the Pact
+pub(crate) fn shared_session(pact: &RequestResponsePact) -> SharedSession {
+  indexed_session(InteractionIndex::new(pact))
+}
+
+/// Creates a shared session for the interactions of an index that has already been built
+pub(crate) fn indexed_session(index: InteractionIndex) -> SharedSession {
+  Arc::new(Sessions { current: RwLock::new(Arc::new(MockServerSession::from_index(index))) })
+}
+
+/// Returns the URL for a mock server bound to the address and port
+pub(crate) fn server_url(scheme: &MockServerScheme, address: &str, port: u16) -> String {
+  format!("{}://{}:{}", scheme.to_string(), if address == "0.0.0.0" { "127.0.0.1" } else { address }, port)
+}
+
+/// Returns the path of the pact file for the pact in the output directory, or the current
+/// working directory if there is none
+fn pact_file_path(pact: &dyn Pact, output_path: &Option<String>) -> PathBuf {
+  let pact_file_name = pact.default_file_name();
+  match *output_path {
+    Some(ref path) => {
+      let mut path = PathBuf::from(path);
+      path.push(pact_file_name);
+      path
+    },
+    None => PathBuf::from(pact_file_name)
+  }
 }
 
 /// Struct to represent the "foreground" part of mock server
@@ -73,14 +223,14 @@ pub struct MockServer {
   pub resources: Vec<CString>,
   /// Pact that this mock server is based on
   pub pact: Arc<Mutex<dyn Pact + Send + Sync>>,
-  /// Receiver of match results
-  matches: Arc<Mutex<Vec<MatchResult>>>,
+  /// Interactions being served and the match results
+  session: SharedSession,
   /// Shutdown signal
   shutdown_tx: RefCell<Option<futures::channel::oneshot::Sender<()>>>,
   /// Mock server config
   pub config: MockServerConfig,
   /// Metrics collected by the mock server
-  pub metrics: MockServerMetrics
+  metrics: Arc<MetricsCounters>
 }
 
 impl MockServer {
@@ -91,44 +241,51 @@ impl MockServer {
     addr: std::net::SocketAddr,
     config: MockServerConfig
   ) -> Result<(Arc<Mutex<MockServer>>, impl std::future::Future<Output = ()>), String> {
-    let (shutdown_tx, shutdown_rx) = futures::channel::oneshot::channel();
-    let matches = Arc::new(Mutex::new(vec![]));
+    let session = shared_session(&pact.as_request_response_pact().unwrap());
+    MockServer::with_session(id, pact, session, addr, config).await
+  }
 
-    let mock_server = Arc::new(Mutex::new(MockServer {
-      id: id.clone(),
-      port: None,
-      address: None,
-      scheme: MockServerScheme::HTTP,
-      resources: vec![],
-      pact: pact.thread_safe(),
-      matches: matches.clone(),
-      shutdown_tx: RefCell::new(Some(shutdown_tx)),
-      config: config.clone(),
-      metrics: MockServerMetrics::default()
-    }));
+  /// Create a new mock server that serves an existing session, consisting of its state (self)
+  /// and its executable server future.
+  pub(crate) async fn with_session(
+    id: String,
+    pact: Box<dyn Pact>,
+    session: SharedSession,
+    addr: std::net::SocketAddr,
+    config: MockServerConfig
+  ) -> Result<(Arc<Mutex<MockServer>>, impl std::future::Future<Output = ()>), String> {
+    let (shutdown_tx, shutdown_rx) = futures::channel::oneshot::channel();
+    let metrics = Arc::new(MetricsCounters::default());
 
     let (future, socket_addr) = hyper_server::create_and_bind(
-      pact.as_request_response_pact().unwrap(),
       addr,
       async {
         shutdown_rx.await.ok();
       },
-      matches,
-      mock_server.clone(),
+      session.clone(),
+      metrics.clone(),
+      &config,
       &id
     )
       .await
       .map_err(|err| format!("Could not start server: {}", err))?;
 
-    {
-      let mut ms = mock_server.lock().unwrap();
-      ms.deref_mut().port = Some(socket_addr.port());
-      ms.deref_mut().address = Some(socket_addr.ip().to_string());
+    debug!("Started mock server on {}:{}", socket_addr.ip(), socket_addr.port());
 
-      debug!("Started mock server on {}:{}", socket_addr.ip(), socket_addr.port());
-    }
+    let mock_server = Arc::new(Mutex::new(MockServer {
+      id,
+      port: Some(socket_addr.port()),
+      address: Some(socket_addr.ip().to_string()),
+      scheme: MockServerScheme::HTTP,
+      resources: vec![],
+      pact: pact.thread_safe(),
+      session,
+      shutdown_tx: RefCell::new(Some(shutdown_tx)),
+      config,
+      metrics
+    }));
 
-    Ok((mock_server.clone(), future))
+    Ok((mock_server, future))
   }
 
   /// Create a new TLS mock server, consisting of its state (self) and its executable server future.
@@ -138,42 +295,51 @@ impl MockServer {
     addr: std::net::SocketAddr,
     tls: &ServerConfig,
     config: MockServerConfig
+  ) -> Result<(Arc<Mutex<MockServer>>, impl std::future::Future<Output = ()>), String> {
+    let session = shared_session(&pact.as_request_response_pact().unwrap());
+    MockServer::with_session_tls(id, pact, session, addr, tls, config).await
+  }
+
+  /// Create a new TLS mock server that serves an existing session, consisting of its state
+  /// (self) and its executable server future.
+  pub(crate) async fn with_session_tls(
+    id: String,
+    pact: Box<dyn Pact>,
+    session: SharedSession,
+    addr: std::net::SocketAddr,
+    tls: &ServerConfig,
+    config: MockServerConfig
   ) -> Result<(Arc<Mutex<MockServer>>, impl std::future::Future<Output = ()>), String> {
     let (shutdown_tx, shutdown_rx) = futures::channel::oneshot::channel();
-    let matches = Arc::new(Mutex::new(vec![]));
-    let mock_server = Arc::new(Mutex::new(MockServer {
-      id: id.clone(),
-      port: None,
-      address: None,
-      scheme: MockServerScheme::HTTPS,
-      resources: vec![],
-      pact: pact.thread_safe(),
-      matches: matches.clone(),
-      shutdown_tx: RefCell::new(Some(shutdown_tx)),
-      config: config.clone(),
-      metrics: MockServerMetrics::default()
-    }));
+    let metrics = Arc::new(MetricsCounters::default());
 
     let (future, socket_addr) = hyper_server::create_and_bind_tls(
-      pact.as_request_response_pact().unwrap(),
       addr,
       async {
         shutdown_rx.await.ok();
       },
-      matches,
+      session.clone(),
+      metrics.clone(),
       tls.clone(),
-      mock_server.clone()
+      &config
     ).await.map_err(|err| format!("Could not start server: {}", err))?;
 
-    {
-      let mut ms = mock_server.lock().unwrap();
-      ms.deref_mut().port = Some(socket_addr.port());
-      ms.deref_mut().address = Some(socket_addr.ip().to_string());
+    debug!("Started mock server on {}:{}", socket_addr.ip(), socket_addr.port());
 
-      debug!("Started mock server on {}:{}", socket_addr.ip(), socket_addr.port());
-    }
+    let mock_server = Arc::new(Mutex::new(MockServer {
+      id,
+      port: Some(socket_addr.port()),
+      address: Some(socket_addr.ip().to_string()),
+      scheme: MockServerScheme::HTTPS,
+      resources: vec![],
+      pact: pact.thread_safe(),
+      session,
+      shutdown_tx: RefCell::new(Some(shutdown_tx)),
+      config,
+      metrics
+    }));
 
-    Ok((mock_server.clone(), future))
+    Ok((mock_server, future))
   }
 
   /// Send the shutdown signal to the server
@@ -183,7 +349,7 @@ impl MockServer {
       Some(sender) => {
         match sender.send(()) {
           Ok(()) => {
-            debug!("Mock server {} shutdown - {:?}", self.id, self.metrics);
+            debug!("Mock server {} shutdown - {:?}", self.id, self.metrics());
             Ok(())
           },
           Err(_) => Err("Problem sending shutdown signal to mock server".into())
@@ -202,14 +368,51 @@ impl MockServer {
         "address" : self.address.clone().unwrap_or_default(),
         "scheme" : self.scheme.to_string(),
         "provider" : pact.provider().name.clone(),
-        "status" : if self.mismatches().is_empty() { "ok" } else { "error" },
-        "metrics" : self.metrics
+        "status" : if self.all_matched() { "ok" } else { "error" },
+        "metrics" : self.metrics()
       })
     }
 
     /// Returns all collected matches
     pub fn matches(&self) -> Vec<MatchResult> {
-        self.matches.lock().unwrap().clone()
+        self.session.current().matches.to_vec()
+    }
+
+    /// Returns the matches with a sequence number greater than the given one, along with their
+    /// sequence numbers. Sequence numbers start at 1, and start again when the mock server is reset.
+    pub fn matches_since(&self, seq: usize) -> Vec<(usize, MatchResult)> {
+        self.session.current().matches.since(seq)
+    }
+
+    /// Replaces the Pact this mock server is serving, discarding all the collected matches and
+    /// metrics. The mock server keeps running on the same port, so it can be reused for another
+    /// test without binding a new listener. Only request/response Pacts are supported.
+    pub fn reset(&mut self, pact: &dyn Pact) -> anyhow::Result<()> {
+      let request_response_pact = pact.as_request_response_pact()?;
+      self.session.replace(MockServerSession::new(&request_response_pact));
+      self.pact = pact.thread_safe();
+      self.metrics.reset();
+      debug!("Mock server {} reset", self.id);
+      Ok(())
+    }
+
+    /// Returns the metrics collected by the mock server, including the metrics for each
+    /// interaction it is serving
+    pub fn metrics(&self) -> MockServerMetrics {
+      let session = self.session.current();
+      let mut metrics = self.metrics.snapshot();
+      metrics.interactions = session.interactions.interactions().iter()
+        .zip(session.interaction_metrics.iter())
+        .map(|(interaction, counters)| counters.snapshot(&interaction.description))
+        .collect();
+      metrics
+    }
+
+    /// If all the requests received by this mock server matched, and all the expected requests
+    /// were received. This is the same as `mismatches()` being empty, but uses the counts kept
+    /// by the match log rather than going through all the match results.
+    pub fn all_matched(&self) -> bool {
+      self.session.current().matches.all_matched()
     }
 
     /// Returns all the mismatches that have occurred with this mock server
@@ -239,15 +442,7 @@ impl MockServer {
   /// Mock server writes its pact out to the provided directory
   pub fn write_pact(&self, output_path: &Option<String>, overwrite: bool) -> anyhow::Result<()> {
     let pact = self.pact.lock().unwrap().boxed();
-    let pact_file_name = pact.default_file_name();
-    let filename = match *output_path {
-      Some(ref path) => {
-        let mut path = PathBuf::from(path);
-        path.push(pact_file_name);
-        path
-      },
-      None => PathBuf::from(pact_file_name)
-    };
+    let filename = pact_file_path(pact.as_ref(), output_path);
 
     info!("Writing pact out to '{}'", filename.display());
     let specification = pact.specification_version();
@@ -260,12 +455,37 @@ impl MockServer {
     }
   }
 
+  /// Mock server appends the interactions of its pact to the journal for the pact file in the
+  /// provided directory. The pact file is written out from the journal with
+  /// `pact_matching::models::journal::finalise_pact`.
+  pub fn append_pact(&self, output_path: &Option<String>) -> anyhow::Result<()> {
+    let pact = self.pact.lock().unwrap().boxed();
+    let filename = pact_file_path(pact.as_ref(), output_path);
+
+    info!("Appending pact to the journal for '{}'", filename.display());
+    let specification = pact.specification_version();
+    journal::append_pact(pact.as_ref(), filename.as_path(), specification)
+      .map_err(|err| {
+        warn!("Failed to append pact to the journal - {}", err);
+        err
+      })
+  }
+
+  /// Writes a snapshot of the Pact of this mock server and the index of its interactions to the
+  /// file. Mock servers for the same Pact can then be started from the snapshot with
+  /// `create_mock_server_from_snapshot_file`.
+  pub fn write_snapshot(&self, path: &Path) -> anyhow::Result<()> {
+    let pact = self.pact.lock().unwrap().as_request_response_pact()?;
+    let session = self.session.current();
+    info!("Writing snapshot of the pact to '{}'", path.display());
+    snapshot::write_snapshot(&pact, &session.interactions, path)
+  }
+
     /// Returns the URL of the mock server
     pub fn url(&self) -> String {
       let addr = self.address.clone().unwrap_or_else(|| "127.0.0.1".to_string());
       match self.port {
-        Some(port) => format!("{}://{}:{}", self.scheme.to_string(),
-          if addr == "0.0.0.0" { "127.0.0.1" } else { addr.as_str() }, port),
+        Some(port) => server_url(&self.scheme, addr.as_str(), port),
         None => "error(port is not set)".to_string()
       }
     }
@@ -282,7 +502,7 @@ impl Clone for MockServer {
       scheme: self.scheme.clone(),
       resources: vec![],
       pact: self.pact.clone(),
-      matches: self.matches.clone(),
+      session: self.session.clone(),
       shutdown_tx: RefCell::new(None),
       config: self.config.clone(),
       metrics: self.metrics.clone()
@@ -299,10 +519,52 @@ impl Default for MockServer {
       address: None,
       resources: vec![],
       pact: Arc::new(Mutex::new(RequestResponsePact::default())),
-      matches: Arc::new(Mutex::new(vec![])),
+      session: shared_session(&RequestResponsePact::default()),
       shutdown_tx: RefCell::new(None),
       config: Default::default(),
       metrics: Default::default()
     }
   }
 }
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+
+  use pact_matching::models::{RequestResponseInteraction, RequestResponsePact};
+
+  use super::*;
+
+  #[test]
+  fn resetting_a_mock_server_drops_the_previous_sessions() {
+    let pact = RequestResponsePact {
+      interactions: vec![RequestResponseInteraction::default()],
+      .. RequestResponsePact::default()
+    };
+    let mut mock_server = MockServer::default();
+    let mut previous = vec![];
+
+    for _ in 0..100 {
+      let session = mock_server.session.current();
+      previous.push(Arc::downgrade(&session));
+      drop(session);
+      mock_server.reset(&pact).unwrap();
+    }
+
+    expect!(previous.iter().all(|session| session.upgrade().is_none())).to(be_true());
+    expect!(mock_server.session.current().interactions.interactions().len()).to(be_equal_to(1));
+  }
+
+  #[test]
+  fn a_session_in_use_is_kept_until_it_is_released() {
+    let mut mock_server = MockServer::default();
+    let in_flight = mock_server.session.current();
+    let previous = Arc::downgrade(&in_flight);
+
+    mock_server.reset(&RequestResponsePact::default()).unwrap();
+    expect!(previous.upgrade().is_some()).to(be_true());
+
+    drop(in_flight);
+    expect!(previous.upgrade().is_none()).to(be_true());
+  }
+}
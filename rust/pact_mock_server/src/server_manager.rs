@@ -9,13 +9,16 @@ use std::sync::{Arc, Mutex};
 use log::*;
 use rustls::ServerConfig;
 
+use pact_matching::logging::remove_log_buffer;
 use pact_matching::models::Pact;
 
-use crate::mock_server::{MockServer, MockServerConfig};
+use crate::matching::InteractionIndex;
+use crate::mock_server::{indexed_session, MockServer, MockServerConfig};
 
 struct ServerEntry {
   mock_server: Arc<Mutex<MockServer>>,
   join_handle: tokio::task::JoinHandle<()>,
+  runtime: Option<tokio::runtime::Runtime>
 }
 
 /// Struct to represent many mock servers running in a background thread
@@ -38,6 +41,22 @@ impl ServerManager {
     }
   }
 
+  /// Creates the runtime for a mock server that is configured with more than one worker thread.
+  /// Other mock servers run on the shared runtime.
+  fn worker_runtime(config: &MockServerConfig) -> Result<Option<tokio::runtime::Runtime>, String> {
+    if config.workers > 1 {
+      tokio::runtime::Builder::new_multi_thread()
+        .worker_threads(config.workers)
+        .thread_name("pact-mock-server-worker")
+        .enable_all()
+        .build()
+        .map(Some)
+        .map_err(|err| format!("Could not create the runtime for the mock server: {}", err))
+    } else {
+      Ok(None)
+    }
+  }
+
     /// Start a new server on the runtime
     pub fn start_mock_server_with_addr(
       &mut self,
@@ -46,15 +65,19 @@ impl ServerManager {
       addr: SocketAddr,
       config: MockServerConfig
     ) -> Result<SocketAddr, String> {
+      let worker_runtime = ServerManager::worker_runtime(&config)?;
+      let runtime = worker_runtime.as_ref().unwrap_or(&self.runtime);
       let (mock_server, future) =
-        self.runtime.block_on(MockServer::new(id.clone(), pact, addr, config))?;
+        runtime.block_on(MockServer::new(id.clone(), pact, addr, config))?;
+      let join_handle = runtime.spawn(future);
 
       let port = { mock_server.lock().unwrap().port.clone() };
       self.mock_servers.insert(
         id,
         ServerEntry {
           mock_server,
-          join_handle: self.runtime.spawn(future),
+          join_handle,
+          runtime: worker_runtime
         },
       );
 
@@ -73,15 +96,19 @@ impl ServerManager {
       tls_config: &ServerConfig,
       config: MockServerConfig
     ) -> Result<SocketAddr, String> {
+      let worker_runtime = ServerManager::worker_runtime(&config)?;
+      let runtime = worker_runtime.as_ref().unwrap_or(&self.runtime);
       let (mock_server, future) =
-        self.runtime.block_on(MockServer::new_tls(id.clone(), pact, addr, tls_config, config))?;
+        runtime.block_on(MockServer::new_tls(id.clone(), pact, addr, tls_config, config))?;
+      let join_handle = runtime.spawn(future);
 
       let port = { mock_server.lock().unwrap().port.clone() };
       self.mock_servers.insert(
         id,
         ServerEntry {
           mock_server,
-          join_handle: self.runtime.spawn(future),
+          join_handle,
+          runtime: worker_runtime
         }
       );
 
@@ -91,6 +118,49 @@ impl ServerManager {
       }
     }
 
+  /// Start a new server on the runtime for a Pact whose interactions have already been indexed,
+  /// such as one loaded from a snapshot. If the TLS config is given, a TLS server is started.
+  pub(crate) fn start_indexed_mock_server(
+    &mut self,
+    id: String,
+    pact: Box<dyn Pact>,
+    index: InteractionIndex,
+    addr: SocketAddr,
+    tls_config: Option<&ServerConfig>,
+    config: MockServerConfig
+  ) -> Result<SocketAddr, String> {
+    let worker_runtime = ServerManager::worker_runtime(&config)?;
+    let runtime = worker_runtime.as_ref().unwrap_or(&self.runtime);
+    let session = indexed_session(index);
+    let (mock_server, join_handle) = match tls_config {
+      Some(tls_config) => {
+        let (mock_server, future) = runtime.block_on(
+          MockServer::with_session_tls(id.clone(), pact, session, addr, tls_config, config))?;
+        (mock_server, runtime.spawn(future))
+      },
+      None => {
+        let (mock_server, future) = runtime.block_on(
+          MockServer::with_session(id.clone(), pact, session, addr, config))?;
+        (mock_server, runtime.spawn(future))
+      }
+    };
+
+    let port = { mock_server.lock().unwrap().port.clone() };
+    self.mock_servers.insert(
+      id,
+      ServerEntry {
+        mock_server,
+        join_handle,
+        runtime: worker_runtime
+      }
+    );
+
+    match port {
+      Some(port) => Ok(SocketAddr::new(addr.ip(), port)),
+      None => Ok(addr)
+    }
+  }
+
     /// Start a new server on the runtime
     pub fn start_mock_server(
       &mut self,
@@ -103,7 +173,8 @@ impl ServerManager {
             .map(|addr| addr.port())
     }
 
-  /// Start a new server on the runtime, returning the future
+  /// Start a new server on the runtime, returning the future. The mock server always runs on the
+  /// shared runtime, so the number of workers in the config only sets the number of listeners.
   pub async fn start_mock_server_nonblocking(
     &mut self,
     id: String,
@@ -122,6 +193,7 @@ impl ServerManager {
       ServerEntry {
         mock_server,
         join_handle: self.runtime.spawn(future),
+        runtime: None
       },
     );
 
@@ -146,10 +218,14 @@ impl ServerManager {
       match self.mock_servers.remove(&id) {
         Some(entry) => {
           let mut ms = entry.mock_server.lock().unwrap();
-          debug!("Shutting down mock server with ID {} - {:?}", id, ms.metrics);
+          debug!("Shutting down mock server with ID {} - {:?}", id, ms.metrics());
           match ms.shutdown() {
             Ok(()) => {
               self.runtime.block_on(entry.join_handle).unwrap();
+              if let Some(runtime) = entry.runtime {
+                runtime.shutdown_background();
+              }
+              remove_log_buffer(&id);
               true
             }
             Err(_) => false,
@@ -171,10 +247,14 @@ impl ServerManager {
       if let Some(id) = result {
         if let Some(entry) = self.mock_servers.remove(&id) {
           let mut ms = entry.mock_server.lock().unwrap();
-          debug!("Shutting down mock server with port {} - {:?}", port, ms.metrics);
+          debug!("Shutting down mock server with port {} - {:?}", port, ms.metrics());
           return match ms.shutdown() {
             Ok(()) => {
               self.runtime.block_on(entry.join_handle).unwrap();
+              if let Some(runtime) = entry.runtime {
+                runtime.shutdown_background();
+              }
+              remove_log_buffer(&id);
               true
             }
             Err(_) => false,
@@ -0,0 +1,706 @@
+//!
+//! The snapshot module defines a compact binary format for a loaded Pact and the index of its
+//! interactions, so that mock servers for the same Pact can be started repeatedly without having
+//! to process the original Pact file.
+//!
+//! A snapshot has a fixed header followed by the payload. All integers are little-endian.
+//!
+//! | Bytes | Contents |
+//! |-------|----------|
+//! | 8 | Magic bytes `PACTSNAP` |
+//! | 2 | Format version of the snapshot |
+//! | 2 | Length of the library version |
+//! | n | Version of this library that wrote the snapshot |
+//! | 8 | FNV-1a hash of the payload |
+//! | 8 | Length of the payload |
+//! | n | Payload |
+//!
+//! The payload holds the Pact model as it is after loading, not the Pact JSON. Bodies are stored
+//! as their bytes, and matching rules and generators are stored by category and key, so only
+//! the individual matching rules, generators and provider state parameters are small JSON
+//! values. The buckets of the interaction index follow the Pact, so the index is not rebuilt
+//! when the snapshot is loaded. Loading a snapshot compiles the regular expressions of the
+//! matching rules into the regex cache, as happens when a Pact is loaded from JSON and then
+//! matched against.
+//!
+//! Snapshots are only loaded by the same format and library version that wrote them.
+//!
+
+use std::collections::{BTreeMap, HashMap};
+use std::convert::TryInto;
+use std::fs;
+use std::path::Path;
+
+use bytes::Bytes;
+use log::*;
+use serde::de::DeserializeOwned;
+use serde::Serialize;
+
+use pact_matching::models::{RequestResponseInteraction, RequestResponsePact};
+use pact_matching::regex_cache::cached_regex;
+use pact_models::{Consumer, Provider};
+use pact_models::bodies::OptionalBody;
+use pact_models::generators::{GeneratorCategory, Generators};
+use pact_models::hash_utils::fnv1a;
+use pact_models::matchingrules::{Category, MatchingRule, MatchingRules, RuleList, RuleLogic};
+use pact_models::provider_states::ProviderState;
+use pact_models::request::Request;
+use pact_models::response::Response;
+
+use crate::matching::InteractionIndex;
+
+/// Magic bytes at the start of a snapshot
+pub const SNAPSHOT_MAGIC: &[u8; 8] = b"PACTSNAP";
+/// Current format version of snapshots
+pub const SNAPSHOT_FORMAT_VERSION: u16 = 1;
+/// Version of the library, which snapshots need to match to be loaded
+const LIBRARY_VERSION: &str = env!("CARGO_PKG_VERSION");
+
+/// Errors from loading a snapshot
+#[derive(thiserror::Error, Debug, Clone, PartialEq)]
+pub enum SnapshotError {
+  /// The data is not a snapshot, or has been truncated or corrupted
+  #[error("Invalid Pact snapshot - {0}")]
+  InvalidSnapshot(String),
+  /// The snapshot was written with a different format or library version
+  #[error("Pact snapshot was written with format version {format_version} by version {library_version}, expected format version {} by version {}", SNAPSHOT_FORMAT_VERSION, LIBRARY_VERSION)]
+  IncompatibleVersion {
+    /// Format version of the snapshot
+    format_version: u16,
+    /// Version of the library that wrote the snapshot
+    library_version: String
+  }
+}
+
+fn invalid<S: Into<String>>(message: S) -> SnapshotError {
+  SnapshotError::InvalidSnapshot(message.into())
+}
+
+/// Creates a snapshot of the Pact and the index of its interactions. The interactions are
+/// written from the index, which needs to have been built from the Pact.
+pub fn to_snapshot(pact: &RequestResponsePact, index: &InteractionIndex) -> anyhow::Result<Vec<u8>> {
+  let mut payload = SnapshotWriter::default();
+  payload.pact(pact, index.interactions())?;
+  payload.index(index);
+  let payload = payload.data;
+
+  let mut snapshot = Vec::with_capacity(SNAPSHOT_MAGIC.len() + 20 + LIBRARY_VERSION.len() + payload.len());
+  snapshot.extend_from_slice(SNAPSHOT_MAGIC);
+  snapshot.extend_from_slice(&SNAPSHOT_FORMAT_VERSION.to_le_bytes());
+  snapshot.extend_from_slice(&(LIBRARY_VERSION.len() as u16).to_le_bytes());
+  snapshot.extend_from_slice(LIBRARY_VERSION.as_bytes());
+  snapshot.extend_from_slice(&fnv1a(&payload).to_le_bytes());
+  snapshot.extend_from_slice(&(payload.len() as u64).to_le_bytes());
+  snapshot.extend_from_slice(&payload);
+  Ok(snapshot)
+}
+
+/// Writes a snapshot of the Pact and the index of its interactions to the file. The snapshot is
+/// written to a temporary file first and then renamed, so processes loading the snapshot never
+/// see a partially written one.
+pub fn write_snapshot(pact: &RequestResponsePact, index: &InteractionIndex, path: &Path) -> anyhow::Result<()> {
+  let snapshot = to_snapshot(pact, index)?;
+  let mut temp_name = path.file_name().unwrap_or_default().to_os_string();
+  temp_name.push(format!(".{}.tmp", std::process::id()));
+  let temp_path = path.with_file_name(temp_name);
+  fs::write(&temp_path, &snapshot)?;
+  fs::rename(&temp_path, path).map_err(|err| {
+    let _ = fs::remove_file(&temp_path);
+    err.into()
+  })
+}
+
+/// Loads the Pact and the index of its interactions from a snapshot. Returns an error if the
+/// data is not a valid snapshot or was written by a different version.
+pub fn load_snapshot(snapshot: &[u8]) -> Result<(RequestResponsePact, InteractionIndex), SnapshotError> {
+  let result = snapshot_payload(snapshot).and_then(|payload| {
+    let mut reader = SnapshotReader { data: payload, position: 0 };
+    let pact = reader.pact()?;
+    let index = reader.index(&pact)?;
+    if reader.position != payload.len() {
+      return Err(invalid("snapshot payload has trailing data"));
+    }
+    Ok((pact, index))
+  });
+  if let Err(err) = &result {
+    error!("Could not load the Pact snapshot: {}", err);
+  }
+  result
+}
+
+/// Loads the Pact and the index of its interactions from a snapshot file. The file is read into
+/// a buffer rather than memory mapped, as the whole payload is hashed and the bodies are copied
+/// out of it anyway, and a mapped file that is truncated while it is loaded would crash the
+/// process. Returns an IO error if the file can not be read, otherwise the same errors as
+/// `load_snapshot`.
+pub fn read_snapshot_file(path: &Path) -> anyhow::Result<(RequestResponsePact, InteractionIndex)> {
+  let snapshot = fs::read(path)?;
+  if snapshot.is_empty() {
+    return Err(invalid("snapshot file is empty").into());
+  }
+  Ok(load_snapshot(&snapshot)?)
+}
+
+/// Checks the header of the snapshot, and returns the payload
+fn snapshot_payload(snapshot: &[u8]) -> Result<&[u8], SnapshotError> {
+  let mut reader = SnapshotReader { data: snapshot, position: 0 };
+  if reader.take(SNAPSHOT_MAGIC.len()).ok() != Some(&SNAPSHOT_MAGIC[..]) {
+    return Err(invalid("data is not a Pact snapshot"));
+  }
+
+  let format_version = reader.u16()?;
+  let version_length = reader.u16()? as usize;
+  let library_version = String::from_utf8_lossy(reader.take(version_length)?).to_string();
+  if format_version != SNAPSHOT_FORMAT_VERSION || library_version != LIBRARY_VERSION {
+    return Err(SnapshotError::IncompatibleVersion { format_version, library_version });
+  }
+
+  let hash = reader.u64()?;
+  let length = reader.len()?;
+  let payload = reader.take(length)?;
+  if reader.position != snapshot.len() {
+    return Err(invalid("snapshot has trailing data"));
+  }
+  if fnv1a(payload) != hash {
+    return Err(invalid("snapshot payload does not match its hash"));
+  }
+  Ok(payload)
+}
+
+/// Compiles the regular expressions of the matching rule into the regex cache, so the first
+/// requests to the mock server do not have to
+fn compile_regexes(rule: &MatchingRule) {
+  match rule {
+    MatchingRule::Regex(regex) => if let Err(err) = cached_regex(regex) {
+      warn!("Could not compile the regex '{}' of a matching rule - {}", regex, err);
+    },
+    MatchingRule::ArrayContains(variants) => for (_, rules, _) in variants {
+      for rule in rules.rules.values().flat_map(|list| list.rules.iter()) {
+        compile_regexes(rule);
+      }
+    },
+    _ => ()
+  }
+}
+
+/// Writes the parts of the snapshot payload
+#[derive(Default)]
+struct SnapshotWriter {
+  data: Vec<u8>
+}
+
+impl SnapshotWriter {
+  fn u8(&mut self, value: u8) {
+    self.data.push(value);
+  }
+
+  fn u16(&mut self, value: u16) {
+    self.data.extend_from_slice(&value.to_le_bytes());
+  }
+
+  fn len(&mut self, len: usize) {
+    self.data.extend_from_slice(&(len as u64).to_le_bytes());
+  }
+
+  fn bytes(&mut self, bytes: &[u8]) {
+    self.len(bytes.len());
+    self.data.extend_from_slice(bytes);
+  }
+
+  fn str(&mut self, value: &str) {
+    self.bytes(value.as_bytes());
+  }
+
+  fn opt_str(&mut self, value: &Option<String>) {
+    match value {
+      Some(value) => {
+        self.u8(1);
+        self.str(value);
+      },
+      None => self.u8(0)
+    }
+  }
+
+  fn json<T: Serialize>(&mut self, value: &T) -> anyhow::Result<()> {
+    let json = serde_json::to_vec(value)?;
+    self.bytes(&json);
+    Ok(())
+  }
+
+  fn multi_map(&mut self, map: &Option<HashMap<String, Vec<String>>>) {
+    match map {
+      Some(map) => {
+        self.u8(1);
+        self.len(map.len());
+        for (key, values) in map {
+          self.str(key);
+          self.len(values.len());
+          for value in values {
+            self.str(value);
+          }
+        }
+      },
+      None => self.u8(0)
+    }
+  }
+
+  fn positions(&mut self, positions: &[usize]) {
+    self.len(positions.len());
+    for position in positions {
+      self.len(*position);
+    }
+  }
+
+  fn pact(&mut self, pact: &RequestResponsePact, interactions: &[RequestResponseInteraction]) -> anyhow::Result<()> {
+    self.str(&pact.consumer.name);
+    self.str(&pact.provider.name);
+    self.json(&pact.specification_version)?;
+    self.len(pact.metadata.len());
+    for (key, values) in &pact.metadata {
+      self.str(key);
+      self.len(values.len());
+      for (name, value) in values {
+        self.str(name);
+        self.str(value);
+      }
+    }
+    self.len(interactions.len());
+    for interaction in interactions {
+      self.interaction(interaction)?;
+    }
+    Ok(())
+  }
+
+  fn interaction(&mut self, interaction: &RequestResponseInteraction) -> anyhow::Result<()> {
+    self.opt_str(&interaction.id);
+    self.str(&interaction.description);
+    self.len(interaction.provider_states.len());
+    for state in &interaction.provider_states {
+      self.str(&state.name);
+      self.json(&state.params)?;
+    }
+
+    let request = &interaction.request;
+    self.str(&request.method);
+    self.str(&request.path);
+    self.multi_map(&request.query);
+    self.multi_map(&request.headers);
+    self.body(&request.body)?;
+    self.matching_rules(&request.matching_rules)?;
+    self.generators(&request.generators)?;
+
+    let response = &interaction.response;
+    self.u16(response.status);
+    self.multi_map(&response.headers);
+    self.body(&response.body)?;
+    self.matching_rules(&response.matching_rules)?;
+    self.generators(&response.generators)
+  }
+
+  fn body(&mut self, body: &OptionalBody) -> anyhow::Result<()> {
+    match body {
+      OptionalBody::Missing => self.u8(0),
+      OptionalBody::Empty => self.u8(1),
+      OptionalBody::Null => self.u8(2),
+      OptionalBody::Present(bytes, content_type) => {
+        self.u8(3);
+        self.bytes(bytes);
+        match content_type {
+          Some(content_type) => {
+            self.u8(1);
+            self.json(content_type)?;
+          },
+          None => self.u8(0)
+        }
+      }
+    }
+    Ok(())
+  }
+
+  fn matching_rules(&mut self, matching_rules: &MatchingRules) -> anyhow::Result<()> {
+    self.len(matching_rules.rules.len());
+    for (category, rules) in &matching_rules.rules {
+      self.str(&category.to_string());
+      self.len(rules.rules.len());
+      for (key, list) in &rules.rules {
+        self.str(key);
+        self.u8(match list.rule_logic {
+          RuleLogic::And => 0,
+          RuleLogic::Or => 1
+        });
+        self.json(&list.rules)?;
+      }
+    }
+    Ok(())
+  }
+
+  fn generators(&mut self, generators: &Generators) -> anyhow::Result<()> {
+    self.len(generators.categories.len());
+    for (category, generators) in &generators.categories {
+      let name: String = category.clone().into();
+      self.str(&name);
+      self.len(generators.len());
+      for (key, generator) in generators {
+        self.str(key);
+        self.json(generator)?;
+      }
+    }
+    Ok(())
+  }
+
+  fn index(&mut self, index: &InteractionIndex) {
+    let by_method_and_path = index.by_method_and_path();
+    self.len(by_method_and_path.len());
+    for (method, paths) in by_method_and_path {
+      self.str(method);
+      self.len(paths.len());
+      for (path, positions) in paths {
+        self.str(path);
+        self.positions(positions);
+      }
+    }
+
+    let by_method = index.by_method();
+    self.len(by_method.len());
+    for (method, positions) in by_method {
+      self.str(method);
+      self.positions(positions);
+    }
+  }
+}
+
+/// Reads the parts of a snapshot, failing if it is truncated
+struct SnapshotReader<'a> {
+  data: &'a [u8],
+  position: usize
+}
+
+impl <'a> SnapshotReader<'a> {
+  fn take(&mut self, length: usize) -> Result<&'a [u8], SnapshotError> {
+    if self.data.len() - self.position < length {
+      return Err(invalid("snapshot is truncated"));
+    }
+    let bytes = &self.data[self.position..self.position + length];
+    self.position += length;
+    Ok(bytes)
+  }
+
+  fn u8(&mut self) -> Result<u8, SnapshotError> {
+    Ok(self.take(1)?[0])
+  }
+
+  fn u16(&mut self) -> Result<u16, SnapshotError> {
+    Ok(u16::from_le_bytes(self.take(2)?.try_into().unwrap()))
+  }
+
+  fn u64(&mut self) -> Result<u64, SnapshotError> {
+    Ok(u64::from_le_bytes(self.take(8)?.try_into().unwrap()))
+  }
+
+  /// Reads a length or count. Every item takes at least one byte, so a length that is larger
+  /// than the rest of the data can only come from a truncated or corrupted snapshot.
+  fn len(&mut self) -> Result<usize, SnapshotError> {
+    let len = self.u64()?;
+    if len > (self.data.len() - self.position) as u64 {
+      Err(invalid("snapshot is truncated"))
+    } else {
+      Ok(len as usize)
+    }
+  }
+
+  fn flag(&mut self) -> Result<bool, SnapshotError> {
+    match self.u8()? {
+      0 => Ok(false),
+      1 => Ok(true),
+      flag => Err(invalid(format!("invalid flag {}", flag)))
+    }
+  }
+
+  fn bytes(&mut self) -> Result<&'a [u8], SnapshotError> {
+    let len = self.len()?;
+    self.take(len)
+  }
+
+  fn str(&mut self) -> Result<String, SnapshotError> {
+    std::str::from_utf8(self.bytes()?)
+      .map(|value| value.to_string())
+      .map_err(|err| invalid(format!("invalid string - {}", err)))
+  }
+
+  fn opt_str(&mut self) -> Result<Option<String>, SnapshotError> {
+    if self.flag()? { Ok(Some(self.str()?)) } else { Ok(None) }
+  }
+
+  fn json<T: DeserializeOwned>(&mut self) -> Result<T, SnapshotError> {
+    serde_json::from_slice(self.bytes()?)
+      .map_err(|err| invalid(format!("invalid JSON value - {}", err)))
+  }
+
+  fn multi_map(&mut self) -> Result<Option<HashMap<String, Vec<String>>>, SnapshotError> {
+    if !self.flag()? {
+      return Ok(None);
+    }
+    let len = self.len()?;
+    let mut map = HashMap::with_capacity(len);
+    for _ in 0..len {
+      let key = self.str()?;
+      let count = self.len()?;
+      let mut values = Vec::with_capacity(count);
+      for _ in 0..count {
+        values.push(self.str()?);
+      }
+      map.insert(key, values);
+    }
+    Ok(Some(map))
+  }
+
+  fn positions(&mut self) -> Result<Vec<usize>, SnapshotError> {
+    let len = self.len()?;
+    let mut positions = Vec::with_capacity(len);
+    for _ in 0..len {
+      positions.push(self.u64()? as usize);
+    }
+    Ok(positions)
+  }
+
+  fn pact(&mut self) -> Result<RequestResponsePact, SnapshotError> {
+    let consumer = Consumer { name: self.str()? };
+    let provider = Provider { name: self.str()? };
+    let specification_version = self.json()?;
+    let mut metadata = BTreeMap::new();
+    for _ in 0..self.len()? {
+      let key = self.str()?;
+      let mut values = BTreeMap::new();
+      for _ in 0..self.len()? {
+        let name = self.str()?;
+        values.insert(name, self.str()?);
+      }
+      metadata.insert(key, values);
+    }
+    let len = self.len()?;
+    let mut interactions = Vec::with_capacity(len);
+    for _ in 0..len {
+      interactions.push(self.interaction()?);
+    }
+    Ok(RequestResponsePact { consumer, provider, interactions, metadata, specification_version })
+  }
+
+  fn interaction(&mut self) -> Result<RequestResponseInteraction, SnapshotError> {
+    let id = self.opt_str()?;
+    let description = self.str()?;
+    let mut provider_states = vec![];
+    for _ in 0..self.len()? {
+      let name = self.str()?;
+      provider_states.push(ProviderState { name, params: self.json()? });
+    }
+
+    let request = Request {
+      method: self.str()?,
+      path: self.str()?,
+      query: self.multi_map()?,
+      headers: self.multi_map()?,
+      body: self.body()?,
+      matching_rules: self.matching_rules()?,
+      generators: self.generators()?
+    };
+    let response = Response {
+      status: self.u16()?,
+      headers: self.multi_map()?,
+      body: self.body()?,
+      matching_rules: self.matching_rules()?,
+      generators: self.generators()?
+    };
+    Ok(RequestResponseInteraction { id, description, provider_states, request, response })
+  }
+
+  fn body(&mut self) -> Result<OptionalBody, SnapshotError> {
+    match self.u8()? {
+      0 => Ok(OptionalBody::Missing),
+      1 => Ok(OptionalBody::Empty),
+      2 => Ok(OptionalBody::Null),
+      3 => {
+        let bytes = Bytes::copy_from_slice(self.bytes()?);
+        let content_type = if self.flag()? { Some(self.json()?) } else { None };
+        Ok(OptionalBody::Present(bytes, content_type))
+      },
+      tag => Err(invalid(format!("invalid body type {}", tag)))
+    }
+  }
+
+  /// Reads the matching rules. They are added through the categories, so the paths of the rules
+  /// are parsed as they are when the rules are loaded from JSON.
+  fn matching_rules(&mut self) -> Result<MatchingRules, SnapshotError> {
+    let mut matching_rules = MatchingRules::default();
+    for _ in 0..self.len()? {
+      let category: Category = self.str()?.parse().map_err(invalid)?;
+      let rules = matching_rules.add_category(category);
+      for _ in 0..self.len()? {
+        let key = self.str()?;
+        let rule_logic = match self.u8()? {
+          0 => RuleLogic::And,
+          1 => RuleLogic::Or,
+          logic => return Err(invalid(format!("invalid rule logic {}", logic)))
+        };
+        let list: Vec<MatchingRule> = self.json()?;
+        if list.is_empty() {
+          rules.rules.insert(key, RuleList::empty(&rule_logic));
+        }
+        for rule in list {
+          compile_regexes(&rule);
+          rules.add_rule(&key, rule, &rule_logic);
+        }
+      }
+    }
+    Ok(matching_rules)
+  }
+
+  fn generators(&mut self) -> Result<Generators, SnapshotError> {
+    let mut generators = Generators::default();
+    for _ in 0..self.len()? {
+      let category: GeneratorCategory = self.str()?.parse().map_err(invalid)?;
+      let mut category_generators = HashMap::new();
+      for _ in 0..self.len()? {
+        let key = self.str()?;
+        category_generators.insert(key, self.json()?);
+      }
+      generators.categories.insert(category, category_generators);
+    }
+    Ok(generators)
+  }
+
+  fn index(&mut self, pact: &RequestResponsePact) -> Result<InteractionIndex, SnapshotError> {
+    let mut by_method_and_path = HashMap::new();
+    for _ in 0..self.len()? {
+      let method = self.str()?;
+      let mut paths = HashMap::new();
+      for _ in 0..self.len()? {
+        let path = self.str()?;
+        paths.insert(path, self.positions()?);
+      }
+      by_method_and_path.insert(method, paths);
+    }
+
+    let mut by_method = HashMap::new();
+    for _ in 0..self.len()? {
+      let method = self.str()?;
+      by_method.insert(method, self.positions()?);
+    }
+
+    InteractionIndex::from_parts(pact.interactions.clone(), by_method_and_path, by_method)
+      .map_err(invalid)
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+  use maplit::*;
+
+  use pact_models::content_types::JSON;
+  use pact_models::generators::Generator;
+  use pact_models::PactSpecification;
+
+  use super::*;
+
+  fn pact() -> RequestResponsePact {
+    let mut request = Request {
+      method: "POST".into(),
+      path: "/snapshot/100".into(),
+      query: Some(hashmap!{ "q".to_string() => vec!["1".to_string(), "2".to_string()] }),
+      headers: Some(hashmap!{ "Content-Type".to_string() => vec!["application/json".to_string()] }),
+      body: OptionalBody::Present("{\"id\":100}".into(), Some(JSON.clone())),
+      .. Request::default()
+    };
+    request.matching_rules.add_category("path")
+      .add_rule("", MatchingRule::Regex("/snapshot/\\d+".into()), &RuleLogic::And);
+    request.matching_rules.add_category("body")
+      .add_rule("$.id", MatchingRule::Integer, &RuleLogic::Or);
+    request.generators.categories.insert(GeneratorCategory::BODY, hashmap!{
+      "$.id".to_string() => Generator::RandomInt(1, 10)
+    });
+
+    RequestResponsePact {
+      consumer: Consumer { name: "snapshot_consumer".into() },
+      provider: Provider { name: "snapshot_provider".into() },
+      interactions: vec![
+        RequestResponseInteraction {
+          id: Some("1".into()),
+          description: "a request".into(),
+          provider_states: vec![ProviderState {
+            name: "a state".into(),
+            params: hashmap!{ "id".to_string() => serde_json::json!(100) }
+          }],
+          request,
+          response: Response { status: 201, body: OptionalBody::Empty, .. Response::default() }
+        },
+        RequestResponseInteraction {
+          description: "another request".into(),
+          request: Request { path: "/other".into(), .. Request::default() },
+          .. RequestResponseInteraction::default()
+        }
+      ],
+      metadata: btreemap!{
+        "pactRust".to_string() => btreemap!{ "version".to_string() => "1.0".to_string() }
+      },
+      specification_version: PactSpecification::V3
+    }
+  }
+
+  fn snapshot() -> Vec<u8> {
+    let pact = pact();
+    to_snapshot(&pact, &InteractionIndex::new(&pact)).unwrap()
+  }
+
+  #[test]
+  fn snapshot_round_trip() {
+    let pact = pact();
+    let (loaded, index) = load_snapshot(&snapshot()).unwrap();
+    expect!(&loaded).to(be_equal_to(&pact));
+    expect!(index.interactions()).to(be_equal_to(&pact.interactions));
+    expect!(index.candidates("post", "/snapshot/200").len()).to(be_equal_to(1));
+    expect!(index.candidates("GET", "/other").len()).to(be_equal_to(1));
+    expect!(index.candidates("GET", "/snapshot/200").len()).to(be_equal_to(0));
+  }
+
+  #[test]
+  fn snapshot_with_a_different_version_is_rejected() {
+    let mut snapshot = snapshot();
+    snapshot[8] = 99;
+    expect!(load_snapshot(&snapshot).unwrap_err()).to(be_equal_to(SnapshotError::IncompatibleVersion {
+      format_version: 99,
+      library_version: LIBRARY_VERSION.to_string()
+    }));
+
+    let mut snapshot = self::snapshot();
+    snapshot[12] = b'X';
+    expect!(load_snapshot(&snapshot).unwrap_err()).to(be_equal_to(SnapshotError::IncompatibleVersion {
+      format_version: SNAPSHOT_FORMAT_VERSION,
+      library_version: format!("X{}", &LIBRARY_VERSION[1..])
+    }));
+  }
+
+  #[test]
+  fn invalid_snapshots_are_rejected() {
+    let snapshot = snapshot();
+    expect!(load_snapshot(b"{\"consumer\": {}}")).to(be_err());
+    expect!(load_snapshot(&snapshot[..snapshot.len() - 1])).to(be_err());
+
+    let mut corrupted = snapshot.clone();
+    let last = corrupted.len() - 2;
+    corrupted[last] ^= 0xFF;
+    expect!(load_snapshot(&corrupted)).to(be_err());
+
+    let mut trailing = snapshot.clone();
+    trailing.push(0);
+    expect!(load_snapshot(&trailing)).to(be_err());
+  }
+
+  #[test]
+  fn index_positions_outside_the_interactions_are_rejected() {
+    let pact = pact();
+    let index = InteractionIndex::from_parts(pact.interactions.clone(), hashmap!{}, hashmap!{
+      "GET".to_string() => vec![5]
+    });
+    expect!(index).to(be_err());
+  }
+}
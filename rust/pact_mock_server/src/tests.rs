@@ -7,11 +7,12 @@ use pact_matching::Mismatch;
 use pact_matching::models::{Interaction, RequestResponseInteraction, RequestResponsePact};
 use pact_models::bodies::OptionalBody;
 use pact_models::matchingrules;
-use pact_models::matchingrules::MatchingRule;
+use pact_models::matchingrules::{MatchingRule, RuleLogic};
 use pact_models::request::Request;
 use pact_models::response::Response;
 
-use crate::matching::{match_request, MatchResult};
+use crate::matching::{InteractionIndex, MatchLog, match_request, MatchResult};
+use crate::mock_server::HttpProtocols;
 
 use super::*;
 
@@ -209,6 +210,119 @@ fn match_request_with_header_with_multiple_values() {
   expect!(response.unwrap().status()).to(be_equal_to(200));
 }
 
+#[test]
+fn mock_server_collects_metrics_for_each_interaction() {
+  let pact = RequestResponsePact {
+    interactions: vec![
+      RequestResponseInteraction {
+        description: "get animals".into(),
+        request: Request { method: "GET".into(), path: "/animals".into(), .. Request::default() },
+        response: Response { body: OptionalBody::Present("[]".into(), None), .. Response::default() },
+        .. RequestResponseInteraction::default()
+      },
+      RequestResponseInteraction {
+        description: "get plants".into(),
+        request: Request { method: "GET".into(), path: "/plants".into(), .. Request::default() },
+        .. RequestResponseInteraction::default()
+      }
+    ],
+    .. RequestResponsePact::default()
+  };
+  let mut manager = ServerManager::new();
+  let id = "mock_server_collects_metrics_for_each_interaction".to_string();
+  let port = manager.start_mock_server(id.clone(), pact.boxed(), 0, MockServerConfig::default()).unwrap();
+
+  let client = reqwest::blocking::Client::new();
+  for _ in 0..2 {
+    client.get(format!("http://127.0.0.1:{}/animals", port).as_str()).send().unwrap();
+  }
+  client.get(format!("http://127.0.0.1:{}/trees", port).as_str()).send().unwrap();
+
+  let metrics = manager.find_mock_server_by_id(&id, &|ms| ms.metrics()).unwrap();
+  manager.shutdown_mock_server_by_port(port);
+
+  expect!(metrics.requests).to(be_equal_to(3));
+  expect!(metrics.latency.count).to(be_equal_to(3));
+  expect!(metrics.candidates).to(be_equal_to(2));
+  expect!(metrics.max_candidates).to(be_equal_to(1));
+  expect!(metrics.response_bytes >= 4).to(be_true());
+  expect!(metrics.interactions.len()).to(be_equal_to(2));
+  expect!(metrics.interactions[0].description.as_str()).to(be_equal_to("get animals"));
+  expect!(metrics.interactions[0].requests).to(be_equal_to(2));
+  expect!(metrics.interactions[0].response_bytes).to(be_equal_to(4));
+  expect!(metrics.interactions[0].latency.count).to(be_equal_to(2));
+  expect!(metrics.interactions[1].requests).to(be_equal_to(0));
+}
+
+#[test]
+fn mock_server_with_multiple_workers_serves_requests_on_all_listeners() {
+  let pact = RequestResponsePact {
+    interactions: vec![
+      RequestResponseInteraction {
+        request: Request { method: "GET".into(), path: "/animals".into(), .. Request::default() },
+        .. RequestResponseInteraction::default()
+      }
+    ],
+    .. RequestResponsePact::default()
+  };
+  let mut manager = ServerManager::new();
+  let id = "mock_server_with_multiple_workers_serves_requests_on_all_listeners".to_string();
+  let config = MockServerConfig { workers: 4, .. MockServerConfig::default() };
+  let port = manager.start_mock_server(id.clone(), pact.boxed(), 0, config).unwrap();
+
+  let threads = (0..4).map(|_| {
+    std::thread::spawn(move || {
+      let client = reqwest::blocking::Client::new();
+      (0..10).map(|_| {
+        client.get(format!("http://127.0.0.1:{}/animals", port).as_str()).send().unwrap().status().as_u16()
+      }).collect::<Vec<_>>()
+    })
+  }).collect::<Vec<_>>();
+  let statuses = threads.into_iter().flat_map(|thread| thread.join().unwrap()).collect::<Vec<_>>();
+
+  let metrics = manager.find_mock_server_by_id(&id, &|ms| ms.metrics()).unwrap();
+  let stopped = manager.shutdown_mock_server_by_port(port);
+
+  expect!(stopped).to(be_true());
+  expect!(statuses.iter().all(|status| *status == 200)).to(be_true());
+  expect!(metrics.requests).to(be_equal_to(40));
+}
+
+#[test]
+fn mock_server_can_be_restricted_to_http2() {
+  let pact = RequestResponsePact {
+    interactions: vec![
+      RequestResponseInteraction {
+        request: Request { method: "GET".into(), path: "/animals".into(), .. Request::default() },
+        .. RequestResponseInteraction::default()
+      }
+    ],
+    .. RequestResponsePact::default()
+  };
+  let mut manager = ServerManager::new();
+  let id = "mock_server_can_be_restricted_to_http2".to_string();
+  let config = MockServerConfig {
+    protocols: HttpProtocols::Http2,
+    tcp_nodelay: true,
+    .. MockServerConfig::default()
+  };
+  let port = manager.start_mock_server(id.clone(), pact.boxed(), 0, config).unwrap();
+
+  let runtime = tokio::runtime::Builder::new_current_thread().enable_all().build().unwrap();
+  let http2_response = runtime.block_on(async {
+    let client = hyper::Client::builder().http2_only(true).build_http::<hyper::Body>();
+    let uri = format!("http://127.0.0.1:{}/animals", port).parse().unwrap();
+    client.get(uri).await.map(|response| (response.status().as_u16(), response.version()))
+  });
+  let http1_response = reqwest::blocking::Client::new()
+    .get(format!("http://127.0.0.1:{}/animals", port).as_str()).send();
+
+  manager.shutdown_mock_server_by_port(port);
+
+  expect!(http2_response).to(be_ok().value((200, hyper::Version::HTTP_2)));
+  expect!(http1_response).to(be_err());
+}
+
 #[test]
 fn match_request_with_more_specific_request() {
   let request1 = Request { path: "/animals/available".into(), .. Request::default() };
@@ -239,3 +353,121 @@ fn match_request_with_more_specific_request() {
     &interaction1 as &dyn Interaction, &interaction2 as &dyn Interaction]);
   expect!(result2).to(be_equal_to(MatchResult::RequestMatch(expected.request, expected.response)));
 }
+
+#[test]
+fn interaction_index_only_returns_candidates_for_the_method_and_path() {
+  let interaction1 = RequestResponseInteraction {
+    description: "get animals".into(),
+    request: Request { method: "GET".into(), path: "/animals".into(), .. Request::default() },
+    .. RequestResponseInteraction::default()
+  };
+  let interaction2 = RequestResponseInteraction {
+    description: "post animals".into(),
+    request: Request { method: "POST".into(), path: "/animals".into(), .. Request::default() },
+    .. RequestResponseInteraction::default()
+  };
+  let interaction3 = RequestResponseInteraction {
+    description: "get plants".into(),
+    request: Request { method: "GET".into(), path: "/plants".into(), .. Request::default() },
+    .. RequestResponseInteraction::default()
+  };
+  let pact = RequestResponsePact {
+    interactions: vec![ interaction1.clone(), interaction2.clone(), interaction3.clone() ],
+    .. RequestResponsePact::default()
+  };
+  let index = InteractionIndex::new(&pact);
+
+  expect!(index.candidates("GET", "/animals")).to(be_equal_to(vec![&interaction1]));
+  expect!(index.candidates("post", "/animals")).to(be_equal_to(vec![&interaction2]));
+  expect!(index.candidates("GET", "/trees")).to(be_equal_to(Vec::<&RequestResponseInteraction>::new()));
+  expect!(index.candidates("DELETE", "/plants")).to(be_equal_to(Vec::<&RequestResponseInteraction>::new()));
+}
+
+#[test]
+fn interaction_index_includes_interactions_with_path_matchers_for_any_path() {
+  let mut request = Request { method: "GET".into(), path: "/animals/100".into(), .. Request::default() };
+  request.matching_rules.add_category("path")
+    .add_rule("", MatchingRule::Regex("/animals/\\d+".into()), &RuleLogic::And);
+  let interaction1 = RequestResponseInteraction {
+    description: "get an animal".into(),
+    request,
+    .. RequestResponseInteraction::default()
+  };
+  let interaction2 = RequestResponseInteraction {
+    description: "get animal 200".into(),
+    request: Request { method: "GET".into(), path: "/animals/200".into(), .. Request::default() },
+    .. RequestResponseInteraction::default()
+  };
+  let pact = RequestResponsePact {
+    interactions: vec![ interaction1.clone(), interaction2.clone() ],
+    .. RequestResponsePact::default()
+  };
+  let index = InteractionIndex::new(&pact);
+
+  expect!(index.candidates("GET", "/animals/200")).to(be_equal_to(vec![&interaction1, &interaction2]));
+  expect!(index.candidates("GET", "/animals/300")).to(be_equal_to(vec![&interaction1]));
+
+  let result = index.match_request(&Request { method: "GET".into(), path: "/animals/300".into(), .. Request::default() });
+  expect!(result).to(be_equal_to(MatchResult::RequestMatch(interaction1.request.clone(), interaction1.response.clone())));
+
+  let request = Request { method: "GET".into(), path: "/plants".into(), .. Request::default() };
+  expect!(index.match_request(&request)).to(be_equal_to(MatchResult::RequestNotFound(request)));
+}
+
+#[test]
+fn match_log_assigns_sequence_numbers_in_order() {
+  let log = MatchLog::new();
+  expect!(log.is_empty()).to(be_true());
+
+  let request1 = Request { path: "/one".into(), .. Request::default() };
+  let request2 = Request { path: "/two".into(), .. Request::default() };
+  expect!(log.push(MatchResult::RequestNotFound(request1.clone()))).to(be_equal_to(1));
+  expect!(log.push(MatchResult::RequestNotFound(request2.clone()))).to(be_equal_to(2));
+
+  expect!(log.len()).to(be_equal_to(2));
+  expect!(log.to_vec()).to(be_equal_to(vec![
+    MatchResult::RequestNotFound(request1),
+    MatchResult::RequestNotFound(request2.clone())
+  ]));
+  expect!(log.since(1)).to(be_equal_to(vec![(2, MatchResult::RequestNotFound(request2))]));
+  expect!(log.since(2).is_empty()).to(be_true());
+}
+
+#[test]
+fn match_log_can_be_appended_to_from_multiple_threads() {
+  let log = std::sync::Arc::new(MatchLog::new());
+  let threads: Vec<_> = (0..8).map(|i| {
+    let log = log.clone();
+    std::thread::spawn(move || {
+      for j in 0..100 {
+        log.push(MatchResult::RequestNotFound(Request { path: format!("/{}/{}", i, j), .. Request::default() }));
+      }
+    })
+  }).collect();
+  for thread in threads {
+    thread.join().unwrap();
+  }
+
+  let results = log.since(0);
+  expect!(results.len()).to(be_equal_to(800));
+  expect!(results.iter().map(|(seq, _)| *seq).collect::<Vec<usize>>()).to(be_equal_to((1..=800).collect::<Vec<usize>>()));
+}
+
+#[test]
+fn match_log_counts_failures_and_missing_requests() {
+  let log = MatchLog::expecting(2);
+  expect!(log.all_matched()).to(be_false());
+
+  let request = Request { path: "/one".into(), .. Request::default() };
+  log.push_received(MatchResult::RequestMatch(request.clone(), Response::default()), Some(0));
+  log.push_received(MatchResult::RequestMatch(request.clone(), Response::default()), Some(0));
+  expect!(log.all_matched()).to(be_false());
+  log.push_received(MatchResult::RequestMatch(request.clone(), Response::default()), Some(1));
+  expect!(log.all_matched()).to(be_true());
+
+  let options = Request { method: "OPTIONS".into(), .. Request::default() };
+  log.push(MatchResult::RequestNotFound(options));
+  expect!(log.all_matched()).to(be_true());
+  log.push(MatchResult::RequestNotFound(request));
+  expect!(log.all_matched()).to(be_false());
+}
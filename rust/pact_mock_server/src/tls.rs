@@ -24,7 +24,10 @@ use std::fs::File;
 use std::io::{self, BufReader, Cursor, Read};
 use std::path::{Path, PathBuf};
 
-use tokio_rustls::rustls::{NoClientAuth, ServerConfig, TLSError};
+use tokio_rustls::rustls::{NoClientAuth, ServerConfig, ServerSessionMemoryCache, Ticketer, TLSError};
+
+/// Number of TLS sessions kept for clients resuming a session by ID
+const SESSION_CACHE_SIZE: usize = 1024;
 
 /// Represents errors that can occur building the TlsConfig
 #[derive(Debug)]
@@ -109,7 +112,8 @@ impl TlsConfigBuilder {
     self
   }
 
-  /// Build the TLS configuration
+  /// Build the TLS configuration. Clients can resume TLS sessions with either session IDs or
+  /// session tickets, and clones of the configuration share the session cache and ticket keys.
   pub fn build(mut self) -> Result<ServerConfig, TlsConfigError> {
     let mut cert_rdr = BufReader::new(self.cert);
     let cert = tokio_rustls::rustls::internal::pemfile::certs(&mut cert_rdr)
@@ -152,6 +156,8 @@ impl TlsConfigBuilder {
       .set_single_cert(cert, key)
       .map_err(|err| TlsConfigError::InvalidKey(err))?;
     config.set_protocols(&["h2".into(), "http/1.1".into()]);
+    config.set_persistence(ServerSessionMemoryCache::new(SESSION_CACHE_SIZE));
+    config.ticketer = Ticketer::new();
     Ok(config)
   }
 }
@@ -65,7 +65,8 @@ fn start_provider(context: &mut WebmachineContext, options: ServerOpts) -> Resul
           debug!("Loaded pact = {:?}", pact);
           let mock_server_id = Uuid::new_v4().to_string();
           let config = MockServerConfig {
-            cors_preflight: query_param_set(context, "cors")
+            cors_preflight: query_param_set(context, "cors"),
+            .. MockServerConfig::default()
           };
           debug!("Mock server config = {:?}", config);
 
@@ -0,0 +1,77 @@
+//! Hashes for values that are written to files or shared between processes. Unlike the hashers
+//! in the standard library, these give the same result on every platform and with every Rust
+//! release, so they can be used for file names and for decisions that several processes need to
+//! agree on.
+
+const FNV_OFFSET_BASIS: u64 = 0xcbf29ce484222325;
+const FNV_PRIME: u64 = 0x100000001b3;
+
+/// 64 bit FNV-1a hash. It is not a cryptographic hash, so it must not be relied on where the
+/// input could be chosen to collide.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Fnv1a(u64);
+
+impl Fnv1a {
+  /// Creates a hash of no data
+  pub fn new() -> Self {
+    Fnv1a(FNV_OFFSET_BASIS)
+  }
+
+  /// Adds the bytes to the hash
+  pub fn write(&mut self, bytes: &[u8]) {
+    self.0 = bytes.iter().fold(self.0, |hash, byte| (hash ^ *byte as u64).wrapping_mul(FNV_PRIME));
+  }
+
+  /// Adds the bytes to the hash followed by a zero byte, so that a sequence of parts (such as
+  /// `"ab"` and `"c"`) does not hash the same as a different split of the same bytes (`"a"` and
+  /// `"bc"`)
+  pub fn write_part(&mut self, bytes: &[u8]) {
+    self.write(bytes);
+    self.write(&[0]);
+  }
+
+  /// Returns the hash of the data added so far
+  pub fn finish(&self) -> u64 {
+    self.0
+  }
+}
+
+impl Default for Fnv1a {
+  fn default() -> Self {
+    Fnv1a::new()
+  }
+}
+
+/// Returns the 64 bit FNV-1a hash of the bytes
+pub fn fnv1a(bytes: &[u8]) -> u64 {
+  let mut hash = Fnv1a::new();
+  hash.write(bytes);
+  hash.finish()
+}
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+
+  use super::*;
+
+  #[test]
+  fn fnv1a_test() {
+    expect!(fnv1a(b"")).to(be_equal_to(0xcbf29ce484222325));
+    expect!(fnv1a(b"a")).to(be_equal_to(0xaf63dc4c8601ec8c));
+    expect!(fnv1a(b"foobar")).to(be_equal_to(0x85944171f73967e8));
+  }
+
+  #[test]
+  fn write_part_separates_the_parts() {
+    let hash_of = |parts: &[&str]| {
+      let mut hash = Fnv1a::new();
+      for part in parts {
+        hash.write_part(part.as_bytes());
+      }
+      hash.finish()
+    };
+    expect!(hash_of(&["ab", "c"])).to_not(be_equal_to(hash_of(&["a", "bc"])));
+    expect!(hash_of(&["ab", "c"])).to(be_equal_to(hash_of(&["ab", "c"])));
+  }
+}
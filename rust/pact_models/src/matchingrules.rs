@@ -885,28 +885,34 @@ impl MatchingRuleCategory {
 
   /// If there is a matcher defined for the path
   pub fn matcher_is_defined(&self, path: &[&str]) -> bool {
-    let result = !self.resolve_matchers_for_path(path).is_empty();
+    let result = self.rules.keys().any(|val| self.rule_applies_to_path(val, path));
     trace!("matcher_is_defined: for category {} and path {:?} -> {}", self.name.to_string(), path, result);
     result
   }
 
-  /// filters this category with all rules that match the given path for categories that contain
-  /// collections (eg. bodies, headers, query parameters). Returns self otherwise.
-  pub fn resolve_matchers_for_path(&self, path: &[&str]) -> MatchingRuleCategory {
+  /// If the rules stored against the key apply to the given path. Only categories that contain
+  /// collections (eg. bodies, headers, query parameters) are keyed by path.
+  fn rule_applies_to_path(&self, key: &str, path: &[&str]) -> bool {
     match self.name {
       Category::HEADER| Category::QUERY | Category::BODY |
-      Category::CONTENTS | Category::METADATA => self.filter(|(val, _)| {
-        calc_path_weight(val, path).0 > 0
-      }),
-      _ => self.clone()
+      Category::CONTENTS | Category::METADATA => calc_path_weight(key, path).0 > 0,
+      _ => true
     }
   }
 
+  /// filters this category with all rules that match the given path for categories that contain
+  /// collections (eg. bodies, headers, query parameters). Returns self otherwise.
+  pub fn resolve_matchers_for_path(&self, path: &[&str]) -> MatchingRuleCategory {
+    self.filter(|(val, _)| self.rule_applies_to_path(val, path))
+  }
+
   /// Selects the best matcher for the given path by calculating a weighting for each one
   pub fn select_best_matcher(&self, path: &[&str]) -> Option<RuleList> {
     match self.name {
       Category::BODY | Category::METADATA => self.max_by_path(path),
-      _ => self.resolve_matchers_for_path(path).as_rule_list()
+      _ => self.rules.iter()
+        .find(|(val, _)| self.rule_applies_to_path(val, path))
+        .map(|(_, rules)| rules.clone())
     }
   }
 
@@ -1021,6 +1027,159 @@ impl Ord for MatchingRuleCategory {
   }
 }
 
+/// Matching rules of a category compiled into a trie keyed by the tokens of their path
+/// expressions. Looking up the rules for a path walks the trie along the path, instead of parsing
+/// and weighting the path expression of every rule in the category. The trie is a snapshot of the
+/// category it was compiled from, and does not see rules added to the category afterwards.
+#[derive(Debug, Clone, Default)]
+pub struct MatchingRuleTrie {
+  /// Name of the category
+  name: Category,
+  /// Keys and rules of the category
+  entries: Vec<(String, RuleList)>,
+  /// Root node of the trie. Only categories that contain collections are keyed by path.
+  root: PathTrieNode
+}
+
+#[derive(Debug, Clone, Default)]
+struct PathTrieNode {
+  /// Entries whose path expression ends at this node
+  entries: Vec<usize>,
+  root: Option<Box<PathTrieNode>>,
+  fields: HashMap<String, PathTrieNode>,
+  indices: HashMap<usize, PathTrieNode>,
+  star: Option<Box<PathTrieNode>>,
+  star_index: Option<Box<PathTrieNode>>
+}
+
+impl PathTrieNode {
+  fn child(&mut self, token: &PathToken) -> &mut PathTrieNode {
+    match token {
+      PathToken::Root => self.root.get_or_insert_with(Default::default),
+      PathToken::Field(name) => self.fields.entry(name.clone()).or_default(),
+      PathToken::Index(index) => self.indices.entry(*index).or_default(),
+      PathToken::Star => self.star.get_or_insert_with(Default::default),
+      PathToken::StarIndex => self.star_index.get_or_insert_with(Default::default)
+    }
+  }
+
+  /// Visits the entries of this node and of the nodes below it that match the rest of the path,
+  /// with the weight of the match and the number of tokens matched (the same values as
+  /// `calc_path_weight`). Stops and returns true as soon as the callback returns true.
+  fn visit<F>(&self, path: &[&str], depth: usize, weight: usize, callback: &mut F) -> bool
+    where F: FnMut(usize, usize, usize) -> bool {
+    if self.entries.iter().any(|entry| callback(*entry, weight, depth)) {
+      return true;
+    }
+    match path.get(depth) {
+      Some(fragment) => {
+        let index = fragment.parse::<usize>().ok();
+        let children = [
+          (if *fragment == "$" { self.root.as_deref() } else { None }, 2),
+          (self.fields.get(*fragment), 2),
+          (index.and_then(|i| self.indices.get(&i)), 2),
+          (index.and(self.star_index.as_deref()), 1),
+          (self.star.as_deref(), 1)
+        ];
+        children.iter().any(|(child, token_weight)| match child {
+          Some(child) => child.visit(path, depth + 1, weight * token_weight, &mut *callback),
+          None => false
+        })
+      },
+      None => false
+    }
+  }
+}
+
+impl MatchingRuleTrie {
+  /// Compiles the rules of the category into a trie
+  pub fn new(category: &MatchingRuleCategory) -> Self {
+    let mut trie = MatchingRuleTrie {
+      name: category.name.clone(),
+      .. MatchingRuleTrie::default()
+    };
+    for (key, rules) in &category.rules {
+      if trie.is_keyed_by_path() {
+        match parse_path_exp(key) {
+          Ok(tokens) => {
+            let index = trie.entries.len();
+            let node = tokens.iter().fold(&mut trie.root, |node, token| node.child(token));
+            node.entries.push(index);
+          },
+          Err(err) => warn!("Failed to parse path expression - {}", err)
+        }
+      }
+      trie.entries.push((key.clone(), rules.clone()));
+    }
+    trie
+  }
+
+  fn is_keyed_by_path(&self) -> bool {
+    match self.name {
+      Category::HEADER| Category::QUERY | Category::BODY |
+      Category::CONTENTS | Category::METADATA => true,
+      _ => false
+    }
+  }
+
+  /// Calls the callback with each rule that applies to the path, the weight of the match and the
+  /// number of tokens in its path expression. Stops and returns true as soon as the callback
+  /// returns true.
+  fn find_rules<'a, F>(&'a self, path: &[&str], mut callback: F) -> bool
+    where F: FnMut(&'a (String, RuleList), usize, usize) -> bool {
+    if self.is_keyed_by_path() {
+      self.root.visit(path, 0, 1, &mut |entry, weight, length| callback(&self.entries[entry], weight, length))
+    } else {
+      self.entries.iter().any(|entry| callback(entry, 1, 0))
+    }
+  }
+
+  /// If there is a matcher defined for the path
+  pub fn matcher_is_defined(&self, path: &[&str]) -> bool {
+    let result = self.find_rules(path, |_, _, _| true);
+    trace!("matcher_is_defined: for category {} and path {:?} -> {}", self.name.to_string(), path, result);
+    result
+  }
+
+  /// Selects the best matcher for the given path by calculating a weighting for each one
+  pub fn select_best_matcher(&self, path: &[&str]) -> Option<RuleList> {
+    let mut best: Option<(&RuleList, usize)> = None;
+    match self.name {
+      Category::BODY | Category::METADATA => self.find_rules(path, |(_, rules), weight, length| {
+        if best.map_or(true, |(_, best_weight)| weight * length > best_weight) {
+          best = Some((rules, weight * length));
+        }
+        false
+      }),
+      _ => self.find_rules(path, |(_, rules), _, _| {
+        best = Some((rules, 0));
+        true
+      })
+    };
+    best.map(|(rules, _)| rules.clone())
+  }
+
+  /// If there is a type matcher defined for the path
+  pub fn type_matcher_defined(&self, path: &[&str]) -> bool {
+    self.find_rules(path, |(_, rules), _, _| rules.type_matcher_defined())
+  }
+
+  /// Returns the keys and rules with a path expression that matches the whole path, and not just
+  /// the start of it
+  pub fn rules_for_exact_path(&self, path: &[&str]) -> Vec<(&str, &RuleList)> {
+    let mut result = vec![];
+    if self.is_keyed_by_path() {
+      self.find_rules(path, |(key, rules), _, length| {
+        if length == path.len() {
+          result.push((key.as_str(), rules));
+        }
+        false
+      });
+    }
+    result
+  }
+}
+
 /// Data structure for representing a collection of matchers
 #[derive(Serialize, Deserialize, Debug, Clone, Eq)]
 #[serde(transparent)]
@@ -1854,6 +2013,68 @@ mod tests {
     expect!(calc_path_weight("$[*]", &vec!["$", "name"]).0 > 0).to(be_false());
   }
 
+  #[test]
+  fn select_best_matcher_selects_the_rule_with_the_highest_weight() {
+    let mut category = MatchingRuleCategory::empty("body");
+    category.add_rule("$.items[*]", MatchingRule::Type, &RuleLogic::And);
+    category.add_rule("$.items[1]", MatchingRule::Regex("\\d+".to_string()), &RuleLogic::And);
+
+    expect!(category.matcher_is_defined(&["$", "items", "0"])).to(be_true());
+    expect!(category.matcher_is_defined(&["$", "other"])).to(be_false());
+    expect!(category.select_best_matcher(&["$", "items", "0"])).to(be_some().value(RuleList::new(MatchingRule::Type)));
+    expect!(category.select_best_matcher(&["$", "items", "1"]))
+      .to(be_some().value(RuleList::new(MatchingRule::Regex("\\d+".to_string()))));
+  }
+
+  #[test]
+  fn matching_rule_trie_selects_the_same_matchers_as_the_category() {
+    let mut category = MatchingRuleCategory::empty("body");
+    category.add_rule("$.items[*]", MatchingRule::Type, &RuleLogic::And);
+    category.add_rule("$.items[1]", MatchingRule::Regex("\\d+".to_string()), &RuleLogic::And);
+    category.add_rule("$.items[*].*", MatchingRule::Include("a".to_string()), &RuleLogic::And);
+    category.add_rule("$.*.name", MatchingRule::Equality, &RuleLogic::And);
+    category.add_rule("$['a-b']", MatchingRule::Number, &RuleLogic::And);
+    category.add_rule("$[", MatchingRule::Integer, &RuleLogic::And);
+    let trie = MatchingRuleTrie::new(&category);
+
+    let paths: Vec<Vec<&str>> = vec![
+      vec!["$"], vec!["$", "items"], vec!["$", "items", "0"], vec!["$", "items", "1"],
+      vec!["$", "items", "one"], vec!["$", "items", "1", "name"], vec!["$", "other", "name"],
+      vec!["$", "a-b"], vec!["$", "a-b", "c"], vec!["other"], vec![]
+    ];
+    for path in paths {
+      expect!(trie.matcher_is_defined(&path)).to(be_equal_to(category.matcher_is_defined(&path)));
+      expect!(trie.select_best_matcher(&path)).to(be_equal_to(category.select_best_matcher(&path)));
+      expect!(trie.type_matcher_defined(&path))
+        .to(be_equal_to(category.resolve_matchers_for_path(&path).type_matcher_defined()));
+    }
+  }
+
+  #[test]
+  fn matching_rule_trie_returns_the_rules_for_an_exact_path() {
+    let mut category = MatchingRuleCategory::empty("body");
+    category.add_rule("$.items", MatchingRule::MinType(1), &RuleLogic::And);
+    category.add_rule("$.items[*]", MatchingRule::Type, &RuleLogic::And);
+    category.add_rule("$.items.*", MatchingRule::Values, &RuleLogic::And);
+    let trie = MatchingRuleTrie::new(&category);
+
+    let mut keys = trie.rules_for_exact_path(&["$", "items", "0"]).iter()
+      .map(|(key, _)| key.to_string()).collect::<Vec<_>>();
+    keys.sort();
+    expect!(keys).to(be_equal_to(vec!["$.items.*".to_string(), "$.items[*]".to_string()]));
+    expect!(trie.rules_for_exact_path(&["$", "items"]).len()).to(be_equal_to(1));
+    expect!(MatchingRuleTrie::new(&MatchingRuleCategory::equality("path")).rules_for_exact_path(&[]).is_empty())
+      .to(be_true());
+  }
+
+  #[test]
+  fn matching_rule_trie_applies_all_rules_for_categories_not_keyed_by_path() {
+    let trie = MatchingRuleTrie::new(&MatchingRuleCategory::equality("path"));
+    expect!(trie.matcher_is_defined(&["any"])).to(be_true());
+    expect!(trie.select_best_matcher(&[])).to(be_some().value(RuleList::equality()));
+    expect!(MatchingRuleTrie::default().matcher_is_defined(&["$"])).to(be_false());
+  }
+
   #[test]
   fn min_and_max_values_get_serialised_to_json_as_numbers() {
     expect!(MatchingRule::MinType(1).to_json().to_string()).to(be_equal_to("{\"match\":\"type\",\"min\":1}"));
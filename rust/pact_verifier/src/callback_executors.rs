@@ -50,6 +50,51 @@ pub struct ProviderStateError {
 pub trait ProviderStateExecutor {
   /// Invoke the callback for the given provider state, returning an optional Map of values
   async fn call(self: Arc<Self>, interaction_id: Option<String>, provider_state: &ProviderState, setup: bool, client: Option<&reqwest::Client>) -> Result<HashMap<String, Value>, ProviderStateError>;
+
+  /// Invoke the callbacks for all the provider states of an interaction, returning the values from
+  /// all the callbacks combined. The default implementation invokes `call` for each state in turn.
+  async fn call_batch(
+    self: Arc<Self>,
+    interaction_id: Option<String>,
+    provider_states: &[ProviderState],
+    setup: bool,
+    client: Option<&reqwest::Client>
+  ) -> Result<HashMap<String, Value>, ProviderStateError> where Self: Send + Sync {
+    call_each_state(self, interaction_id, provider_states, setup, client).await
+  }
+}
+
+/// Invokes the callback for each of the provider states, returning the first error if any of
+/// them fail. All the callbacks are invoked even if one fails.
+async fn call_each_state<S: ProviderStateExecutor + Send + Sync + ?Sized>(
+  executor: Arc<S>,
+  interaction_id: Option<String>,
+  provider_states: &[ProviderState],
+  setup: bool,
+  client: Option<&reqwest::Client>
+) -> Result<HashMap<String, Value>, ProviderStateError> {
+  let mut values = hashmap!{};
+  let mut error = None;
+  for provider_state in provider_states {
+    match executor.clone().call(interaction_id.clone(), provider_state, setup, client).await {
+      Ok(result) => values.extend(result),
+      Err(err) => if error.is_none() {
+        error = Some(err);
+      }
+    }
+  }
+  match error {
+    Some(err) => Err(err),
+    None => Ok(values)
+  }
+}
+
+fn state_change_action(setup: bool) -> String {
+  if setup {
+    "setup".to_string()
+  } else {
+    "teardown".to_string()
+  }
 }
 
 /// Default provider state callback executor, which executes an HTTP request
@@ -59,7 +104,11 @@ pub struct HttpRequestProviderStateExecutor {
   /// If teardown state change requests should be made (default is false)
   pub state_change_teardown: bool,
   /// If state change request data should be sent in the body (true) or as query parameters (false)
-  pub state_change_body: bool
+  pub state_change_body: bool,
+  /// If all the provider states of an interaction should be sent in a single state change request
+  /// (default is false). Only applies when the state change data is sent in the body, which will
+  /// then have a `states` attribute with the name and params of each state.
+  pub state_change_batch: bool
 }
 
 impl Default for HttpRequestProviderStateExecutor {
@@ -68,7 +117,8 @@ impl Default for HttpRequestProviderStateExecutor {
     HttpRequestProviderStateExecutor {
       state_change_url: None,
       state_change_teardown: false,
-      state_change_body: true
+      state_change_body: true,
+      state_change_batch: false
     }
   }
 }
@@ -89,21 +139,13 @@ impl ProviderStateExecutor for HttpRequestProviderStateExecutor {
           let json_body = json!({
                     "state".to_string() : provider_state.name.clone(),
                     "params".to_string() : provider_state.params.clone(),
-                    "action".to_string() : if setup {
-                        "setup".to_string()
-                    } else {
-                        "teardown".to_string()
-                    }
+                    "action".to_string() : state_change_action(setup)
                 });
           state_change_request.body = OptionalBody::Present(json_body.to_string().into(), Some(JSON.clone()));
           state_change_request.headers = Some(hashmap!{ "Content-Type".to_string() => vec!["application/json".to_string()] });
         } else {
           let mut query = hashmap!{ "state".to_string() => vec![provider_state.name.clone()] };
-          if setup {
-            query.insert("action".to_string(), vec!["setup".to_string()]);
-          } else {
-            query.insert("action".to_string(), vec!["teardown".to_string()]);
-          }
+          query.insert("action".to_string(), vec![state_change_action(setup)]);
           for (k, v) in provider_state.params.clone() {
             query.insert(k, vec![match v {
               Value::String(ref s) => s.clone(),
@@ -123,4 +165,39 @@ impl ProviderStateExecutor for HttpRequestProviderStateExecutor {
       }
     }
   }
+
+  async fn call_batch(
+    self: Arc<Self>,
+    interaction_id: Option<String>,
+    provider_states: &[ProviderState],
+    setup: bool,
+    client: Option<&reqwest::Client>
+  ) -> Result<HashMap<String, Value>, ProviderStateError> {
+    let batch_url = if self.state_change_batch && self.state_change_body {
+      self.state_change_url.clone()
+    } else {
+      None
+    };
+    match batch_url {
+      Some(state_change_url) => {
+        let states: Vec<Value> = provider_states.iter().map(|provider_state| json!({
+          "name": provider_state.name.clone(),
+          "params": provider_state.params.clone()
+        })).collect();
+        let json_body = json!({
+          "states": states,
+          "action": state_change_action(setup)
+        });
+        let state_change_request = Request {
+          method: "POST".to_string(),
+          body: OptionalBody::Present(json_body.to_string().into(), Some(JSON.clone())),
+          headers: Some(hashmap!{ "Content-Type".to_string() => vec!["application/json".to_string()] }),
+          .. Request::default()
+        };
+        make_state_change_request(client.unwrap_or(&reqwest::Client::default()), &state_change_url, &state_change_request).await
+          .map_err(|err| ProviderStateError { description: provider_client_error_to_string(err), interaction_id })
+      },
+      None => call_each_state(self, interaction_id, provider_states, setup, client).await
+    }
+  }
 }
@@ -7,7 +7,7 @@ use std::collections::HashMap;
 use std::fmt::{Debug, Display, Formatter};
 use std::fmt;
 use std::fs;
-use std::path::Path;
+use std::path::{Path, PathBuf};
 use std::sync::Arc;
 use std::time::Duration;
 
@@ -33,16 +33,19 @@ use pact_models::provider_states::*;
 
 use crate::callback_executors::{ProviderStateError, ProviderStateExecutor};
 use crate::messages::{display_message_result, verify_message_from_provider};
-use crate::pact_broker::{Link, PactVerificationContext, publish_verification_results, TestResult};
+use crate::pact_broker::{Link, PactVerificationContext, publish_test_results, test_results_json, TestResult};
 pub use crate::pact_broker::{ConsumerVersionSelector, PactsForVerificationRequest};
 use crate::provider_client::{make_provider_request, provider_client_error_to_string};
 use crate::request_response::display_request_response_result;
+use crate::shards::{Shard, ShardPactResults, ShardResults, write_shard_results};
 
 mod provider_client;
 pub mod pact_broker;
 pub mod callback_executors;
 mod request_response;
 mod messages;
+mod pact_cache;
+pub mod shards;
 
 /// Source for loading pacts
 #[derive(Debug, Clone)]
@@ -252,94 +255,175 @@ async fn verify_response_from_provider<F: RequestFilterExecutor>(
   }
 }
 
-async fn execute_state_change<S: ProviderStateExecutor>(
-  provider_state: &ProviderState,
+async fn execute_state_change<S: ProviderStateExecutor + Send + Sync>(
+  provider_states: &[ProviderState],
   setup: bool,
   interaction_id: Option<String>,
   client: &reqwest::Client,
   provider_state_executor: Arc<S>
 ) -> Result<HashMap<String, Value>, MismatchResult> {
     if setup {
-        println!("  Given {}", Style::new().bold().paint(provider_state.name.clone()));
+        for provider_state in provider_states {
+            println!("  Given {}", Style::new().bold().paint(provider_state.name.clone()));
+        }
     }
-    let result = provider_state_executor.call(interaction_id, provider_state, setup, Some(client)).await;
-    log::debug!("State Change: \"{:?}\" -> {:?}", provider_state, result);
+    let result = provider_state_executor.call_batch(interaction_id, provider_states, setup, Some(client)).await;
+    log::debug!("State Change: \"{:?}\" -> {:?}", provider_states, result);
     result.map_err(|err| MismatchResult::Error(err.description, err.interaction_id))
 }
 
-async fn verify_interaction<F: RequestFilterExecutor, S: ProviderStateExecutor>(
+/// Creates the HTTP client used to make requests to the provider and state change calls
+pub fn create_provider_client(disable_ssl_verification: bool, request_timeout: u64) -> reqwest::Client {
+  reqwest::Client::builder()
+    .danger_accept_invalid_certs(disable_ssl_verification)
+    .timeout(Duration::from_millis(request_timeout))
+    .build()
+    .unwrap_or(reqwest::Client::new())
+}
+
+/// Returns the shared HTTP client from the options, or creates one if there is no shared client
+fn provider_client<F: RequestFilterExecutor>(options: &VerificationOptions<F>) -> Arc<reqwest::Client> {
+  match &options.client {
+    Some(client) => client.clone(),
+    None => Arc::new(create_provider_client(options.disable_ssl_verification, options.request_timeout))
+  }
+}
+
+/// Runs the state change setup calls for the provider states of the interaction, returning the
+/// values returned by the state change handlers
+async fn setup_provider_states<S: ProviderStateExecutor + Send + Sync>(
+  interaction: &dyn Interaction,
+  client: &Arc<reqwest::Client>,
+  provider_state_executor: &Arc<S>
+) -> Result<HashMap<String, Value>, MismatchResult> {
+  let provider_states = interaction.provider_states();
+  if provider_states.is_empty() {
+    return Ok(hashmap!{});
+  }
+
+  for state in &provider_states {
+    info!("Running provider state change handler '{}' for '{}'", state.name, interaction.description());
+  }
+  execute_state_change(&provider_states, true, interaction.id(), client,
+                       provider_state_executor.clone()).await
+    .map_err(|err| {
+      error!("Provider state change for '{}' has failed - {:?}", interaction.description(), err);
+      MismatchResult::Error("One or more of the state change handlers has failed".to_string(), interaction.id())
+    })
+}
+
+/// Runs the state change teardown calls for the provider states of the interaction
+async fn teardown_provider_states<S: ProviderStateExecutor + Send + Sync>(
+  interaction: &dyn Interaction,
+  client: &Arc<reqwest::Client>,
+  provider_state_executor: &Arc<S>
+) -> Result<(), MismatchResult> {
+  let provider_states = interaction.provider_states();
+  if provider_states.is_empty() {
+    return Ok(());
+  }
+
+  for state in &provider_states {
+    info!("Running provider state change handler '{}' for '{}'", state.name, interaction.description());
+  }
+  execute_state_change(&provider_states, false, interaction.id(), client,
+                       provider_state_executor.clone()).await
+    .map(|_| ())
+    .map_err(|err| {
+      error!("Provider state change teardown for '{}' has failed - {:?}", interaction.description(), err);
+      MismatchResult::Error("One or more of the state change handlers has failed during teardown phase".to_string(), interaction.id())
+    })
+}
+
+/// Verifies the interaction against the provider, once its provider states have been set up
+async fn verify_interaction_in_state<F: RequestFilterExecutor>(
   provider: &ProviderInfo,
   interaction: &dyn Interaction,
   options: &VerificationOptions<F>,
+  client: &Arc<reqwest::Client>,
+  provider_states_results: &HashMap<String, Value>
+) -> Result<Option<String>, MismatchResult> {
+  info!("Running provider verification for '{}'", interaction.description());
+  let context: HashMap<&str, Value> = provider_states_results.iter()
+    .map(|(k, v)| (k.as_str(), v.clone())).collect();
+  let mut result = Err(MismatchResult::Error("No interaction was verified".into(), interaction.id().clone()));
+  if let Some(interaction) = interaction.as_request_response() {
+    result = verify_response_from_provider(provider, &interaction, options, client, &context).await;
+  }
+  if interaction.is_message() {
+    result = verify_message_from_provider(provider, &interaction.boxed(), options, client, &context).await;
+  }
+  result
+}
+
+async fn verify_interaction<F: RequestFilterExecutor, S: ProviderStateExecutor + Send + Sync>(
+  provider: &ProviderInfo,
+  interaction: &dyn Interaction,
+  options: &VerificationOptions<F>,
+  client: &Arc<reqwest::Client>,
   provider_state_executor: &Arc<S>
 ) -> Result<Option<String>, MismatchResult> {
-  let client = Arc::new(reqwest::Client::builder()
-  .danger_accept_invalid_certs(options.disable_ssl_verification)
-  .timeout(Duration::from_millis(options.request_timeout))
-  .build()
-  .unwrap_or(reqwest::Client::new()));
-
-  let mut provider_states_results = hashmap!{};
-  let sc_results = futures::stream::iter(
-    interaction.provider_states().iter().map(|state| (state, client.clone())))
-    .then(|(state, client)| {
-      let state_name = state.name.clone();
-      info!("Running provider state change handler '{}' for '{}'", state_name, interaction.description());
-      async move {
-        execute_state_change(&state, true, interaction.id(), &client,
-                             provider_state_executor.clone())
-          .map_err(|err| {
-            error!("Provider state change for '{}' has failed - {:?}", state_name, err);
-            err
-          }).await
-      }
-    }).collect::<Vec<Result<HashMap<String, Value>, MismatchResult>>>().await;
-  if sc_results.iter().any(|result| result.is_err()) {
-    return Err(MismatchResult::Error("One or more of the state change handlers has failed".to_string(), interaction.id()))
-  } else {
-    for result in sc_results {
-      if result.is_ok() {
-        for (k, v) in result.unwrap() {
-          provider_states_results.insert(k, v);
-        }
+  let provider_states_results = setup_provider_states(interaction, client, provider_state_executor).await?;
+
+  let result = verify_interaction_in_state(provider, interaction, options, client, &provider_states_results).await;
+
+  teardown_provider_states(interaction, client, provider_state_executor).await?;
+
+  result
+}
+
+/// Key used to group interactions that have the same provider states
+fn provider_states_key(interaction: &dyn Interaction) -> String {
+  interaction.provider_states().iter()
+    .map(|state| format!("{}:{:?}", state.name, state.params.iter().sorted_by(|a, b| a.0.cmp(b.0)).collect::<Vec<_>>()))
+    .join("\n")
+}
+
+/// Verifies the interactions, grouping the ones with the same provider states together so that
+/// the setup and teardown state changes are only run once for each group. The results are
+/// returned with the index of each interaction.
+async fn verify_interactions_grouped_by_state<'a, F: RequestFilterExecutor, S: ProviderStateExecutor + Send + Sync>(
+  provider: &ProviderInfo,
+  interactions: Vec<(usize, &'a dyn Interaction)>,
+  options: &VerificationOptions<F>,
+  client: &Arc<reqwest::Client>,
+  provider_state_executor: &Arc<S>
+) -> Vec<(usize, &'a dyn Interaction, Result<Option<String>, MismatchResult>)> {
+  let mut groups: Vec<Vec<(usize, &dyn Interaction)>> = vec![];
+  let mut group_index: HashMap<String, usize> = hashmap!{};
+  for (index, interaction) in interactions {
+    let key = provider_states_key(interaction);
+    match group_index.get(&key) {
+      Some(group) => groups[*group].push((index, interaction)),
+      None => {
+        group_index.insert(key, groups.len());
+        groups.push(vec![(index, interaction)]);
       }
     }
-  };
+  }
 
-  info!("Running provider verification for '{}'", interaction.description());
-  let result = futures::future::ready((provider_states_results.iter()
-    .map(|(k, v)| (k.as_str(), v.clone())).collect(), client.clone()))
-    .then(|(context, client)| async move {
-    let mut result = Err(MismatchResult::Error("No interaction was verified".into(), interaction.id().clone()));
-    if let Some(interaction) = interaction.as_request_response() {
-      result = verify_response_from_provider(provider, &interaction, options, &client, &context).await;
-    }
-    if interaction.is_message() {
-      result = verify_message_from_provider(provider, &interaction.boxed(), options, &client, &context).await;
-    }
-    result
-  }).await;
-
-  if !interaction.provider_states().is_empty() {
-    let sc_teardown_result = futures::stream::iter(
-      interaction.provider_states().iter().map(|state| (state, client.clone())))
-      .then(|(state, client)| async move {
-        let state_name = state.name.clone();
-        info!("Running provider state change handler '{}' for '{}'", state_name, interaction.description());
-        execute_state_change(&state, false, interaction.id(), &client,
-                             provider_state_executor.clone())
-          .map_err(|err| {
-            error!("Provider state change teardown for '{}' has failed - {:?}", state.name, err);
-            err
-          }).await
-      }).collect::<Vec<Result<HashMap<String, Value>, MismatchResult>>>().await;
-
-    if sc_teardown_result.iter().any(|result| result.is_err()) {
-      return Err(MismatchResult::Error("One or more of the state change handlers has failed during teardown phase".to_string(), interaction.id()))
+  let mut results = vec![];
+  for group in groups {
+    let (_, first) = group[0];
+    match setup_provider_states(first, client, provider_state_executor).await {
+      Ok(provider_states_results) => {
+        let group_start = results.len();
+        for (index, interaction) in group {
+          let result = verify_interaction_in_state(provider, interaction, options, client, &provider_states_results).await;
+          results.push((index, interaction, result));
+        }
+        if let Err(err) = teardown_provider_states(first, client, provider_state_executor).await {
+          for (_, _, result) in &mut results[group_start..] {
+            *result = Err(err.clone());
+          }
+        }
+      },
+      Err(err) => for (index, interaction) in group {
+        results.push((index, interaction, Err(err.clone())));
+      }
     }
   }
-
-  result
+  results
 }
 
 fn display_result(
@@ -496,7 +580,40 @@ pub struct VerificationOptions<F> where F: RequestFilterExecutor {
   /// Ignore invalid/self-signed SSL certificates
   pub disable_ssl_verification: bool,
   /// Timeout in ms for verification requests and state callbacks
-  pub request_timeout: u64
+  pub request_timeout: u64,
+  /// HTTP client to use for verification requests and state callbacks, so connections can be
+  /// reused across verifications. If not set, a new client is created for each pact using the
+  /// `disable_ssl_verification` and `request_timeout` options.
+  pub client: Option<Arc<reqwest::Client>>,
+  /// HTTP client to use for the requests to the Pact Broker, so connections to the broker are
+  /// pooled across fetching the pacts and publishing the results. If not set, a new client is
+  /// created for each verification run.
+  pub broker_client: Option<Arc<reqwest::Client>>,
+  /// Maximum number of interactions without provider states to verify at the same time. Defaults
+  /// to one. When it is greater than one, the interactions with provider states are verified one
+  /// at a time after the others. The results are always reported in the order of the interactions
+  /// in the pact.
+  pub interaction_concurrency: usize,
+  /// Directory to cache the pact documents fetched from a Pact Broker in. Pacts that have not
+  /// changed since they were cached are then loaded from the directory instead of being downloaded
+  /// again. If not set, pacts are always downloaded.
+  pub pact_cache_dir: Option<PathBuf>,
+  /// If interactions with the same provider states should be verified together, so the provider
+  /// state setup and teardown calls are only made once for each group of interactions. The results
+  /// are still reported in the order of the interactions in the pact.
+  pub group_provider_states: bool,
+  /// Maximum number of pacts to verify at the same time. Defaults to one. As provider states from
+  /// different pacts can then be set up at the same time, this should only be used with providers
+  /// where the states of different pacts do not affect each other. The output of pacts that are
+  /// verified at the same time can be interleaved, but the failures are reported in order.
+  pub pact_concurrency: usize,
+  /// Only verify the interactions assigned to this shard. When set, the results are not published
+  /// to the Pact Broker, as they are only for some of the interactions of each pact. Set
+  /// `shard_results` as well, otherwise the results of the shard are discarded.
+  pub shard: Option<Shard>,
+  /// File to write the results of the shard to, so they can be merged with the results of the
+  /// other shards and published with `shards::publish_shard_results`
+  pub shard_results: Option<PathBuf>
 }
 
 impl <F: RequestFilterExecutor> Default for VerificationOptions<F> {
@@ -508,7 +625,15 @@ impl <F: RequestFilterExecutor> Default for VerificationOptions<F> {
       request_filter: None,
       provider_tags: vec![],
       disable_ssl_verification: false,
-      request_timeout: 5000
+      request_timeout: 5000,
+      client: None,
+      broker_client: None,
+      interaction_concurrency: 1,
+      pact_cache_dir: None,
+      group_provider_states: false,
+      pact_concurrency: 1,
+      shard: None,
+      shard_results: None
     }
   }
 }
@@ -532,7 +657,7 @@ fn display_notices(context: &Option<PactVerificationContext>, stage: &str) {
 }
 
 /// Verify the provider with the given pact sources.
-pub fn verify_provider<F: RequestFilterExecutor, S: ProviderStateExecutor>(
+pub fn verify_provider<F: RequestFilterExecutor, S: ProviderStateExecutor + Send + Sync>(
   provider_info: ProviderInfo,
   source: Vec<PactSource>,
   filter: FilterInfo,
@@ -551,7 +676,7 @@ pub fn verify_provider<F: RequestFilterExecutor, S: ProviderStateExecutor>(
 }
 
 /// Verify the provider with the given pact sources (async version)
-pub async fn verify_provider_async<F: RequestFilterExecutor, S: ProviderStateExecutor>(
+pub async fn verify_provider_async<F: RequestFilterExecutor, S: ProviderStateExecutor + Send + Sync>(
     provider_info: ProviderInfo,
     source: Vec<PactSource>,
     filter: FilterInfo,
@@ -559,62 +684,45 @@ pub async fn verify_provider_async<F: RequestFilterExecutor, S: ProviderStateExe
     options: VerificationOptions<F>,
     provider_state_executor: &Arc<S>
 ) -> bool {
-    let pact_results = fetch_pacts(source, consumers).await;
+    let mut options = options;
+    if options.broker_client.is_none() {
+      options.broker_client = Some(Arc::new(reqwest::Client::new()));
+    }
+    let pact_results = fetch_pacts(source, consumers, &options.pact_cache_dir, &options.broker_client).await;
+
+    if let Some(shard) = options.shard {
+      if options.shard_results.is_none() {
+        warn!("The results of shard {} will be discarded, as no file to write them to has been set. They can not be merged with the results of the other shards and published.", shard);
+      } else if options.publish {
+        warn!("Verification results are not published when verifying a shard, they need to be merged with the results of the other shards first");
+      }
+    }
+
+    let outcomes: Vec<PactOutcome> = futures::stream::iter(pact_results)
+      .map(|pact_result| verify_fetched_pact(&provider_info, &filter, pact_result, &options, provider_state_executor))
+      .buffered(options.pact_concurrency.max(1))
+      .collect()
+      .await;
 
-    let mut results: Vec<(Option<String>, Result<(), MismatchResult>)> = vec![];
     let mut pending_errors: Vec<(String, MismatchResult)> = vec![];
     let mut errors: Vec<(String, MismatchResult)> = vec![];
-    for pact_result in pact_results {
-      match pact_result {
-        Ok((pact, context, pact_source)) => {
-          display_notices(&context, VERIFICATION_NOTICE_BEFORE);
-          println!("\nVerifying a pact between {} and {}",
-          Style::new().bold().paint(pact.consumer().name.clone()),
-          Style::new().bold().paint(pact.provider().name.clone()));
-
-          if pact.interactions().is_empty() {
-            println!("         {}", Yellow.paint("WARNING: Pact file has no interactions"));
-          } else {
-            let pending = match &context {
-              Some(context) => context.verification_properties.pending,
-              None => false
-            };
-            let result = verify_pact_internal(&provider_info, &filter, pact, &options,
-                                              &provider_state_executor.clone(), pending).await;
-            for result in &result.results {
-              results.push((result.interaction_id.clone(), result.result.clone()));
-              if let Err(error) = &result.result {
-                if result.pending {
-                  pending_errors.push((result.description.clone(), error.clone()));
-                } else {
-                  errors.push((result.description.clone(), error.clone()));
-                }
-              }
-            }
-
-            if options.publish {
-              publish_result(&results, &pact_source, &options).await;
+    let mut shard_pacts = vec![];
+    for outcome in outcomes {
+      pending_errors.extend(outcome.pending_errors);
+      errors.extend(outcome.errors);
+      shard_pacts.extend(outcome.shard_results);
+    }
 
-              if !errors.is_empty() || !pending_errors.is_empty() {
-                display_notices(&context, VERIFICATION_NOTICE_AFTER_ERROR_RESULT_AND_PUBLISH);
-              } else {
-                display_notices(&context, VERIFICATION_NOTICE_AFTER_SUCCESSFUL_RESULT_AND_PUBLISH);
-              }
-            } else {
-              if !errors.is_empty() || pending_errors.is_empty() {
-                display_notices(&context, VERIFICATION_NOTICE_AFTER_ERROR_RESULT_AND_NO_PUBLISH);
-              } else {
-                display_notices(&context, VERIFICATION_NOTICE_AFTER_SUCCESSFUL_RESULT_AND_NO_PUBLISH);
-              }
-            }
-          }
-        },
+    if let (Some(shard), Some(path)) = (options.shard, &options.shard_results) {
+      let results = ShardResults { shard, pacts: shard_pacts };
+      match write_shard_results(&results, path) {
+        Ok(_) => info!("Wrote the results of shard {} to '{}'", shard, path.display()),
         Err(err) => {
-          error!("Failed to load pact - {}", Red.paint(err.to_string()));
-          errors.push(("Failed to load pact".to_string(), MismatchResult::Error(err.to_string(), None)));
+          error!("{}", err);
+          errors.push(("Failed to write the shard results".to_string(), MismatchResult::Error(err.to_string(), None)));
         }
       }
-    };
+    }
 
     if !pending_errors.is_empty() {
       println!("\nPending Failures:\n");
@@ -632,6 +740,85 @@ pub async fn verify_provider_async<F: RequestFilterExecutor, S: ProviderStateExe
     }
 }
 
+/// Outcome of verifying one of the pacts fetched from the pact sources
+struct PactOutcome {
+  errors: Vec<(String, MismatchResult)>,
+  pending_errors: Vec<(String, MismatchResult)>,
+  shard_results: Option<ShardPactResults>
+}
+
+async fn verify_fetched_pact<F: RequestFilterExecutor, S: ProviderStateExecutor + Send + Sync>(
+  provider_info: &ProviderInfo,
+  filter: &FilterInfo,
+  pact_result: Result<(Box<dyn Pact>, Option<PactVerificationContext>, PactSource), String>,
+  options: &VerificationOptions<F>,
+  provider_state_executor: &Arc<S>
+) -> PactOutcome {
+  let mut outcome = PactOutcome { errors: vec![], pending_errors: vec![], shard_results: None };
+  match pact_result {
+    Ok((pact, context, pact_source)) => {
+      display_notices(&context, VERIFICATION_NOTICE_BEFORE);
+      println!("\nVerifying a pact between {} and {}",
+      Style::new().bold().paint(pact.consumer().name.clone()),
+      Style::new().bold().paint(pact.provider().name.clone()));
+
+      if pact.interactions().is_empty() {
+        println!("         {}", Yellow.paint("WARNING: Pact file has no interactions"));
+      } else {
+        let pending = match &context {
+          Some(context) => context.verification_properties.pending,
+          None => false
+        };
+        let result = verify_pact_internal(provider_info, filter, pact, options,
+                                          &provider_state_executor.clone(), pending).await;
+        let mut results: Vec<(Option<String>, Result<(), MismatchResult>)> = vec![];
+        for result in &result.results {
+          results.push((result.interaction_id.clone(), result.result.clone()));
+          if let Err(error) = &result.result {
+            if result.pending {
+              outcome.pending_errors.push((result.description.clone(), error.clone()));
+            } else {
+              outcome.errors.push((result.description.clone(), error.clone()));
+            }
+          }
+        }
+
+        if options.shard.is_some() {
+          if let PactSource::BrokerUrl(_, broker_url, _, links) = &pact_source {
+            let result = to_test_result(&results);
+            outcome.shard_results = Some(ShardPactResults {
+              broker_url: broker_url.clone(),
+              links: links.clone(),
+              success: result.to_bool(),
+              test_results: test_results_json(result)
+            });
+          }
+        } else if options.publish {
+          publish_result(&results, &pact_source, options).await;
+
+          if !outcome.errors.is_empty() || !outcome.pending_errors.is_empty() {
+            display_notices(&context, VERIFICATION_NOTICE_AFTER_ERROR_RESULT_AND_PUBLISH);
+          } else {
+            display_notices(&context, VERIFICATION_NOTICE_AFTER_SUCCESSFUL_RESULT_AND_PUBLISH);
+          }
+        }
+        if options.shard.is_some() || !options.publish {
+          if !outcome.errors.is_empty() || outcome.pending_errors.is_empty() {
+            display_notices(&context, VERIFICATION_NOTICE_AFTER_ERROR_RESULT_AND_NO_PUBLISH);
+          } else {
+            display_notices(&context, VERIFICATION_NOTICE_AFTER_SUCCESSFUL_RESULT_AND_NO_PUBLISH);
+          }
+        }
+      }
+    },
+    Err(err) => {
+      error!("Failed to load pact - {}", Red.paint(err.to_string()));
+      outcome.errors.push(("Failed to load pact".to_string(), MismatchResult::Error(err.to_string(), None)));
+    }
+  }
+  outcome
+}
+
 fn print_errors(errors: &Vec<(String, MismatchResult)>) {
   for (i, &(ref description, ref mismatch)) in errors.iter().enumerate() {
     match *mismatch {
@@ -659,7 +846,11 @@ fn print_errors(errors: &Vec<(String, MismatchResult)>) {
   }
 }
 
-async fn fetch_pact(source: PactSource) -> Vec<Result<(Box<dyn Pact>, Option<PactVerificationContext>, PactSource), String>> {
+async fn fetch_pact(
+  source: PactSource,
+  pact_cache_dir: &Option<PathBuf>,
+  broker_client: &Option<Arc<reqwest::Client>>
+) -> Vec<Result<(Box<dyn Pact>, Option<PactVerificationContext>, PactSource), String>> {
   match source {
     PactSource::File(ref file) => vec![read_pact(Path::new(&file))
       .map_err(|err| format!("Failed to load pact '{}' - {}", file, err))
@@ -677,10 +868,12 @@ async fn fetch_pact(source: PactSource) -> Vec<Result<(Box<dyn Pact>, Option<Pac
       .map_err(|err| format!("Failed to load pact '{}' - {}", url, err))
       .map(|pact| (pact, None, source))],
     PactSource::BrokerUrl(ref provider_name, ref broker_url, ref auth, _) => {
-      let result = pact_broker::fetch_pacts_from_broker(
+      let result = pact_broker::fetch_pacts_from_broker_with_options(
         broker_url.as_str(),
         provider_name.as_str(),
-        auth.clone()
+        auth.clone(),
+        pact_cache_dir.clone(),
+        broker_client.as_deref().cloned()
       ).await;
 
       match result {
@@ -706,14 +899,16 @@ async fn fetch_pact(source: PactSource) -> Vec<Result<(Box<dyn Pact>, Option<Pac
       }
     },
     PactSource::BrokerWithDynamicConfiguration { provider_name, broker_url, enable_pending, include_wip_pacts_since, provider_tags, selectors, auth, links: _ } => {
-      let result = pact_broker::fetch_pacts_dynamically_from_broker(
+      let result = pact_broker::fetch_pacts_dynamically_from_broker_with_options(
         broker_url.as_str(),
         provider_name.clone(),
         enable_pending,
         include_wip_pacts_since,
         provider_tags,
         selectors,
-        auth.clone()
+        auth.clone(),
+        pact_cache_dir.clone(),
+        broker_client.as_deref().cloned()
       ).await;
 
       match result {
@@ -743,11 +938,15 @@ async fn fetch_pact(source: PactSource) -> Vec<Result<(Box<dyn Pact>, Option<Pac
   }
 }
 
-async fn fetch_pacts(source: Vec<PactSource>, consumers: Vec<String>)
-  -> Vec<Result<(Box<dyn Pact>, Option<PactVerificationContext>, PactSource), String>> {
+async fn fetch_pacts(
+  source: Vec<PactSource>,
+  consumers: Vec<String>,
+  pact_cache_dir: &Option<PathBuf>,
+  broker_client: &Option<Arc<reqwest::Client>>
+) -> Vec<Result<(Box<dyn Pact>, Option<PactVerificationContext>, PactSource), String>> {
   futures::stream::iter(source)
-    .then(|pact_source| async {
-      futures::stream::iter(fetch_pact(pact_source).await)
+    .then(|pact_source| async move {
+      futures::stream::iter(fetch_pact(pact_source, pact_cache_dir, broker_client).await)
     })
     .flatten()
     .filter(|res| futures::future::ready(filter_consumers(&consumers, res)))
@@ -774,7 +973,7 @@ pub struct VerificationResult {
 }
 
 /// Internal function, public for testing purposes
-pub async fn verify_pact_internal<'a, F: RequestFilterExecutor, S: ProviderStateExecutor>(
+pub async fn verify_pact_internal<'a, F: RequestFilterExecutor, S: ProviderStateExecutor + Send + Sync>(
   provider_info: &ProviderInfo,
   filter: &FilterInfo,
   pact: Box<dyn Pact + 'a>,
@@ -782,17 +981,50 @@ pub async fn verify_pact_internal<'a, F: RequestFilterExecutor, S: ProviderState
   provider_state_executor: &Arc<S>,
   pending: bool
 ) -> VerificationResult {
-  let results: Vec<(&dyn Interaction, Result<Option<String>, MismatchResult>)> = futures::stream::iter(
-    pact.interactions().iter().cloned()
-  )
-    .filter(|interaction| futures::future::ready(filter_interaction(*interaction, filter)))
-    .then( |interaction| async move {
-      verify_interaction(provider_info, interaction, options, provider_state_executor)
-        .then(|result| futures::future::ready((interaction, result)))
+  let client = &provider_client(options);
+  let consumer = pact.consumer().name;
+  let provider = pact.provider().name;
+  let interactions = pact.interactions().iter().cloned()
+    .filter(|interaction| filter_interaction(*interaction, filter))
+    .filter(|interaction| options.shard.map(|shard| shard.includes(&consumer, &provider, *interaction)).unwrap_or(true))
+    .collect::<Vec<&dyn Interaction>>();
+  let results: Vec<(&dyn Interaction, Result<Option<String>, MismatchResult>)> = if options.interaction_concurrency > 1 || options.group_provider_states {
+    // Interactions with provider states can not be verified at the same time as any others, as
+    // the state changes could affect them
+    let (stateless, with_states): (Vec<_>, Vec<_>) = interactions.iter().cloned().enumerate()
+      .partition(|(_, interaction)| interaction.provider_states().is_empty());
+    let mut indexed_results: Vec<(usize, &dyn Interaction, Result<Option<String>, MismatchResult>)> = futures::stream::iter(stateless)
+      .map(|(index, interaction)| async move {
+        let result = verify_interaction(provider_info, interaction, options, client, provider_state_executor).await;
+        (index, interaction, result)
+      })
+      .buffer_unordered(options.interaction_concurrency.max(1))
+      .collect()
+      .await;
+    let state_results: Vec<(usize, &dyn Interaction, Result<Option<String>, MismatchResult>)> = if options.group_provider_states {
+      verify_interactions_grouped_by_state(provider_info, with_states, options, client, provider_state_executor).await
+    } else {
+      futures::stream::iter(with_states)
+        .then(|(index, interaction)| async move {
+          let result = verify_interaction(provider_info, interaction, options, client, provider_state_executor).await;
+          (index, interaction, result)
+        })
+        .collect()
         .await
-    })
-    .collect()
-    .await;
+    };
+    indexed_results.extend(state_results);
+    indexed_results.sort_by_key(|(index, _, _)| *index);
+    indexed_results.into_iter().map(|(_, interaction, result)| (interaction, result)).collect()
+  } else {
+    futures::stream::iter(interactions)
+      .then( |interaction| async move {
+        verify_interaction(provider_info, interaction, options, client, provider_state_executor)
+          .then(|result| futures::future::ready((interaction, result)))
+          .await
+      })
+      .collect()
+      .await
+  };
 
   let mut errors: Vec<VerificationInteractionResult> = vec![];
   for (interaction, match_result) in results {
@@ -869,6 +1101,18 @@ fn display_comments(interaction: Box<dyn V4Interaction>) {
   }
 }
 
+fn to_test_result(results: &[(Option<String>, Result<(), MismatchResult>)]) -> TestResult {
+  if results.iter().all(|(_, result)| result.is_ok()) {
+    TestResult::Ok(results.iter().map(|(id, _)| id.clone()).collect())
+  } else {
+    TestResult::Failed(
+      results.iter()
+      .map(|(id, result)| (id.clone(), result.as_ref().err().cloned()))
+      .collect()
+    )
+  }
+}
+
 async fn publish_result<F: RequestFilterExecutor>(
   results: &[(Option<String>, Result<(), MismatchResult>)],
   source: &PactSource,
@@ -876,26 +1120,23 @@ async fn publish_result<F: RequestFilterExecutor>(
 ) {
   if let PactSource::BrokerUrl(_, broker_url, auth, links) = source.clone() {
     info!("Publishing verification results back to the Pact Broker");
-    let result = if results.iter().all(|(_, result)| result.is_ok()) {
+    let result = to_test_result(results);
+    if result.to_bool() {
       debug!("Publishing a successful result to {}", source);
-      TestResult::Ok(results.iter().map(|(id, _)| id.clone()).collect())
     } else {
       debug!("Publishing a failure result to {}", source);
-      TestResult::Failed(
-        results.iter()
-        .map(|(id, result)| (id.clone(), result.as_ref().err().cloned()))
-        .collect()
-      )
-    };
+    }
     let provider_version = options.provider_version.clone().unwrap();
-    let publish_result = publish_verification_results(
+    let publish_result = publish_test_results(
       links,
       broker_url.as_str(),
       auth.clone(),
-      result,
+      result.to_bool(),
+      test_results_json(result),
       provider_version,
       options.build_url.clone(),
-      options.provider_tags.clone()
+      options.provider_tags.clone(),
+      options.broker_client.as_deref().cloned()
     ).await;
 
     match &publish_result {
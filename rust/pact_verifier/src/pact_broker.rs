@@ -1,6 +1,7 @@
 //! Structs and functions for interacting with a Pact Broker
 
 use std::collections::HashMap;
+use std::path::PathBuf;
 
 use anyhow::anyhow;
 use futures::stream::*;
@@ -21,6 +22,7 @@ use pact_matching::s;
 use pact_models::http_utils::HttpAuth;
 
 use crate::MismatchResult;
+use crate::pact_cache::PactCache;
 
 use super::provider_client::join_paths;
 
@@ -175,6 +177,9 @@ impl Default for Link {
   }
 }
 
+/// Maximum number of pact documents that are fetched from the Pact Broker at the same time
+pub const MAX_CONCURRENT_PACT_FETCHES: usize = 8;
+
 /// HAL aware HTTP client
 #[derive(Clone)]
 pub struct HALClient {
@@ -182,7 +187,8 @@ pub struct HALClient {
   url: String,
   path_info: Option<serde_json::Value>,
   auth: Option<HttpAuth>,
-  retries: u8
+  retries: u8,
+  cache: Option<PactCache>
 }
 
 impl HALClient {
@@ -191,13 +197,29 @@ impl HALClient {
     HALClient { url: url.to_string(), auth, ..HALClient::default() }
   }
 
+  /// Stores the pact documents fetched by this client in the directory, and uses the stored
+  /// copies for documents that have not changed on the Pact Broker
+  pub fn with_pact_cache_dir(self, dir: Option<PathBuf>) -> HALClient {
+    HALClient { cache: dir.map(PactCache::new), ..self }
+  }
+
+  /// Uses the HTTP client for the requests to the Pact Broker, so connections to the broker are
+  /// pooled with the other HAL clients it is passed to. If not set, the HAL client creates its own.
+  pub fn with_client(self, client: Option<reqwest::Client>) -> HALClient {
+    match client {
+      Some(client) => HALClient { client, ..self },
+      None => self
+    }
+  }
+
   fn update_path_info(self, path_info: serde_json::Value) -> HALClient {
     HALClient {
       client: self.client.clone(),
       url: self.url.clone(),
       path_info: Some(path_info),
       auth: self.auth,
-      retries: self.retries
+      retries: self.retries,
+      cache: self.cache
     }
   }
 
@@ -255,6 +277,26 @@ impl HALClient {
     link: &Link,
     template_values: &HashMap<String, String>
   ) -> Result<serde_json::Value, PactBrokerError> {
+    let path = self.link_path(link, template_values)?;
+    self.fetch(&path).await
+  }
+
+  /// Fetch the pact document at the Link from the Pact broker, using the pact cache if the client
+  /// has one
+  async fn fetch_pact_document(
+    self,
+    link: &Link,
+    template_values: &HashMap<String, String>
+  ) -> Result<serde_json::Value, PactBrokerError> {
+    let path = self.link_path(link, template_values)?;
+    self.fetch_cached(&path).await
+  }
+
+  fn link_path(
+    &self,
+    link: &Link,
+    template_values: &HashMap<String, String>
+  ) -> Result<String, PactBrokerError> {
       let link_url = if link.templated {
           log::debug!("Link URL is templated");
           self.clone().parse_link_url(&link, &template_values)
@@ -273,12 +315,64 @@ impl HALClient {
       let joined_url = base_url.join(&link_url)
           .map_err(|err| PactBrokerError::UrlError(format!("{}", err)))?;
 
-      self.fetch(joined_url.path().into()).await
+      Ok(joined_url.path().to_string())
   }
 
   async fn fetch(self, path: &str) -> Result<serde_json::Value, PactBrokerError> {
     info!("Fetching path '{}' from pact broker", path);
 
+    let response = self.get(path, &[]).await?;
+
+    self.parse_broker_response(path.to_string(), response)
+        .await
+  }
+
+  async fn fetch_cached(self, path: &str) -> Result<serde_json::Value, PactBrokerError> {
+    let cache = match &self.cache {
+      Some(cache) => cache.clone(),
+      None => return self.fetch(path).await
+    };
+
+    info!("Fetching path '{}' from pact broker", path);
+
+    let url = join_paths(&self.url, path);
+    // The request is only made conditional when there is a cached document to fall back on
+    let cached = cache.lookup(&url);
+    let response = match &cached {
+      Some((etag, _)) => self.get(path, &[("if-none-match", etag.as_str())]).await?,
+      None => self.get(path, &[]).await?
+    };
+
+    let response = if response.status() == reqwest::StatusCode::NOT_MODIFIED {
+      match cached {
+        Some((_, document)) => {
+          debug!("Pact at path '{}' has not changed, using the cached copy", path);
+          return Ok(document);
+        },
+        None => {
+          // Not modified with nothing in the cache to use, so the request was made conditional
+          // somewhere else (i.e. by a proxy). Fetch it again, asking for it not to come from a cache.
+          warn!("Got a 304 Not Modified response for path '{}' but there is no cached copy, fetching it again", path);
+          self.get(path, &[("cache-control", "no-cache")]).await?
+        }
+      }
+    } else {
+      response
+    };
+
+    let etag = response.headers().get("etag")
+      .and_then(|etag| etag.to_str().ok())
+      .map(|etag| etag.to_string());
+    let document = self.parse_broker_response(path.to_string(), response).await?;
+    if let Some(etag) = etag {
+      if let Err(err) = cache.store(&url, &etag, &document) {
+        warn!("Failed to store the pact from path '{}' in the pact cache - {}", path, err);
+      }
+    }
+    Ok(document)
+  }
+
+  async fn get(&self, path: &str, headers: &[(&str, &str)]) -> Result<reqwest::Response, PactBrokerError> {
     let url = join_paths(&self.url, path).parse::<reqwest::Url>()
         .map_err(|err| PactBrokerError::UrlError(format!("{}", err)))?;
 
@@ -289,18 +383,17 @@ impl HALClient {
         },
         None => self.client.get(url)
     }.header("accept", "application/hal+json, application/json");
+    let request_builder = headers.iter()
+      .fold(request_builder, |builder, (name, value)| builder.header(*name, *value));
 
-    let response = with_retries(self.retries, request_builder).await
+    with_retries(self.retries, request_builder).await
       .map_err(|err| {
           PactBrokerError::IoError(format!("Failed to access pact broker path '{}' - {}. URL: '{}'",
               &path,
               err,
               &self.url,
           ))
-      })?;
-
-    self.parse_broker_response(path.to_string(), response)
-        .await
+      })
   }
 
     async fn parse_broker_response(
@@ -519,13 +612,12 @@ async fn with_retries(retries: u8, request: RequestBuilder) -> Result<reqwest::R
 impl Default for HALClient {
   fn default() -> Self {
     HALClient {
-      client: reqwest::ClientBuilder::new()
-        .build()
-        .unwrap(),
+      client: reqwest::ClientBuilder::new().build().unwrap(),
       url: s!(""),
       path_info: None,
       auth: None,
-      retries: 3
+      retries: 3,
+      cache: None
     }
   }
 }
@@ -551,7 +643,22 @@ pub async fn fetch_pacts_from_broker(
   provider_name: &str,
   auth: Option<HttpAuth>
 ) -> anyhow::Result<Vec<anyhow::Result<(Box<dyn Pact + Send>, Option<PactVerificationContext>, Vec<Link>)>>> {
-    let mut hal_client = HALClient::with_url(broker_url, auth);
+  fetch_pacts_from_broker_with_options(broker_url, provider_name, auth, None, None).await
+}
+
+/// Fetches the pacts from the broker that match the provider name. Pacts are cached in the
+/// `pact_cache_dir` directory if one is given, and the requests to the broker use the `client`
+/// if one is given, so its connections can be shared with other requests.
+pub async fn fetch_pacts_from_broker_with_options(
+  broker_url: &str,
+  provider_name: &str,
+  auth: Option<HttpAuth>,
+  pact_cache_dir: Option<PathBuf>,
+  client: Option<reqwest::Client>
+) -> anyhow::Result<Vec<anyhow::Result<(Box<dyn Pact + Send>, Option<PactVerificationContext>, Vec<Link>)>>> {
+    let mut hal_client = HALClient::with_url(broker_url, auth)
+      .with_pact_cache_dir(pact_cache_dir)
+      .with_client(client);
     let template_values = hashmap!{ "provider".to_string() => provider_name.to_string() };
 
     hal_client = hal_client.navigate("pb:latest-provider-pacts", &template_values)
@@ -568,29 +675,30 @@ pub async fn fetch_pacts_from_broker(
 
     let pact_links = hal_client.clone().iter_links("pacts")?;
 
+    let template_values = &template_values;
     let results: Vec<_> = futures::stream::iter(pact_links)
-        .map(|ref pact_link| {
-          match pact_link.href {
-            Some(_) => Ok((hal_client.clone(), pact_link.clone())),
-            None => Err(
-              PactBrokerError::LinkError(
-                format!(
-                  "Expected a HAL+JSON response from the pact broker, but got a link with no HREF. URL: '{}', LINK: '{:?}'",
-                  &hal_client.url,
-                  pact_link
+        .map(|pact_link| {
+          let hal_client = hal_client.clone();
+          async move {
+            match pact_link.href {
+              Some(_) => {
+                let pact_json = hal_client.fetch_pact_document(&pact_link, template_values).await?;
+                Ok((pact_link, pact_json))
+              },
+              None => Err(
+                PactBrokerError::LinkError(
+                  format!(
+                    "Expected a HAL+JSON response from the pact broker, but got a link with no HREF. URL: '{}', LINK: '{:?}'",
+                    &hal_client.url,
+                    pact_link
+                  )
                 )
               )
-            )
+            }
           }
         })
-        .and_then(|(hal_client, pact_link)| async {
-          let pact_json = hal_client.fetch_url(
-            &pact_link.clone(),
-            &template_values.clone()
-          ).await?;
-          Ok((pact_link, pact_json))
-        })
-        .map(|result| {
+        .buffered(MAX_CONCURRENT_PACT_FETCHES)
+        .map(|result: Result<(Link, Value), PactBrokerError>| {
           match result {
             Ok((pact_link, pact_json)) => {
               let href = pact_link.href.unwrap_or_default();
@@ -608,7 +716,6 @@ pub async fn fetch_pacts_from_broker(
             Err(err) => Err(err.into())
           }
         })
-        .into_stream()
         .collect()
         .await;
 
@@ -625,7 +732,27 @@ pub async fn fetch_pacts_dynamically_from_broker(
   consumer_version_selectors: Vec<ConsumerVersionSelector>,
   auth: Option<HttpAuth>
 ) -> Result<Vec<Result<(Box<dyn Pact + Send>, Option<PactVerificationContext>, Vec<Link>), PactBrokerError>>, PactBrokerError> {
-    let mut hal_client = HALClient::with_url(broker_url, auth);
+  fetch_pacts_dynamically_from_broker_with_options(broker_url, provider_name, pending, include_wip_pacts_since,
+    provider_tags, consumer_version_selectors, auth, None, None).await
+}
+
+/// Fetch Pacts from the broker using the "provider-pacts-for-verification" endpoint. Pacts are
+/// cached in the `pact_cache_dir` directory if one is given, and the requests to the broker use
+/// the `client` if one is given, so its connections can be shared with other requests.
+pub async fn fetch_pacts_dynamically_from_broker_with_options(
+  broker_url: &str,
+  provider_name: String,
+  pending: bool,
+  include_wip_pacts_since: Option<String>,
+  provider_tags: Vec<String>,
+  consumer_version_selectors: Vec<ConsumerVersionSelector>,
+  auth: Option<HttpAuth>,
+  pact_cache_dir: Option<PathBuf>,
+  client: Option<reqwest::Client>
+) -> Result<Vec<Result<(Box<dyn Pact + Send>, Option<PactVerificationContext>, Vec<Link>), PactBrokerError>>, PactBrokerError> {
+    let mut hal_client = HALClient::with_url(broker_url, auth)
+      .with_pact_cache_dir(pact_cache_dir)
+      .with_client(client);
     let template_values = hashmap!{ s!("provider") => provider_name.clone() };
 
     hal_client = hal_client.navigate("pb:provider-pacts-for-verification", &template_values)
@@ -699,29 +826,30 @@ pub async fn fetch_pacts_dynamically_from_broker(
       None => Err(PactBrokerError::NotFound(format!("No pacts were found for this provider")))
     }?;
 
+    let template_values = &template_values;
     let results: Vec<_> = futures::stream::iter(pact_links)
-      .map(|(ref pact_link, ref context)| {
-        match pact_link.href {
-          Some(_) => Ok((hal_client.clone(), pact_link.clone(), context.clone())),
-          None => Err(
-            PactBrokerError::LinkError(
-              format!(
-                "Expected a HAL+JSON response from the pact broker, but got a link with no HREF. URL: '{}', LINK: '{:?}'",
-                &hal_client.url,
-                pact_link
+      .map(|(pact_link, context)| {
+        let hal_client = hal_client.clone();
+        async move {
+          match pact_link.href {
+            Some(_) => {
+              let pact_json = hal_client.fetch_pact_document(&pact_link, template_values).await?;
+              Ok((pact_link, pact_json, context))
+            },
+            None => Err(
+              PactBrokerError::LinkError(
+                format!(
+                  "Expected a HAL+JSON response from the pact broker, but got a link with no HREF. URL: '{}', LINK: '{:?}'",
+                  &hal_client.url,
+                  pact_link
+                )
               )
             )
-          )
+          }
         }
       })
-      .and_then(|(hal_client, pact_link, context)| async {
-        let pact_json = hal_client.fetch_url(
-          &pact_link.clone(),
-          &template_values.clone()
-        ).await?;
-        Ok((pact_link, pact_json, context))
-      })
-      .map(|result| {
+      .buffered(MAX_CONCURRENT_PACT_FETCHES)
+      .map(|result: Result<(Link, Value, PactVerificationContext), PactBrokerError>| {
         match result {
           Ok((pact_link, pact_json, context)) => {
             let href = pact_link.href.unwrap_or_default();
@@ -741,7 +869,6 @@ pub async fn fetch_pacts_dynamically_from_broker(
           Err(err) => Err(err)
         }
       })
-      .into_stream()
       .collect()
       .await;
 
@@ -776,7 +903,25 @@ pub async fn publish_verification_results(
   build_url: Option<String>,
   provider_tags: Vec<String>
 ) -> Result<serde_json::Value, PactBrokerError> {
-  let hal_client = HALClient::with_url(broker_url, auth.clone());
+  let success = result.to_bool();
+  publish_test_results(links, broker_url, auth, success, test_results_json(result), version,
+    build_url, provider_tags, None).await
+}
+
+/// Publishes verification results where the results of each interaction have already been
+/// converted to the JSON form the broker expects, such as the merged results of several shards
+pub(crate) async fn publish_test_results(
+  links: Vec<Link>,
+  broker_url: &str,
+  auth: Option<HttpAuth>,
+  success: bool,
+  test_results: Vec<serde_json::Value>,
+  version: String,
+  build_url: Option<String>,
+  provider_tags: Vec<String>,
+  client: Option<reqwest::Client>
+) -> Result<serde_json::Value, PactBrokerError> {
+  let hal_client = HALClient::with_url(broker_url, auth.clone()).with_client(client);
 
   if !provider_tags.is_empty() {
     publish_provider_tags(&hal_client, &links, provider_tags, &version).await?;
@@ -790,13 +935,23 @@ pub async fn publish_verification_results(
           "Response from the pact broker has no 'pb:publish-verification-results' link".into()
       ))?;
 
-  let json = build_payload(result, version, build_url);
+  let json = build_payload_from_test_results(success, test_results, version, build_url);
   hal_client.post_json(publish_link.href.unwrap_or_default().as_str(), json.to_string().as_str()).await
 }
 
 fn build_payload(result: TestResult, version: String, build_url: Option<String>) -> serde_json::Value {
+  let success = result.to_bool();
+  build_payload_from_test_results(success, test_results_json(result), version, build_url)
+}
+
+fn build_payload_from_test_results(
+  success: bool,
+  test_results: Vec<serde_json::Value>,
+  version: String,
+  build_url: Option<String>
+) -> serde_json::Value {
   let mut json = json!({
-    "success": result.to_bool(),
+    "success": success,
     "providerApplicationVersion": version,
     "verifiedBy": {
       "implementation": "Pact-Rust",
@@ -809,6 +964,12 @@ fn build_payload(result: TestResult, version: String, build_url: Option<String>)
     json_obj.insert("buildUrl".into(), json!(build_url.unwrap()));
   }
 
+  json_obj.insert("testResults".into(), serde_json::Value::Array(test_results));
+  json
+}
+
+/// Converts the result to the JSON the broker expects for the result of each interaction
+pub(crate) fn test_results_json(result: TestResult) -> Vec<serde_json::Value> {
   match result {
     TestResult::Failed(mismatches) => {
       let values = mismatches.iter()
@@ -882,20 +1043,17 @@ fn build_payload(result: TestResult, version: String, build_url: Option<String>)
           }
 
           json
-        }).collect::<Vec<serde_json::Value>>();
-
-      json_obj.insert("testResults".into(), serde_json::Value::Array(values));
+        }).collect();
+      values
     }
     TestResult::Ok(ids) => {
-      let values = ids.iter().filter(|id| id.is_some())
+      ids.iter().filter(|id| id.is_some())
         .map(|id| json!({
         "interactionId": id.clone().unwrap_or_default(),
         "success": true
-      })).collect();
-      json_obj.insert("testResults".into(), serde_json::Value::Array(values));
+      })).collect()
     }
   }
-  json
 }
 
 async fn publish_provider_tags(
@@ -1054,6 +1212,58 @@ mod tests {
       pact_broker.url())));
   }
 
+  #[tokio::test]
+  async fn fetch_pact_document_uses_the_cached_copy_if_the_pact_has_not_changed() {
+    let pact_broker = PactBuilder::new("RustPactVerifier", "PactBrokerStub")
+      .interaction("a request for a pact that has not changed", |i| {
+          i.request
+            .path("/pacts/provider/Bob/consumer/Alice/latest")
+            .header("If-None-Match", "\"1234\"");
+          i.response.status(304);
+      })
+      .start_mock_server();
+
+    let cache_dir = std::env::temp_dir().join(format!("pact-broker-cache-test-{}", std::process::id()));
+    let url = join_paths(pact_broker.url().as_str(), "/pacts/provider/Bob/consumer/Alice/latest");
+    let document = json!({ "consumer": { "name": "Alice" }, "provider": { "name": "Bob" } });
+    PactCache::new(&cache_dir).store(&url, "\"1234\"", &document).unwrap();
+
+    let client = HALClient::with_url(pact_broker.url().as_str(), None)
+      .with_pact_cache_dir(Some(cache_dir.clone()));
+    let link = Link { href: Some("/pacts/provider/Bob/consumer/Alice/latest".to_string()), .. Link::default() };
+    let result = client.fetch_pact_document(&link, &hashmap!{}).await;
+    let _ = std::fs::remove_dir_all(&cache_dir);
+
+    expect!(result).to(be_ok().value(document));
+  }
+
+  #[tokio::test]
+  async fn fetch_pact_document_fetches_the_pact_again_if_it_is_not_modified_and_not_cached() {
+    let pact_broker = PactBuilder::new("RustPactVerifier", "PactBrokerStub")
+      .interaction("a request for a pact that has not changed", |i| {
+          i.request.path("/pacts/provider/Bob/consumer/Alice/latest");
+          i.response.status(304);
+      })
+      .interaction("a request for a pact that is not from a cache", |i| {
+          i.request
+            .path("/pacts/provider/Bob/consumer/Alice/latest")
+            .header("Cache-Control", "no-cache");
+          i.response
+            .header("Content-Type", "application/json")
+            .json_body(json_pattern!({ "consumer": { "name": "Alice" }, "provider": { "name": "Bob" } }));
+      })
+      .start_mock_server();
+
+    let cache_dir = std::env::temp_dir().join(format!("pact-broker-cache-miss-test-{}", std::process::id()));
+    let client = HALClient::with_url(pact_broker.url().as_str(), None)
+      .with_pact_cache_dir(Some(cache_dir.clone()));
+    let link = Link { href: Some("/pacts/provider/Bob/consumer/Alice/latest".to_string()), .. Link::default() };
+    let result = client.fetch_pact_document(&link, &hashmap!{}).await;
+    let _ = std::fs::remove_dir_all(&cache_dir);
+
+    expect!(result).to(be_ok().value(json!({ "consumer": { "name": "Alice" }, "provider": { "name": "Bob" } })));
+  }
+
     #[test]
     fn content_type_test() {
         let response = reqwest::Response::from(
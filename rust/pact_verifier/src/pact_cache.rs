@@ -0,0 +1,101 @@
+//! On-disk cache of the pact documents fetched from a Pact Broker. Entries are keyed by the URL of
+//! the document and store the ETag returned by the broker, so a later fetch can send it with an
+//! `If-None-Match` header and use the stored document if the broker responds with Not Modified.
+
+use std::fs;
+use std::io;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use log::*;
+use serde::{Deserialize, Serialize};
+use serde_json::Value;
+
+use pact_models::hash_utils::fnv1a;
+
+/// Counter used to give each temporary file a unique name
+static TEMP_FILE_COUNTER: AtomicUsize = AtomicUsize::new(0);
+
+#[derive(Debug, Serialize, Deserialize)]
+struct CacheEntry {
+  url: String,
+  etag: String,
+  document: Value
+}
+
+/// Cache of pact documents stored in a directory
+#[derive(Debug, Clone)]
+pub(crate) struct PactCache {
+  dir: PathBuf
+}
+
+impl PactCache {
+  /// Creates a cache that stores the documents in the given directory. The directory is created
+  /// when the first document is stored.
+  pub(crate) fn new<P: AsRef<Path>>(dir: P) -> PactCache {
+    PactCache { dir: dir.as_ref().to_path_buf() }
+  }
+
+  /// The file name is a hash of the URL, which must not change between Rust releases so the
+  /// entries written by one build of the verifier can be read by another
+  fn entry_path(&self, url: &str) -> PathBuf {
+    self.dir.join(format!("{:016x}.json", fnv1a(url.as_bytes())))
+  }
+
+  /// Looks up the ETag and document stored for the URL
+  pub(crate) fn lookup(&self, url: &str) -> Option<(String, Value)> {
+    let path = self.entry_path(url);
+    let data = fs::read(&path).ok()?;
+    match serde_json::from_slice::<CacheEntry>(&data) {
+      // The URL is checked, as different URLs can hash to the same file name
+      Ok(entry) if entry.url == url => Some((entry.etag, entry.document)),
+      Ok(_) => None,
+      Err(err) => {
+        warn!("Ignoring invalid pact cache entry '{}' - {}", path.display(), err);
+        None
+      }
+    }
+  }
+
+  /// Stores the document with its ETag. The entry is written to a temporary file first and then
+  /// renamed, so concurrent readers never see a partially written entry.
+  pub(crate) fn store(&self, url: &str, etag: &str, document: &Value) -> io::Result<()> {
+    fs::create_dir_all(&self.dir)?;
+    let entry = CacheEntry {
+      url: url.to_string(),
+      etag: etag.to_string(),
+      document: document.clone()
+    };
+    let data = serde_json::to_vec(&entry)?;
+    let path = self.entry_path(url);
+    let temp_path = path.with_extension(format!("{}.{}.tmp", std::process::id(),
+      TEMP_FILE_COUNTER.fetch_add(1, Ordering::Relaxed)));
+    fs::write(&temp_path, data)?;
+    fs::rename(&temp_path, &path).map_err(|err| {
+      let _ = fs::remove_file(&temp_path);
+      err
+    })
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+  use serde_json::json;
+
+  use super::*;
+
+  #[test]
+  fn stores_and_looks_up_documents_by_url() {
+    let dir = std::env::temp_dir().join(format!("pact-cache-test-{}", std::process::id()));
+    let cache = PactCache::new(&dir);
+    let document = json!({ "consumer": { "name": "a" }, "provider": { "name": "b" } });
+
+    expect!(cache.lookup("http://broker/pacts/1")).to(be_none());
+    cache.store("http://broker/pacts/1", "\"etag-1\"", &document).unwrap();
+    expect!(cache.lookup("http://broker/pacts/1")).to(be_some().value(("\"etag-1\"".to_string(), document)));
+    expect!(cache.lookup("http://broker/pacts/2")).to(be_none());
+
+    let _ = fs::remove_dir_all(&dir);
+  }
+}
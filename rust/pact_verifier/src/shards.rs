@@ -0,0 +1,340 @@
+//! Splitting the verification of a provider across several processes, such as the nodes of a CI
+//! build. Each shard verifies the interactions assigned to it, which is decided by hashing the
+//! names of the consumer and provider and the interaction, so every shard makes the same decision
+//! without having to coordinate with the others.
+//!
+//! Publishing the results of one shard to the Pact Broker would report pacts as verified when
+//! only some of their interactions were, so the shards write their results to a file instead.
+//! Once all the shards are done, the files are merged and the results for each pact published
+//! with `publish_shard_results`.
+
+use std::fmt::{self, Display, Formatter};
+use std::fs;
+use std::path::Path;
+use std::str::FromStr;
+
+use anyhow::anyhow;
+use log::*;
+use serde::{Deserialize, Serialize};
+use serde_json::Value;
+
+use pact_matching::models::Interaction;
+use pact_models::hash_utils::Fnv1a;
+use pact_models::http_utils::HttpAuth;
+
+use crate::callback_executors::RequestFilterExecutor;
+use crate::pact_broker::{Link, publish_test_results};
+use crate::VerificationOptions;
+
+/// One of the shards the interactions are split between
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+pub struct Shard {
+  /// Index of the shard, starting at 1
+  pub index: usize,
+  /// Total number of shards
+  pub total: usize
+}
+
+impl Shard {
+  /// If the interaction of the pact between the consumer and provider is assigned to this shard
+  pub fn includes(&self, consumer: &str, provider: &str, interaction: &dyn Interaction) -> bool {
+    let mut hash = Fnv1a::new();
+    hash.write_part(consumer.as_bytes());
+    hash.write_part(provider.as_bytes());
+    hash.write_part(interaction.description().as_bytes());
+    for state in interaction.provider_states() {
+      hash.write_part(state.name.as_bytes());
+    }
+    (hash.finish() % self.total as u64) as usize == self.index - 1
+  }
+}
+
+impl FromStr for Shard {
+  type Err = String;
+
+  /// Parses a shard in the form `index/total`, such as `2/4`
+  fn from_str(s: &str) -> Result<Self, Self::Err> {
+    let mut parts = s.splitn(2, '/');
+    let (index, total) = match (parts.next(), parts.next()) {
+      (Some(index), Some(total)) => (index, total),
+      _ => return Err(format!("'{}' is not a valid shard, expected index/total", s))
+    };
+    let index = index.trim().parse::<usize>()
+      .map_err(|err| format!("'{}' is not a valid shard index: {}", index, err))?;
+    let total = total.trim().parse::<usize>()
+      .map_err(|err| format!("'{}' is not a valid shard total: {}", total, err))?;
+    if total == 0 || index == 0 || index > total {
+      Err(format!("'{}' is not a valid shard, the index must be between 1 and the total", s))
+    } else {
+      Ok(Shard { index, total })
+    }
+  }
+}
+
+impl Display for Shard {
+  fn fmt(&self, f: &mut Formatter<'_>) -> fmt::Result {
+    write!(f, "{}/{}", self.index, self.total)
+  }
+}
+
+/// Results of verifying a pact fetched from a Pact Broker, in the form they are published
+#[derive(Debug, Clone, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+pub struct ShardPactResults {
+  /// URL of the Pact Broker the pact was fetched from
+  pub broker_url: String,
+  /// Links from the pact, which include the link to publish the results to
+  pub links: Vec<Link>,
+  /// If all the interactions verified by the shard were successful
+  pub success: bool,
+  /// Result of each interaction, in the JSON form the broker expects
+  pub test_results: Vec<Value>
+}
+
+impl ShardPactResults {
+  fn publish_url(&self) -> Option<&str> {
+    self.links.iter()
+      .find(|link| link.name.eq_ignore_ascii_case("pb:publish-verification-results"))
+      .and_then(|link| link.href.as_deref())
+  }
+}
+
+/// Results written by a shard
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct ShardResults {
+  /// The shard that wrote the results
+  pub shard: Shard,
+  /// Results for each pact the shard verified
+  pub pacts: Vec<ShardPactResults>
+}
+
+/// Writes the shard results to the file as JSON
+pub fn write_shard_results(results: &ShardResults, path: &Path) -> anyhow::Result<()> {
+  fs::write(path, serde_json::to_vec_pretty(results)?)
+    .map_err(|err| anyhow!("Could not write the shard results to '{}' - {}", path.display(), err))
+}
+
+/// Reads the shard results written by `write_shard_results` from the file
+pub fn read_shard_results(path: &Path) -> anyhow::Result<ShardResults> {
+  let data = fs::read(path)
+    .map_err(|err| anyhow!("Could not read the shard results from '{}' - {}", path.display(), err))?;
+  serde_json::from_slice(&data)
+    .map_err(|err| anyhow!("'{}' does not contain valid shard results - {}", path.display(), err))
+}
+
+/// Merges the results of all the shards, giving the results for each pact. Fails if the results
+/// are not from exactly one of each of the shards, or if the results of a pact have no link to
+/// publish them to, as the merged results would then be missing the results of some interactions.
+/// A pact that some of the shards have no results for (for instance, because they could not load
+/// it) is marked as failed, as not all of its interactions were verified.
+pub fn merge_shard_results(shards: Vec<ShardResults>) -> anyhow::Result<Vec<ShardPactResults>> {
+  let total = shards.first().map(|results| results.shard.total)
+    .ok_or_else(|| anyhow!("There are no shard results to merge"))?;
+  let mut seen = vec![false; total];
+  for results in &shards {
+    let shard = results.shard;
+    if shard.index == 0 || shard.index > shard.total {
+      return Err(anyhow!("Shard {} is not a valid shard", shard));
+    }
+    if shard.total != total {
+      return Err(anyhow!("Shard {} is from a run with a different number of shards to {}", shard, total));
+    }
+    if seen[shard.index - 1] {
+      return Err(anyhow!("There is more than one set of results for shard {}", shard));
+    }
+    seen[shard.index - 1] = true;
+    if let Some(pact) = results.pacts.iter().find(|pact| pact.publish_url().is_none()) {
+      return Err(anyhow!("The results of shard {} for a pact from {} have no link to publish them to",
+        shard, pact.broker_url));
+    }
+  }
+  if let Some(missing) = seen.iter().position(|seen| !seen) {
+    return Err(anyhow!("The results for shard {}/{} are missing", missing + 1, total));
+  }
+
+  // The merged results of each pact, with the shards that reported results for it
+  let mut merged: Vec<(ShardPactResults, Vec<bool>)> = vec![];
+  for results in shards {
+    let index = results.shard.index - 1;
+    for pact in results.pacts {
+      match merged.iter_mut().find(|(existing, _)| existing.publish_url() == pact.publish_url()) {
+        Some((existing, reported)) => {
+          existing.success = existing.success && pact.success;
+          existing.test_results.extend(pact.test_results);
+          reported[index] = true;
+        },
+        None => {
+          let mut reported = vec![false; total];
+          reported[index] = true;
+          merged.push((pact, reported));
+        }
+      }
+    }
+  }
+
+  Ok(merged.into_iter().map(|(mut pact, reported)| {
+    if let Some(missing) = reported.iter().position(|reported| !reported) {
+      warn!("Shard {}/{} has no results for the pact published to {}, so it is marked as failed",
+        missing + 1, total, pact.publish_url().unwrap_or_default());
+      pact.success = false;
+    }
+    pact
+  }).collect())
+}
+
+/// Merges the results of all the shards, and publishes the results for each pact to the Pact
+/// Broker it was fetched from. The provider version, build URL and provider tags are taken from
+/// the options.
+pub async fn publish_shard_results<F: RequestFilterExecutor>(
+  shards: Vec<ShardResults>,
+  auth: Option<HttpAuth>,
+  options: &VerificationOptions<F>
+) -> anyhow::Result<()> {
+  let provider_version = options.provider_version.clone()
+    .ok_or_else(|| anyhow!("A provider version is required to publish the verification results"))?;
+  let mut failed = 0;
+  for pact in merge_shard_results(shards)? {
+    info!("Publishing the merged verification results to {}", pact.publish_url().unwrap_or_default());
+    let result = publish_test_results(
+      pact.links,
+      pact.broker_url.as_str(),
+      auth.clone(),
+      pact.success,
+      pact.test_results,
+      provider_version.clone(),
+      options.build_url.clone(),
+      options.provider_tags.clone(),
+      options.broker_client.as_deref().cloned()
+    ).await;
+    match result {
+      Ok(_) => info!("Results published to Pact Broker"),
+      Err(err) => {
+        error!("Publishing of verification results failed with an error: {}", err);
+        failed += 1;
+      }
+    }
+  }
+
+  if failed > 0 {
+    Err(anyhow!("Publishing the verification results failed for {} pact(s)", failed))
+  } else {
+    Ok(())
+  }
+}
+
+#[cfg(test)]
+mod tests {
+  use expectest::prelude::*;
+  use serde_json::json;
+
+  use pact_matching::models::RequestResponseInteraction;
+
+  use super::*;
+
+  fn pact_results(href: &str, success: bool, id: &str) -> ShardPactResults {
+    ShardPactResults {
+      broker_url: "http://broker".to_string(),
+      links: vec![Link {
+        name: "pb:publish-verification-results".to_string(),
+        href: Some(href.to_string()),
+        templated: false,
+        title: None
+      }],
+      success,
+      test_results: vec![json!({ "interactionId": id, "success": success })]
+    }
+  }
+
+  #[test]
+  fn parse_shard() {
+    expect!("2/4".parse::<Shard>()).to(be_ok().value(Shard { index: 2, total: 4 }));
+    expect!("1/1".parse::<Shard>()).to(be_ok().value(Shard { index: 1, total: 1 }));
+    expect!("0/4".parse::<Shard>()).to(be_err());
+    expect!("5/4".parse::<Shard>()).to(be_err());
+    expect!("1/0".parse::<Shard>()).to(be_err());
+    expect!("2".parse::<Shard>()).to(be_err());
+    expect!("a/b".parse::<Shard>()).to(be_err());
+  }
+
+  #[test]
+  fn each_interaction_is_assigned_to_exactly_one_shard() {
+    let total = 3;
+    let shards = (1..=total).map(|index| Shard { index, total }).collect::<Vec<_>>();
+    let mut counts = vec![0; total];
+    for i in 0..60 {
+      let interaction = RequestResponseInteraction {
+        description: format!("interaction {}", i),
+        .. RequestResponseInteraction::default()
+      };
+      let assigned = shards.iter()
+        .filter(|shard| shard.includes("consumer", "provider", &interaction))
+        .map(|shard| shard.index)
+        .collect::<Vec<_>>();
+      expect!(assigned.len()).to(be_equal_to(1));
+      expect!(shards[assigned[0] - 1].includes("consumer", "provider", &interaction)).to(be_true());
+      counts[assigned[0] - 1] += 1;
+    }
+    expect!(counts.iter().all(|count| *count > 0)).to(be_true());
+  }
+
+  #[test]
+  fn merge_shard_results_combines_the_results_for_each_pact() {
+    let merged = merge_shard_results(vec![
+      ShardResults {
+        shard: Shard { index: 2, total: 2 },
+        pacts: vec![pact_results("http://broker/a", true, "1"), pact_results("http://broker/b", false, "2")]
+      },
+      ShardResults {
+        shard: Shard { index: 1, total: 2 },
+        pacts: vec![pact_results("http://broker/a", true, "3")]
+      }
+    ]).unwrap();
+
+    expect!(merged.len()).to(be_equal_to(2));
+    expect!(merged[0].publish_url()).to(be_some().value("http://broker/a"));
+    expect!(merged[0].success).to(be_true());
+    expect!(merged[0].test_results.len()).to(be_equal_to(2));
+    expect!(merged[1].publish_url()).to(be_some().value("http://broker/b"));
+    expect!(merged[1].success).to(be_false());
+  }
+
+  #[test]
+  fn merge_shard_results_fails_pacts_that_a_shard_has_no_results_for() {
+    let merged = merge_shard_results(vec![
+      ShardResults {
+        shard: Shard { index: 1, total: 2 },
+        pacts: vec![pact_results("http://broker/a", true, "1"), pact_results("http://broker/b", true, "2")]
+      },
+      ShardResults {
+        shard: Shard { index: 2, total: 2 },
+        pacts: vec![pact_results("http://broker/a", true, "3")]
+      }
+    ]).unwrap();
+
+    expect!(merged.len()).to(be_equal_to(2));
+    expect!(merged[0].publish_url()).to(be_some().value("http://broker/a"));
+    expect!(merged[0].success).to(be_true());
+    expect!(merged[1].publish_url()).to(be_some().value("http://broker/b"));
+    expect!(merged[1].success).to(be_false());
+  }
+
+  #[test]
+  fn merge_shard_results_requires_a_link_to_publish_each_pact_to() {
+    let mut pact = pact_results("http://broker/a", true, "1");
+    pact.links.clear();
+    let merged = merge_shard_results(vec![
+      ShardResults { shard: Shard { index: 1, total: 1 }, pacts: vec![pact] }
+    ]);
+    expect!(merged).to(be_err());
+  }
+
+  #[test]
+  fn merge_shard_results_requires_the_results_of_every_shard() {
+    let shard = |index, total| ShardResults { shard: Shard { index, total }, pacts: vec![] };
+    expect!(merge_shard_results(vec![])).to(be_err());
+    expect!(merge_shard_results(vec![shard(1, 2)])).to(be_err());
+    expect!(merge_shard_results(vec![shard(1, 2), shard(1, 2)])).to(be_err());
+    expect!(merge_shard_results(vec![shard(1, 2), shard(2, 3)])).to(be_err());
+    expect!(merge_shard_results(vec![shard(1, 2), shard(2, 2)])).to(be_ok());
+  }
+}
@@ -13,6 +13,7 @@ use pact_matching::models::*;
 use pact_matching::s;
 use pact_models::Consumer;
 use pact_models::provider_states::*;
+use pact_models::request::Request;
 
 use crate::PactSource;
 use crate::callback_executors::HttpRequestProviderStateExecutor;
@@ -153,7 +154,7 @@ async fn test_state_change_with_parameters() {
     .. HttpRequestProviderStateExecutor::default()
   });
   let client = reqwest::Client::new();
-  let result = execute_state_change(&provider_state, true,
+  let result = execute_state_change(&[provider_state], true,
                                     None, &client, provider_state_executor).await;
   expect!(result.clone()).to(be_ok());
 }
@@ -191,7 +192,43 @@ async fn test_state_change_with_parameters_in_query() {
   });
   let client = reqwest::Client::new();
 
-  let result = execute_state_change(&provider_state, true,
+  let result = execute_state_change(&[provider_state], true,
+                                    None, &client, provider_state_executor).await;
+  expect!(result.clone()).to(be_ok());
+}
+
+#[tokio::test]
+async fn test_state_change_batch_sends_all_the_states_in_one_request() {
+  try_init().unwrap_or(());
+
+  let server = PactBuilder::new("RustPactVerifier", "SomeRunningProvider")
+    .interaction("a batched state change request", |i| {
+      i.request.method("POST");
+      i.request.path("/");
+      i.request.header("Content-Type", "application/json");
+      i.request.body("{\"states\":[{\"name\":\"StateOne\",\"params\":{\"A\":\"1\"}},{\"name\":\"StateTwo\",\"params\":{}}],\"action\":\"setup\"}");
+      i.response.status(200);
+    })
+    .start_mock_server();
+
+  let provider_states = vec![
+    ProviderState {
+      name: s!("StateOne"),
+      params: hashmap!{ s!("A") => json!("1") }
+    },
+    ProviderState {
+      name: s!("StateTwo"),
+      params: hashmap!{}
+    }
+  ];
+
+  let provider_state_executor = Arc::new(HttpRequestProviderStateExecutor {
+    state_change_url: Some(server.url().to_string()),
+    state_change_batch: true,
+    .. HttpRequestProviderStateExecutor::default()
+  });
+  let client = reqwest::Client::new();
+  let result = execute_state_change(&provider_states, true,
                                     None, &client, provider_state_executor).await;
   expect!(result.clone()).to(be_ok());
 }
@@ -222,7 +259,7 @@ async fn test_state_change_returning_json_values() {
     .. HttpRequestProviderStateExecutor::default()
   });
   let client = reqwest::Client::new();
-  let result = execute_state_change(&provider_state, true,
+  let result = execute_state_change(&[provider_state], true,
                                     None, &client, provider_state_executor).await;
   expect!(result.clone()).to(be_ok().value(hashmap! {
     "a".into() => json!("A"),
@@ -307,3 +344,121 @@ async fn publish_successful_result_to_broker() {
   let source = PactSource::BrokerUrl("Test".to_string(), server.url().to_string(), None, links);
   super::publish_result(&vec![(Some("1".to_string()), Ok(()))], &source, &options).await;
 }
+
+#[tokio::test]
+async fn verify_pact_internal_reports_results_in_interaction_order_when_verifying_concurrently() {
+  try_init().unwrap_or(());
+
+  let server = PactBuilder::new("RustPactVerifier", "SomeRunningProvider")
+    .interaction("request a", |i| {
+      i.request.path("/a");
+      i.response.status(200);
+    })
+    .interaction("request b", |i| {
+      i.request.path("/b");
+      i.response.status(200);
+    })
+    .interaction("request c", |i| {
+      i.request.path("/c");
+      i.response.status(200);
+    })
+    .start_mock_server();
+
+  let interaction = |description: &str, path: &str| RequestResponseInteraction {
+    description: description.to_string(),
+    request: Request { path: path.to_string(), .. Request::default() },
+    .. RequestResponseInteraction::default()
+  };
+  let pact = RequestResponsePact {
+    interactions: vec![
+      interaction("request c", "/c"),
+      interaction("request a", "/a"),
+      interaction("request b", "/b")
+    ],
+    .. RequestResponsePact::default()
+  };
+  let provider = super::ProviderInfo {
+    host: "127.0.0.1".to_string(),
+    port: server.url().port(),
+    .. super::ProviderInfo::default()
+  };
+  let options = super::VerificationOptions {
+    request_filter: None::<Arc<super::NullRequestFilterExecutor>>,
+    interaction_concurrency: 3,
+    .. super::VerificationOptions::default()
+  };
+  let provider_state_executor = Arc::new(HttpRequestProviderStateExecutor::default());
+
+  let result = super::verify_pact_internal(&provider, &FilterInfo::None, pact.boxed(), &options,
+    &provider_state_executor, false).await;
+
+  let descriptions: Vec<String> = result.results.iter()
+    .map(|result| result.description.rsplit(" - ").next().unwrap().to_string())
+    .collect();
+  expect!(descriptions).to(be_equal_to(vec!["request c".to_string(), "request a".to_string(), "request b".to_string()]));
+  expect!(result.results.iter().all(|result| result.result.is_ok())).to(be_true());
+}
+
+#[tokio::test]
+async fn verify_pact_internal_only_changes_shared_provider_states_once_when_grouping() {
+  try_init().unwrap_or(());
+
+  let server = PactBuilder::new("RustPactVerifier", "SomeRunningProvider")
+    .interaction("a state change setup request", |i| {
+      i.request.method("POST");
+      i.request.path("/");
+      i.request.header("Content-Type", "application/json");
+      i.request.body("{\"action\":\"setup\",\"state\":\"TestState\",\"params\":{}}");
+      i.response.status(200);
+    })
+    .interaction("a state change teardown request", |i| {
+      i.request.method("POST");
+      i.request.path("/");
+      i.request.header("Content-Type", "application/json");
+      i.request.body("{\"action\":\"teardown\",\"state\":\"TestState\",\"params\":{}}");
+      i.response.status(200);
+    })
+    .interaction("request a", |i| {
+      i.request.path("/a");
+      i.response.status(200);
+    })
+    .interaction("request b", |i| {
+      i.request.path("/b");
+      i.response.status(200);
+    })
+    .start_mock_server();
+
+  let interaction = |description: &str, path: &str| RequestResponseInteraction {
+    description: description.to_string(),
+    provider_states: vec![ ProviderState::default(&s!("TestState")) ],
+    request: Request { path: path.to_string(), .. Request::default() },
+    .. RequestResponseInteraction::default()
+  };
+  let pact = RequestResponsePact {
+    interactions: vec![
+      interaction("request a", "/a"),
+      interaction("request b", "/b")
+    ],
+    .. RequestResponsePact::default()
+  };
+  let provider = super::ProviderInfo {
+    host: "127.0.0.1".to_string(),
+    port: server.url().port(),
+    .. super::ProviderInfo::default()
+  };
+  let options = super::VerificationOptions {
+    request_filter: None::<Arc<super::NullRequestFilterExecutor>>,
+    group_provider_states: true,
+    .. super::VerificationOptions::default()
+  };
+  let provider_state_executor = Arc::new(HttpRequestProviderStateExecutor {
+    state_change_url: Some(server.url().to_string()),
+    .. HttpRequestProviderStateExecutor::default()
+  });
+
+  let result = super::verify_pact_internal(&provider, &FilterInfo::None, pact.boxed(), &options,
+    &provider_state_executor, false).await;
+
+  expect!(result.results.iter().all(|result| result.result.is_ok())).to(be_true());
+  expect!(server.metrics().requests).to(be_equal_to(4));
+}